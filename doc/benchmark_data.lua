@@ -1,7 +1,38 @@
 -- benchmark_data
 -- @short: Retrieve gathered benchmarking values.
--- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl
+-- @inargs:
+-- @inargs: vid:fsrv, bool:reset=false
+-- @outargs: nticks, tickcosttbl, framecount, frametimetbl, costcount, framecosttbl, synchtbl
+-- @outargs: timingtbl
+-- @longdescr: The first form returns the global tick and frame costs that
+-- are being collected after a call to ref:benchmark_enable. The *synchtbl*
+-- is always collected and has the fields frames, missed (frames that took
+-- more than 1.5 synch periods to reach the display), client_hit and
+-- client_miss (clients that the predict synchronization strategy expected
+-- to deliver before composition), margin and compose (the safety margin and
+-- modelled composition cost used by the predict strategy, in microseconds),
+-- uniforms and uniforms_skipped (shader uniform uploads issued and those
+-- skipped as the program already had the value, both since startup).
+--
+-- The second form returns frame timing statistics for the frameserver
+-- connected to *fsrv*. These are always collected. Each frame is timed
+-- from the point where the engine first sees it as ready, and *timingtbl*
+-- has one table for each of the following stages:
+-- ack (the contents have been uploaded and the buffer released to the client),
+-- compose (the frame has been composited in a video refresh),
+-- scanout (the platform synch following composition has completed),
+-- interval (time between two consecutive frames being ready) and, for output
+-- segments such as recordtargets, readback (from the readback being requested
+-- until the contents were handed over to the client).
+--
+-- Each stage table has the fields count, min, max, mean, p50, p90, p99 and
+-- p999, all in microseconds. Percentiles come from a log-linear histogram
+-- and are accurate to within 12.5%. The *superseded* field counts frames
+-- that were replaced by a newer one before they reached a synch, and
+-- *deadline_hit*, *deadline_miss* the per client form of the synchtbl fields.
+-- The *readback_drop* field counts readbacks that were skipped as all the
+-- readback buffers (video_readback_buffers, default 3) were still pending.
+-- If *reset* is set, the statistics are cleared after being returned.
 -- @group: system
 -- @cfunction: getbenchvals
 -- @related: benchmark_enable, benchmark_timestamp
-
@@ -53,6 +53,11 @@
 -- If [arg] is a table, it will be treated as n indexed and new lines will be
 -- appending at the end of the table [#tbl+1] = line1; [#tbl+2] = line2; and so
 -- on.
+-- If [arg] is a table followed by a function, lines are appended to the table
+-- as above and the function is then invoked once as callback(tbl, bool:eof)
+-- rather than once for each line.
+-- The local buffer starts at 64k and grows as needed to fit a line, up to 1M
+-- after which the buffered part is returned as a line of its own.
 --
 -- The lf_strip(bool) function affects read results to include or exclude a
 -- splitting linefeed if operating in linefeed mode. This is mainly an
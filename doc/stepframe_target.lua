@@ -31,9 +31,10 @@
 -- If possible storage- coordinate region (x+w,y+h) is defined, the processing
 -- stage is hinted that only a certain region of the target should actually be
 -- considered.
--- The function will return *false* if a step is requested while a readback is
--- already pending. This can happen if the receiving step, which in the case of
--- a recordtarget is an external process, is slow to process.
+-- The function will return *false* if a step is requested while all readback
+-- buffers for the target are already pending (see video_readback_buffers in
+-- the configuration). This can happen if the receiving step, which in the case
+-- of a recordtarget is an external process, is slow to process.
 -- @group: targetcontrol
 -- @related: define_calctarget, define_recordtarget
 -- @cfunction: targetstepframe
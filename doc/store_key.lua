@@ -14,6 +14,8 @@
 -- @note: If the string length of a value field is set to 0, the key
 -- will be deleted.
 -- To set multiple pairs at once, pack them in a key- indexed table.
+-- @note: Writes can be committed in the background, false is then returned
+-- if an earlier store could not be committed rather than this one.
 -- @group: database
 -- @cfunction: storekey
 -- @related: get_key, match_keys, list_targets, target_configurations
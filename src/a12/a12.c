@@ -304,6 +304,56 @@ static void send_hello_packet(struct a12_state* S,
 		STATE_CONTROL_PACKET, outb, CONTROL_PACKET_SIZE, NULL, 0);
 }
 
+/*
+ * Set while a12_channel_vframe_encode runs on the calling thread. Packets are
+ * then recorded into the pending buffer of the channel rather than sequenced
+ * and encrypted, each record is [struct deferred_pkt][prepend][data].
+ */
+static _Thread_local struct a12_channel* capture;
+
+struct deferred_pkt {
+	uint8_t type;
+	bool step;
+	uint32_t len;
+};
+
+static void deferred_out(struct a12_channel* ch, uint8_t type,
+	const uint8_t* const out, size_t out_sz, uint8_t* prepend, size_t prepend_sz)
+{
+	if (ch->pending.failed)
+		return;
+
+	struct deferred_pkt pkt = {
+		.type = type,
+		.step = ch->pending.step,
+		.len = out_sz + prepend_sz
+	};
+	ch->pending.step = false;
+
+	size_t required = ch->pending.ofs + sizeof(pkt) + pkt.len;
+	ch->pending.buf = grow_array(
+		ch->pending.buf, &ch->pending.buf_sz, required, -1);
+
+/* the encoder state has already moved on, the commit will fail the state */
+	if (ch->pending.buf_sz < required){
+		ch->pending.failed = true;
+		ch->pending.ofs = 0;
+		return;
+	}
+
+	uint8_t* dst = &ch->pending.buf[ch->pending.ofs];
+	memcpy(dst, &pkt, sizeof(pkt));
+	dst += sizeof(pkt);
+
+	if (prepend_sz){
+		memcpy(dst, prepend, prepend_sz);
+		dst += prepend_sz;
+	}
+
+	memcpy(dst, out, out_sz);
+	ch->pending.ofs = required;
+}
+
 /*
  * Used when a full byte buffer for a packet has been prepared, important
  * since it will also encrypt, generate MAC and add to buffer prestate.
@@ -328,6 +378,11 @@ static void send_hello_packet(struct a12_state* S,
 void a12int_append_out(struct a12_state* S, uint8_t type,
 	const uint8_t* const out, size_t out_sz, uint8_t* prepend, size_t prepend_sz)
 {
+	if (capture){
+		deferred_out(capture, type, out, out_sz, prepend, prepend_sz);
+		return;
+	}
+
 	if (S->state == STATE_BROKEN)
 		return;
 
@@ -731,6 +786,12 @@ a12_channel_close(struct a12_state* S)
 	a12int_encode_drop(S, S->out_channel, false);
 	a12int_decode_drop(S, S->out_channel, false);
 
+	DYNAMIC_FREE(ch->pending.buf);
+	ch->pending.buf = NULL;
+	ch->pending.buf_sz = 0;
+	ch->pending.ofs = 0;
+	ch->pending.failed = false;
+
 	if (ch->unpack_state.bframe.zstd){
 		ZSTD_freeDCtx(ch->unpack_state.bframe.zstd);
 		ch->unpack_state.bframe.zstd = NULL;
@@ -1160,6 +1221,7 @@ void a12_stream_cancel(struct a12_state* S, uint8_t channel)
 		struct a12_bhandler_meta bm = {
 			.fd = bframe->tmp_fd,
 			.state = A12_BHANDLER_CANCELLED,
+			.type = bframe->type,
 			.streamid = bframe->streamid,
 			.channel = channel
 		};
@@ -1413,9 +1475,18 @@ static void command_videoframe(struct a12_state* S)
 	if (channel->active == CHANNEL_RAW)
 		update_proxy_vcont(channel, vframe);
 
-/* shmif itself only needs the one though */
+/* shmif itself only needs the one though, the source resizes on its own terms
+ * and can be large (full desktops or several displays) so let the segment be
+ * reserved so that most resizes don't remap */
 	else if (hints_changed || vframe->sw != cont->w || vframe->sh != cont->h){
-			arcan_shmif_resize(cont, vframe->sw, vframe->sh);
+			arcan_shmif_resize_ext(cont, vframe->sw, vframe->sh,
+				(struct shmif_resize_ext){
+					.abuf_sz = cont->addr->abufsize,
+					.vbuf_cnt = -1,
+					.abuf_cnt = -1,
+					.samplerate = -1,
+					.flags = SHMIF_RESIZE_RESERVE
+				});
 
 		if (vframe->sw != cont->w || vframe->sh != cont->h){
 			a12int_trace(A12_TRACE_SYSTEM, "parent size rejected");
@@ -1848,6 +1919,10 @@ static void process_hello_auth(struct a12_state* S)
 - [21+ 32]  x25519 Pk     : blob,
 - [54]      Source/Sink
 	 */
+	S->remote_version[0] = S->decode[18];
+	S->remote_version[1] = S->decode[19];
+	a12int_trace(A12_TRACE_SYSTEM, "remote_version=%"PRIu8".%"PRIu8,
+		S->remote_version[0], S->remote_version[1]);
 
 	if (S->decode[54]){
 		S->remote_mode = ROLE_PROBE;
@@ -2161,10 +2236,13 @@ void a12_drop_tunnel(struct a12_state* S, uint8_t id)
 
 	int fd = S->channels[id].unpack_state.bframe.tmp_fd;
 	if (0 < fd){
-		close(fd);
+		if (!S->channels[id].unpack_state.bframe.tunnel_sink)
+			close(fd);
 		S->channels[id].unpack_state.bframe.active = false;
 		S->channels[id].unpack_state.bframe.tmp_fd = -1;
 	}
+	S->channels[id].unpack_state.bframe.tunnel_sink = NULL;
+	S->channels[id].unpack_state.bframe.tunnel_tag = NULL;
 }
 
 /*
@@ -2413,7 +2491,18 @@ static void process_blob(struct a12_state* S)
  * operations won't work so we are left with this. To not block video/audio
  * processing we would have to buffer / flush this separately, with a big
  * complexity leap. */
-	if (-1 != cbf->tmp_fd){
+	if (cbf->tunnel_sink){
+/* the sink owner holds the tag, so mark the tunnel closed like a TUNDROP and
+ * leave the release to it rather than cancelling this as a stream */
+		if (!cbf->tunnel_sink(buf, ntw, cbf->tunnel_tag)){
+			cbf->tunnel = 2;
+			reset_state(S);
+			if (free_buf)
+				DYNAMIC_FREE(buf);
+			return;
+		}
+	}
+	else if (-1 != cbf->tmp_fd){
 		size_t pos = 0;
 
 		while(pos < ntw){
@@ -2668,7 +2757,7 @@ static void process_audio(struct a12_state* S)
 			if (!arcan_shmif_resize_ext(cont,
 			cont->w, cont->h, (struct shmif_resize_ext){
 				.abuf_sz = 1024, .samplerate = caf->rate,
-				.abuf_cnt = 16, .vbuf_cnt = 1
+				.abuf_cnt = 16, .vbuf_cnt = 1, .flags = SHMIF_RESIZE_RESERVE
 			})){
 			a12int_trace(A12_TRACE_ALLOC, "frame-resize failed");
 			caf->commit = 255;
@@ -3267,13 +3356,10 @@ a12_channel_aframe(struct a12_state* S,
  * This function merely performs basic sanity checks of the input sources
  * then forwards to the corresponding _encode method that match the set opts.
  */
-void
-a12_channel_vframe(struct a12_state* S,
+/* returns the number of pixels covered by the update or 0 if it was dropped */
+static size_t vframe_encode(struct a12_state* S, uint8_t chid,
 	struct shmifsrv_vbuffer* vb, struct a12_vframe_opts opts)
 {
-	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
-		return;
-
 /* use a fix size now as the outb- writer lacks queueing and interleaving */
 	size_t chunk_sz = 32768;
 
@@ -3289,7 +3375,7 @@ a12_channel_vframe(struct a12_state* S,
 /* sanity check against a dumb client here as well */
 	if (!w || !h){
 		a12int_trace(A12_TRACE_SYSTEM, "kind=einval:status=bad dimensions");
-		return;
+		return 0;
 	}
 
 	if (x + w > vb->w || y + h > vb->h){
@@ -3317,13 +3403,11 @@ a12_channel_vframe(struct a12_state* S,
  * then we have the problem of the meta- area that should take
  * other package types when we get there
  */
-	uint32_t sid = S->out_stream;
+	uint32_t sid = capture ? 0 : S->out_stream;
 
 	a12int_trace(A12_TRACE_VIDEO,
 		"out vframe: %zu*%zu @%zu,%zu+%zu,%zu", vb->w, vb->h, w, h, x, y);
-#define argstr S, vb, opts, sid, x, y, w, h, chunk_sz, S->out_channel
-
-	size_t now = arcan_timemillis();
+#define argstr S, vb, opts, sid, x, y, w, h, chunk_sz, chid
 
 /* we have a pre-compressed passthrough - send it with the FOURCC stored
  * in place of expanded length and just send the buffer as is */
@@ -3359,15 +3443,97 @@ a12_channel_vframe(struct a12_state* S,
 	break;
 	default:
 		a12int_trace(A12_TRACE_SYSTEM, "unknown format: %d\n", opts.method);
-		return;
+		return 0;
 	break;
 	}
+#undef argstr
+
+	return w * h;
+}
+
+static void vframe_stats(struct a12_state* S, size_t ms, size_t px)
+{
+	if (ms && px){
+		S->stats.ms_vframe = ms;
+		S->stats.ms_vframe_px = (float) ms / (float) px;
+	}
+}
 
+void
+a12_channel_vframe(struct a12_state* S,
+	struct shmifsrv_vbuffer* vb, struct a12_vframe_opts opts)
+{
+	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
+		return;
+
+	size_t now = arcan_timemillis();
+	size_t px = vframe_encode(S, S->out_channel, vb, opts);
 	size_t then = arcan_timemillis();
-	if (then > now){
-		S->stats.ms_vframe = then - now;
-		S->stats.ms_vframe_px = (float)(then - now) / (float)(w * h);
+
+	vframe_stats(S, then > now ? then - now : 0, px);
+}
+
+void
+a12_channel_vframe_encode(struct a12_state* S, uint8_t chid,
+	struct shmifsrv_vbuffer* vb, struct a12_vframe_opts opts)
+{
+	if (!S || S->cookie != 0xfeedface || S->state == STATE_BROKEN)
+		return;
+
+/* the encoders only touch the channel state and emit through append_out and
+ * step_vstream, both of which record into the channel while capture is set */
+	struct a12_channel* ch = &S->channels[chid];
+	capture = ch;
+		size_t now = arcan_timemillis();
+		ch->pending.px = vframe_encode(S, chid, vb, opts);
+		size_t then = arcan_timemillis();
+	capture = NULL;
+
+	ch->pending.ms = then > now ? then - now : 0;
+}
+
+void
+a12_channel_vframe_commit(struct a12_state* S, uint8_t chid)
+{
+	if (!S || S->cookie != 0xfeedface)
+		return;
+
+	struct a12_channel* ch = &S->channels[chid];
+
+/* part of the frame is missing and the delta state on the other end would
+ * diverge, treat it the same as append_out failing to grow */
+	if (ch->pending.failed){
+		ch->pending.failed = false;
+		ch->pending.ofs = 0;
+		fail_state(S);
+		return;
+	}
+
+	size_t pos = 0;
+	while (pos < ch->pending.ofs && S->state != STATE_BROKEN){
+		struct deferred_pkt pkt;
+		memcpy(&pkt, &ch->pending.buf[pos], sizeof(pkt));
+		uint8_t* data = &ch->pending.buf[pos + sizeof(pkt)];
+		pos += sizeof(pkt) + pkt.len;
+
+/* the frame header was built before we knew the stream id and with whatever
+ * the last seen sequence number happened to be, patch in the current ones so
+ * the output matches that of a12_channel_vframe called here */
+		if (pkt.type == STATE_CONTROL_PACKET &&
+			pkt.len == CONTROL_PACKET_SIZE && data[17] == COMMAND_VIDEOFRAME){
+			uint32_t sid = S->out_stream;
+			step_sequence(S, data);
+			pack_u32(sid, &data[18]);
+			if (pkt.step)
+				a12int_step_vstream(S, sid);
+		}
+
+		a12int_append_out(S, pkt.type, data, pkt.len, NULL, 0);
 	}
+
+	ch->pending.ofs = 0;
+	ch->pending.step = false;
+	vframe_stats(S, ch->pending.ms, ch->pending.px);
 }
 
 bool
@@ -3508,6 +3674,12 @@ void* a12_sensitive_alloc(size_t nb)
 
 void a12int_step_vstream(struct a12_state* S, uint32_t id)
 {
+/* deferred to commit, the stream id is only assigned there */
+	if (capture){
+		capture->pending.step = true;
+		return;
+	}
+
 	size_t slot = S->congestion_stats.pending;
 
 /* clamp so that sz-1 compared to sz-2 can indicate how reckless the api
@@ -3534,6 +3706,12 @@ int a12_remote_mode(struct a12_state* S)
 	return S->remote_mode;
 }
 
+bool a12_remote_tpack_v2(struct a12_state* S)
+{
+	return S->remote_version[0] > 0 ||
+		S->remote_version[1] >= A12_TPACK_V2_MINOR;
+}
+
 void a12int_notify_dynamic_resource(struct a12_state* S,
 		const char* petname, uint8_t kpub[static 32], uint8_t role, bool added)
 {
@@ -3643,12 +3821,34 @@ int
 		return -1;
 }
 
+void*
+	a12_tunnel_tag(struct a12_state* S, uint8_t chid)
+{
+	if (!S->channels[chid].active)
+		return NULL;
+	return S->channels[chid].unpack_state.bframe.tunnel_tag;
+}
+
+bool
+	a12_set_tunnel_sink_cb(struct a12_state* S, uint8_t chid, int fd,
+		bool (*sink)(const uint8_t* buf, size_t buf_sz, void* tag), void* tag)
+{
+	if (-1 == fd || !sink)
+		return a12_set_tunnel_sink(S, chid, -1);
+
+	a12_set_tunnel_sink(S, chid, fd);
+	S->channels[chid].unpack_state.bframe.tunnel_sink = sink;
+	S->channels[chid].unpack_state.bframe.tunnel_tag = tag;
+	return true;
+}
+
 bool
 	a12_set_tunnel_sink(struct a12_state* S, uint8_t chid, int fd)
 {
 	if (S->channels[chid].active){
 		a12int_trace(A12_TRACE_DIRECTORY, "swap_sink:chid=%"PRIu8, chid);
-		if (0 < S->channels[chid].unpack_state.bframe.tmp_fd)
+		if (0 < S->channels[chid].unpack_state.bframe.tmp_fd &&
+			!S->channels[chid].unpack_state.bframe.tunnel_sink)
 			close(S->channels[chid].unpack_state.bframe.tmp_fd);
 	}
 
@@ -3656,6 +3856,8 @@ bool
 		S->channels[chid].active = false;
 		S->channels[chid].unpack_state.bframe.tunnel = false;
 		S->channels[chid].unpack_state.bframe.tmp_fd = -1;
+		S->channels[chid].unpack_state.bframe.tunnel_sink = NULL;
+		S->channels[chid].unpack_state.bframe.tunnel_tag = NULL;
 		return true;
 	}
 
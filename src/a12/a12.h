@@ -344,6 +344,18 @@ bool
 bool
 	a12_set_tunnel_sink(struct a12_state*, uint8_t chid, int fd);
 
+/* Same as a12_set_tunnel_sink, but incoming tunnel data is handed to [sink]
+ * rather than written to [fd]. The descriptor is still what is returned by
+ * a12_tunnel_descriptor for polling, but it is owned by the caller and is not
+ * closed when the tunnel is dropped or swapped. */
+bool
+	a12_set_tunnel_sink_cb(struct a12_state*, uint8_t chid, int fd,
+		bool (*sink)(const uint8_t* buf, size_t buf_sz, void* tag), void* tag);
+
+/* retrieve the [tag] of a tunnel set with a12_set_tunnel_sink_cb, or NULL */
+void*
+	a12_tunnel_tag(struct a12_state*, uint8_t chid);
+
 void
 	a12_drop_tunnel(struct a12_state*, uint8_t chid);
 
@@ -596,6 +608,26 @@ a12_channel_vframe(
 	struct a12_vframe_opts opts
 );
 
+/* Split form of a12_channel_vframe for when several threads feed the same
+ * state. The _encode stage runs the compression for [chid] and records the
+ * resulting packets in the channel, it only touches the per-channel encoder
+ * state and can run without holding whatever lock protects [S]. The _commit
+ * stage sequences, encrypts and queues the recorded packets and has to be
+ * serialised with all other calls that modify [S].
+ *
+ * There can be at most one thread encoding into a channel at a time and the
+ * channel should not be closed between the two stages. */
+void
+a12_channel_vframe_encode(
+	struct a12_state* S,
+	uint8_t chid,
+	struct shmifsrv_vbuffer* vb,
+	struct a12_vframe_opts opts
+);
+
+void
+a12_channel_vframe_commit(struct a12_state* S, uint8_t chid);
+
 /*
  * Forward / start a new channel intended for the 'real' client. If this
  * comes as a NEWSEGMENT event from the 'real' arcan instance, make sure
@@ -640,6 +672,12 @@ bool a12_ok(struct a12_state* S);
  */
 int a12_remote_mode(struct a12_state* S);
 
+/*
+ * Check if the remote end has announced that it can take TPACK v2 (RPACK_V2)
+ * buffers, this is false until its HELLO has been received.
+ */
+bool a12_remote_tpack_v2(struct a12_state* S);
+
 /*
  * Cancel a video stream that is ongoing in a specific channel
  */
@@ -416,11 +416,23 @@ static void compress_tzstd(struct a12_state* S, uint8_t ch,
 /* cursor state is last, do we have an extended header? */
 	bool extcursor = (vb->buffer_bytes[15] & 8) == 8;
 
-	size_t hdr_ver_sz = n_lines * raster_line_sz +
-		n_cells * raster_cell_sz + raster_hdr_sz +
-		extcursor * 3;
+/* v2 (flags, byte 9) is only for peers that announced it, the cells are
+ * variable sized so the length can only be checked against the buffer, the
+ * raster does the rest */
+	bool valid;
+	if (vb->buffer_bytes[9] & 4){
+		valid = a12_remote_tpack_v2(S) &&
+			compress_in_sz > raster_hdr_sz + extcursor * 3 &&
+			(!vb->buffer_sz || compress_in_sz <= vb->buffer_sz);
+	}
+	else {
+		size_t hdr_ver_sz = n_lines * raster_line_sz +
+			n_cells * raster_cell_sz + raster_hdr_sz +
+			extcursor * 3;
+		valid = compress_in_sz == hdr_ver_sz;
+	}
 
-	if (compress_in_sz != hdr_ver_sz){
+	if (!valid){
 		a12int_trace(A12_TRACE_SYSTEM, "kind=error:message=corrupt TPACK buffer");
 		return;
 	}
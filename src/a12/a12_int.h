@@ -31,6 +31,9 @@
 #define CONTROL_PACKET_SIZE 128
 #define CIPHER_ROUNDS 8
 
+/* first shmif version (sent in HELLO) that can unpack TPACK v2 */
+#define A12_TPACK_V2_MINOR 17
+
 #ifndef BLOB_QUEUE_CAP
 #define BLOB_QUEUE_CAP (128 * 1024)
 #endif
@@ -143,6 +146,8 @@ struct binary_frame {
 	int type;
 	bool active;
 	int tunnel;
+	bool (*tunnel_sink)(const uint8_t*, size_t, void*);
+	void* tunnel_tag;
 	uint64_t size;
 	uint32_t identifier;
 	uint8_t checksum[16];
@@ -224,6 +229,18 @@ struct a12_channel {
 /* used for both encoding and decoding, state is aliased into unpack_state */
 	struct shmifsrv_vbuffer acc;
 
+/* packets produced by a12_channel_vframe_encode, replayed through append_out
+ * by a12_channel_vframe_commit, see deferred_out in a12.c for the format */
+	struct {
+		uint8_t* buf;
+		size_t buf_sz;
+		size_t ofs;
+		size_t px;
+		size_t ms;
+		bool step;
+		bool failed;
+	} pending;
+
 	struct {
 		uint8_t* compression;
 		struct ZSTD_CCtx_s* zstd;
@@ -346,6 +363,7 @@ struct a12_state {
 	bool cl_firstout;
 	int authentic;
 	int remote_mode;
+	uint8_t remote_version[2];
 	char* endpoint;
 
 /* saved between calls to unpack, see end of a12_unpack for explanation */
@@ -20,7 +20,22 @@ struct a12_broadcast_beacon;
 struct anet_discover_opts;
 struct ipcfg;
 
+/*
+ * One end of a shared memory byte transport, see a12helper_shmring_pair.
+ * Treat as opaque, it is only exposed to allow it being passed by value.
+ */
+struct a12helper_shmring {
+	void* page;
+	size_t page_sz;
+	int efd_in;
+	int efd_out;
+	int side;
+};
+
 struct a12helper_opts {
+/* Pick the compression for a video frame. In the shmifsrv helper each segment
+ * has a thread of its own, this is called from those with the state lock held
+ * so [S] can be inspected, only the compression itself runs without it. */
 	struct a12_vframe_opts (*eval_vcodec)(
 		struct a12_state* S, int segid, struct shmifsrv_vbuffer*, void* tag);
 	void* tag;
@@ -47,6 +62,9 @@ struct a12helper_opts {
 
 /* opendir to populate with b64[checksum] for fonts and other cacheables */
 	int bcache_dir;
+
+/* if set, use the ring as bitstream carrier instead of fd_in/fd_out */
+	struct a12helper_shmring* ring;
 };
 
 /*
@@ -175,6 +193,68 @@ int a12helper_a12srv_shmifcl(
 	struct arcan_shmif_cont* prealloc,
 	struct a12_state* S, const char* cp, int fd_in, int fd_out);
 
+/*
+ * Same as a12helper_a12srv_shmifcl but with a shared memory ring (see
+ * a12helper_shmring_pair) as the bitstream carrier.
+ */
+int a12helper_a12srv_shmifcl_ring(
+	struct arcan_shmif_cont* prealloc,
+	struct a12_state* S, const char* cp, struct a12helper_shmring* ring);
+
+/*
+ * Create the two connected ends [out] of a shared memory transport for a12
+ * between two co-located parties (threads or processes related by fork).
+ * Each direction is a single producer / single consumer ring of at least
+ * [ring_sz] bytes with an eventfd for wakeups.
+ *
+ * Returns false if the platform lacks support (memfd/eventfd) or allocation
+ * failed, the caller is expected to fall back to a socketpair.
+ *
+ * After a fork, each side should _drop the end it doesn't use, _close marks
+ * the end as closed to the other side (reads there return 0 when drained).
+ */
+#ifndef A12HELPER_SHMRING_SZ
+#define A12HELPER_SHMRING_SZ 262144
+#endif
+bool a12helper_shmring_pair(size_t ring_sz, struct a12helper_shmring out[static 2]);
+void a12helper_shmring_close(struct a12helper_shmring*);
+void a12helper_shmring_drop(struct a12helper_shmring*);
+
+/*
+ * Descriptor that becomes readable when there is data to read or when space
+ * has been freed after a short write.
+ */
+int a12helper_shmring_pollfd(struct a12helper_shmring*);
+
+/*
+ * Non-blocking read / write with socket like semantics:
+ * read returns 0 when the other end is closed and the ring is drained, -1
+ * with errno set to EAGAIN if there is nothing to read.
+ * write returns the number of bytes that fit (possibly 0), -1 if the other
+ * end is closed.
+ */
+ssize_t a12helper_shmring_read(struct a12helper_shmring*, uint8_t* buf, size_t);
+ssize_t a12helper_shmring_write(
+	struct a12helper_shmring*, const uint8_t* buf, size_t);
+
+/*
+ * Blocking write, waits for the reader to make room. Returns false if the
+ * other end was closed.
+ */
+bool a12helper_shmring_write_all(
+	struct a12helper_shmring*, const uint8_t* buf, size_t);
+
+/*
+ * anet_authenticate equivalent with the ring as carrier.
+ */
+bool a12helper_shmring_authenticate(
+	struct a12_state* S, struct a12helper_shmring*, char** err);
+
+/*
+ * Matches the a12_set_tunnel_sink_cb signature with the ring as tag.
+ */
+bool a12helper_shmring_tunnel_sink(const uint8_t* buf, size_t buf_sz, void* tag);
+
 uint8_t* a12helper_tob64(const uint8_t* data, size_t inl, size_t* outl);
 bool a12helper_fromb64(const uint8_t* instr, size_t lim, uint8_t outb[static 32]);
 
@@ -322,9 +322,9 @@ static void auth_handler(struct a12_state* S, void* tag)
 	spawn_thread(S, C->user, C, 0);
 }
 
-int a12helper_a12srv_shmifcl(
-	struct arcan_shmif_cont* prealloc,
-	struct a12_state* S, const char* cp, int fd_in, int fd_out)
+static int a12srv_shmifcl(
+	struct arcan_shmif_cont* prealloc, struct a12_state* S, const char* cp,
+	int fd_in, int fd_out, struct a12helper_shmring* ring)
 {
 	if (!cp)
 		cp = getenv("ARCAN_CONNPATH");
@@ -376,12 +376,14 @@ int a12helper_a12srv_shmifcl(
 	}
 
 /*
- * Socket in/out liveness, buffer flush / dispatch
+ * Socket in/out liveness, buffer flush / dispatch, see a12_helper_srv.c for
+ * how the ring differs.
  */
 	size_t n_fd = 2;
 	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
+	bool ring_full = false;
 	struct pollfd fds[3] = {
-		{.fd = fd_in,        .events = POLLIN  | errmask},
+		{.fd = ring ? a12helper_shmring_pollfd(ring) : fd_in, .events = POLLIN  | errmask},
 		{.fd = pipe_pair[0], .events = POLLIN  | errmask},
 		{.fd = fd_out,       .events = POLLOUT | errmask}
 	};
@@ -389,7 +391,8 @@ int a12helper_a12srv_shmifcl(
 /* flush any left overs from authentication */
 	a12_unpack(S, NULL, 0, NULL, on_cl_event);
 
-	while(a12_ok(S) && -1 != poll(fds, n_fd, -1)){
+	while(a12_ok(S) &&
+		-1 != poll(fds, n_fd, ring && outbuf_sz && !ring_full ? 0 : -1)){
 		if (
 			(fds[0].revents & errmask) ||
 			(fds[1].revents & errmask) ||
@@ -410,7 +413,16 @@ int a12helper_a12srv_shmifcl(
 		}
 
 /* pending out, flush or grab next out buffer */
-		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
+		if (ring && outbuf_sz){
+			ssize_t nw = a12helper_shmring_write(ring, outbuf, outbuf_sz);
+			if (-1 == nw)
+				break;
+
+			ring_full = (size_t) nw < outbuf_sz;
+			outbuf += nw;
+			outbuf_sz -= nw;
+		}
+		else if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
 			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
@@ -429,7 +441,8 @@ int a12helper_a12srv_shmifcl(
 /* grab the lock from the other threads, unpack the data (which in turn will
  * trigger on_cl_event, the lock is held while that happens */
 		if (fds[0].revents & POLLIN){
-			ssize_t nr = recv(fd_in, inbuf, 9000, 0);
+			ssize_t nr = ring ?
+				a12helper_shmring_read(ring, inbuf, 9000) : recv(fd_in, inbuf, 9000, 0);
 			if (-1 == nr && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
 				BEGIN_CRITICAL(&cl, "read-buffer");
 					a12int_trace(A12_TRACE_SYSTEM, "failed to read from input: %d", errno);
@@ -446,10 +459,12 @@ int a12helper_a12srv_shmifcl(
 				break;
 			}
 
-			BEGIN_CRITICAL(&cl, "unpack-buffer");
-				a12int_trace(A12_TRACE_BTRANSFER, "unpack %zd bytes", nr);
-				a12_unpack(S, inbuf, nr, NULL, on_cl_event);
-			END_CRITICAL(&cl);
+			if (nr > 0){
+				BEGIN_CRITICAL(&cl, "unpack-buffer");
+					a12int_trace(A12_TRACE_BTRANSFER, "unpack %zd bytes", nr);
+					a12_unpack(S, inbuf, nr, NULL, on_cl_event);
+				END_CRITICAL(&cl);
+			}
 		}
 
 /* refill outgoing buffer if there is something left, better heuristics can be
@@ -458,10 +473,11 @@ int a12helper_a12srv_shmifcl(
 			BEGIN_CRITICAL(&cl, "step-buffer");
 				outbuf_sz = a12_flush(S, &outbuf, A12_FLUSH_ALL);
 			END_CRITICAL(&cl);
+			ring_full = false;
 		}
 
 /* poll accordingly */
-		n_fd = outbuf_sz > 0 ? 3 : 2;
+		n_fd = outbuf_sz > 0 && !ring ? 3 : 2;
 	}
 
 /* things died before authenticating, drop the context */
@@ -480,3 +496,17 @@ int a12helper_a12srv_shmifcl(
 
 	return 0;
 }
+
+int a12helper_a12srv_shmifcl(
+	struct arcan_shmif_cont* prealloc,
+	struct a12_state* S, const char* cp, int fd_in, int fd_out)
+{
+	return a12srv_shmifcl(prealloc, S, cp, fd_in, fd_out, NULL);
+}
+
+int a12helper_a12srv_shmifcl_ring(
+	struct arcan_shmif_cont* prealloc,
+	struct a12_state* S, const char* cp, struct a12helper_shmring* ring)
+{
+	return a12srv_shmifcl(prealloc, S, cp, -1, -1, ring);
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright: Bjorn Stahl
+ * License: 3-Clause BSD
+ * Description: Shared memory transport for a12 between co-located ends (e.g.
+ * a directory tunnel and the runner on the other side of it). Each end writes
+ * into its own single-producer single-consumer byte ring and wakes the other
+ * through an eventfd, so a packet costs a memcpy in and a memcpy out rather
+ * than a write() and a read() through a socketpair.
+ *
+ * The memory is a memfd mapped once per end so that the ends can be dropped
+ * independently, also when they end up on different sides of a fork().
+ */
+#include <arcan_shmif.h>
+#include <arcan_shmif_server.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+#include "a12.h"
+#include "a12_int.h"
+#include "a12_helper.h"
+
+/* head/tail are free-running byte counters, ring_sz is a power of two so the
+ * used count is simply head - tail */
+struct shmring_ctl {
+	_Atomic uint32_t head;
+	uint8_t pad0[60];
+	_Atomic uint32_t tail;
+	_Atomic uint32_t want_space;
+	_Atomic uint32_t closed;
+	uint8_t pad1[52];
+};
+
+struct shmring_page {
+	uint32_t ring_sz;
+	uint8_t pad[60];
+
+/* ctl[n] tracks the ring that end [n] writes into */
+	struct shmring_ctl ctl[2];
+	uint8_t data[];
+};
+
+static void signal_fd(int fd)
+{
+	uint64_t one = 1;
+	while (-1 == write(fd, &one, sizeof(one)) && errno == EINTR){}
+}
+
+static void clear_fd(int fd)
+{
+	uint64_t val;
+	while (-1 == read(fd, &val, sizeof(val)) && errno == EINTR){}
+}
+
+bool a12helper_shmring_pair(size_t ring_sz, struct a12helper_shmring out[static 2])
+{
+#ifdef __linux__
+	size_t sz = 4096;
+	while (sz < ring_sz)
+		sz <<= 1;
+
+	size_t page_sz = sizeof(struct shmring_page) + 2 * sz;
+	int mfd = memfd_create("a12ring", MFD_CLOEXEC);
+	if (-1 == mfd)
+		return false;
+
+	if (-1 == ftruncate(mfd, page_sz)){
+		close(mfd);
+		return false;
+	}
+
+	void* a = mmap(NULL, page_sz, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+	void* b = mmap(NULL, page_sz, PROT_READ | PROT_WRITE, MAP_SHARED, mfd, 0);
+	close(mfd);
+
+	int efd[2] = {
+		eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC),
+		eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)
+	};
+	int efd_dup[2] = {
+		-1 != efd[0] ? fcntl(efd[0], F_DUPFD_CLOEXEC, 0) : -1,
+		-1 != efd[1] ? fcntl(efd[1], F_DUPFD_CLOEXEC, 0) : -1
+	};
+
+	if (a == MAP_FAILED || b == MAP_FAILED ||
+		-1 == efd[0] || -1 == efd[1] || -1 == efd_dup[0] || -1 == efd_dup[1]){
+		if (a != MAP_FAILED)
+			munmap(a, page_sz);
+		if (b != MAP_FAILED)
+			munmap(b, page_sz);
+		for (size_t i = 0; i < 2; i++){
+			if (-1 != efd[i])
+				close(efd[i]);
+			if (-1 != efd_dup[i])
+				close(efd_dup[i]);
+		}
+		return false;
+	}
+
+	struct shmring_page* page = a;
+	page->ring_sz = sz;
+
+	out[0] = (struct a12helper_shmring){
+		.page = a,
+		.page_sz = page_sz,
+		.efd_in = efd[0],
+		.efd_out = efd[1],
+		.side = 0
+	};
+
+	out[1] = (struct a12helper_shmring){
+		.page = b,
+		.page_sz = page_sz,
+		.efd_in = efd_dup[1],
+		.efd_out = efd_dup[0],
+		.side = 1
+	};
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+int a12helper_shmring_pollfd(struct a12helper_shmring* R)
+{
+	return R->efd_in;
+}
+
+ssize_t a12helper_shmring_write(
+	struct a12helper_shmring* R, const uint8_t* buf, size_t buf_sz)
+{
+	struct shmring_page* page = R->page;
+	struct shmring_ctl* ctl = &page->ctl[R->side];
+	uint8_t* data = &page->data[R->side * page->ring_sz];
+	uint32_t mask = page->ring_sz - 1;
+
+	if (atomic_load(&page->ctl[!R->side].closed) || atomic_load(&ctl->closed)){
+		errno = EPIPE;
+		return -1;
+	}
+
+	uint32_t head = atomic_load_explicit(&ctl->head, memory_order_relaxed);
+	uint32_t tail = atomic_load(&ctl->tail);
+	size_t space = page->ring_sz - (head - tail);
+
+/* flag that we want to be woken and check again in case the reader consumed
+ * in between, it clears the flag and signals after publishing its tail */
+	if (!space){
+		atomic_store(&ctl->want_space, 1);
+		tail = atomic_load(&ctl->tail);
+		space = page->ring_sz - (head - tail);
+		if (!space)
+			return 0;
+	}
+
+	size_t n = buf_sz < space ? buf_sz : space;
+	size_t ofs = head & mask;
+	size_t run = page->ring_sz - ofs < n ? page->ring_sz - ofs : n;
+
+	memcpy(&data[ofs], buf, run);
+	if (n > run)
+		memcpy(data, &buf[run], n - run);
+
+	atomic_store_explicit(&ctl->head, head + n, memory_order_release);
+	signal_fd(R->efd_out);
+
+	return n;
+}
+
+ssize_t a12helper_shmring_read(
+	struct a12helper_shmring* R, uint8_t* buf, size_t buf_sz)
+{
+	struct shmring_page* page = R->page;
+	struct shmring_ctl* ctl = &page->ctl[!R->side];
+	uint8_t* data = &page->data[!R->side * page->ring_sz];
+	uint32_t mask = page->ring_sz - 1;
+
+/* closed is checked before head so that everything written before the other
+ * end closed is still drained */
+	bool closed = atomic_load(&ctl->closed);
+	uint32_t tail = atomic_load_explicit(&ctl->tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&ctl->head, memory_order_acquire);
+	bool cleared = false;
+
+/* only clear the wakeup when there is nothing left, then re-check as the
+ * writer might have published between the load and the clear */
+	if (head == tail){
+		if (closed)
+			return 0;
+
+		clear_fd(R->efd_in);
+		cleared = true;
+		head = atomic_load_explicit(&ctl->head, memory_order_acquire);
+		if (head == tail){
+			errno = EAGAIN;
+			return -1;
+		}
+	}
+
+	size_t used = head - tail;
+	if (used > page->ring_sz){
+		errno = EINVAL;
+		return -1;
+	}
+
+	size_t n = buf_sz < used ? buf_sz : used;
+	size_t ofs = tail & mask;
+	size_t run = page->ring_sz - ofs < n ? page->ring_sz - ofs : n;
+
+	memcpy(buf, &data[ofs], run);
+	if (n > run)
+		memcpy(&buf[run], data, n - run);
+
+	atomic_store(&ctl->tail, tail + n);
+	if (atomic_exchange(&ctl->want_space, 0))
+		signal_fd(R->efd_out);
+
+/* the wakeup was eaten above but there is more to read */
+	if (cleared && n < used)
+		signal_fd(R->efd_in);
+
+	return n;
+}
+
+bool a12helper_shmring_write_all(
+	struct a12helper_shmring* R, const uint8_t* buf, size_t buf_sz)
+{
+	bool ate = false;
+
+	while (buf_sz){
+		ssize_t nw = a12helper_shmring_write(R, buf, buf_sz);
+		if (-1 == nw)
+			break;
+
+		if (nw){
+			buf += nw;
+			buf_sz -= nw;
+			continue;
+		}
+
+/* the reader signals our end when it frees up space */
+		struct pollfd pfd = {.fd = R->efd_in, .events = POLLIN};
+		if (1 == poll(&pfd, 1, 1000)){
+			clear_fd(R->efd_in);
+			ate = true;
+		}
+	}
+
+/* that signal might also have meant data-in for whatever polls the end */
+	if (ate)
+		signal_fd(R->efd_in);
+
+	return buf_sz == 0;
+}
+
+static bool flushout(struct a12_state* S, struct a12helper_shmring* R, char** err)
+{
+	uint8_t* buf;
+	size_t out = a12_flush(S, &buf, 0);
+
+	if (out && !a12helper_shmring_write_all(R, buf, out)){
+		*err = strdup("ring closed during authentication\n");
+		return false;
+	}
+
+	return true;
+}
+
+bool a12helper_shmring_authenticate(
+	struct a12_state* S, struct a12helper_shmring* R, char** err)
+{
+	uint8_t inbuf[4096];
+
+/* same as anet_authenticate, only with the ring as carrier */
+	while (flushout(S, R, err) &&
+		a12_auth_state(S) != AUTH_FULL_PK && a12_poll(S) >= 0)
+	{
+		ssize_t nr = a12helper_shmring_read(R, inbuf, sizeof(inbuf));
+		if (nr > 0){
+			a12_unpack(S, inbuf, nr, NULL, NULL);
+		}
+		else if (nr == 0 || errno != EAGAIN){
+			*err = strdup("ring read failure during authentication\n");
+			return false;
+		}
+		else {
+			struct pollfd pfd = {.fd = R->efd_in, .events = POLLIN};
+			poll(&pfd, 1, -1);
+		}
+	}
+
+	return a12_auth_state(S) == AUTH_FULL_PK;
+}
+
+bool a12helper_shmring_tunnel_sink(const uint8_t* buf, size_t buf_sz, void* tag)
+{
+	return a12helper_shmring_write_all(tag, buf, buf_sz);
+}
+
+void a12helper_shmring_drop(struct a12helper_shmring* R)
+{
+	if (!R->page)
+		return;
+
+	munmap(R->page, R->page_sz);
+	close(R->efd_in);
+	close(R->efd_out);
+	*R = (struct a12helper_shmring){
+		.efd_in = -1,
+		.efd_out = -1
+	};
+}
+
+void a12helper_shmring_close(struct a12helper_shmring* R)
+{
+	if (!R->page)
+		return;
+
+	struct shmring_page* page = R->page;
+	atomic_store(&page->ctl[R->side].closed, 1);
+	signal_fd(R->efd_out);
+	a12helper_shmring_drop(R);
+}
@@ -64,6 +64,10 @@ static struct a12_vframe_opts vopts_from_segment(
 /* force tpack regardless, tpack doesn't have tuning like this */
 	if (vb.flags.tpack){
 		a12int_trace(A12_TRACE_VIDEO, "tpack segment");
+
+/* the peer might be older and only unpack v1 */
+		shmifsrv_client_caps(data->C,
+			a12_remote_tpack_v2(data->S) ? SHMIF_SRVCAP_TPACK_V2 : 0);
 		return (struct a12_vframe_opts){
 			.method = VFRAME_METHOD_TPACK_ZSTD
 		};
@@ -491,30 +495,35 @@ static void* client_thread(void* inarg)
 			break;
 		}
 
-		struct arcan_event ev;
+		struct arcan_event evs[PP_QUEUE_SZ];
+		size_t nev;
 
-		while (shmifsrv_dequeue_events(data->C, &ev, 1)){
-			if (arcan_shmif_descrevent(&ev)){
-				a12int_trace(A12_TRACE_SYSTEM,
-					"kind=error:status=EINVAL:message=client->server descriptor event");
-				continue;
-			}
+/* drain in bulk and only take the lock once per batch */
+		while ((nev = shmifsrv_dequeue_events(data->C, evs, COUNT_OF(evs)))){
+			BEGIN_CRITICAL(&giant_lock, "client_event");
+			for (size_t i = 0; i < nev; i++){
+				struct arcan_event* ev = &evs[i];
+				if (arcan_shmif_descrevent(ev)){
+					a12int_trace(A12_TRACE_SYSTEM,
+						"kind=error:status=EINVAL:message=client->server descriptor event");
+					continue;
+				}
 
 /* server-consumed or should be forwarded? */
-			BEGIN_CRITICAL(&giant_lock, "client_event");
-				if (shmifsrv_process_event(data->C, &ev)){
+				if (shmifsrv_process_event(data->C, ev)){
 					a12int_trace(A12_TRACE_EVENT,
 						"kind=consumed:channel=%d:eventstr=%s",
-						data->chid, arcan_shmif_eventstr(&ev, NULL, 0)
+						data->chid, arcan_shmif_eventstr(ev, NULL, 0)
 					);
 				}
 				else {
 					a12_set_channel(data->S, data->chid);
 					a12int_trace(A12_TRACE_EVENT, "kind=forward:channel=%d:eventstr=%s",
-						data->chid, arcan_shmif_eventstr(&ev, NULL, 0));
-					a12_channel_enqueue(data->S, &ev);
+						data->chid, arcan_shmif_eventstr(ev, NULL, 0));
+					a12_channel_enqueue(data->S, ev);
 					dirty = true;
 				}
+			}
 			END_CRITICAL(&giant_lock);
 		}
 
@@ -540,9 +549,12 @@ static void* client_thread(void* inarg)
 
 /* check the congestion window - there are many more options for congestion
  * control here, and the tuning is not figured out. One venue would be to
- * track which channel has a segment with focus, and prioritise those higher. */
-				struct a12_iostat stat = a12_state_iostat(data->S);
+ * track which channel has a segment with focus, and prioritise those higher.
+ * The counters are shared with the other segment threads so they are only
+ * read with the lock held. */
 				struct shmifsrv_vbuffer vb = shmifsrv_video(data->C);
+				BEGIN_CRITICAL(&giant_lock, "video-congestion");
+				struct a12_iostat stat = a12_state_iostat(data->S);
 
 				if (data->opts.vframe_block &&
 					stat.vframe_backpressure >= data->opts.vframe_soft_block){
@@ -562,6 +574,7 @@ static void* client_thread(void* inarg)
 							stat.vframe_backpressure, data->opts.vframe_soft_block,
 							data->opts.vframe_block
 						);
+						END_CRITICAL(&giant_lock);
 						break;
 					}
 				}
@@ -570,15 +583,23 @@ static void* client_thread(void* inarg)
  * streams map the stream and convert to h264 on gpu, but easiest now is to
  * just reject and let the caller do the readback. this is currently done by
  * default in shmifsrv.*/
-				BEGIN_CRITICAL(&giant_lock, "video-buffer");
-					a12_set_channel(data->S, data->chid);
-
 /* vopts_from_segment here lets the caller pick compression parameters (coarse),
- * including the special 'defer this frame until later' */
-					a12_channel_vframe(data->S, &vb, vopts_from_segment(data, vb));
+ * including the special 'defer this frame until later'. Both it and the
+ * eval_vcodec callback look at the shared state, so they run with the lock
+ * still held. The compression itself only touches our own channel and runs
+ * outside the lock, other segments can keep forwarding events, audio and their
+ * own frames meanwhile. Only the short packetize / encrypt stage of the commit
+ * is serialised. */
+				struct a12_vframe_opts vopts = vopts_from_segment(data, vb);
+				END_CRITICAL(&giant_lock);
+
+				a12_channel_vframe_encode(data->S, data->chid, &vb, vopts);
+
+				BEGIN_CRITICAL(&giant_lock, "video-buffer");
+					a12_channel_vframe_commit(data->S, data->chid);
 					dirty = true;
+					stat = a12_state_iostat(data->S);
 				END_CRITICAL(&giant_lock);
-				stat = a12_state_iostat(data->S);
 				a12int_trace(A12_TRACE_VDETAIL,
 					"vbuffer=release:time_ms=%zu:time_ms_px=%.4f:congestion=%zu",
 					stat.ms_vframe, stat.ms_vframe_px,
@@ -612,7 +633,11 @@ out:
 		a12_set_channel(data->S, data->chid);
 		a12_channel_close(data->S);
 		write(data->kill_fd, &data->chid, 1);
-		a12int_trace(A12_TRACE_SYSTEM, "client died");
+		struct shmifsrv_evstats evstats;
+		shmifsrv_client_evstats(data->C, &evstats);
+		a12int_trace(A12_TRACE_SYSTEM, "client died:channel=%d:events=%"PRIu64
+			":dropped=%"PRIu64":max_queue=%zu:last_rate=%zu", data->chid,
+			evstats.events, evstats.dropped, evstats.max_used, evstats.rate);
 	END_CRITICAL(&giant_lock);
 
 /* only shut-down everything on the primary- segment failure */
@@ -696,11 +721,15 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 	}
 	fake.user = arg;
 
-/* Socket in/out liveness, buffer flush / dispatch */
+/* Socket in/out liveness, buffer flush / dispatch. With a ring there is no
+ * POLLOUT to wait for, writes are tried every pass and the ring signals the
+ * same descriptor as data-in when a full ring has been drained. */
 	size_t n_fd = 2;
 	static const short errmask = POLLERR | POLLNVAL | POLLHUP;
+	struct a12helper_shmring* ring = opts.ring;
+	bool ring_full = false;
 	struct pollfd fds[3] = {
-		{	.fd = fd_in, .events = POLLIN | errmask},
+		{	.fd = ring ? a12helper_shmring_pollfd(ring) : fd_in, .events = POLLIN | errmask},
 		{ .fd = pipe_pair[0], .events = POLLIN | errmask},
 		{ .fd = fd_out, .events = POLLOUT | errmask}
 	};
@@ -709,7 +738,8 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 	a12_unpack(S, NULL, 0, arg, on_srv_event);
 
 	uint8_t inbuf[9000];
-	while(a12_ok(S) && -1 != poll(fds, n_fd, -1)){
+	while(a12_ok(S) &&
+		-1 != poll(fds, n_fd, ring && outbuf_sz && !ring_full ? 0 : -1)){
 
 /* death by poll? */
 		if ((fds[0].revents & errmask) ||
@@ -731,7 +761,16 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 		}
 
 /* pending out, flush or grab next out buffer */
-		if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
+		if (ring && outbuf_sz){
+			ssize_t nw = a12helper_shmring_write(ring, outbuf, outbuf_sz);
+			if (-1 == nw)
+				break;
+
+			ring_full = (size_t) nw < outbuf_sz;
+			outbuf += nw;
+			outbuf_sz -= nw;
+		}
+		else if (n_fd == 3 && (fds[2].revents & POLLOUT) && outbuf_sz){
 			ssize_t nw = write(fd_out, outbuf, outbuf_sz);
 
 			if (a12_trace_targets & A12_TRACE_TRANSFER){
@@ -750,7 +789,8 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 /* then read and unpack incoming data, note that in the on_srv_event handler
  * we ALREADY HOLD THE LOCK so it is a deadlock condition to try and lock there */
 		if (fds[0].revents & POLLIN){
-			ssize_t nr = recv(fd_in, inbuf, 9000, 0);
+			ssize_t nr = ring ?
+				a12helper_shmring_read(ring, inbuf, 9000) : recv(fd_in, inbuf, 9000, 0);
 			if (-1 == nr && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR){
 				if (a12_trace_targets & A12_TRACE_SYSTEM){
 					BEGIN_CRITICAL(&giant_lock, "data error");
@@ -767,18 +807,21 @@ void a12helper_a12cl_shmifsrv(struct a12_state* S,
 				break;
 			}
 
-			BEGIN_CRITICAL(&giant_lock, "unpack-event");
-				a12int_trace(A12_TRACE_TRANSFER, "unpack %zd bytes", nr);
-				a12_unpack(S, inbuf, nr, arg, on_srv_event);
-			END_CRITICAL(&giant_lock);
+			if (nr > 0){
+				BEGIN_CRITICAL(&giant_lock, "unpack-event");
+					a12int_trace(A12_TRACE_TRANSFER, "unpack %zd bytes", nr);
+					a12_unpack(S, inbuf, nr, arg, on_srv_event);
+				END_CRITICAL(&giant_lock);
+			}
 		}
 
 		if (!outbuf_sz){
 			BEGIN_CRITICAL(&giant_lock, "get-buffer");
 				outbuf_sz = a12_flush(S, &outbuf, 0);
 			END_CRITICAL(&giant_lock);
+			ring_full = false;
 		}
-		n_fd = outbuf_sz > 0 ? 3 : 2;
+		n_fd = outbuf_sz > 0 && !ring ? 3 : 2;
 	}
 
 	if (opts.bcache_dir > 0)
@@ -61,7 +61,9 @@ struct tunnel_state {
 	struct a12_state* parent;
 	bool* volatile shutdown;
 
+/* either fd or ring is used as carrier */
 	int fd;
+	struct a12helper_shmring ring;
 };
 
 static void* tunnel_runner(void* t)
@@ -70,12 +72,21 @@ static void* tunnel_runner(void* t)
 	char* err = NULL;
 	struct a12_state* S = a12_client(&ts->opts);
 
-	if (anet_authenticate(S, ts->fd, ts->fd, &err)){
-		a12helper_a12srv_shmifcl(ts->handover, S, NULL, ts->fd, ts->fd);
+	if (ts->ring.page){
+		if (a12helper_shmring_authenticate(S, &ts->ring, &err)){
+			a12helper_a12srv_shmifcl_ring(ts->handover, S, NULL, &ts->ring);
+		}
+		a12helper_shmring_close(&ts->ring);
+	}
+	else {
+		if (anet_authenticate(S, ts->fd, ts->fd, &err)){
+			a12helper_a12srv_shmifcl(ts->handover, S, NULL, ts->fd, ts->fd);
+		}
+
+		shutdown(ts->fd, SHUT_RDWR);
+		close(ts->fd);
 	}
 
-	shutdown(ts->fd, SHUT_RDWR);
-	close(ts->fd);
 	free(err);
 	free(ts);
 
@@ -85,10 +96,14 @@ static void* tunnel_runner(void* t)
 static void detach_tunnel_runner(
 	struct ioloop_shared* I,
 	int fd,
+	struct a12helper_shmring* ring,
 	struct a12_context_options* aopt,
 	struct a12_dynreq* req)
 {
 	struct tunnel_state* ts = malloc(sizeof(struct tunnel_state));
+	*ts = (struct tunnel_state){
+		.ring = ring ? *ring : (struct a12helper_shmring){.efd_in = -1, .efd_out = -1}
+	};
 	ts->opts = *aopt;
 	ts->req = *req;
 	ts->opts.pk_lookup_tag = &ts->req;
@@ -178,6 +193,23 @@ void dircl_source_handler(
 	};
 
 	if (req.proto == 4){
+/* both ends of the tunnel are in this process, so prefer the shared memory
+ * ring over a socketpair when the platform has it */
+		struct a12helper_shmring ring[2];
+		if (a12helper_shmring_pair(A12HELPER_SHMRING_SZ, ring)){
+			struct a12helper_shmring* own = malloc(sizeof(struct a12helper_shmring));
+			if (own){
+				*own = ring[0];
+				a12_set_tunnel_sink_cb(S, 1,
+					a12helper_shmring_pollfd(own), a12helper_shmring_tunnel_sink, own);
+				detach_tunnel_runner(I, -1, &ring[1], &a12opts, &req);
+				I->handover = NULL;
+				return;
+			}
+			a12helper_shmring_drop(&ring[0]);
+			a12helper_shmring_drop(&ring[1]);
+		}
+
 		int sv[2];
 		if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv)){
 			a12int_trace(A12_TRACE_DIRECTORY, "tunnel_socketpair_fail");
@@ -185,7 +217,7 @@ void dircl_source_handler(
 		}
 
 		a12_set_tunnel_sink(S, 1, sv[0]);
-		detach_tunnel_runner(I, sv[1], &a12opts, &req);
+		detach_tunnel_runner(I, sv[1], NULL, &a12opts, &req);
 		I->handover = NULL;
 		return;
 	}
@@ -861,6 +893,11 @@ struct a12_bhandler_res anet_directory_cl_bhandler(
  */
 	switch (M.state){
 	case A12_BHANDLER_COMPLETED:
+		if (M.type == A12_BTYPE_BLOB && cbt->appl_out){
+			fflush(cbt->appl_out);
+			appl_pkg_cache_store(cbt->clopt->basedir,
+				cbt->appl_out_checksum, fileno(cbt->appl_out));
+		}
 		mark_xfer_complete(I, M);
 	break;
 	case A12_BHANDLER_INITIALIZE:{
@@ -913,6 +950,21 @@ struct a12_bhandler_res anet_directory_cl_bhandler(
 			cbt->clopt->basedir = open(cbt->clopt->basedir_path, O_DIRECTORY);
 		}
 
+/* Already received this exact package? then substitute the cached copy and
+ * cancel, completion is triggered from the cancellation. */
+		int cached = appl_pkg_cache_open(cbt->clopt->basedir, M.checksum);
+		if (-1 != cached){
+			cbt->appl_out = fdopen(cached, "r");
+			if (cbt->appl_out){
+				a12int_trace(A12_TRACE_DIRECTORY, "appl_pkg:cached");
+				cbt->appl_out_cached = true;
+				res.flag = A12_BHANDLER_CACHED;
+				return res;
+			}
+			close(cached);
+		}
+		memcpy(cbt->appl_out_checksum, M.checksum, 16);
+
 		char filename[] = "appltemp-XXXXXX";
 		int appl_fd = mkstemp(filename);
 		if (-1 == appl_fd){
@@ -936,6 +988,11 @@ struct a12_bhandler_res anet_directory_cl_bhandler(
 			cbt->state_in = -1;
 			cbt->state_in_complete = false;
 		}
+		else if (M.type == A12_BTYPE_BLOB && cbt->appl_out_cached){
+			cbt->appl_out_cached = false;
+			M.state = A12_BHANDLER_COMPLETED;
+			mark_xfer_complete(I, M);
+		}
 		else if (M.type == A12_BTYPE_BLOB){
 			fprintf(stderr, "appl download cancelled\n");
 			if (cbt->appl_out){
@@ -24,6 +24,7 @@
 #include "a12_helper.h"
 #include "anet_helper.h"
 #include "directory.h"
+#include "hashmap.h"
 
 #include <sys/types.h>
 #include <sys/file.h>
@@ -32,59 +33,171 @@
 #include <fcntl.h>
 #include <poll.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 #include <stdatomic.h>
 #include <pthread.h>
 
 extern bool g_shutdown;
 
+/* upper bound for the number of event loop threads multiplexing workers */
+#ifndef DIRSRV_LOOP_LIM
+#define DIRSRV_LOOP_LIM 8
+#endif
+
+/* worst-case wait between sweeps, matches the shmifsrv monotonic tick */
+#ifndef DIRSRV_TICK_MS
+#define DIRSRV_TICK_MS 25
+#endif
+
+/* The lookup indices are all protected by the sync mutex, and the keys are
+ * stored in the dircl / appl_meta they refer to, so any entry must be removed
+ * before the memory backing the key is modified or released. */
 static struct {
 	pthread_mutex_t sync;
+	pthread_mutex_t trace_sync;
 	struct dircl root;
 	volatile struct anet_dirsrv_opts* opts;
+
+	struct hashmap_s petnames;
+	struct hashmap_s pubkeys;
+	struct hashmap_s members;
+	struct hashmap_s appl_ids;
+
 	char* dirlist;
 	size_t dirlist_sz;
+	bool dirlist_dirty;
 } active_clients = {
-	.sync = PTHREAD_MUTEX_INITIALIZER
+	.sync = PTHREAD_MUTEX_INITIALIZER,
+	.trace_sync = PTHREAD_MUTEX_INITIALIZER
 };
 
 #define A12INT_DIRTRACE(...) do { \
 	if (!(a12_trace_targets & A12_TRACE_DIRECTORY))\
 		break;\
-	pthread_mutex_lock(&active_clients.sync);\
+	pthread_mutex_lock(&active_clients.trace_sync);\
 		a12int_trace(A12_TRACE_DIRECTORY, __VA_ARGS__);\
-	pthread_mutex_unlock(&active_clients.sync);\
+	pthread_mutex_unlock(&active_clients.trace_sync);\
 	} while (0);
 
 static void rebuild_index();
+static void patch_index(volatile struct appl_meta* entry);
+
+static pthread_once_t index_once = PTHREAD_ONCE_INIT;
+static void setup_index()
+{
+	hashmap_create(64, &active_clients.petnames);
+	hashmap_create(64, &active_clients.pubkeys);
+	hashmap_create(64, &active_clients.members);
+	hashmap_create(64, &active_clients.appl_ids);
+}
+
+/* petnames are matched case-insensitive, fold into [out] and return length */
+static size_t fold_name(const char* in, char* out, size_t lim)
+{
+	size_t i = 0;
+	for (; i < lim - 1 && in[i]; i++)
+		out[i] = tolower((unsigned char) in[i]);
+	out[i] = '\0';
+	return i;
+}
+
+static size_t member_key(char* out, size_t lim, int appid, const char* name)
+{
+	int len = snprintf(out, lim, "%d:%s", appid, name);
+	if (len < 0)
+		return 0;
+	return (size_t) len >= lim ? lim - 1 : (size_t) len;
+}
+
+/* assumes active_clients are locked */
+static void index_remove(struct hashmap_s* map, const void* key, size_t len, void* val)
+{
+	if (len && hashmap_get(map, key, len) == val)
+		hashmap_remove(map, key, len);
+}
+
+/* assumes active_clients are locked, called whenever the petname, and with it
+ * the pubk that dynopen resolves against, changes */
+static void index_petname(struct dircl* C)
+{
+	index_remove(&active_clients.petnames, C->name_key, C->name_key_len, C);
+	C->name_key_len = fold_name(
+		C->petname.ext.netstate.name, C->name_key, COUNT_OF(C->name_key));
+
+	if (C->name_key_len)
+		hashmap_put(&active_clients.petnames, C->name_key, C->name_key_len, C);
+
+	if (C->pubk_indexed)
+		index_remove(&active_clients.pubkeys, C->pubk_key, 32, C);
+
+	memcpy(C->pubk_key, C->pubk, 32);
+	C->pubk_indexed = C->name_key_len > 0;
+
+	if (C->pubk_indexed)
+		hashmap_put(&active_clients.pubkeys, C->pubk_key, 32, C);
+}
+
+/* assumes active_clients are locked, two registrations of the same name can
+ * race past the collision check and the later one takes the index entry, so
+ * when the holder goes away the entry moves to the other */
+static void reindex_petname(struct dircl* C)
+{
+	if (!C->name_key_len ||
+		hashmap_get(&active_clients.petnames, C->name_key, C->name_key_len))
+		return;
+
+	for (struct dircl* cur = active_clients.root.next; cur; cur = cur->next){
+		if (cur != C && cur->name_key_len == C->name_key_len &&
+			memcmp(cur->name_key, C->name_key, C->name_key_len) == 0){
+			hashmap_put(&active_clients.petnames, cur->name_key, cur->name_key_len, cur);
+			return;
+		}
+	}
+}
+
+/* assumes active_clients are locked */
+static void unindex_client(struct dircl* C)
+{
+	index_remove(&active_clients.petnames, C->name_key, C->name_key_len, C);
+	reindex_petname(C);
+	C->name_key_len = 0;
+	index_remove(&active_clients.members, C->member_key, C->member_key_len, C);
+
+	if (!C->pubk_indexed)
+		return;
+
+/* Same key can be used by several connections (e.g. a source re-connecting
+ * before the old worker times out) so fallback to any other named match. */
+	index_remove(&active_clients.pubkeys, C->pubk_key, 32, C);
+	C->pubk_indexed = false;
+
+	if (hashmap_get(&active_clients.pubkeys, C->pubk_key, 32))
+		return;
+
+	for (struct dircl* cur = active_clients.root.next; cur; cur = cur->next){
+		if (cur != C && cur->pubk_indexed && memcmp(cur->pubk_key, C->pubk_key, 32) == 0){
+			hashmap_put(&active_clients.pubkeys, cur->pubk_key, 32, cur);
+			break;
+		}
+	}
+}
 
 /* Check for petname collision among existing instances, this is another of
  * those policy decisions that should be moved to a scripting layer to also
  * apply geographically appropriate blocklists for the inevitable censors */
 static bool gotname(struct dircl* source, struct arcan_event ev)
 {
-	bool rv = false;
+	char key[COUNT_OF(ev.ext.netstate.name)];
+	size_t len = fold_name(ev.ext.netstate.name, key, COUNT_OF(key));
 
 	pthread_mutex_lock(&active_clients.sync);
-		struct dircl* C = active_clients.root.next;
-		while (C){
-			if (C == source){
-				C = C->next;
-				continue;
-			}
-
-			if (strncasecmp(
-					(char*)C->petname.ext.netstate.name,
-					(char*)ev.ext.netstate.name,
-					COUNT_OF(ev.ext.netstate.name)) == 0){
-				rv = true;
-				break;
-			}
-
-			C = C->next;
-		}
+		struct dircl* C = len ? hashmap_get(&active_clients.petnames, key, len) : NULL;
 	pthread_mutex_unlock(&active_clients.sync);
 
-	return rv;
+	return C && C != source;
 }
 
 /* convert a buffer to a tempfile worth sending - this comes from the worker
@@ -120,8 +233,12 @@ static int buf_memfd(const char* buf, size_t buf_sz)
 	return out;
 }
 
+/* assumes active_clients are locked */
 static void dirlist_to_worker(struct dircl* C)
 {
+	if (active_clients.dirlist_dirty)
+		rebuild_index();
+
 	if (!active_clients.dirlist)
 		return;
 
@@ -153,54 +270,55 @@ static void dynopen_to_worker(struct dircl* C, struct arg_arr* entry)
 		goto send_fail;
 
 	pthread_mutex_lock(&active_clients.sync);
-		struct dircl* cur = active_clients.root.next;
-		while (cur){
-			if (cur == C || !cur->C || !cur->petname.ext.netstate.name[0]){
-				cur = cur->next;
-				continue;
-			}
+		struct dircl* cur = hashmap_get(&active_clients.pubkeys, pubk_dec, 32);
+		if (!cur || cur == C || !cur->C){
+			pthread_mutex_unlock(&active_clients.sync);
+			return;
+		}
 
 /* got match, an open question here is if the sources should be consume on use
  * or let the load balancing / queueing etc. happen at the source stage. Right
  * now in the PoC we assume the source is the listening end and the sink the
  * outbound one. We also have a default port for the source (6680) that should
  * be possible to change. */
-			if (memcmp(pubk_dec, cur->pubk, 32) == 0){
-				arcan_event to_src = {
-					.category = EVENT_EXTERNAL,
-					.ext.kind = EVENT_EXTERNAL_NETSTATE,
+		arcan_event to_src = {
+			.category = EVENT_EXTERNAL,
+			.ext.kind = EVENT_EXTERNAL_NETSTATE,
 /* this does not conflict with dynlist notifications, those are only for SINK */
-					.ext.netstate = {
-						.space = 5
-					}
-				};
+			.ext.netstate = {
+				.space = 5
+			}
+		};
 
 /* here is the heuristic spot for setting up NAT hole punching, or allocating a
  * tunnel or .. */
-				arcan_event to_sink = cur->endpoint;
+		arcan_event to_sink = cur->endpoint;
 
 /* for now blindly accept tunneling if requested and permitted */
-				if (arg_lookup(entry, "tunnel", 0, NULL)){
-					if (!active_clients.opts->allow_tunnel){
-						goto send_fail;
-					}
-
-					int sv[2];
-					if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv))
-						goto send_fail;
-					arcan_event ts = {
-						.category = EVENT_TARGET,
-						.tgt.kind = TARGET_COMMAND_BCHUNK_IN,
-						.tgt.message = ".tun"
-					};
-
-					shmifsrv_enqueue_event(cur->C, &ts, sv[0]);
-					shmifsrv_enqueue_event(C->C, &ts, sv[1]);
-					close(sv[0]);
-					close(sv[1]);
-				}
+		if (arg_lookup(entry, "tunnel", 0, NULL)){
+			if (!active_clients.opts->allow_tunnel){
+				pthread_mutex_unlock(&active_clients.sync);
+				goto send_fail;
+			}
+
+			int sv[2];
+			if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv)){
+				pthread_mutex_unlock(&active_clients.sync);
+				goto send_fail;
+			}
+			arcan_event ts = {
+				.category = EVENT_TARGET,
+				.tgt.kind = TARGET_COMMAND_BCHUNK_IN,
+				.tgt.message = ".tun"
+			};
 
-				memcpy(to_src.ext.netstate.name, C->pubk, 32);
+			shmifsrv_enqueue_event(cur->C, &ts, sv[0]);
+			shmifsrv_enqueue_event(C->C, &ts, sv[1]);
+			close(sv[0]);
+			close(sv[1]);
+		}
+
+		memcpy(to_src.ext.netstate.name, C->pubk, 32);
 
 /*
  * This could ideally be arranged so that the ordering (listening first)
@@ -216,34 +334,30 @@ static void dynopen_to_worker(struct dircl* C, struct arg_arr* entry)
  * of discovery. This means that the source end might need to (if it should
  * support multiple connection origins) enumerate secrets on the first packet
  * increasing the cost somewhat. */
-				arcan_event ss = {
-					.category = EVENT_TARGET,
-					.tgt.kind = TARGET_COMMAND_MESSAGE
-				};
-
-				uint8_t secret[8];
-				arcan_random(secret, 8);
-				unsigned char* b64 = a12helper_tob64(secret, 8, &(size_t){0});
-				snprintf((char*)ss.tgt.message,
-					COUNT_OF(ss.tgt.message), "a12:dir_secret=%s", b64);
-
-				shmifsrv_enqueue_event(C->C, &ss, -1);
-				shmifsrv_enqueue_event(cur->C, &ss, -1);
-				shmifsrv_enqueue_event(cur->C, &to_src, -1);
-				shmifsrv_enqueue_event(C->C, &to_sink, -1);
-
-				if (0 < asprintf(&msg,
-					"tunnel:source=%s:sink=%s", cur->petname.ext.netstate.name,
-					C->petname.ext.netstate.name)){
-					msg = NULL;
-				}
+		arcan_event ss = {
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_MESSAGE
+		};
 
-				cur->tunnel = C->tunnel;
-				free(b64);
-				break;
-			}
-			cur = cur->next;
+		uint8_t secret[8];
+		arcan_random(secret, 8);
+		unsigned char* b64 = a12helper_tob64(secret, 8, &(size_t){0});
+		snprintf((char*)ss.tgt.message,
+			COUNT_OF(ss.tgt.message), "a12:dir_secret=%s", b64);
+
+		shmifsrv_enqueue_event(C->C, &ss, -1);
+		shmifsrv_enqueue_event(cur->C, &ss, -1);
+		shmifsrv_enqueue_event(cur->C, &to_src, -1);
+		shmifsrv_enqueue_event(C->C, &to_sink, -1);
+
+		if (0 < asprintf(&msg,
+			"tunnel:source=%s:sink=%s", cur->petname.ext.netstate.name,
+			C->petname.ext.netstate.name)){
+			msg = NULL;
 		}
+
+		cur->tunnel = C->tunnel;
+		free(b64);
 	pthread_mutex_unlock(&active_clients.sync);
 	if (msg){
 		A12INT_DIRTRACE("%s", msg);
@@ -301,16 +415,7 @@ enum {
  */
 static struct appl_meta* locked_numid_appl(uint16_t id)
 {
-	volatile struct appl_meta* cur = &active_clients.opts->dir;
-
-	while (cur){
-		if (cur->identifier == id){
-			return (struct appl_meta*) cur;
-		}
-		cur = cur->next;
-	}
-
-	return NULL;
+	return hashmap_get(&active_clients.appl_ids, &id, sizeof(uint16_t));
 }
 
 static volatile struct appl_meta* identifier_to_appl(
@@ -346,20 +451,17 @@ static volatile struct appl_meta* identifier_to_appl(
 	}
 
 	pthread_mutex_lock(&active_clients.sync);
-	volatile struct appl_meta* cur = &active_clients.opts->dir;
+		volatile struct appl_meta* cur = locked_numid_appl(*mid);
+	pthread_mutex_unlock(&active_clients.sync);
 
-	while (cur){
-		if (cur->identifier == *mid){
-			pthread_mutex_unlock(&active_clients.sync);
-			A12INT_DIRTRACE("dirsv:resolve_id:id=%s:applname=%s", id, cur->appl.name);
-			return cur;
-		}
-		cur = cur->next;
+	if (cur){
+		A12INT_DIRTRACE("dirsv:resolve_id:id=%s:applname=%s", id, cur->appl.name);
+	}
+	else {
+		A12INT_DIRTRACE("dirsv:kind=missing_id:id=%s", id);
 	}
 
-	pthread_mutex_unlock(&active_clients.sync);
-	A12INT_DIRTRACE("dirsv:kind=missing_id:id=%s", id);
-	return NULL;
+	return cur;
 }
 
 static int get_state_res(
@@ -452,7 +554,10 @@ static void register_source(struct dircl* C, struct arcan_event ev)
 	}
 
 	ev.ext.netstate.state = 1;
-	C->petname = ev;
+	pthread_mutex_lock(&active_clients.sync);
+		C->petname = ev;
+		index_petname(C);
+	pthread_mutex_unlock(&active_clients.sync);
 
 /* finally ack the petname and broadcast */
 	if (!tag_outbound_name(&ev, C->pubk))
@@ -485,20 +590,11 @@ static void handle_bchunk_completion(struct dircl* C, bool ok)
 		close(C->pending_fd);
 		return;
 	}
-	ok = false;
 
 	pthread_mutex_lock(&active_clients.sync);
-		volatile struct appl_meta* cur = &active_clients.opts->dir;
-		while (cur){
-			if (cur->identifier != C->pending_id){
-				cur = cur->next;
-				continue;
-			}
-			ok = true;
-			break;
-		}
+		volatile struct appl_meta* cur = locked_numid_appl(C->pending_id);
 
-	if (!ok){
+	if (!cur){
 		A12INT_DIRTRACE("dirsv:bchunk_state:complete_unknown");
 		pthread_mutex_unlock(&active_clients.sync);
 		goto out;
@@ -508,8 +604,10 @@ static void handle_bchunk_completion(struct dircl* C, bool ok)
  * attestation / signing (external / popen and sandboxed ofc.) */
 		lseek(C->pending_fd, 0, SEEK_SET);
 		FILE* fpek = fdopen(C->pending_fd, "r");
-		if (!fpek)
+		if (!fpek){
+			pthread_mutex_unlock(&active_clients.sync);
 			goto out;
+		}
 
 		char* dst;
 		size_t dst_sz;
@@ -526,16 +624,12 @@ static void handle_bchunk_completion(struct dircl* C, bool ok)
 			blake3_hasher_update(&hash, dst, dst_sz);
 			blake3_hasher_finalize(&hash, (uint8_t*)cur->hash, 4);
 
-/* need to unlock as shmifsrv set will lock again, it will take care of
- * rebuilding the index and notifying listeners though - identity action
- * so volatile is no concern */
-			pthread_mutex_unlock(&active_clients.sync);
+/* the identifier is retained so the appl index is still valid, only the
+ * entry itself needs to be patched into the dirlist and sent to listeners */
 			A12INT_DIRTRACE("dirsv:bchunk_state:appl_update=%d", cur->identifier);
-			anet_directory_shmifsrv_set(
-				(struct anet_dirsrv_opts*) active_clients.opts);
+			patch_index(cur);
 		}
-		else
-			pthread_mutex_unlock(&active_clients.sync);
+	pthread_mutex_unlock(&active_clients.sync);
 
 	fclose(fpek);
 	return;
@@ -844,7 +938,11 @@ void handle_netstate(struct dircl* C, arcan_event ev)
 			(unsigned char*)ev.ext.netstate.name, 32, &(size_t){0});
 			A12INT_DIRTRACE("dirsv:kind=worker:update_sink_pk=%s", b64);
 		free(b64);
-		memcpy(C->pubk, ev.ext.netstate.name, 32);
+		pthread_mutex_lock(&active_clients.sync);
+			memcpy(C->pubk, ev.ext.netstate.name, 32);
+			if (C->pubk_indexed)
+				index_petname(C);
+		pthread_mutex_unlock(&active_clients.sync);
 	}
 	else
 		A12INT_DIRTRACE("dirsv:kind=worker:unknown_netstate");
@@ -852,18 +950,11 @@ void handle_netstate(struct dircl* C, arcan_event ev)
 
 static bool got_collision(int appid, char* name)
 {
-	bool res = false;
+	char key[COUNT_OF(((struct dircl*)NULL)->member_key)];
+	size_t len = member_key(key, COUNT_OF(key), appid, name);
+
 	pthread_mutex_lock(&active_clients.sync);
-		struct dircl* C = active_clients.root.next;
-		while (C){
-			if (C->in_appl == appid){
-				if (strcmp(name, C->identity) == 0){
-					res = true;
-					break;
-				}
-			}
-			C = C->next;
-		}
+		bool res = len && hashmap_get(&active_clients.members, key, len);
 	pthread_mutex_unlock(&active_clients.sync);
 	return res;
 }
@@ -915,9 +1006,18 @@ make_random:
 	struct appl_meta* cur;
 
 	pthread_mutex_lock(&active_clients.sync);
+	index_remove(&active_clients.members, C->member_key, C->member_key_len, C);
+	C->member_key_len = 0;
+
 	cur = locked_numid_appl(ind);
 	if (cur){
 		C->in_appl = ind;
+		snprintf(C->identity, COUNT_OF(C->identity), "%s", end);
+		C->member_key_len = member_key(
+			C->member_key, COUNT_OF(C->member_key), C->in_appl, C->identity);
+		if (C->member_key_len)
+			hashmap_put(&active_clients.members, C->member_key, C->member_key_len, C);
+
 		if (cur->server_appl){
 			anet_directory_lua_join(C, cur);
 		}
@@ -928,101 +1028,83 @@ make_random:
 	pthread_mutex_unlock(&active_clients.sync);
 }
 
-static void* dircl_process(void* P)
+/* Run one pass of the worker state machine, this is invoked by the event loop
+ * owning [C] when its handle is signalled or the timer ticks. Returns false if
+ * the client is dead and should be dropped. */
+static bool dircl_process(struct dircl* C, int ticks)
 {
-	struct dircl* C = P;
-
 /* a 'fun' little side notice here is that there is a race in shmifsrv-
  * spawn child where the descriptor gets sent while the client is in a
  * forked state but not completed exec. */
-
-	shmifsrv_monotonic_rebase();
-	int pv = 25;
-	bool dead = false, activated = false;
-
-	while (!dead){
-		struct pollfd pfd = {
-			.fd = shmifsrv_client_handle(C->C, NULL),
-			.events = POLLIN | POLLERR | POLLHUP
-		};
-
-		if (poll(&pfd, 1, pv) > 0){
-			if (pfd.revents){
-				if (pfd.revents != POLLIN){
-					A12INT_DIRTRACE("dirsv:kind=worker:epipe");
-					break;
-				}
-				pv = 25;
-			}
-		}
-
-		int sv;
-		if ((sv = shmifsrv_poll(C->C)) == CLIENT_DEAD){
-			A12INT_DIRTRACE("dirsv:kind=worker:dead");
-			dead = true;
-			continue;
-		}
+	if (shmifsrv_poll(C->C) == CLIENT_DEAD){
+		A12INT_DIRTRACE("dirsv:kind=worker:dead");
+		return false;
+	}
 
 /* send the directory index as a bchunkstate, this lets us avoid abusing the
  * MESSAGE event as well as re-using the same codepaths for dynamically
  * updating the index later. */
-		if (!activated && shmifsrv_poll(C->C) == CLIENT_IDLE){
-			arcan_event ev = {
-				.category = EVENT_TARGET,
-				.tgt.kind = TARGET_COMMAND_MESSAGE
-			};
+	if (!C->activated && shmifsrv_poll(C->C) == CLIENT_IDLE){
+		arcan_event ev = {
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_MESSAGE
+		};
 
-			if (active_clients.opts->a12_cfg->secret[0]){
-				snprintf(
-					(char*)ev.tgt.message, COUNT_OF(ev.tgt.message),
-					"secret=%s", active_clients.opts->a12_cfg->secret
-				);
+		if (active_clients.opts->a12_cfg->secret[0]){
+			snprintf(
+				(char*)ev.tgt.message, COUNT_OF(ev.tgt.message),
+				"secret=%s", active_clients.opts->a12_cfg->secret
+			);
 
 /* apply the \t is illegal, escapes : rule */
-				for (size_t i = 0; i < 32 && ev.tgt.message[i]; i++){
-					if (ev.tgt.message[i] == ':')
-						ev.tgt.message[i] = '\t';
-				}
-
-				shmifsrv_enqueue_event(C->C, &ev, -1);
+			for (size_t i = 0; i < 32 && ev.tgt.message[i]; i++){
+				if (ev.tgt.message[i] == ':')
+					ev.tgt.message[i] = '\t';
 			}
 
+			shmifsrv_enqueue_event(C->C, &ev, -1);
+		}
+
 /* the applindex need to be set when the worker constructs the state machine,
  * while as the list of dynamic sources happens after it is up and running */
+/* activated is set while locked so that a concurrent patch_index either is
+ * part of the list sent here or will be sent after it */
+		pthread_mutex_lock(&active_clients.sync);
 			dirlist_to_worker(C);
-			ev.tgt.kind = TARGET_COMMAND_ACTIVATE;
-			shmifsrv_enqueue_event(C->C, &ev, -1);
-			activated = true;
-		}
+			C->activated = true;
+		pthread_mutex_unlock(&active_clients.sync);
+		ev.tgt.kind = TARGET_COMMAND_ACTIVATE;
+		shmifsrv_enqueue_event(C->C, &ev, -1);
+	}
 
-		struct arcan_event ev;
-		while (1 == shmifsrv_dequeue_events(C->C, &ev, 1)){
+	struct arcan_event ev;
+	while (1 == shmifsrv_dequeue_events(C->C, &ev, 1)){
 /* petName for a source/dir or for joining an appl */
-			if (ev.ext.kind == EVENT_EXTERNAL_IDENT){
-				A12INT_DIRTRACE("dirsv:kind=worker:cl_join=%s", (char*)ev.ext.message.data);
-				handle_ident(C, ev);
-			}
-			else if (ev.ext.kind == EVENT_EXTERNAL_NETSTATE){
-				handle_netstate(C, ev);
-			}
+		if (ev.ext.kind == EVENT_EXTERNAL_IDENT){
+			A12INT_DIRTRACE("dirsv:kind=worker:cl_join=%s", (char*)ev.ext.message.data);
+			handle_ident(C, ev);
+		}
+		else if (ev.ext.kind == EVENT_EXTERNAL_NETSTATE){
+			handle_netstate(C, ev);
+		}
 /* right now we permit the worker to fetch / update their state store of any
  * appl as the format is id[.resource]. The other option is to use IDENT to
  * explicitly enter an appl signalling that participation in networked activity
  * is desired. */
-			else if (ev.ext.kind == EVENT_EXTERNAL_BCHUNKSTATE){
-				handle_bchunk_req(C, (char*) ev.ext.bchunk.extensions, ev.ext.bchunk.input);
-			}
+		else if (ev.ext.kind == EVENT_EXTERNAL_BCHUNKSTATE){
+			handle_bchunk_req(C, (char*) ev.ext.bchunk.extensions, ev.ext.bchunk.input);
+		}
 
 /* bounce-back ack streamstatus */
-			else if (ev.ext.kind == EVENT_EXTERNAL_STREAMSTATUS){
-				shmifsrv_enqueue_event(C->C, &ev, -1);
-				if (C->pending_stream){
-					C->pending_stream = false;
-					handle_bchunk_completion(C, ev.ext.streamstat.completion >= 1.0);
-				}
-				else
-					A12INT_DIRTRACE("dirsv:kind=worker_error:status_no_pending");
+		else if (ev.ext.kind == EVENT_EXTERNAL_STREAMSTATUS){
+			shmifsrv_enqueue_event(C->C, &ev, -1);
+			if (C->pending_stream){
+				C->pending_stream = false;
+				handle_bchunk_completion(C, ev.ext.streamstat.completion >= 1.0);
 			}
+			else
+				A12INT_DIRTRACE("dirsv:kind=worker_error:status_no_pending");
+		}
 
 /* this is cheating a bit, SHMIF splits TARGET and EXTERNAL for (srv->cl), (cl->srv)
  * but by replaying like this we use EXTERNAL as (cl->srv->cl) */
@@ -1031,17 +1113,20 @@ static void* dircl_process(void* P)
  * keys on the initial connection. If the authentication goes through and IDENT
  * is used to 'join' an appl the MESSAGE facility should (TOFIX) become a broadcast
  * domain or wrapped through a Lua VM instance as the server end of the appl. */
-			else if (ev.ext.kind == EVENT_EXTERNAL_MESSAGE){
-				dircl_message(C, ev);
-			}
+		else if (ev.ext.kind == EVENT_EXTERNAL_MESSAGE){
+			dircl_message(C, ev);
 		}
+	}
 
-		int ticks = shmifsrv_monotonic_tick(NULL);
-		while (!dead && ticks--){
-			shmifsrv_tick(C->C);
-		}
+	while (ticks--){
+		shmifsrv_tick(C->C);
 	}
 
+	return true;
+}
+
+static void dircl_drop(struct dircl* C)
+{
 	pthread_mutex_lock(&active_clients.sync);
 
 		if (C->tunnel){
@@ -1057,6 +1142,7 @@ static void* dircl_process(void* P)
 
 	a12int_trace(A12_TRACE_DIRECTORY,
 		"srv:kind=worker:terminated:name=%s", C->petname.ext.netstate.name);
+		unindex_client(C);
 		C->prev->next = C->next;
 		if (C->next)
 			C->next->prev = C->prev;
@@ -1080,13 +1166,300 @@ static void* dircl_process(void* P)
 	shmifsrv_free(C->C, true);
 	memset(C, 0xff, sizeof(struct dircl));
 	free(C);
+}
+
+/* Workers are multiplexed over a small set of event loops rather than given a
+ * thread each. A client is owned by exactly one loop for its entire lifespan,
+ * so the per-client state machine is never touched concurrently. New clients
+ * are handed over through the loop-local 'incoming' list and a wakeup pipe so
+ * the accepting thread never needs to contend with the registry lock. The
+ * worker handles are only used as a wakeup hint (edge triggered), the timer
+ * sweep guarantees the same 25ms worst-case latency as the old per-thread
+ * poll did. */
+struct dircl_loop {
+	pthread_t pth;
+	pthread_mutex_t sync;
+	struct dircl* incoming;
+
+	int wakeup[2];
+	int epfd;
+
+/* only accessed from the loop thread */
+	struct dircl* clients;
+	size_t n_pfd;
+	struct pollfd* pfd;
+	struct dircl** pfd_cl;
+
+	_Atomic size_t count;
+};
+
+static struct {
+	pthread_once_t once;
+	size_t n_loops;
+	struct dircl_loop loops[DIRSRV_LOOP_LIM];
+} dirloops = {
+	.once = PTHREAD_ONCE_INIT
+};
+
+static void loop_add(struct dircl_loop* L, struct dircl* C)
+{
+	C->loop_next = L->clients;
+	L->clients = C;
+
+#ifdef __linux__
+	int fd = shmifsrv_client_handle(C->C, NULL);
+	if (-1 == fd)
+		return;
+
+	struct epoll_event ev = {
+		.events = EPOLLIN | EPOLLET,
+		.data.ptr = C
+	};
+	epoll_ctl(L->epfd, EPOLL_CTL_ADD, fd, &ev);
+#endif
+}
+
+/* sweep the loop-owned list for clients that were marked dead during
+ * processing, it is only done when something actually died */
+static void loop_reap(struct dircl_loop* L)
+{
+	struct dircl** cur = &L->clients;
+
+	while (*cur){
+		struct dircl* C = *cur;
+		if (!C->dead){
+			cur = &C->loop_next;
+			continue;
+		}
+
+		*cur = C->loop_next;
+#ifdef __linux__
+		int fd = shmifsrv_client_handle(C->C, NULL);
+		if (-1 != fd)
+			epoll_ctl(L->epfd, EPOLL_CTL_DEL, fd, NULL);
+#endif
+		atomic_fetch_sub(&L->count, 1);
+		dircl_drop(C);
+	}
+}
+
+/* move the clients handed to this loop into the owned set and give them a
+ * first pass, returns true if any of them died in the process */
+static bool loop_adopt(struct dircl_loop* L)
+{
+	bool died = false;
+	char buf[64];
+	while (read(L->wakeup[0], buf, 64) > 0){}
+
+	pthread_mutex_lock(&L->sync);
+		struct dircl* C = L->incoming;
+		L->incoming = NULL;
+	pthread_mutex_unlock(&L->sync);
+
+	while (C){
+		struct dircl* next = C->loop_next;
+		loop_add(L, C);
+		C->dead = !dircl_process(C, 0);
+		died |= C->dead;
+		C = next;
+	}
+
+	return died;
+}
+
+/* wait for at most [timeout] ms and run the state machine for every client
+ * that was signalled, returns true if any client died in the process. */
+static bool loop_wait(struct dircl_loop* L, int timeout)
+{
+	bool reap = false;
+
+#ifdef __linux__
+	struct epoll_event evs[64];
+	int nr = epoll_wait(L->epfd, evs, COUNT_OF(evs), timeout);
+
+	for (int i = 0; i < nr; i++){
+		struct dircl* C = evs[i].data.ptr;
+		if (!C){
+			reap |= loop_adopt(L);
+			continue;
+		}
+
+		if (C->dead)
+			continue;
+
+		if (evs[i].events & (EPOLLERR | EPOLLHUP)){
+			A12INT_DIRTRACE("dirsv:kind=worker:epipe");
+			C->dead = true;
+		}
+		else
+			C->dead = !dircl_process(C, 0);
+
+		reap |= C->dead;
+	}
+#else
+/* no epoll, rebuild the pollset from the owned list every pass */
+	size_t count = atomic_load(&L->count) + 1;
+	if (count > L->n_pfd){
+		free(L->pfd);
+		free(L->pfd_cl);
+		L->pfd = malloc(sizeof(struct pollfd) * count);
+		L->pfd_cl = malloc(sizeof(struct dircl*) * count);
+		if (!L->pfd || !L->pfd_cl){
+			L->n_pfd = 0;
+			return false;
+		}
+		L->n_pfd = count;
+	}
+
+	size_t nfd = 0;
+	L->pfd[nfd++] = (struct pollfd){.fd = L->wakeup[0], .events = POLLIN};
+	for (struct dircl* C = L->clients; C && nfd < L->n_pfd; C = C->loop_next){
+		L->pfd_cl[nfd] = C;
+		L->pfd[nfd++] = (struct pollfd){
+			.fd = shmifsrv_client_handle(C->C, NULL),
+			.events = POLLIN | POLLERR | POLLHUP
+		};
+	}
+
+	if (poll(L->pfd, nfd, timeout) <= 0)
+		return false;
+
+	for (size_t i = 1; i < nfd; i++){
+		struct dircl* C = L->pfd_cl[i];
+		if (!L->pfd[i].revents)
+			continue;
+
+		if (L->pfd[i].revents != POLLIN){
+			A12INT_DIRTRACE("dirsv:kind=worker:epipe");
+			C->dead = true;
+		}
+		else
+			C->dead = !dircl_process(C, 0);
+
+		reap |= C->dead;
+	}
+
+/* adopt last as the pollset only covers the previous set of clients */
+	if (L->pfd[0].revents)
+		reap |= loop_adopt(L);
+#endif
+
+	return reap;
+}
+
+static void* dircl_loop(void* tag)
+{
+	struct dircl_loop* L = tag;
+	shmifsrv_monotonic_rebase();
+
+	for(;;){
+		int left;
+		int ticks = shmifsrv_monotonic_tick(&left);
+		bool reap = false;
+
+/* same worst-case behaviour as when each client had a thread to itself */
+		if (ticks){
+			for (struct dircl* C = L->clients; C; C = C->loop_next){
+				if (!C->dead){
+					C->dead = !dircl_process(C, ticks);
+					reap |= C->dead;
+				}
+			}
+		}
+
+		if (left <= 0 || left > DIRSRV_TICK_MS)
+			left = DIRSRV_TICK_MS;
+
+		reap |= loop_wait(L, left);
+
+		if (reap)
+			loop_reap(L);
+	}
 
 	return NULL;
 }
 
+static bool setup_loop(struct dircl_loop* L)
+{
+	*L = (struct dircl_loop){
+		.epfd = -1
+	};
+
+	pthread_mutex_init(&L->sync, NULL);
+
+	if (-1 == pipe(L->wakeup))
+		return false;
+
+	for (size_t i = 0; i < 2; i++){
+		fcntl(L->wakeup[i], F_SETFL, O_NONBLOCK);
+		fcntl(L->wakeup[i], F_SETFD, FD_CLOEXEC);
+	}
+
+#ifdef __linux__
+	L->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (-1 == L->epfd)
+		goto fail;
+
+	struct epoll_event ev = {
+		.events = EPOLLIN,
+		.data.ptr = NULL
+	};
+	if (-1 == epoll_ctl(L->epfd, EPOLL_CTL_ADD, L->wakeup[0], &ev))
+		goto fail;
+#endif
+
+	pthread_attr_t pthattr;
+	pthread_attr_init(&pthattr);
+	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+
+	if (0 == pthread_create(&L->pth, &pthattr, dircl_loop, L))
+		return true;
+
+#ifdef __linux__
+fail:
+	if (-1 != L->epfd)
+		close(L->epfd);
+#endif
+	close(L->wakeup[0]);
+	close(L->wakeup[1]);
+	return false;
+}
+
+static void setup_loops()
+{
+	long nproc = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nproc <= 0)
+		nproc = 1;
+
+	size_t want = nproc > DIRSRV_LOOP_LIM ? DIRSRV_LOOP_LIM : nproc;
+	for (size_t i = 0; i < want; i++){
+		if (!setup_loop(&dirloops.loops[dirloops.n_loops]))
+			break;
+		dirloops.n_loops++;
+	}
+
+	a12int_trace(A12_TRACE_DIRECTORY,
+		"dirsv:kind=status:event_loops=%zu", dirloops.n_loops);
+}
+
+static void index_entry(FILE* dst, volatile struct appl_meta* cur)
+{
+	fprintf(dst,
+		"kind=appl:name=%s:id=%"PRIu16":size=%"PRIu64
+		":categories=%"PRIu16":hash=%"PRIx8
+		"%"PRIx8"%"PRIx8"%"PRIx8":timestamp=%"PRIu64":description=%s\n",
+		cur->appl.name, cur->identifier, cur->buf_sz, cur->categories,
+		cur->hash[0], cur->hash[1], cur->hash[2], cur->hash[3],
+		cur->update_ts,
+		cur->appl.short_descr
+	);
+}
+
 /*
  * the index only contain active appls, dynamic sources are sent separately
- * as netstate discover / lost events and just forwarded.
+ * as netstate discover / lost events and just forwarded. The full list is
+ * only serialized on demand when a new worker is activated, updates to
+ * already active workers go through patch_index.
  */
 static void rebuild_index()
 {
@@ -1098,27 +1471,76 @@ static void rebuild_index()
 	volatile struct appl_meta* cur = &active_clients.opts->dir;
 	while (cur){
 		if (cur->appl.name[0]){
-			fprintf(dirlist,
-				"kind=appl:name=%s:id=%"PRIu16":size=%"PRIu64
-				":categories=%"PRIu16":hash=%"PRIx8
-				"%"PRIx8"%"PRIx8"%"PRIx8":timestamp=%"PRIu64":description=%s\n",
-				cur->appl.name, cur->identifier, cur->buf_sz, cur->categories,
-				cur->hash[0], cur->hash[1], cur->hash[2], cur->hash[3],
-				cur->update_ts,
-				cur->appl.short_descr
-			);
+			index_entry(dirlist, cur);
 		}
 		cur = cur->next;
 	}
 
 	fclose(dirlist);
+	active_clients.dirlist_dirty = false;
+}
+
+/* assumes active_clients are locked, identifiers are unique and stay with the
+ * appl_meta until the next rescan */
+static void reindex_appls()
+{
+	hashmap_destroy(&active_clients.appl_ids);
+	hashmap_create(64, &active_clients.appl_ids);
+
+	volatile struct appl_meta* cur = &active_clients.opts->dir;
+	while (cur){
+		if (cur->appl.name[0]){
+			hashmap_put(&active_clients.appl_ids,
+				(const void*) &cur->identifier, sizeof(uint16_t), (void*) cur);
+		}
+		cur = cur->next;
+	}
+}
+
+/* assumes active_clients are locked, send the updated entry to all active
+ * workers as a patch that they merge into the index they already have */
+static void patch_index(volatile struct appl_meta* entry)
+{
+	active_clients.dirlist_dirty = true;
+
+	char* buf = NULL;
+	size_t buf_sz = 0;
+	FILE* patch = open_memstream(&buf, &buf_sz);
+	if (!patch)
+		return;
+
+	index_entry(patch, entry);
+	fclose(patch);
+
+	for (struct dircl* cur = active_clients.root.next; cur; cur = cur->next){
+		if (!cur->activated)
+			continue;
+
+		int fd = buf_memfd(buf, buf_sz);
+		if (-1 == fd)
+			break;
+
+		shmifsrv_enqueue_event(cur->C,
+			&(struct arcan_event){
+				.category = EVENT_TARGET,
+				.tgt.kind = TARGET_COMMAND_BCHUNK_IN,
+				.tgt.ioevs[1].iv = buf_sz,
+				.tgt.message = ".index_patch"
+			}, fd);
+
+		close(fd);
+	}
+
+	free(buf);
 }
 
 void anet_directory_shmifsrv_set(struct anet_dirsrv_opts* opts)
 {
 	static bool first = true;
+	pthread_once(&index_once, setup_index);
 	pthread_mutex_lock(&active_clients.sync);
 	active_clients.opts = opts;
+	reindex_appls();
 
 	if (opts->dir.handle || opts->dir.buf){
 		rebuild_index();
@@ -1143,18 +1565,26 @@ void anet_directory_shmifsrv_set(struct anet_dirsrv_opts* opts)
 	pthread_mutex_unlock(&active_clients.sync);
 }
 
-/* This is in the parent process, it acts as a 1:1 thread/process which
- * pools and routes. The other end of this shmif connection is in the
- * normal net->listen thread */
+/* This is in the parent process, the worker connection gets assigned to the
+ * least loaded event loop which pools and routes. The other end of this shmif
+ * connection is in the normal net->listen thread */
 void anet_directory_shmifsrv_thread(
 	struct shmifsrv_client* cl, struct a12_state* S)
 {
-	pthread_t pth;
-	pthread_attr_t pthattr;
-	pthread_attr_init(&pthattr);
-	pthread_attr_setdetachstate(&pthattr, PTHREAD_CREATE_DETACHED);
+	pthread_once(&index_once, setup_index);
+	pthread_once(&dirloops.once, setup_loops);
+	if (!dirloops.n_loops){
+		a12int_trace(A12_TRACE_DIRECTORY, "dirsv:kind=error:no_event_loop");
+		shmifsrv_free(cl, true);
+		return;
+	}
 
 	struct dircl* newent = malloc(sizeof(struct dircl));
+	if (!newent){
+		shmifsrv_free(cl, true);
+		return;
+	}
+
 	*newent = (struct dircl){
 		.C = cl,
 		.in_appl = -1,
@@ -1185,7 +1615,20 @@ void anet_directory_shmifsrv_thread(
 		cur->next = newent;
 		newent->prev = cur;
 	pthread_mutex_unlock(&active_clients.sync);
-	pthread_create(&pth, &pthattr, dircl_process, newent);
+
+	struct dircl_loop* L = &dirloops.loops[0];
+	for (size_t i = 1; i < dirloops.n_loops; i++){
+		if (atomic_load(&dirloops.loops[i].count) < atomic_load(&L->count))
+			L = &dirloops.loops[i];
+	}
+
+	atomic_fetch_add(&L->count, 1);
+	pthread_mutex_lock(&L->sync);
+		newent->loop_next = L->incoming;
+		L->incoming = newent;
+	pthread_mutex_unlock(&L->sync);
+
+	while (-1 == write(L->wakeup[1], "", 1) && errno == EINTR){}
 }
 
 /* this will just keep / cache the built .FAPs in memory, the startup times
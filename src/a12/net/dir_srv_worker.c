@@ -227,16 +227,8 @@ static void on_a12srv_event(
 	}
 }
 
-static void unpack_index(
-	struct a12_state *S, struct arcan_shmif_cont *C, struct arcan_event* ev)
+static struct appl_meta* parse_index(FILE* fpek)
 {
-	a12int_trace(A12_TRACE_DIRECTORY, "new_index");
-	FILE* fpek = fdopen(ev->tgt.ioevs[0].iv, "r");
-	if (!fpek){
-		a12int_trace(A12_TRACE_DIRECTORY, "error=einval_fd");
-		return;
-	}
-
 	struct appl_meta* first = NULL;
 	struct appl_meta** cur = &first;
 
@@ -304,9 +296,112 @@ static void unpack_index(
 		arg_cleanup(entry);
 	}
 
+	return first;
+}
+
+static void free_index(struct appl_meta* cur)
+{
+	while (cur){
+		struct appl_meta* next = cur->next;
+		free(cur->buf);
+		free(cur);
+		cur = next;
+	}
+}
+
+static void unpack_index(
+	struct a12_state *S, struct arcan_shmif_cont *C, struct arcan_event* ev)
+{
+	a12int_trace(A12_TRACE_DIRECTORY, "new_index");
+	FILE* fpek = fdopen(ev->tgt.ioevs[0].iv, "r");
+	if (!fpek){
+		a12int_trace(A12_TRACE_DIRECTORY, "error=einval_fd");
+		return;
+	}
+
+	struct appl_meta* first = parse_index(fpek);
+	fclose(fpek);
+
+	if (!S){
+		free_index(pending_index);
+		pending_index = first;
+	}
+	else
+		a12int_set_directory(S, first);
+}
+
+/* The parent only sends the entries that changed after the initial index, so
+ * build a new list from the current one with the patched entries replaced or
+ * appended. set_directory will in turn only forward what actually differs. */
+static void unpack_index_patch(
+	struct a12_state *S, struct arcan_shmif_cont *C, struct arcan_event* ev)
+{
+	a12int_trace(A12_TRACE_DIRECTORY, "index_patch");
+	FILE* fpek = fdopen(ev->tgt.ioevs[0].iv, "r");
+	if (!fpek){
+		a12int_trace(A12_TRACE_DIRECTORY, "error=einval_fd");
+		return;
+	}
+
+	struct appl_meta* patch = parse_index(fpek);
 	fclose(fpek);
-	if (!S)
+
+	struct appl_meta* base = S ? a12int_get_directory(S, NULL) : pending_index;
+	struct appl_meta* first = NULL;
+	struct appl_meta** tail = &first;
+
+	for (; base; base = base->next){
+		*tail = malloc(sizeof(struct appl_meta));
+		if (!*tail){
+			free_index(first);
+			free_index(patch);
+			return;
+		}
+		**tail = *base;
+		(*tail)->buf = NULL;
+		(*tail)->handle = NULL;
+		(*tail)->next = NULL;
+
+/* set_directory frees the old list along with its buffers */
+		if (base->buf){
+			(*tail)->buf = malloc(base->buf_sz);
+			if (!(*tail)->buf){
+				free_index(first);
+				free_index(patch);
+				return;
+			}
+			memcpy((*tail)->buf, base->buf, base->buf_sz);
+		}
+		tail = &(*tail)->next;
+	}
+
+	while (patch){
+		struct appl_meta* next = patch->next;
+		struct appl_meta* cur = first;
+
+		while (cur && cur->identifier != patch->identifier)
+			cur = cur->next;
+
+		if (cur){
+			struct appl_meta* keep = cur->next;
+			free(cur->buf);
+			*cur = *patch;
+			cur->next = keep;
+			free(patch);
+		}
+		else {
+			patch->next = NULL;
+			*tail = patch;
+			tail = &patch->next;
+		}
+
+		patch = next;
+	}
+
+	if (!S){
+		free_index(pending_index);
 		pending_index = first;
+	}
 	else
 		a12int_set_directory(S, first);
 }
@@ -321,6 +416,10 @@ static void bchunk_event(struct a12_state *S,
 	if (strcmp(ev->tgt.message, ".index") == 0){
 		unpack_index(S, C, ev);
 	}
+/* incremental updates to the index after the initial one */
+	else if (strcmp(ev->tgt.message, ".index_patch") == 0){
+		unpack_index_patch(S, C, ev);
+	}
 /* Only single channel handled for now, 1:1 source-sink connections. Multiple
  * ones are not difficult as such but evaluate the need experimentally first. */
 	else if (strcmp(ev->tgt.message, ".tun") == 0){
@@ -19,6 +19,7 @@
 #include "../a12.h"
 #include "../a12_int.h"
 #include "anet_helper.h"
+#include "a12_helper.h"
 #include "directory.h"
 
 #include <sys/types.h>
@@ -29,6 +30,20 @@
 #include <fcntl.h>
 #include <poll.h>
 
+/* With a ring as our end of the tunnel a12 only holds it as the sink tag and
+ * won't close anything on drop, so mark it closed here (the runner on the
+ * other end blocks on it until then) and release it. */
+static void drop_tunnel(struct a12_state* S)
+{
+	struct a12helper_shmring* ring = a12_tunnel_tag(S, 1);
+	a12_drop_tunnel(S, 1);
+
+	if (ring){
+		a12helper_shmring_close(ring);
+		free(ring);
+	}
+}
+
 void anet_directory_ioloop(struct ioloop_shared* I)
 {
 	int errmask = POLLERR | POLLHUP;
@@ -72,16 +87,31 @@ void anet_directory_ioloop(struct ioloop_shared* I)
 /* tunnel is dead? need to close-id it */
 		if (fds[3].revents){
 			if (fds[3].revents & errmask){
-				a12_drop_tunnel(I->S, 1);
+				drop_tunnel(I->S);
 				a12int_trace(A12_TRACE_DIRECTORY, "tunnel_close:internal");
 			}
 
 			else {
 				uint8_t buf[8832];
-				size_t nw = 0, sz;
+				size_t nw = 0;
+				ssize_t sz = -1;
 
 				int fd = a12_tunnel_descriptor(I->S, 1, &tun_ok);
-				if (tun_ok &&
+				struct a12helper_shmring* ring = a12_tunnel_tag(I->S, 1);
+
+/* the ring end is ours and only signals, drain what is there */
+				if (ring){
+					while (tun_ok &&
+						(sz = a12helper_shmring_read(ring, buf, sizeof(buf))) > 0){
+						a12_write_tunnel(I->S, 1, buf, (size_t) sz);
+						nw += sz;
+					}
+					if (tun_ok && (0 == sz || errno != EAGAIN)){
+						drop_tunnel(I->S);
+						a12int_trace(A12_TRACE_DIRECTORY, "tunnel_close:ring");
+					}
+				}
+				else if (tun_ok &&
 					(sz = read(fd, buf, sizeof(buf))) > 0){
 						a12_write_tunnel(I->S, 1, buf, (size_t) sz);
 						nw += sz;
@@ -136,6 +166,13 @@ void anet_directory_ioloop(struct ioloop_shared* I)
 		fds[2].fd = outbuf_sz ? I->fdout : -1;
 		fds[0].fd = I->userfd;
 		fds[3].fd = a12_tunnel_descriptor(I->S, 1, &tun_ok);
+
+/* closed from the other side (TUNDROP) or the sink failed, release our end */
+		if (-1 != fds[3].fd && !tun_ok){
+			drop_tunnel(I->S);
+			a12int_trace(A12_TRACE_DIRECTORY, "tunnel_close:remote");
+			fds[3].fd = a12_tunnel_descriptor(I->S, 1, &tun_ok);
+		}
 		fds[4].fd = I->shmif.addr ? I->shmif.epipe : -1;
 		fds[5].fd = I->userfd2;
 	}
@@ -172,6 +209,16 @@ FILE* file_to_membuf(FILE* applin, char** out, size_t* out_sz)
 	return applbuf;
 }
 
+static void hex_digest(const uint8_t* in, size_t len, char* out)
+{
+	static const char digits[] = "0123456789abcdef";
+	for (size_t i = 0; i < len; i++){
+		out[i*2+0] = digits[in[i] >> 4];
+		out[i*2+1] = digits[in[i] & 0x0f];
+	}
+	out[len*2] = '\0';
+}
+
 static int comp_alpha(const FTSENT** a, const FTSENT** b)
 {
 	return strcmp((*a)->fts_name, (*b)->fts_name);
@@ -330,6 +377,12 @@ bool extract_appl_pkg(FILE* fin, int cdir, const char* basename, const char** ms
 		free(fn);
 		fout = fdopen(fd, "w");
 
+/* older packages lack the per-file hash, only verify if present */
+		const char* fhash = NULL;
+		arg_lookup(args, "hash", 0, &fhash);
+		blake3_hasher hash;
+		blake3_hasher_init(&hash);
+
 		while (ntc){
 			char buf[4096];
 			size_t nr = fread(buf, 1, 4096 > ntc ? ntc : 4096, fin);
@@ -337,9 +390,25 @@ bool extract_appl_pkg(FILE* fin, int cdir, const char* basename, const char** ms
 				break;
 			}
 			fwrite(buf, 1, nr, fout);
+			blake3_hasher_update(&hash, buf, nr);
 			ntc -= nr;
 		}
 
+		if (!ntc && fhash){
+			uint8_t digest[16];
+			char digest_hex[33];
+			blake3_hasher_finalize(&hash, digest, 16);
+			hex_digest(digest, 16, digest_hex);
+
+			if (strcmp(digest_hex, fhash) != 0){
+				a12int_trace(A12_TRACE_DIRECTORY,
+					"malformed_appl:invalid=hash:name=%s", name);
+				*msg = "file contents do not match package hash";
+				fclose(fout);
+				break;
+			}
+		}
+
 		if (ntc){
 			a12int_trace(A12_TRACE_DIRECTORY,
 				"malformed_appl:invalid=size:name=%s", fn);
@@ -355,6 +424,130 @@ bool extract_appl_pkg(FILE* fin, int cdir, const char* basename, const char** ms
 	return feof(fin) && !in_file;
 }
 
+/* Packages are cached on a fingerprint of the appl tree (path, name, size and
+ * mtime of every file) so that a rescan where nothing changed won't re-read,
+ * re-pack and re-hash the contents. The cache owns its copy of the package,
+ * the appl_meta gets a duplicate as its lifecycle is managed elsewhere. When
+ * the packages together exceed PKG_MEMCACHE_SZ the least recently used ones
+ * are dropped, this also takes care of appls that have been removed. */
+#define PKG_MEMCACHE_SZ (64 * 1024 * 1024)
+
+#ifdef __APPLE__
+#define STAT_MTIM(X) ((X)->st_mtimespec)
+#else
+#define STAT_MTIM(X) ((X)->st_mtim)
+#endif
+
+struct pkg_cache {
+	char name[18];
+	uint8_t fingerprint[16];
+	uint8_t hash[4];
+	char* buf;
+	size_t buf_sz;
+	uint64_t used;
+	struct pkg_cache* next;
+};
+
+static struct pkg_cache* pkg_cache;
+static size_t pkg_cache_sz;
+static uint64_t pkg_cache_clock;
+
+static bool tree_fingerprint(uint8_t out[static 16])
+{
+	char* path[] = {".", NULL};
+	FTS* fts = afts_open(path, FTS_PHYSICAL, comp_alpha);
+	if (!fts)
+		return false;
+
+	blake3_hasher hash;
+	blake3_hasher_init(&hash);
+
+	for (FTSENT* cur = afts_read(fts); cur; cur = afts_read(fts)){
+		if (cur->fts_info != FTS_F)
+			continue;
+
+/* .manifest is included as it affects the package header */
+		struct stat* sb = cur->fts_statp;
+		uint64_t meta[] = {
+			(uint64_t) sb->st_size,
+			(uint64_t) STAT_MTIM(sb).tv_sec,
+			(uint64_t) STAT_MTIM(sb).tv_nsec,
+			(uint64_t) sb->st_ino
+		};
+		blake3_hasher_update(&hash, cur->fts_path, cur->fts_pathlen + 1);
+		blake3_hasher_update(&hash, meta, sizeof(meta));
+	}
+
+	afts_close(fts);
+	blake3_hasher_finalize(&hash, out, 16);
+	return true;
+}
+
+static bool pkg_cache_lookup(
+	const char* name, uint8_t fingerprint[static 16], struct appl_meta* dst)
+{
+	for (struct pkg_cache* cur = pkg_cache; cur; cur = cur->next){
+		if (strcmp(cur->name, name) != 0 || memcmp(cur->fingerprint, fingerprint, 16))
+			continue;
+
+		dst->buf = malloc(cur->buf_sz);
+		if (!dst->buf)
+			return false;
+
+		memcpy(dst->buf, cur->buf, cur->buf_sz);
+		memcpy(dst->hash, cur->hash, 4);
+		dst->buf_sz = cur->buf_sz;
+		cur->used = ++pkg_cache_clock;
+		return true;
+	}
+
+	return false;
+}
+
+static void pkg_cache_store(
+	const char* name, uint8_t fingerprint[static 16], struct appl_meta* src)
+{
+	struct pkg_cache** cur = &pkg_cache;
+	while (*cur && strcmp((*cur)->name, name) != 0)
+		cur = &(*cur)->next;
+
+	if (!*cur){
+		*cur = malloc(sizeof(struct pkg_cache));
+		if (!*cur)
+			return;
+		**cur = (struct pkg_cache){0};
+		snprintf((*cur)->name, COUNT_OF((*cur)->name), "%s", name);
+	}
+
+	char* buf = malloc(src->buf_sz);
+	if (!buf)
+		return;
+
+	memcpy(buf, src->buf, src->buf_sz);
+	free((*cur)->buf);
+	pkg_cache_sz = pkg_cache_sz - (*cur)->buf_sz + src->buf_sz;
+	(*cur)->buf = buf;
+	(*cur)->buf_sz = src->buf_sz;
+	(*cur)->used = ++pkg_cache_clock;
+	memcpy((*cur)->fingerprint, fingerprint, 16);
+	memcpy((*cur)->hash, src->hash, 4);
+
+/* the one just stored is the most recent, so it is the last to go */
+	while (pkg_cache_sz > PKG_MEMCACHE_SZ){
+		struct pkg_cache** lru = &pkg_cache;
+		for (struct pkg_cache** ent = &pkg_cache; *ent; ent = &(*ent)->next)
+			if ((*ent)->used < (*lru)->used)
+				lru = ent;
+
+		struct pkg_cache* drop = *lru;
+		a12int_trace(A12_TRACE_DIRECTORY, "pkg_memcache:evict=%s", drop->name);
+		*lru = drop->next;
+		pkg_cache_sz -= drop->buf_sz;
+		free(drop->buf);
+		free(drop);
+	}
+}
+
 bool build_appl_pkg(const char* name, struct appl_meta* dst, int cdir)
 {
 	FILE* fpek = NULL;
@@ -366,13 +559,20 @@ bool build_appl_pkg(const char* name, struct appl_meta* dst, int cdir)
 	fchdir(cdir);
 	chdir(name);
 
+	uint8_t fingerprint[16];
+	bool got_fingerprint = tree_fingerprint(fingerprint);
+
+	if (got_fingerprint && pkg_cache_lookup(name, fingerprint, dst)){
+		a12int_trace(A12_TRACE_DIRECTORY, "build_appl:cached=%s", name);
+		goto out;
+	}
+
 	size_t buf_sz;
 	if (!(fpek = open_memstream(&dst->buf, &buf_sz)))
 		goto err;
 
 	if (!(fts = afts_open(path, FTS_PHYSICAL, comp_alpha)))
 		goto err;
-
 /* for extended permissions -- net,frameserver,... the .manifest file needs to
  * be present, follow the regular arg_arr pack/unpack format and specify which
  * ones it needs. */
@@ -430,12 +630,23 @@ bool build_appl_pkg(const char* name, struct appl_meta* dst, int cdir)
 		}
 		fclose(fin);
 		fclose(fbuf_f);
+
+/* per-file content hash so the receiver can verify and tell which files that
+ * actually changed between two versions of a package */
+		uint8_t fhash[16];
+		char fhash_hex[33];
+		blake3_hasher hash;
+		blake3_hasher_init(&hash);
+		blake3_hasher_update(&hash, fbuf, fbuf_sz);
+		blake3_hasher_finalize(&hash, fhash, 16);
+		hex_digest(fhash, 16, fhash_hex);
+
 		cur->fts_path[cur->fts_pathlen - cur->fts_namelen - 1] = '\0';
 		fprintf(fpek,
-				"path=%s:name=%s:size=%zu\n",
+				"path=%s:name=%s:size=%zu:hash=%s\n",
 				strcmp(cur->fts_path, ".") == 0 ? "" :
 				&cur->fts_path[2],
-				cur->fts_name, fbuf_sz
+				cur->fts_name, fbuf_sz, fhash_hex
 		);
 		cur->fts_path[cur->fts_pathlen - cur->fts_namelen - 1] = '/';
 		fflush(fpek);
@@ -452,6 +663,10 @@ bool build_appl_pkg(const char* name, struct appl_meta* dst, int cdir)
 	blake3_hasher_update(&hash, dst->buf, dst->buf_sz);
 	blake3_hasher_finalize(&hash, (uint8_t*)dst->hash, 4);
 
+	if (got_fingerprint)
+		pkg_cache_store(name, fingerprint, dst);
+
+out:
 	snprintf(dst->appl.name, COUNT_OF(dst->appl.name), "%s", name);
 
 	dst->next = malloc(sizeof(struct appl_meta));
@@ -472,3 +687,134 @@ err:
 	close(olddir);
 	return false;
 }
+
+/* The client side keeps received packages in a content addressed store keyed
+ * on the bstream checksum, so a package that has already been received (e.g.
+ * a reconnect or an unrelated appl being updated) is substituted locally and
+ * the transfer cancelled before any data has been sent. */
+#define PKG_CACHE_DIR ".pkgcache"
+#define PKG_CACHE_LIM 8
+
+int appl_pkg_cache_open(int basedir, const uint8_t checksum[static 16])
+{
+	char fn[sizeof(PKG_CACHE_DIR) + 34];
+	char hex[33];
+	hex_digest(checksum, 16, hex);
+	snprintf(fn, sizeof(fn), "%s/%s", PKG_CACHE_DIR, hex);
+
+	int fd = openat(basedir, fn, O_RDONLY | O_CLOEXEC);
+	if (-1 == fd)
+		return -1;
+
+/* mark as recently used for eviction */
+	futimens(fd, NULL);
+	return fd;
+}
+
+static void pkg_cache_evict(int cdir)
+{
+	int fd = dup(cdir);
+	DIR* dir = fdopendir(fd);
+	if (!dir){
+		close(fd);
+		return;
+	}
+
+	struct dirent* ent;
+	size_t count = 0;
+	char oldest[NAME_MAX + 1] = {0};
+	time_t oldest_ts = 0;
+
+	while ((ent = readdir(dir))){
+		struct stat sb;
+		if (ent->d_name[0] == '.' || -1 == fstatat(cdir, ent->d_name, &sb, 0))
+			continue;
+
+		count++;
+		if (!oldest[0] || sb.st_mtime < oldest_ts){
+			snprintf(oldest, sizeof(oldest), "%s", ent->d_name);
+			oldest_ts = sb.st_mtime;
+		}
+	}
+
+	closedir(dir);
+
+/* only one is added at a time so one out is sufficient */
+	if (count > PKG_CACHE_LIM && oldest[0]){
+		a12int_trace(A12_TRACE_DIRECTORY, "pkg_cache:evict=%s", oldest);
+		unlinkat(cdir, oldest, 0);
+	}
+}
+
+bool appl_pkg_cache_store(int basedir, const uint8_t checksum[static 16], int fd)
+{
+	char hex[33];
+	char tmpname[40];
+	hex_digest(checksum, 16, hex);
+	snprintf(tmpname, sizeof(tmpname), ".%s", hex);
+
+	mkdirat(basedir, PKG_CACHE_DIR, S_IRWXU);
+	int cdir = openat(basedir, PKG_CACHE_DIR, O_DIRECTORY | O_CLOEXEC);
+	if (-1 == cdir)
+		return false;
+
+	int out = openat(cdir, tmpname, O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600);
+	if (-1 == out){
+		close(cdir);
+		return false;
+	}
+
+/* the checksum is provided by the other end, verify before trusting it as a
+ * cache key that later transfers will be substituted with */
+	blake3_hasher hash;
+	blake3_hasher_init(&hash);
+	bool ok = true;
+	off_t pos = 0;
+
+	for(;;){
+		char buf[4096];
+		ssize_t nr = pread(fd, buf, sizeof(buf), pos);
+		if (-1 == nr && errno == EINTR)
+			continue;
+		if (nr <= 0){
+			ok = nr == 0;
+			break;
+		}
+
+		blake3_hasher_update(&hash, buf, nr);
+		pos += nr;
+
+		for (ssize_t ofs = 0; ofs < nr;){
+			ssize_t nw = write(out, &buf[ofs], nr - ofs);
+			if (-1 == nw){
+				if (errno == EINTR)
+					continue;
+				ok = false;
+				break;
+			}
+			ofs += nw;
+		}
+
+		if (!ok)
+			break;
+	}
+
+	close(out);
+
+	uint8_t digest[16];
+	blake3_hasher_finalize(&hash, digest, 16);
+	if (ok && memcmp(digest, checksum, 16) != 0){
+		a12int_trace(A12_TRACE_DIRECTORY, "pkg_cache:error=checksum_mismatch");
+		ok = false;
+	}
+
+	if (ok && 0 == renameat(cdir, tmpname, cdir, hex))
+		pkg_cache_evict(cdir);
+	else {
+		unlinkat(cdir, tmpname, 0);
+		ok = false;
+	}
+
+	close(cdir);
+	return ok;
+}
@@ -81,6 +81,8 @@ struct directory_meta {
 
 	FILE* appl_out;
 	bool appl_out_complete;
+	bool appl_out_cached;
+	uint8_t appl_out_checksum[16];
 	int state_in;
 	bool state_in_complete;
 
@@ -114,6 +116,19 @@ struct dircl {
 
 /* [UAF-risk] 1:1 for now - always check this when removing a dircl */
 	struct dircl* tunnel;
+
+/* owned by the event loop the client was assigned to, see dir_srv.c */
+	bool activated;
+	bool dead;
+	struct dircl* loop_next;
+
+/* backing store for the registry lookup keys, see dir_srv.c */
+	char name_key[66];
+	size_t name_key_len;
+	uint8_t pubk_key[32];
+	bool pubk_indexed;
+	char member_key[24];
+	size_t member_key_len;
 };
 
 struct global_cfg {
@@ -145,7 +160,7 @@ void anet_directory_srv(
 	struct a12_context_options*, struct anet_dirsrv_opts, int fdin, int fdout);
 
 /*
- * shmif connection to map to a thread for coordination
+ * shmif connection to map to an event loop thread for coordination
  */
 void anet_directory_shmifsrv_thread(struct shmifsrv_client*, struct a12_state*);
 void anet_directory_shmifsrv_set(struct anet_dirsrv_opts* opts);
@@ -172,6 +187,12 @@ void dircl_source_handler(
 bool build_appl_pkg(const char* name, struct appl_meta* dst, int dirfd);
 bool extract_appl_pkg(FILE* fin, int dirfd, const char* basename, const char** msg);
 
+/* content addressed store of received packages relative to dirfd, keyed on
+ * the bstream checksum. open returns -1 on a cache miss, store verifies the
+ * contents of fd against the checksum before adding it. */
+int appl_pkg_cache_open(int dirfd, const uint8_t checksum[static 16]);
+bool appl_pkg_cache_store(int dirfd, const uint8_t checksum[static 16], int fd);
+
 FILE* file_to_membuf(FILE* applin, char** out, size_t* out_sz);
 
 struct ioloop_shared;
@@ -409,6 +409,9 @@ struct dirstate {
 	struct anet_options* aopts;
 	struct shmifsrv_client* shmif;
 	struct a12_dynreq req;
+
+/* set in the tunnel child when the tunnel is carried over a shmring */
+	struct a12helper_shmring* ring;
 };
 
 static void a12cl_dispatch(
@@ -488,7 +491,9 @@ static void dir_a12srv(struct a12_state* S, int fd, void* tag)
  * the right authk and if you have that you're either source, sink or dirsrv
  * and both sink and dirsrv would be able to match the pubk. */
 	char* msg;
-	if (!anet_authenticate(S, fd, fd, &msg)){
+	if (ds->ring ?
+		!a12helper_shmring_authenticate(S, ds->ring, &msg) :
+		!anet_authenticate(S, fd, fd, &msg)){
 		a12int_trace(A12_TRACE_SECURITY, "authentication_failed");
 		return;
 	}
@@ -500,11 +505,15 @@ static void dir_a12srv(struct a12_state* S, int fd, void* tag)
 		.vframe_block = global.backpressure,
 		.vframe_soft_block = global.backpressure_soft,
 		.eval_vcodec = vcodec_tuning,
-		.bcache_dir = get_bcache_dir()
+		.bcache_dir = get_bcache_dir(),
+		.ring = ds->ring
 	});
 	shmifsrv_free(ds->shmif, SHMIFSRV_FREE_NO_DMS);
 
-	shutdown(fd, SHUT_RDWR);
+	if (ds->ring)
+		a12helper_shmring_close(ds->ring);
+	else
+		shutdown(fd, SHUT_RDWR);
 	exit(EXIT_SUCCESS);
 }
 
@@ -519,15 +528,35 @@ static void dir_to_shmifsrv(struct a12_state* S, struct a12_dynreq a, void* tag)
  * the a12_channel bstream sink and the other with the supported read into
  * state part. */
 	int pre_fd = -1;
-	int sv[2];
+	int sv[2] = {-1, -1};
+
+/* the other end of the tunnel is our own child, so a shared memory ring can
+ * replace the socketpair when the platform supports it */
+	struct a12helper_shmring ring[2];
+	struct a12helper_shmring* own = NULL;
 
 	if (a.proto == 4){
-		if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv)){
-			a12int_trace(A12_TRACE_DIRECTORY, "tunnel_socketpair_fail");
-			return;
+		if (a12helper_shmring_pair(A12HELPER_SHMRING_SZ, ring)){
+			own = malloc(sizeof(struct a12helper_shmring));
+			if (own){
+				*own = ring[0];
+				a12_set_tunnel_sink_cb(S, 1,
+					a12helper_shmring_pollfd(own), a12helper_shmring_tunnel_sink, own);
+			}
+			else {
+				a12helper_shmring_drop(&ring[0]);
+				a12helper_shmring_drop(&ring[1]);
+			}
+		}
+
+		if (!own){
+			if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, sv)){
+				a12int_trace(A12_TRACE_DIRECTORY, "tunnel_socketpair_fail");
+				return;
+			}
+			a12_set_tunnel_sink(S, 1, sv[0]);
+			pre_fd = sv[1];
 		}
-		a12_set_tunnel_sink(S, 1, sv[0]);
-		pre_fd = sv[1];
 	}
 
 	pid_t fpid = fork();
@@ -555,9 +584,15 @@ static void dir_to_shmifsrv(struct a12_state* S, struct a12_dynreq a, void* tag)
 	if (fpid == 0){
 		struct sigaction oldsig;
 		sigaction(SIGINT, &(struct sigaction){}, &oldsig);
-		close(sv[0]);
+		if (-1 != sv[0])
+			close(sv[0]);
 		close(ds->fd);
 
+		if (own){
+			a12helper_shmring_drop(own);
+			ds->ring = &ring[1];
+		}
+
 		if (fork()){
 			exit(EXIT_SUCCESS);
 		}
@@ -605,15 +640,19 @@ static void dir_to_shmifsrv(struct a12_state* S, struct a12_dynreq a, void* tag)
 		char* errmsg = NULL;
 		ds->aopts->host = NULL;
 
-/* With tunnel mode we have a socketpair pre-created, where one end is set as
- * the tunnel-channel sink for the a12_state machine to the directory, and
- * the other is fed into the channel.
+/* With tunnel mode we have a socketpair (or shmring) pre-created, where one
+ * end is set as the tunnel-channel sink for the a12_state machine to the
+ * directory, and the other is fed into the channel.
  *
  * Without tunnel-mode we listen for an inbound connection (or make an outbound
  * or send an outbound then listen for an inbound). The mentally more complex
  * dance is what happens if we tunnel through a directory that we tunnel ..
  */
-		if (pre_fd == -1){
+		if (ds->ring){
+			struct a12_state* ast = a12_server(ds->aopts->opts);
+			dir_a12srv(ast, -1, ds);
+		}
+		else if (pre_fd == -1){
 			anet_listen(ds->aopts, &errmsg, dir_a12srv, ds);
 		}
 		else {
@@ -626,6 +665,8 @@ static void dir_to_shmifsrv(struct a12_state* S, struct a12_dynreq a, void* tag)
 	}
 	else if (fpid == -1){
 		fprintf(stderr, "fork_a12cl() couldn't fork new process, check ulimits\n");
+		if (own)
+			a12helper_shmring_drop(&ring[1]);
 		shmifsrv_free(ds->shmif, SHMIFSRV_FREE_NO_DMS);
 		shutdown(ds->fd, SHUT_RDWR);
 		close(ds->fd);
@@ -638,6 +679,8 @@ static void dir_to_shmifsrv(struct a12_state* S, struct a12_dynreq a, void* tag)
 		if (pre_fd != -1){
 			close(pre_fd);
 		}
+		if (own)
+			a12helper_shmring_drop(&ring[1]);
 
 		a12int_trace(A12_TRACE_SYSTEM, "client handed off to %d", (int)fpid);
 /* child double-forked so just collect the first */
@@ -314,6 +314,17 @@ int alt_nbio_close(lua_State* L, struct nonblock_io** ibb)
 {
 	struct nonblock_io* ib = *ibb;
 	int fd = ib->fd;
+
+/* deregister while the descriptor is still valid, epoll can't remove a closed
+ * one and would keep watching whatever the description is still shared with */
+	intptr_t tag;
+	if (remove_job(fd, O_RDONLY, &tag)){
+		unref_registry(L, tag, LUA_TUSERDATA, "nbio_close_rdmeta");
+	}
+	if (remove_job(fd, O_WRONLY, &tag)){
+		unref_registry(L, tag, LUA_TUSERDATA, "nbio_close_wrmeta");
+	}
+
 	if (fd > 0)
 		close(fd);
 
@@ -326,6 +337,7 @@ int alt_nbio_close(lua_State* L, struct nonblock_io** ibb)
 	}
 
 	free(ib->pending);
+	free(ib->buf);
 	drop_all_jobs(ib);
 
 	if (ib->data_handler != LUA_NOREF){
@@ -338,15 +350,6 @@ int alt_nbio_close(lua_State* L, struct nonblock_io** ibb)
 		ib->write_handler = LUA_NOREF;
 	}
 
-/* no-op if nothing registered */
-	intptr_t tag;
-	if (remove_job(fd, O_RDONLY, &tag)){
-		unref_registry(L, tag, LUA_TUSERDATA, "nbio_close_rdmeta");
-	}
-	if (remove_job(fd, O_WRONLY, &tag)){
-		unref_registry(L, tag, LUA_TUSERDATA, "nbio_close_wrmeta");
-	}
-
 	free(ib);
 	*ibb = NULL;
 
@@ -669,54 +672,137 @@ static char* nextline(
 {
 
 /* empty input buffer? early - out */
-	if (!ib->ofs)
+	if (start >= ib->ofs)
 		return NULL;
 
-	*step = 0;
+	char* base = &ib->buf[start];
+	size_t left = ib->ofs - start;
 
-/* consume each character in buffer */
-	for (size_t i = start; i < ib->ofs; i++){
-
-/* if we match linefeed at our current position we are done */
-		if (ib->buf[i] == linech){
+/* let libc do the scanning, memchr is vectorised on anything relevant */
+	char* lf = memchr(base, linech, left);
+	if (lf){
+		size_t n = lf - base;
 
 /* some callers want the character to remain, others will strip it */
-			*nb = ib->lfstrip ? (i - start) : (i - start) + 1;
-			*step = (i - start) + 1;
-			*gotline = true;
-			return &ib->buf[start];
-		}
+		*nb = ib->lfstrip ? n : n + 1;
+		*step = n + 1;
+		*gotline = true;
+		return base;
 	}
 
-/* we are full without separator or at end-of-source */
-	if (eof || (!start && ib->ofs == COUNT_OF(ib->buf))){
+/* we are full without separator and can't grow, or at end-of-source */
+	if (eof || (!start && ib->ofs == ib->buf_sz && ib->buf_sz >= ib->buf_cap)){
 		*gotline = false;
+		*nb = left;
+		*step = left;
+		return base;
+	}
 
-		if (ib->ofs < start){
-			*nb = 0;
-			*step = 0;
-			ib->ofs = 0;
-		}
-		else {
-			*nb = ib->ofs - start;
-			*step = ib->ofs - start;
+	return NULL;
+}
+
+/*
+ * Make room at the end of the input buffer. Pending data is only slid down
+ * when the tail is getting short, so that is one memmove per buffer worth of
+ * lines rather than one per line, and the buffer grows if a single line
+ * doesn't fit.
+ */
+static bool prepare_input(struct nonblock_io* ib)
+{
+	if (!ib->buf){
+		ib->buf = malloc(NBIO_BUFFER_BASE);
+		if (!ib->buf)
+			return false;
+		ib->buf_sz = NBIO_BUFFER_BASE;
+		ib->buf_cap = NBIO_BUFFER_CAP;
+		ib->head = ib->ofs = 0;
+	}
+
+	if (ib->head == ib->ofs){
+		ib->head = ib->ofs = 0;
+		return true;
+	}
+
+	if (ib->head && ib->buf_sz - ib->ofs < ib->buf_sz / 4){
+		memmove(ib->buf, &ib->buf[ib->head], ib->ofs - ib->head);
+		ib->ofs -= ib->head;
+		ib->head = 0;
+	}
+
+	if (ib->ofs == ib->buf_sz && ib->buf_sz < ib->buf_cap){
+		char* buf = realloc(ib->buf, ib->buf_sz * 2);
+
+/* cap where we are, nextline will then return the line in pieces */
+		if (!buf){
+			ib->buf_cap = ib->buf_sz;
+			return true;
 		}
-		return ib->buf;
+
+		ib->buf = buf;
+		ib->buf_sz *= 2;
 	}
 
-	return NULL;
+	return true;
+}
+
+/* append each pending line to the table at [ind], return number of lines */
+static size_t lines_to_table(lua_State* L, struct nonblock_io* ib, bool eof, int ind)
+{
+	size_t pos = lua_rawlen(L, ind) + 1;
+	size_t len, step, n = 0;
+	bool gotline;
+	char* ch;
+
+/* let the table set ceiling on the number of lines per call, if the field
+ * isnt't there count will be set to 0 and we just turn it into SIZET_MAX.
+ * The use-case for this is to be able to yield cothreads between table
+ * reads. */
+	lua_getfield(L, ind, "read_cap");
+	size_t count = lua_tonumber(L, -1);
+	if (!count)
+		count = (size_t) -1;
+	lua_pop(L, 1);
+
+	if (ind < 0)
+		ind -= 2;
+
+	while (
+		count &&
+		(ch = nextline(ib, ib->head, eof, &len, &step, &gotline, ib->lfch))){
+		lua_pushinteger(L, pos++);
+		lua_pushlstring(L, ch, len);
+		lua_rawset(L, ind);
+		ib->head += step;
+		count--;
+		n++;
+	}
+
+	return n;
 }
 
 int alt_nbio_process_read(
 	lua_State* L, struct nonblock_io* ib, bool nonbuffered)
 {
-	size_t buf_sz = COUNT_OF(ib->buf);
 	char* ch = NULL;
 	size_t len = 0, step = 0;
+	bool gotline;
 
 	if (!ib || ib->fd < 0)
 		return 0;
 
+/* for the one line per call form, a line that is already buffered is
+ * returned as is rather than paying for a read() each time */
+	bool single = !nonbuffered &&
+		lua_type(L, -1) != LUA_TFUNCTION && lua_type(L, -1) != LUA_TTABLE;
+
+	if (single && ib->buf &&
+		(ch = nextline(ib, ib->head, false, &len, &step, &gotline, ib->lfch))){
+		lua_pushlstring(L, ch, len);
+		ib->head += step;
+		lua_pushboolean(L, true);
+		return 2;
+	}
+
 /*
  * The normal ugly edge case is EOF when where is strings in the buffer
  * still pending and the caller wants returns per logical line to avoid
@@ -729,7 +815,12 @@ int alt_nbio_process_read(
  * the caller that the descriptor can be closed.
  */
 	bool eof = false;
-	ssize_t nr = read(ib->fd, &ib->buf[ib->ofs], buf_sz - ib->ofs);
+	ssize_t nr = -1;
+	errno = EAGAIN;
+
+/* a buffer full of lines the caller hasn't taken yet is not end of file */
+	if (prepare_input(ib) && ib->ofs < ib->buf_sz)
+		nr = read(ib->fd, &ib->buf[ib->ofs], ib->buf_sz - ib->ofs);
 
 	if (0 == nr){
 		eof = true;
@@ -738,16 +829,15 @@ int alt_nbio_process_read(
 /*
  * For the old :read() -> line, ok form there is a case where we try to read,
  * manages to get a line, call a read again and it fails with valid data still
- * in buffer. In that case we fall through (ib->ofs set) and the normal nonbuf
+ * in buffer. In that case we fall through (pending data) and the normal nonbuf
  * or nextline approach will continue correctly.
  */
 	else if (-1 == nr){
 		if (errno == EAGAIN || errno == EINTR){
-			if (!ib->ofs){
+			if (!ib->buf || ib->head == ib->ofs){
 				lua_pushnil(L);
 				lua_pushboolean(L, true);
-				if (!ib->ofs)
-					return 2;
+				return 2;
 			}
 		}
 		else
@@ -756,30 +846,41 @@ int alt_nbio_process_read(
 	else
 		ib->ofs += nr;
 
+	bool pending = ib->buf && ib->head < ib->ofs;
+
 	if (nonbuffered){
-		if (ib->ofs)
-			lua_pushlstring(L, ib->buf, ib->ofs);
+		if (pending)
+			lua_pushlstring(L, &ib->buf[ib->head], ib->ofs - ib->head);
 		else
 			lua_pushnil(L);
-		lua_pushboolean(L, !eof || ib->ofs);
-		ib->ofs = 0;
+		lua_pushboolean(L, !eof || pending);
+		ib->head = ib->ofs = 0;
 		return 2;
 	}
 
-/* three different transfer modes based on the top argument.
+/* four different transfer modes based on the top argument(s).
  * 1. just return the first string as a call result.
  * 2. append to table at -1.
  * 3. forward to the callback at -1.
+ * 4. append to table at -2 and forward that to the callback at -1.
  */
-#define SLIDE(X) do{\
-	if (ci <= ib->ofs){\
-		memmove(ib->buf, &ib->buf[ci], ib->ofs - ci);\
-		ib->ofs -= ci;\
-}} while(0)
-	bool gotline;
+	if (lua_type(L, -1) == LUA_TFUNCTION && lua_type(L, -2) == LUA_TTABLE){
+		size_t n = lines_to_table(L, ib, eof, -2);
 
-	if (lua_type(L, -1) == LUA_TFUNCTION){
-		size_t ci = 0;
+/* one call for everything that could be read, eof is only set when there is
+ * nothing left in the buffer for the next round */
+		if (n || eof){
+			lua_pushvalue(L, -1);
+			lua_pushvalue(L, -3);
+			lua_pushboolean(L, eof && ib->head == ib->ofs);
+			alt_call(L, CB_SOURCE_NONE, 0, 2, 0, LINE_TAG":read_batch_cb");
+		}
+
+		lua_pushnil(L);
+		lua_pushboolean(L, !eof);
+		return 2;
+	}
+	else if (lua_type(L, -1) == LUA_TFUNCTION){
 
 /* several invariants:
  * 1. normal lf -> string
@@ -789,73 +890,32 @@ int alt_nbio_process_read(
 		bool cancel = false;
 		while (
 			!cancel &&
-			(ch = nextline(ib, ci, eof, &len, &step, &gotline, ib->lfch))){
+			(ch = nextline(ib, ib->head, eof, &len, &step, &gotline, ib->lfch))){
 			lua_pushvalue(L, -1);
 			lua_pushlstring(L, ch, len);
 			lua_pushboolean(L, eof && !gotline);
-			ci += step;
+			ib->head += step;
 			alt_call(L, CB_SOURCE_NONE, 0, 2, 1, LINE_TAG":read_cb");
 
-/* the caller doesn't want more data (right now) OR the offset has
- * been incremented past buffer constraints when there is <LF><EOF>
- * as step will be 1 <= step <= ofs could cause nextline called at
- * a start beyond end of buffer */
-			cancel = lua_toboolean(L, -1) || ib->ofs <= ci;
+/* the caller doesn't want more data (right now) OR there is nothing left */
+			cancel = lua_toboolean(L, -1) || ib->ofs <= ib->head;
 			lua_pop(L, 1);
 		}
 
-		SLIDE();
-
 		lua_pushnil(L);
 		lua_pushboolean(L, !eof);
 		return 2;
 	}
 	else if (lua_type(L, -1) == LUA_TTABLE){
-		size_t ind = lua_rawlen(L, -1) + 1;
-		size_t ci = 0;
-
-/* let the table set ceiling on the number of lines per call, if the field
- * isnt't there count will be set to 0 and we just turn it into SIZET_MAX.
- * The use-case for this is to be able to yield cothreads between table
- * reads. */
-		lua_getfield(L, -1, "read_cap");
-		size_t count = lua_tonumber(L, -1);
-		if (!count)
-			count = (size_t) -1;
-		lua_pop(L, 1);
-
-	while (
-			count &&
-	/* same caveat as above, striplf mode can cause len == 0 with step+1
-	 * at end-of-full buffer causing ci to overstep buffer cap */
-			ci < ib->ofs,
-			(ch = nextline(ib, ci, eof, &len, &step, &gotline, ib->lfch))){
-			if (eof && len == 0 && step == 0)
-				break;
-
-			lua_pushinteger(L, ind++);
-			lua_pushlstring(L, ch, len);
-			lua_rawset(L, -3);
-			count--;
-
-			ci += step;
-		}
-
-		SLIDE();
+		lines_to_table(L, ib, eof, -1);
 		lua_pushnil(L);
 		lua_pushboolean(L, !eof);
 		return 2;
 	}
 	else {
-		if ((ch = nextline(ib, 0, eof, &len, &step, &gotline, ib->lfch))){
+		if ((ch = nextline(ib, ib->head, eof, &len, &step, &gotline, ib->lfch))){
 			lua_pushlstring(L, ch, len);
-
-			if (step < ib->ofs){
-				memmove(ib->buf, &ib->buf[step], buf_sz - step);
-				ib->ofs -= step;
-			}
-			else
-				ib->ofs = 0;
+			ib->head += step;
 		}
 		else
 			lua_pushnil(L);
@@ -104,16 +104,62 @@ static char* synchopts[] = {
 	"powersave", "synch to clock tick (~25Hz)",
 	"adaptive", "defer composition",
 	"tight", "defer composition, delay client-wake",
+	"predict", "defer composition to a predicted deadline",
 	NULL
 };
 
+/*
+ * Cost models used by the predict strategy, a window of the most recent
+ * samples (us) that is queried for a percentile rather than a mean so that
+ * one occasional heavy frame or client doesn't drag the estimate with it
+ * like the EMA in estimate_frame_cost does.
+ */
+#define COST_WINDOW 64
+struct cost_model {
+	uint32_t samples[COST_WINDOW];
+	size_t ofs, count;
+	bool dirty;
+	uint32_t cached;
+};
+
+/* per client, arrival is measured from the last display synch to the point
+ * the frame was first seen ready, and history has one bit for every synch
+ * that the client did deliver to (lsb is the most recent) */
+struct client_model {
+	struct cost_model arrival;
+	struct cost_model upload;
+	uint32_t history;
+	bool expected;
+};
+
 static struct {
 	struct arcan_frameserver** ref;
+	struct client_model* model;
 	size_t count;
 	size_t used;
 	struct arcan_frameserver* focus;
 } frameservers;
 
+/*
+ * The predict strategy composes at the latest point where the modelled
+ * compose cost, and the uploads of the clients that are expected to deliver
+ * before then, still fit inside the synch period. Missing the display synch
+ * is detected from the synch to synch interval and a margin is adjusted to
+ * keep the miss rate over the last 32 frames below PREDICT_MISS_LIMIT.
+ */
+#define PREDICT_MISS_LIMIT 2
+#define PREDICT_QUANTILE 0.95
+#define PREDICT_CLIENT_QUANTILE 0.9
+
+static struct {
+	struct cost_model compose;
+	uint64_t last_refresh;
+	uint64_t last_synch;
+	uint32_t missed;
+	int64_t margin;
+	struct conductor_synchstats stats;
+} predict;
+
 enum synchopts {
 /* wait for display, wake clients after vsynch */
 	SYNCH_VSYNCH = 0,
@@ -126,7 +172,9 @@ enum synchopts {
 /* defer composition, wake clients after vsynch */
 	SYNCH_ADAPTIVE,
 /* defer composition, wake clients after half-time */
-	SYNCH_TIGHT
+	SYNCH_TIGHT,
+/* defer composition to a deadline from per client and compose cost models */
+	SYNCH_PREDICT
 };
 
 static int synchopt = SYNCH_IMMEDIATE;
@@ -166,6 +214,75 @@ static void step_herd(int mode)
 		TRACE_SYS_DEFAULT, mode, conductor.transfer_cost, "step-herd");
 }
 
+static void cost_add(struct cost_model* m, uint64_t v)
+{
+	m->samples[m->ofs] = v > UINT32_MAX ? UINT32_MAX : v;
+	m->ofs = (m->ofs + 1) % COST_WINDOW;
+	if (m->count < COST_WINDOW)
+		m->count++;
+	m->dirty = true;
+}
+
+/* the window is small enough that a sorted copy is cheaper than maintaining
+ * anything smarter, and the result is cached until the next sample */
+static uint64_t cost_pct(struct cost_model* m, float pct)
+{
+	if (!m->dirty)
+		return m->cached;
+
+	uint32_t tmp[COST_WINDOW];
+	for (size_t i = 0; i < m->count; i++){
+		uint32_t v = m->samples[i];
+		size_t j = i;
+		for (; j > 0 && tmp[j-1] > v; j--)
+			tmp[j] = tmp[j-1];
+		tmp[j] = v;
+	}
+
+	m->dirty = false;
+	m->cached = m->count ? tmp[(size_t)(pct * (float)(m->count - 1))] : 0;
+	return m->cached;
+}
+
+/* whatever was uploaded before the synch has now reached scanout (or at least
+ * the point where the platform lets go), close the timing record for those */
+static void present_herd()
+{
+	uint64_t now = arcan_timemicros();
+	uint64_t composed = arcan_video_display.refresh_us;
+
+	for (size_t i = 0; i < frameservers.count; i++){
+		struct arcan_frameserver* fsrv = frameservers.ref[i];
+		if (!fsrv)
+			continue;
+
+/* only frames that made it into this composition feed the client model */
+		struct client_model* cm = &frameservers.model[i];
+		bool delivered = fsrv->timing.inflight &&
+			composed >= fsrv->timing.inflight_ack;
+		cm->history = (cm->history << 1) | delivered;
+
+		if (delivered){
+			uint64_t ready = fsrv->timing.inflight;
+			cost_add(&cm->arrival,
+				ready > predict.last_synch ? ready - predict.last_synch : 0);
+			cost_add(&cm->upload, fsrv->timing.upload);
+		}
+
+		if (cm->expected){
+			if (delivered)
+				fsrv->timing.deadline_hit++;
+			else
+				fsrv->timing.deadline_miss++;
+			cm->expected = false;
+		}
+
+		arcan_frameserver_timing_present(fsrv, composed, now);
+	}
+
+	predict.last_synch = now;
+}
+
 static void forward_vblank()
 {
 	for (size_t i = 0; i < frameservers.count; i++){
@@ -202,6 +319,10 @@ static void alloc_frameserver_struct()
 		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
 
 	memset(frameservers.ref, '\0', sizeof(void*) * frameservers.count);
+
+	frameservers.model = arcan_alloc_mem(
+		sizeof(struct client_model) * frameservers.count,
+		ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
 }
 
 void arcan_conductor_lock_gpu(
@@ -280,12 +401,22 @@ void arcan_conductor_register_frameserver(struct arcan_frameserver* fsrv)
 		memcpy(newref, frameservers.ref, frameservers.count * sizeof(void*));
 		arcan_mem_free(frameservers.ref);
 		frameservers.ref = newref;
+
+		struct client_model* newmodel = arcan_alloc_mem(
+			sizeof(struct client_model) * frameservers.count * 2,
+			ARCAN_MEM_VSTRUCT, ARCAN_MEM_BZERO, ARCAN_MEMALIGN_NATURAL);
+		memcpy(newmodel, frameservers.model,
+			frameservers.count * sizeof(struct client_model));
+		arcan_mem_free(frameservers.model);
+		frameservers.model = newmodel;
+
 		dst_i = frameservers.count;
 		frameservers.count *= 2;
 	}
 
 	frameservers.used++;
 	frameservers.ref[dst_i] = fsrv;
+	memset(&frameservers.model[dst_i], '\0', sizeof(struct client_model));
 	TRACE_MARK_ONESHOT("conductor", "frameserver",
 		TRACE_SYS_DEFAULT, fsrv->vid, 0, "register");
 
@@ -365,6 +496,7 @@ void arcan_conductor_setsynch(const char* arg)
 		arcan_frameserver_lock_buffers(2);
 	break;
 	case SYNCH_TIGHT:
+	case SYNCH_PREDICT:
 		arcan_frameserver_lock_buffers(2);
 	break;
 	case SYNCH_IMMEDIATE:
@@ -512,6 +644,100 @@ static int estimate_frame_cost()
 	return conductor.render_cost + conductor.transfer_cost + conductor.timestep;
 }
 
+/* a client is only waited for if it has delivered to most of the recent
+ * synchs and its arrival and upload fit inside the period */
+static bool predict_client(struct client_model* cm, int64_t period, uint64_t* upload)
+{
+	if (__builtin_popcount(cm->history & 0xff) < 6)
+		return false;
+
+	*upload = cost_pct(&cm->upload, PREDICT_CLIENT_QUANTILE);
+	return cost_pct(&cm->arrival, PREDICT_CLIENT_QUANTILE) + *upload < period;
+}
+
+/* latest point (us from the last synch) at which composition can start */
+static int64_t predict_deadline(int next)
+{
+	int64_t period = (int64_t)next * 1000;
+	int64_t budget = cost_pct(&predict.compose, PREDICT_QUANTILE) +
+		predict.margin + conductor.timestep * 1000;
+
+/* uploads from clients that are still expected this period get added, the
+ * ones that have already delivered paid for theirs during the wait */
+	for (size_t i = 0; i < frameservers.count; i++){
+		struct arcan_frameserver* fsrv = frameservers.ref[i];
+		uint64_t upload;
+		if (!fsrv || fsrv->timing.inflight || fsrv->timing.ready)
+			continue;
+
+		if (predict_client(&frameservers.model[i], period - budget, &upload))
+			budget += upload;
+	}
+
+	return period - budget;
+}
+
+/* mark which clients the composition is counting on for the hit/miss stats */
+static void predict_commit()
+{
+	int64_t period = predict.last_synch ?
+		(int64_t)(arcan_timemicros() - predict.last_synch) : 0;
+
+	for (size_t i = 0; i < frameservers.count; i++){
+		struct arcan_frameserver* fsrv = frameservers.ref[i];
+		uint64_t upload;
+		if (fsrv)
+			frameservers.model[i].expected =
+				predict_client(&frameservers.model[i], period, &upload);
+	}
+}
+
+/* feed the compose model and detect if the display synch was missed, which
+ * shows up as the synch to synch interval stretching well past the period */
+static void predict_update(int64_t next, uint64_t interval)
+{
+	if (arcan_video_display.refresh_us != predict.last_refresh){
+		predict.last_refresh = arcan_video_display.refresh_us;
+		cost_add(&predict.compose, arcan_video_display.refresh_cost_us);
+	}
+
+	if (next <= 0)
+		return;
+
+	bool miss = interval * 2 > (uint64_t) next * 3;
+	predict.missed = (predict.missed << 1) | miss;
+	predict.stats.frames++;
+	predict.stats.missed += miss;
+
+	int64_t period = next * 1000;
+	if (__builtin_popcount(predict.missed) > PREDICT_MISS_LIMIT){
+		predict.margin += 500;
+		if (predict.margin > period >> 1)
+			predict.margin = period >> 1;
+	}
+	else if (!predict.missed && predict.margin > 0){
+		predict.margin -= 100;
+		if (predict.margin < 0)
+			predict.margin = 0;
+	}
+
+	predict.stats.margin = predict.margin;
+	predict.stats.compose = cost_pct(&predict.compose, PREDICT_QUANTILE);
+}
+
+void arcan_conductor_synchstats(struct conductor_synchstats* out)
+{
+	*out = predict.stats;
+	out->client_hit = out->client_miss = 0;
+
+	for (size_t i = 0; i < frameservers.count; i++){
+		if (frameservers.ref[i]){
+			out->client_hit += frameservers.ref[i]->timing.deadline_hit;
+			out->client_miss += frameservers.ref[i]->timing.deadline_miss;
+		}
+	}
+}
+
 static bool preframe_synch(int next, int elapsed)
 {
 	switch(synchopt){
@@ -552,6 +778,18 @@ static bool preframe_synch(int next, int elapsed)
 			TRACE_SYS_DEFAULT, 0, elapsed - margin, "tight-deadline");
 		return true;
 	}
+	case SYNCH_PREDICT:{
+		int64_t deadline = predict_deadline(next);
+		if ((int64_t)elapsed * 1000 < deadline){
+			internal_yield();
+			return false;
+		}
+
+		TRACE_MARK_ONESHOT("conductor", "synchronization",
+			TRACE_SYS_DEFAULT, 0, (int64_t)elapsed * 1000 - deadline, "predict-deadline");
+		predict_commit();
+		return true;
+	}
 	case SYNCH_VSYNCH:
 	case SYNCH_PROCESSING:
 	case SYNCH_IMMEDIATE:
@@ -567,6 +805,7 @@ static uint64_t postframe_synch(uint64_t next)
 	case SYNCH_VSYNCH:
 	case SYNCH_ADAPTIVE:
 	case SYNCH_POWERSAVE:
+	case SYNCH_PREDICT:
 		unlock_herd();
 	break;
 	case SYNCH_PROCESSING:
@@ -607,6 +846,7 @@ static int trigger_video_synch(float frag)
 	TRACE_MARK_ENTER("conductor", "platform-frame", TRACE_SYS_DEFAULT, conductor.tick_count, frag, "");
 		arcan_lua_callvoidfun(main_lua_context, "preframe_pulse", false, NULL);
 			platform_video_synch(conductor.tick_count, frag, NULL, NULL);
+			present_herd();
 
 			#ifdef WITH_TRACY
 			TracyCFrameMark
@@ -645,6 +885,20 @@ int arcan_conductor_run(arcan_tick_cb tick)
 
 	arcan_event_setdrain(evctx, overflow_drain);
 
+/* descriptor-passed segments are opt-in as they need clients of the same
+ * shmif version, these can then be kept ready so that bursts of new clients
+ * (session restore and so on) don't have to wait for shared memory setup */
+	uintptr_t tag;
+	char* pool = NULL;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	if (get_config("shm_fdpass", 0, NULL, tag))
+		platform_fsrv_segment_fdpass(true);
+
+	if (get_config("shm_pool", 0, &pool, tag) && pool){
+		platform_fsrv_segment_pool(strtoul(pool, NULL, 10));
+		free(pool);
+	}
+
 	for(;;){
 /*
  * So this is not good enough to do attribution, and it is likely that the
@@ -713,8 +967,12 @@ int arcan_conductor_run(arcan_tick_cb tick)
 				unlock_herd();
 			}
 
+			int64_t period = next_synch > 0 ? next_synch - last_synch : 0;
 			next_synch = postframe_synch( trigger_video_synch(frag) );
-			last_synch = arcan_timemillis();
+
+			uint64_t now = arcan_timemillis();
+			predict_update(period, now - last_synch);
+			last_synch = now;
 		}
 	}
 
@@ -778,6 +1036,9 @@ static void conductor_cycle(int nticks)
 	arcan_lua_tick(main_lua_context, nticks, conductor.tick_count);
 	outcb(nticks);
 
+/* after the scripts so that segments used this tick get replaced */
+	platform_fsrv_segment_pool_refill(2);
+
 	while(nticks--)
 		arcan_mem_tick();
 }
@@ -119,6 +119,21 @@ void arcan_conductor_fakesynch(uint8_t left_ms);
 #ifndef VIDEO_PLATFORM_IMPL
 int arcan_conductor_reset_count(bool step);
 
+/*
+ * Display synch statistics. Frames that took more than 1.5 times the synch
+ * period to reach the display are counted as missed. Client hit/miss counts
+ * are for the clients that the predict strategy expected to deliver for a
+ * composition, and margin/compose the current safety margin and modelled
+ * compose cost in microseconds.
+ */
+struct conductor_synchstats {
+	uint64_t frames, missed;
+	uint64_t client_hit, client_miss;
+	int64_t margin;
+	uint64_t compose;
+};
+void arcan_conductor_synchstats(struct conductor_synchstats* out);
+
 /* Update the priority target to match the specified frameserver. This
  * means that heuristics driving synchronization will be biased towards
  * letting the specific fsrv align synchronization - if the synchronization
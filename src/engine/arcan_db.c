@@ -15,6 +15,8 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "arcan_math.h"
 #include "arcan_general.h"
@@ -133,24 +135,96 @@ static const char* ddls[] = {
 #define DI_INSKV_TARGET_LIBV "INSERT OR REPLACE INTO "\
 	"target_libs(libname, libnote, target) VALUES(?, ?, ?);"
 
+/*
+ * Prepared statements are kept per connection and reused, keyed on the query
+ * text as several of those are built at runtime (appl_ tables). The set is
+ * small enough for a linear scan, and the least recently used one is
+ * finalized when a new query needs a slot.
+ */
+#define DB_STMT_CACHE 32
+struct db_stmtcache {
+	struct {
+		uint32_t hash;
+		char* qry;
+		sqlite3_stmt* stmt;
+		uint64_t used;
+	} ent[DB_STMT_CACHE];
+	uint64_t clock;
+};
+
+/*
+ * Read-through cache for appl_ key/values. Entries with a NULL val are known
+ * to be missing. When the limit is reached the whole set is dropped, which
+ * is safe as misses go through the database after pending writes are done.
+ */
+#define DB_KV_BUCKETS 256
+#define DB_KV_LIMIT 4096
+struct db_kv {
+	uint32_t hash;
+	char* appl;
+	char* key;
+	char* val;
+	struct db_kv* next;
+};
+
+/*
+ * Key/value writes are queued as one op per transaction (or appl_kv call)
+ * and applied by a writer thread with its own connection, everything that
+ * is queued when it wakes up gets committed as one transaction. A NULL val
+ * in an op means that the key should be removed.
+ */
+struct db_op {
+	enum DB_KVTARGET kvt;
+	int64_t id;
+	char* appl;
+	bool clean;
+	size_t count;
+	char** keys;
+	char** vals;
+	struct db_op* next;
+};
+
+struct db_writer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	struct db_op* head;
+	struct db_op** tail;
+	size_t pending;
+	bool shutdown;
+
+/* number of batches that could not be committed, the main thread then drops
+ * the kv cache as it holds values that never made it to the database, and
+ * reports the failure to the next caller that can return one */
+	_Atomic size_t failed;
+	sqlite3* dbh;
+	struct db_stmtcache stmts;
+
+/* journal mode of the file before the writer switched it to WAL */
+	char journal[16];
+};
+
 struct arcan_dbh {
 	sqlite3* dbh;
+	struct db_stmtcache stmts;
+	struct db_writer* writer;
+
+/* writer failures already acted on by the kv cache and reported to a caller */
+	size_t failed_cache;
+	size_t failed_report;
+
+	struct {
+		struct db_kv* buckets[DB_KV_BUCKETS];
+		size_t count;
+	} kv;
+
+/* transaction being built between begin_transaction and end_transaction */
+	struct db_op* op;
 
 /* cached appl name used for the DBHandle, although
  * some special functions may use a different one, none outside _db.c should */
 	char* applname;
-	char* akv_update;
-	char* akv_get;
-	char* akv_clean;
-
-	size_t akv_upd_sz;
-	size_t akv_get_sz;
-	size_t akv_clean_sz;
-
-	enum DB_KVTARGET ttype;
-	union arcan_dbtrans_id trid;
-	bool trclean;
-	sqlite3_stmt* transaction;
 };
 
 static void setup_ddl(struct arcan_dbh* dbh);
@@ -168,6 +242,519 @@ void arcan_db_set_shared(struct arcan_dbh* new)
 	shared_handle = new;
 }
 
+static uint32_t db_hash(const char* str, const char* str2)
+{
+	uint32_t hash = 2166136261;
+	for (; *str; str++)
+		hash = (hash ^ (uint8_t)*str) * 16777619;
+
+	if (str2){
+		hash = (hash ^ '.') * 16777619;
+		for (; *str2; str2++)
+			hash = (hash ^ (uint8_t)*str2) * 16777619;
+	}
+
+	return hash;
+}
+
+static void db_sync(struct arcan_dbh* dbh)
+{
+	struct db_writer* wr = dbh->writer;
+	if (!wr)
+		return;
+
+	pthread_mutex_lock(&wr->lock);
+	while (wr->pending)
+		pthread_cond_wait(&wr->done, &wr->lock);
+	pthread_mutex_unlock(&wr->lock);
+}
+
+static void kv_flush(struct arcan_dbh* dbh);
+
+/*
+ * Check if the writer has failed a batch since the last time [seen] was
+ * updated, the kv cache is then dropped as it is ahead of the database.
+ */
+static bool writer_failed(struct arcan_dbh* dbh, size_t* seen)
+{
+	if (!dbh->writer)
+		return false;
+
+	size_t n = atomic_load(&dbh->writer->failed);
+	if (n == *seen)
+		return false;
+
+	*seen = n;
+	kv_flush(dbh);
+	return true;
+}
+
+static sqlite3_stmt* stmtcache_get(
+	sqlite3* db, struct db_stmtcache* cache, const char* qry)
+{
+	uint32_t hash = db_hash(qry, NULL);
+	size_t lru = 0;
+
+	for (size_t i = 0; i < DB_STMT_CACHE; i++){
+		if (cache->ent[i].stmt &&
+			cache->ent[i].hash == hash && strcmp(cache->ent[i].qry, qry) == 0){
+			cache->ent[i].used = ++cache->clock;
+			return cache->ent[i].stmt;
+		}
+
+		if (cache->ent[i].used < cache->ent[lru].used)
+			lru = i;
+	}
+
+	sqlite3_stmt* stmt = NULL;
+	if (SQLITE_OK != sqlite3_prepare_v2(db, qry, -1, &stmt, NULL)){
+		sqlite3_finalize(stmt);
+		return NULL;
+	}
+
+	if (cache->ent[lru].stmt){
+		sqlite3_finalize(cache->ent[lru].stmt);
+		free(cache->ent[lru].qry);
+	}
+
+	cache->ent[lru].stmt = stmt;
+	cache->ent[lru].qry = strdup(qry);
+	cache->ent[lru].hash = hash;
+	cache->ent[lru].used = ++cache->clock;
+	return stmt;
+}
+
+static void stmtcache_free(struct db_stmtcache* cache)
+{
+	for (size_t i = 0; i < DB_STMT_CACHE; i++){
+		if (!cache->ent[i].stmt)
+			continue;
+
+		sqlite3_finalize(cache->ent[i].stmt);
+		free(cache->ent[i].qry);
+		cache->ent[i].stmt = NULL;
+	}
+}
+
+/*
+ * Retrieve a prepared statement for direct use on the main connection, any
+ * pending writes are completed first so that the query sees them. Pair with
+ * db_stmt_done rather than sqlite3_finalize.
+ */
+static sqlite3_stmt* db_stmt(struct arcan_dbh* dbh, const char* qry)
+{
+	db_sync(dbh);
+	return stmtcache_get(dbh->dbh, &dbh->stmts, qry);
+}
+
+static void db_stmt_done(sqlite3_stmt* stmt)
+{
+	if (!stmt)
+		return;
+
+	sqlite3_reset(stmt);
+	sqlite3_clear_bindings(stmt);
+}
+
+static struct db_kv* kv_find(
+	struct arcan_dbh* dbh, const char* appl, const char* key, uint32_t hash)
+{
+	struct db_kv* cur = dbh->kv.buckets[hash % DB_KV_BUCKETS];
+	for (; cur; cur = cur->next)
+		if (cur->hash == hash &&
+			strcmp(cur->key, key) == 0 && strcmp(cur->appl, appl) == 0)
+			return cur;
+
+	return NULL;
+}
+
+static void kv_flush(struct arcan_dbh* dbh)
+{
+	for (size_t i = 0; i < DB_KV_BUCKETS; i++){
+		struct db_kv* cur = dbh->kv.buckets[i];
+		while (cur){
+			struct db_kv* next = cur->next;
+			free(cur->appl);
+			free(cur->key);
+			free(cur->val);
+			free(cur);
+			cur = next;
+		}
+		dbh->kv.buckets[i] = NULL;
+	}
+	dbh->kv.count = 0;
+}
+
+static void kv_set(struct arcan_dbh* dbh,
+	const char* appl, const char* key, const char* val)
+{
+	uint32_t hash = db_hash(appl, key);
+	struct db_kv* ent = kv_find(dbh, appl, key, hash);
+
+	if (ent){
+		free(ent->val);
+		ent->val = val ? strdup(val) : NULL;
+		return;
+	}
+
+	if (dbh->kv.count >= DB_KV_LIMIT)
+		kv_flush(dbh);
+
+	ent = malloc(sizeof(struct db_kv));
+	if (!ent)
+		return;
+
+	*ent = (struct db_kv){
+		.hash = hash,
+		.appl = strdup(appl),
+		.key = strdup(key),
+		.val = val ? strdup(val) : NULL,
+		.next = dbh->kv.buckets[hash % DB_KV_BUCKETS]
+	};
+	dbh->kv.buckets[hash % DB_KV_BUCKETS] = ent;
+	dbh->kv.count++;
+}
+
+/* empty values are removed on commit so treat those as missing already */
+static void kv_clean(struct arcan_dbh* dbh, const char* appl)
+{
+	for (size_t i = 0; i < DB_KV_BUCKETS; i++)
+		for (struct db_kv* cur = dbh->kv.buckets[i]; cur; cur = cur->next)
+			if (cur->val && cur->val[0] == '\0' && strcmp(cur->appl, appl) == 0){
+				free(cur->val);
+				cur->val = NULL;
+			}
+}
+
+static void op_free(struct db_op* op)
+{
+	for (size_t i = 0; i < op->count; i++){
+		free(op->keys[i]);
+		free(op->vals[i]);
+	}
+	free(op->keys);
+	free(op->vals);
+	free(op->appl);
+	free(op);
+}
+
+static bool op_append(struct db_op* op, const char* key, const char* val)
+{
+	char** keys = realloc(op->keys, sizeof(char*) * (op->count + 1));
+	if (!keys)
+		return false;
+	op->keys = keys;
+
+	char** vals = realloc(op->vals, sizeof(char*) * (op->count + 1));
+	if (!vals)
+		return false;
+	op->vals = vals;
+
+	op->keys[op->count] = strdup(key);
+	op->vals[op->count] = val ? strdup(val) : NULL;
+	op->count++;
+	return true;
+}
+
+/*
+ * Run the queries for one op against [db], the caller is responsible for
+ * the surrounding transaction. Returns false if the database rather than a
+ * single pair failed, the transaction should then be rolled back.
+ */
+static bool op_apply(sqlite3* db, struct db_stmtcache* cache, struct db_op* op)
+{
+	bool ok = true;
+	const char* ins = NULL;
+	const char* drop = NULL;
+	const char* clean = NULL;
+	size_t buf_sz = (op->appl ? strlen(op->appl) : 0) + 64;
+	char ins_buf[buf_sz], drop_buf[buf_sz], clean_buf[buf_sz];
+
+	switch (op->kvt){
+	case DVT_APPL:
+		snprintf(ins_buf, buf_sz,
+			"INSERT OR REPLACE INTO appl_%s(key, val) VALUES(?, ?);", op->appl);
+		snprintf(drop_buf, buf_sz,
+			"DELETE FROM appl_%s WHERE key=?;", op->appl);
+		snprintf(clean_buf, buf_sz,
+			"DELETE FROM appl_%s WHERE val = \"\";", op->appl);
+		ins = ins_buf;
+		drop = drop_buf;
+		clean = clean_buf;
+	break;
+	case DVT_TARGET:
+		ins = DI_INSKV_TARGET;
+		clean = DI_DROPKV_TARGET;
+	break;
+	case DVT_CONFIG:
+		ins = DI_INSKV_CONFIG;
+		clean = DI_DROPKV_CONFIG;
+	break;
+	case DVT_CONFIG_ENV:
+		ins = DI_INSKV_CONFIG_ENV;
+	break;
+	case DVT_TARGET_ENV:
+		ins = DI_INSKV_TARGET_ENV;
+	break;
+	case DVT_TARGET_LIBV:
+		ins = DI_INSKV_TARGET_LIBV;
+	break;
+	case DVT_ENDM:
+		return true;
+	}
+
+	for (size_t i = 0; i < op->count; i++){
+		sqlite3_stmt* stmt = stmtcache_get(db, cache, op->vals[i] ? ins : drop);
+		if (!stmt)
+			continue;
+
+		sqlite3_bind_text(stmt, 1, op->keys[i], -1, SQLITE_STATIC);
+		if (op->vals[i]){
+			sqlite3_bind_text(stmt, 2, op->vals[i], -1, SQLITE_STATIC);
+			if (op->kvt != DVT_APPL)
+				sqlite3_bind_int(stmt, 3, op->id);
+		}
+
+		int rc = sqlite3_step(stmt);
+		if (SQLITE_DONE != rc){
+			arcan_warning("arcan_db_addkvpair(%s=%s), %d failed: %s\n",
+				op->keys[i], op->vals[i] ? op->vals[i] : "", rc, sqlite3_errmsg(db));
+
+/* a constraint or type error only concerns this pair, anything else (busy,
+ * i/o, full) means the database didn't take the transaction */
+			int prc = rc & 0xff;
+			if (prc != SQLITE_CONSTRAINT && prc != SQLITE_MISMATCH && prc != SQLITE_ERROR)
+				ok = false;
+		}
+
+		db_stmt_done(stmt);
+	}
+
+	if (op->clean && clean)
+		sqlite3_exec(db, clean, NULL, NULL, NULL);
+
+	return ok;
+}
+
+static void* db_writer_thread(void* arg)
+{
+	struct db_writer* wr = arg;
+
+	pthread_mutex_lock(&wr->lock);
+	for(;;){
+		while (!wr->head && !wr->shutdown)
+			pthread_cond_wait(&wr->wake, &wr->lock);
+
+		if (!wr->head)
+			break;
+
+/* take everything that has been queued and commit it as one */
+		struct db_op* ops = wr->head;
+		wr->head = NULL;
+		wr->tail = &wr->head;
+		pthread_mutex_unlock(&wr->lock);
+
+/* take the write lock up front so that busy shows up here rather than as
+ * pairs that silently didn't make it. A failed batch or commit leaves the
+ * transaction open, roll it back and retry once before giving up on it */
+		bool ok = false;
+		for (size_t i = 0; i < 2 && !ok; i++){
+			ok = SQLITE_OK ==
+				sqlite3_exec(wr->dbh, "BEGIN IMMEDIATE;", NULL, NULL, NULL);
+			for (struct db_op* cur = ops; ok && cur; cur = cur->next)
+				ok = op_apply(wr->dbh, &wr->stmts, cur);
+
+			if (ok)
+				ok = SQLITE_OK == sqlite3_exec(wr->dbh, "COMMIT;", NULL, NULL, NULL);
+
+			if (!ok){
+				arcan_warning("arcan_db(), writer commit failed: %s\n",
+					sqlite3_errmsg(wr->dbh));
+				sqlite3_exec(wr->dbh, "ROLLBACK;", NULL, NULL, NULL);
+			}
+		}
+
+		if (!ok)
+			atomic_fetch_add(&wr->failed, 1);
+
+		size_t count = 0;
+		for (struct db_op* cur = ops; cur; count++){
+			struct db_op* next = cur->next;
+			op_free(cur);
+			cur = next;
+		}
+
+		pthread_mutex_lock(&wr->lock);
+		wr->pending -= count;
+		pthread_cond_broadcast(&wr->done);
+	}
+	pthread_mutex_unlock(&wr->lock);
+
+	return NULL;
+}
+
+/*
+ * Hand the op over to the writer or, without one, commit it directly. With
+ * the writer the result can only reflect earlier batches, false means that
+ * one of those failed since the last time a failure was returned.
+ */
+static bool db_queue(struct arcan_dbh* dbh, struct db_op* op)
+{
+	struct db_writer* wr = dbh->writer;
+	if (!wr){
+		bool ok = SQLITE_OK ==
+			sqlite3_exec(dbh->dbh, "BEGIN IMMEDIATE;", NULL, NULL, NULL) &&
+			op_apply(dbh->dbh, &dbh->stmts, op) &&
+			SQLITE_OK == sqlite3_exec(dbh->dbh, "COMMIT;", NULL, NULL, NULL);
+
+		if (!ok){
+			arcan_warning("arcan_db_end_transaction(), failed: %s\n",
+				sqlite3_errmsg(dbh->dbh));
+			sqlite3_exec(dbh->dbh, "ROLLBACK;", NULL, NULL, NULL);
+			kv_flush(dbh);
+		}
+		op_free(op);
+		return ok;
+	}
+
+	pthread_mutex_lock(&wr->lock);
+	op->next = NULL;
+	*wr->tail = op;
+	wr->tail = &op->next;
+	wr->pending++;
+	pthread_cond_signal(&wr->wake);
+	pthread_mutex_unlock(&wr->lock);
+
+	return !writer_failed(dbh, &dbh->failed_report);
+}
+
+/* run a journal_mode pragma and return the resulting mode in [out] */
+static bool journal_mode(sqlite3* db, const char* qry, char* out, size_t out_sz)
+{
+	sqlite3_stmt* stmt = NULL;
+	bool ok = false;
+
+	if (SQLITE_OK == sqlite3_prepare_v2(db, qry, -1, &stmt, NULL) &&
+		SQLITE_ROW == sqlite3_step(stmt)){
+		const char* res = (const char*) sqlite3_column_text(stmt, 0);
+		if (res){
+			snprintf(out, out_sz, "%s", res);
+			ok = true;
+		}
+	}
+
+	sqlite3_finalize(stmt);
+	return ok;
+}
+
+static void journal_restore(sqlite3* db, const char* mode)
+{
+	if (!mode[0] || strcmp(mode, "wal") == 0)
+		return;
+
+	char qry[sizeof("PRAGMA journal_mode=;") + 16];
+	char res[16];
+	snprintf(qry, sizeof(qry), "PRAGMA journal_mode=%s;", mode);
+	if (!journal_mode(db, qry, res, sizeof(res)) || strcmp(res, mode) != 0)
+		arcan_warning("arcan_db(), couldn't restore journal mode (%s)\n", mode);
+}
+
+/*
+ * The writer needs a connection of its own to the same file, so an in-memory
+ * database stays synchronous. WAL lets the main connection keep reading while
+ * the writer commits, and as the commits are off the engine thread they can
+ * afford to actually be synchronous. WAL is a persistent property of the file,
+ * so the previous journal mode is restored when the writer is stopped.
+ */
+static void db_writer_start(struct arcan_dbh* dbh, const char* fname)
+{
+	if (!fname[0] || strcmp(fname, ":memory:") == 0 ||
+		strncmp(fname, "file:", 5) == 0)
+		return;
+
+	char old[16] = {0};
+	char mode[16];
+	journal_mode(dbh->dbh, "PRAGMA journal_mode;", old, sizeof(old));
+
+	if (!journal_mode(dbh->dbh, "PRAGMA journal_mode=WAL;", mode, sizeof(mode))
+		|| strcmp(mode, "wal") != 0){
+		arcan_warning("arcan_db(), WAL unavailable, writes will be synchronous\n");
+		return;
+	}
+
+	struct db_writer* wr = malloc(sizeof(struct db_writer));
+	if (!wr){
+		journal_restore(dbh->dbh, old);
+		return;
+	}
+	*wr = (struct db_writer){0};
+	wr->tail = &wr->head;
+	memcpy(wr->journal, old, sizeof(old));
+
+	if (SQLITE_OK != sqlite3_open_v2(fname, &wr->dbh, SQLITE_OPEN_READWRITE, NULL)){
+		sqlite3_close(wr->dbh);
+		journal_restore(dbh->dbh, old);
+		free(wr);
+		return;
+	}
+
+	sqlite3_busy_timeout(wr->dbh, 1000);
+	sqlite3_busy_timeout(dbh->dbh, 1000);
+	sqlite3_exec(wr->dbh, "PRAGMA foreign_keys=ON;", NULL, NULL, NULL);
+	sqlite3_exec(wr->dbh, "PRAGMA synchronous=NORMAL;", NULL, NULL, NULL);
+
+	pthread_mutex_init(&wr->lock, NULL);
+	pthread_cond_init(&wr->wake, NULL);
+	pthread_cond_init(&wr->done, NULL);
+
+	if (0 != pthread_create(&wr->thread, NULL, db_writer_thread, wr)){
+		pthread_mutex_destroy(&wr->lock);
+		pthread_cond_destroy(&wr->wake);
+		pthread_cond_destroy(&wr->done);
+		sqlite3_close(wr->dbh);
+		journal_restore(dbh->dbh, old);
+		free(wr);
+		return;
+	}
+
+	dbh->writer = wr;
+}
+
+static void db_writer_stop(struct arcan_dbh* dbh)
+{
+	struct db_writer* wr = dbh->writer;
+	if (!wr)
+		return;
+
+	pthread_mutex_lock(&wr->lock);
+	wr->shutdown = true;
+	pthread_cond_signal(&wr->wake);
+	pthread_mutex_unlock(&wr->lock);
+	pthread_join(wr->thread, NULL);
+
+	stmtcache_free(&wr->stmts);
+	sqlite3_close(wr->dbh);
+
+/* with the writer connection gone the main one can switch back, this also
+ * checkpoints and removes the -wal and -shm files */
+	journal_restore(dbh->dbh, wr->journal);
+
+	pthread_mutex_destroy(&wr->lock);
+	pthread_cond_destroy(&wr->wake);
+	pthread_cond_destroy(&wr->done);
+	free(wr);
+	dbh->writer = NULL;
+}
+
+bool arcan_db_flush(struct arcan_dbh* dbh)
+{
+	if (!dbh)
+		return false;
+
+	db_sync(dbh);
+	return !writer_failed(dbh, &dbh->failed_report);
+}
+
 /*
  * any query that just returns a list of strings,
  * pack into a dbres (or append to an existing one)
@@ -196,7 +783,7 @@ static struct arcan_strarr db_string_query(struct arcan_dbh* dbh,
 		res.data[res.count++] = (arg ? strdup(arg) : NULL);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
@@ -209,6 +796,7 @@ static int db_num_query(struct arcan_dbh* dbh, const char* qry, bool* status)
 	if (status) *status = false;
 	int count = -1;
 
+	db_sync(dbh);
 	int code = sqlite3_prepare_v2(dbh->dbh, qry, strlen(qry), &stmt, NULL);
 	if (SQLITE_OK == code){
 		while (sqlite3_step(stmt) == SQLITE_ROW){
@@ -225,7 +813,8 @@ static int db_num_query(struct arcan_dbh* dbh, const char* qry, bool* status)
 }
 
 /*
- * query that is just silently assumed to work
+ * query that is just silently assumed to work, these are one-off (ddl,
+ * pragma) so they don't go through the statement cache
  */
 static inline void db_void_query(struct arcan_dbh* dbh,
 	const char* qry, bool suppr_err)
@@ -234,6 +823,7 @@ static inline void db_void_query(struct arcan_dbh* dbh,
 	if (!qry || !dbh)
 		return;
 
+	db_sync(dbh);
 	int rc = sqlite3_prepare_v2(dbh->dbh, qry, strlen(qry), &stmt, NULL);
 	if (rc == SQLITE_OK){
 		rc = sqlite3_step(stmt);
@@ -261,6 +851,7 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 	snprintf(dropbuf, sizeof(dropbuf), "%s%s;", dropqry, appl);
 
 	db_void_query(dbh, dropbuf, true);
+	kv_flush(dbh);
 
 /* special case, reset version fields etc. */
 	if (strcmp(appl, ARCAN_TBL) == 0){
@@ -270,6 +861,10 @@ void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl)
 
 static void sqliteexit()
 {
+/* last chance for queued writes if we exit without closing the handle */
+	if (shared_handle)
+		db_writer_stop(shared_handle);
+
 	sqlite3_shutdown();
 }
 
@@ -281,13 +876,6 @@ static void create_appl_group(struct arcan_dbh* dbh, const char* applname)
 {
 	const char ddl[] = "CREATE TABLE appl_%s "
 		"(key TEXT UNIQUE, val TEXT NOT NULL);";
-	const char kv_ddl[] = "INSERT OR REPLACE INTO "
-		" appl_%s(key, val) VALUES(?, ?);";
-	const char kv_get[] = "SELECT val FROM appl_%s WHERE key = ?;";
-	const char kv_drop[] = "DELETE FROM appl_%s WHERE val = \"\";";
-
-	if (dbh->akv_update)
-		arcan_mem_free(dbh->akv_update);
 
 	size_t len = applname ? strlen(applname) : 0;
 	if (0 == len){
@@ -295,27 +883,8 @@ static void create_appl_group(struct arcan_dbh* dbh, const char* applname)
 		return;
 	}
 
-/* cache key insert into app specific table */
-	assert(sizeof(kv_get) < sizeof(kv_ddl));
-	size_t ddl_sz = len + sizeof(kv_ddl);
-	dbh->akv_update = arcan_alloc_mem(
-		ddl_sz, ARCAN_MEM_STRINGBUF, 0, ARCAN_MEMALIGN_NATURAL);
-	dbh->akv_upd_sz = snprintf(dbh->akv_update, ddl_sz, kv_ddl, applname);
-
-/* cache drop empty values from table */
-	ddl_sz = len + sizeof(kv_drop);
-	dbh->akv_clean = arcan_alloc_mem(
-		ddl_sz, ARCAN_MEM_STRINGBUF, 0, ARCAN_MEMALIGN_NATURAL);
-	dbh->akv_clean_sz = snprintf(dbh->akv_clean, ddl_sz, kv_drop, applname);
-
-/* cache key retrieve into app specific table */
-	ddl_sz = strlen(applname) + sizeof(kv_get);
-	dbh->akv_get = arcan_alloc_mem(
-		ddl_sz, ARCAN_MEM_STRINGBUF, 0, ARCAN_MEMALIGN_NATURAL);
-	dbh->akv_get_sz = snprintf(dbh->akv_get, ddl_sz, kv_get, applname);
-
 /* create the actual table */
-	char wbuf[ sizeof(ddl) + strlen(applname) ];
+	char wbuf[ sizeof(ddl) + len ];
 	snprintf(wbuf, sizeof(wbuf)/sizeof(wbuf[0]), ddl, applname);
 
 	db_void_query(dbh, wbuf, true);
@@ -328,10 +897,10 @@ bool arcan_db_droptarget(struct arcan_dbh* dbh, arcan_targetid id)
 	static const char qry[]  = "DELETE FROM target WHERE tgtid = ?;";
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(qry)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, id);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	return true;
 }
@@ -341,10 +910,10 @@ bool arcan_db_dropconfig(struct arcan_dbh* dbh, arcan_configid id)
 	static const char qry[] = "DELETE FROM config WHERE cfgid = ?;";
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(qry)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, id);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	return true;
 }
@@ -358,7 +927,7 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 		"((select tgtid FROM target where name = ?), ?, ?, ?, ?)";
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, ddl);
 
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 	sqlite3_bind_text(stmt, 2, identifier, -1, SQLITE_STATIC);
@@ -367,16 +936,16 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 	sqlite3_bind_int(stmt, 5, bfmt);
 
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	arcan_targetid newid = sqlite3_last_insert_rowid(dbh->dbh);
 
 /* delete previous arguments */
 	static const char drop_argv[] = "DELETE FROM target_argv WHERE target = ?;";
-	sqlite3_prepare_v2(dbh->dbh, drop_argv, sizeof(drop_argv) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, drop_argv);
 	sqlite3_bind_int(stmt, 1, newid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 /* add new ones */
 	if (0 == sz)
@@ -384,11 +953,11 @@ arcan_targetid arcan_db_addtarget(struct arcan_dbh* dbh,
 
 	static const char add_argv[] = DI_INSARG_TARGET;
 	for (size_t i = 0; i < sz; i++){
-		sqlite3_prepare_v2(dbh->dbh, add_argv, sizeof(add_argv) - 1, &stmt, NULL);
+		stmt = db_stmt(dbh, add_argv);
 		sqlite3_bind_int(stmt, 1, newid);
 		sqlite3_bind_text(stmt, 2, argv[i], -1, SQLITE_STATIC);
 		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
 
 	return newid;
@@ -405,7 +974,7 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 		"(NULL, ?, ?, ?, ?)";
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, ddl);
 
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 	sqlite3_bind_int(stmt, 2, 0);
@@ -413,16 +982,16 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 	sqlite3_bind_int(stmt, 4, id);
 
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	arcan_configid newid = sqlite3_last_insert_rowid(dbh->dbh);
 
 /* delete previous arguments */
 	static const char drop_argv[] = "DELETE FROM config_argv WHERE config = ?;";
-	sqlite3_prepare_v2(dbh->dbh, drop_argv, sizeof(drop_argv) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, drop_argv);
 	sqlite3_bind_int(stmt, 1, newid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 /* add new ones */
 	if (0 == sz)
@@ -430,11 +999,11 @@ arcan_configid arcan_db_addconfig(struct arcan_dbh* dbh,
 
 	static const char add_argv[] = DI_INSARG_CONFIG;
 	for (size_t i = 0; i < sz; i++){
-		sqlite3_prepare_v2(dbh->dbh, add_argv, sizeof(add_argv) - 1, &stmt, NULL);
+		stmt = db_stmt(dbh, add_argv);
 		sqlite3_bind_int(stmt, 1, newid);
 		sqlite3_bind_text(stmt, 2, argv[i], -1, SQLITE_STATIC);
 		sqlite3_step(stmt);
-		sqlite3_finalize(stmt);
+		db_stmt_done(stmt);
 	}
 
 	return newid;
@@ -446,15 +1015,16 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid id)
 {
 	static const char ddl[] = "SELECT COUNT(*) FROM target WHERE tgtid = ?;";
 
-	sqlite3_stmt* stmt = NULL;
-	if (SQLITE_OK == sqlite3_prepare_v2(
-		dbh->dbh, ddl, sizeof(ddl)-1, &stmt, NULL)){
+	sqlite3_stmt* stmt = db_stmt(dbh, ddl);
+	bool rv = false;
+	if (stmt){
 		sqlite3_bind_int(stmt, 1, id);
-		sqlite3_step(stmt);
-		return 1 == sqlite3_column_int(stmt, 0);
+		if (SQLITE_ROW == sqlite3_step(stmt))
+			rv = 1 == sqlite3_column_int(stmt, 0);
+		db_stmt_done(stmt);
 	}
 
-	return false;
+	return rv;
 }
 
 arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
@@ -464,13 +1034,13 @@ arcan_targetid arcan_db_targetid(struct arcan_dbh* dbh,
 	static const char dql[] = "SELECT tgtid FROM target WHERE name = ?;";
 	sqlite3_stmt* stmt;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_text(stmt, 1, identifier, -1, SQLITE_STATIC);
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		rid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return rid;
 }
 
@@ -479,7 +1049,7 @@ struct arcan_strarr arcan_db_list_appl(struct arcan_dbh* dbh)
 	static const char dql[] = "SELECT name FROM sqlite_master WHERE "
 		"type='table' and NAME like \"appl_%\"";
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 
 	return db_string_query(dbh, stmt, NULL, 0);
 }
@@ -489,7 +1059,7 @@ struct arcan_strarr arcan_db_config_argv(struct arcan_dbh* dbh,arcan_configid id
 	static const char dql[] = "SELECT arg FROM config_argv WHERE "
 		"config = ? ORDER BY argnum ASC;";
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, id);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -500,7 +1070,7 @@ struct arcan_strarr arcan_db_target_argv(struct arcan_dbh* dbh,arcan_targetid id
 	static const char dql[] = "SELECT arg FROM target_argv WHERE "
 		"target = ? ORDER BY argnum ASC;";
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, id);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -510,14 +1080,14 @@ arcan_targetid arcan_db_cfgtarget(struct arcan_dbh* dbh, arcan_configid cfg)
 {
 	static const char dql[] = "SELECT target FROM config WHERE cfgid = ?;";
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, cfg);
 	arcan_targetid tid = BAD_TARGET;
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		tid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return tid;
 }
 
@@ -529,14 +1099,14 @@ arcan_configid arcan_db_configid(struct arcan_dbh* dbh,
 	sqlite3_stmt* stmt;
 	arcan_configid cid = BAD_CONFIG;
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_text(stmt, 1, config, strlen(config), SQLITE_STATIC);
 	sqlite3_bind_int(stmt, 2, target);
 
 	if (SQLITE_ROW == sqlite3_step(stmt))
 		cid = sqlite3_column_int64(stmt, 0);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return cid;
 }
 
@@ -544,7 +1114,7 @@ struct arcan_strarr arcan_db_target_tags(struct arcan_dbh* dbh)
 {
 	sqlite3_stmt* stmt;
 	static const char dql[] = "SELECT DISTINCT tag FROM target;";
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	return db_string_query(dbh, stmt, NULL, 0);
 }
 
@@ -553,11 +1123,11 @@ struct arcan_strarr arcan_db_targets(struct arcan_dbh* dbh, const char* tag)
 	sqlite3_stmt* stmt;
 	if (!tag){
 		static const char dql[] = "SELECT name FROM target;";
-		sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+		stmt = db_stmt(dbh, dql);
 	}
 	else {
 		static const char dql[] = "SELECT name FROM target WHERE tag=?;";
-		sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+		stmt = db_stmt(dbh, dql);
 		sqlite3_bind_text(stmt, 1, tag, strlen(tag), SQLITE_STATIC);
 	}
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -568,7 +1138,7 @@ char* arcan_db_targettag(struct arcan_dbh* dbh, arcan_targetid tid)
 	static const char dql[] = "SELECT tag FROM target WHERE tgtid = ?;";
 	char* resstr = NULL;
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 
 	sqlite3_bind_int(stmt, 1, tid);
 	if (sqlite3_step(stmt) == SQLITE_ROW){
@@ -578,7 +1148,7 @@ char* arcan_db_targettag(struct arcan_dbh* dbh, arcan_targetid tid)
 	if (resstr)
 		resstr = strdup(resstr);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return resstr;
 }
 
@@ -595,7 +1165,7 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 	static const char dql[] = "SELECT executable, bfmt "
 		"FROM target WHERE tgtid = ?;";
 
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql) - 1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	char* execstr = NULL;
@@ -607,12 +1177,11 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 	if (execstr)
 		execstr = strdup(execstr);
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 
 	static const char dql_tgt_argv[] = "SELECT arg FROM target_argv WHERE "
 		"target = ? ORDER BY argnum ASC;";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_argv,
-		sizeof(dql_tgt_argv)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_argv);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	*argv = db_string_query(dbh, stmt, NULL, 1);
@@ -620,29 +1189,25 @@ char* arcan_db_targetexec(struct arcan_dbh* dbh,
 
 	static const char dql_cfg_argv[] = "SELECT arg FROM config_argv WHERE "
 		"config = ? ORDER BY argnum ASC;";
-	sqlite3_prepare_v2(dbh->dbh, dql_cfg_argv,
-		sizeof(dql_cfg_argv)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_cfg_argv);
 	sqlite3_bind_int(stmt, 1, configid);
 	*argv = db_string_query(dbh, stmt, argv, 0);
 
 	static const char dql_tgt_env[] = "SELECT key || '=' || val "
 		"FROM target_env WHERE target = ?";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_env,
-		sizeof(dql_tgt_env)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_env);
 	sqlite3_bind_int(stmt, 1, tid);
 	*env = db_string_query(dbh, stmt, NULL, 0);
 
 	static const char dql_cfg_env[] = "SELECT key || '=' || val "
 		"FROM config_env WHERE config = ?";
-	sqlite3_prepare_v2(dbh->dbh, dql_cfg_env,
-		sizeof(dql_cfg_env)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_cfg_env);
 	sqlite3_bind_int(stmt, 1, tid);
 	db_string_query(dbh, stmt, env, 0);
 
 	static const char dql_tgt_lib[] = "SELECT libname FROM target_libs WHERE "
 		"target = ?;";
-	sqlite3_prepare_v2(dbh->dbh, dql_tgt_lib,
-		sizeof(dql_tgt_lib)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql_tgt_lib);
 	sqlite3_bind_int(stmt, 1, tid);
 	*libs = db_string_query(dbh, stmt, NULL, 0);
 
@@ -658,18 +1223,17 @@ void arcan_db_launch_status(struct arcan_dbh* dbh, arcan_configid cid, bool s)
 		"failed_counter = failed_counter + 1 WHERE config = ?;";
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh,
-		(s ? dql_ok : dql_fail), sizeof(dql_ok)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, (s ? dql_ok : dql_fail));
 	sqlite3_bind_int(stmt, 1, cid);
 	sqlite3_step(stmt);
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 }
 
 struct arcan_strarr arcan_db_configs(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT name FROM config WHERE target = ?;";
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -679,7 +1243,7 @@ char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 {
 	static const char dql[] = "SELECT executable FROM target WHERE tgtid = ?;";
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, dql, sizeof(dql)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, dql);
 	sqlite3_bind_int(stmt, 1, tid);
 
 	char* res = NULL;
@@ -688,61 +1252,41 @@ char* arcan_db_execname(struct arcan_dbh* dbh, arcan_targetid tid)
 		res = arg ? strdup((char*)arg) : NULL;
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
 void arcan_db_begin_transaction(struct arcan_dbh* dbh,
 	enum DB_KVTARGET kvt, union arcan_dbtrans_id id)
 {
-	if (dbh->transaction)
+	if (dbh->op)
 		arcan_fatal("arcan_db_begin_transaction()"
 			"	called during a pending transaction\n");
 
-	sqlite3_exec(dbh->dbh, "BEGIN;", NULL, NULL, NULL);
-	int code = SQLITE_OK;
+	dbh->op = malloc(sizeof(struct db_op));
+	if (!dbh->op)
+		arcan_fatal("arcan_db_begin_transaction(), out of memory\n");
+
+	*dbh->op = (struct db_op){
+		.kvt = kvt
+	};
 
 	switch (kvt){
 	case DVT_APPL:
-		code = sqlite3_prepare_v2(dbh->dbh, dbh->akv_update,
-			dbh->akv_upd_sz, &dbh->transaction, NULL);
+		dbh->op->appl = strdup(dbh->applname);
 	break;
-
 	case DVT_TARGET:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET,
-			strlen(DI_INSKV_TARGET)+1, &dbh->transaction, NULL);
+	case DVT_TARGET_ENV:
+	case DVT_TARGET_LIBV:
+		dbh->op->id = id.tid;
 	break;
-
 	case DVT_CONFIG:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG,
-			strlen(DI_INSKV_CONFIG)+1, &dbh->transaction, NULL);
-	break;
-
 	case DVT_CONFIG_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_CONFIG_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
-	break;
-
-	case DVT_TARGET_ENV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_ENV,
-			strlen(DI_INSKV_TARGET_ENV)+1, &dbh->transaction, NULL);
-	break;
-
-	case DVT_TARGET_LIBV:
-		code = sqlite3_prepare_v2(dbh->dbh, DI_INSKV_TARGET_LIBV,
-			strlen(DI_INSKV_TARGET_LIBV)+1, &dbh->transaction, NULL);
+		dbh->op->id = id.cid;
 	break;
 	case DVT_ENDM:
 	break;
 	}
-
-	if (code != SQLITE_OK){
-		arcan_warning("arcan_db_begin_transaction(), failed: %s\n",
-			sqlite3_errmsg(dbh->dbh));
-	}
-
-	dbh->trid = id;
-	dbh->ttype = kvt;
 }
 
 struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
@@ -761,7 +1305,7 @@ struct arcan_strarr arcan_db_getkeys(struct arcan_dbh* dbh,
 		qry = queries[1];
 
 	sqlite3_stmt * stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(GET_KV_TGT)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, qry);
 	sqlite3_bind_int(stmt, 1, tgt>=DVT_TARGET && tgt<DVT_CONFIG ? id.tid:id.cid);
 
 #undef GET_KV_TGT
@@ -778,7 +1322,7 @@ struct arcan_strarr arcan_db_applkeys(struct arcan_dbh* dbh,
 	ssize_t nw = snprintf(mk_buf, mk_sz, MATCH_APPL, applname);
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, mk_buf, mk_sz-1, &stmt, NULL);
+	stmt = db_stmt(dbh, mk_buf);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -803,7 +1347,7 @@ struct arcan_strarr arcan_db_matchkey(struct arcan_dbh* dbh,
 		qry = queries[1];
 
 	sqlite3_stmt* stmt;
-	sqlite3_prepare_v2(dbh->dbh, qry, sizeof(MATCH_KEY_TGT)-1, &stmt, NULL);
+	stmt = db_stmt(dbh, qry);
 	sqlite3_bind_text(stmt, 1, pattern, -1, SQLITE_TRANSIENT);
 
 	return db_string_query(dbh, stmt, NULL, 0);
@@ -832,16 +1376,12 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 	if (qry_sz == 0)
 		qry_sz = strlen(queries[1]);
 
-	sqlite3_stmt* stmt = NULL;
+	if (tgt == DVT_APPL)
+		return arcan_db_appl_val(dbh, dbh->applname, key);
 
-	if (tgt == DVT_APPL){
-		sqlite3_prepare_v2(dbh->dbh, dbh->akv_get, dbh->akv_get_sz, &stmt, NULL);
-	}
-	else {
-		sqlite3_prepare_v2(dbh->dbh, qry, qry_sz, &stmt, NULL);
-		sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
-		sqlite3_bind_int(stmt, 2, id);
-	}
+	sqlite3_stmt* stmt = db_stmt(dbh, qry);
+	sqlite3_bind_text(stmt, 1, key, -1, SQLITE_STATIC);
+	sqlite3_bind_int(stmt, 2, id);
 
 	if (SQLITE_ROW == sqlite3_step(stmt)){
 		const char* row = (const char*) sqlite3_column_text(stmt, 0);
@@ -849,125 +1389,75 @@ char* arcan_db_getvalue(struct arcan_dbh* dbh,
 			res = strdup(row);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
 	return res;
 }
 
 void arcan_db_add_kvpair(
 	struct arcan_dbh* dbh, const char* key, const char* val)
 {
-	if (!dbh->transaction)
+	if (!dbh->op)
 		arcan_fatal("arcan_db_add_kvpair() "
 			"called without any open transaction.");
 
 	if (!val){
-		dbh->trclean = true;
+		dbh->op->clean = true;
 		return;
 	}
 
 	if (val[0] == 0)
-		dbh->trclean = true;
-
-	sqlite3_bind_text(dbh->transaction, 1, key, -1, SQLITE_TRANSIENT);
-	sqlite3_bind_text(dbh->transaction, 2, val, -1, SQLITE_TRANSIENT);
-
-	switch (dbh->ttype){
-	case DVT_APPL:
-	case DVT_ENDM:
-	break;
-
-	case DVT_TARGET:
-	case DVT_TARGET_ENV:
-	case DVT_TARGET_LIBV:
-		sqlite3_bind_int(dbh->transaction, 3, dbh->trid.tid);
-	break;
+		dbh->op->clean = true;
 
-	case DVT_CONFIG:
-	case DVT_CONFIG_ENV:
-		sqlite3_bind_int(dbh->transaction, 3, dbh->trid.cid);
-	break;
+	if (!op_append(dbh->op, key, val)){
+		arcan_warning("arcan_db_addkvpair(%s=%s), out of memory\n", key, val);
+		return;
 	}
 
-	int rc = sqlite3_step(dbh->transaction);
-	if (SQLITE_DONE != rc)
-		arcan_warning("arcan_db_addkvpair(%s=%s), %d failed: %s\n",
-			key, val, rc, sqlite3_errmsg(dbh->dbh));
-	else {
-		sqlite3_clear_bindings(dbh->transaction);
-		sqlite3_reset(dbh->transaction);
-	}
+	if (dbh->op->kvt == DVT_APPL)
+		kv_set(dbh, dbh->op->appl, key, val);
 }
 
-void arcan_db_end_transaction(struct arcan_dbh* dbh)
+bool arcan_db_end_transaction(struct arcan_dbh* dbh)
 {
-	if (!dbh->transaction)
+	if (!dbh->op)
 		arcan_fatal("arcan_db_end_transaction() "
 			"called without any open transaction.");
 
-	sqlite3_finalize(dbh->transaction);
-
-	if (dbh->trclean){
-		switch (dbh->ttype){
-		case DVT_APPL:
-			sqlite3_exec(dbh->dbh, dbh->akv_clean, NULL, NULL, NULL);
-		break;
-		case DVT_TARGET:
-			sqlite3_exec(dbh->dbh, DI_DROPKV_TARGET, NULL, NULL, NULL);
-		break;
-		case DVT_CONFIG:
-			sqlite3_exec(dbh->dbh, DI_DROPKV_CONFIG, NULL, NULL, NULL);
-		break;
-		default:
-		break;
-		}
-		dbh->trclean = false;
-	}
+	if (dbh->op->clean && dbh->op->kvt == DVT_APPL)
+		kv_clean(dbh, dbh->op->appl);
 
-	if (SQLITE_OK != sqlite3_exec(dbh->dbh, "COMMIT;", NULL, NULL, NULL)){
-		arcan_warning("arcan_db_end_transaction(), failed: %s\n",
-			sqlite3_errmsg(dbh->dbh));
-	}
-
-	dbh->transaction = NULL;
+	struct db_op* op = dbh->op;
+	dbh->op = NULL;
+	return db_queue(dbh, op);
 }
 
 bool arcan_db_appl_kv(struct arcan_dbh* dbh,
 	const char* applname, const char* key, const char* value)
 {
-	bool rv = false;
+	if (!applname || !dbh || !key)
+		return false;
 
-	if (dbh->transaction)
+	if (dbh->op)
 		arcan_fatal("arcan_db_appl_kv() called during a pending transaction\n");
 
-	if (!applname || !dbh || !key)
-		return rv;
-
-	const char ddl_insert[] = "INSERT OR REPLACE "
-		"INTO appl_%s(key, val) VALUES(?, ?);";
-	const char k_drop[] = "DELETE FROM appl_%s WHERE key=?;";
+	struct db_op* op = malloc(sizeof(struct db_op));
+	if (!op)
+		return false;
 
-	size_t upd_sz = 0;
-	const char* dqry = ddl_insert;
+	*op = (struct db_op){
+		.kvt = DVT_APPL,
+		.appl = strdup(applname)
+	};
 
-	if (!value){
-		upd_sz = sizeof(k_drop) + strlen(applname);
-		dqry = k_drop;
+	if (!op->appl || !op_append(op, key, value)){
+		op_free(op);
+		return false;
 	}
-	else
-		upd_sz = sizeof(ddl_insert) + strlen(applname);
-
-	char upd_buf[ upd_sz ];
-	ssize_t nw = snprintf(upd_buf, upd_sz, dqry, applname);
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, upd_buf, nw, &stmt, NULL);
-	sqlite3_bind_text(stmt, 1, key,   -1, SQLITE_TRANSIENT);
-	sqlite3_bind_text(stmt, 2, value, -1, SQLITE_TRANSIENT);
-
-	rv = sqlite3_step(stmt) == SQLITE_DONE;
-	sqlite3_finalize(stmt);
-
-	return rv;
+/* drop a stale cache before the new value goes in */
+	writer_failed(dbh, &dbh->failed_cache);
+	kv_set(dbh, applname, key, value);
+	return db_queue(dbh, op);
 }
 
 char* arcan_db_appl_val(struct arcan_dbh* dbh,
@@ -976,6 +1466,13 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	if (!dbh || !key)
 		return NULL;
 
+/* the cache might be ahead of a batch the writer failed to commit */
+	writer_failed(dbh, &dbh->failed_cache);
+
+	struct db_kv* ent = kv_find(dbh, applname, key, db_hash(applname, key));
+	if (ent)
+		return ent->val ? strdup(ent->val) : NULL;
+
 	const char qry[] = "SELECT val FROM appl_%s WHERE key = ?;";
 
 	size_t wbuf_sz = strlen(applname) + sizeof(qry);
@@ -983,8 +1480,10 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 	memset(wbuf, '\0', wbuf_sz);
 	snprintf(wbuf, wbuf_sz, qry, applname);
 
-	sqlite3_stmt* stmt = NULL;
-	sqlite3_prepare_v2(dbh->dbh, wbuf, wbuf_sz, &stmt, NULL);
+	sqlite3_stmt* stmt = db_stmt(dbh, wbuf);
+	if (!stmt)
+		return NULL;
+
 	sqlite3_bind_text(stmt, 1, (char*) key, -1, SQLITE_TRANSIENT);
 
 	char* rv = NULL;
@@ -997,7 +1496,11 @@ char* arcan_db_appl_val(struct arcan_dbh* dbh,
 			rv = strdup((const char*) rowt);
 	}
 
-	sqlite3_finalize(stmt);
+	db_stmt_done(stmt);
+
+/* only cache the outcome of a lookup that actually reached the table */
+	if (rc == SQLITE_ROW || rc == SQLITE_DONE)
+		kv_set(dbh, applname, key, rv);
 
 	return rv;
 }
@@ -1047,14 +1550,25 @@ static bool dbh_integrity_check(struct arcan_dbh* dbh){
 
 void arcan_db_close(struct arcan_dbh** ctx)
 {
-	if (!ctx)
+	if (!ctx || !*ctx)
 		return;
 
-	sqlite3_close((*ctx)->dbh);
-	arcan_mem_free((*ctx)->applname);
-	arcan_mem_free((*ctx)->akv_update);
-	arcan_mem_free((*ctx)->akv_get);
-	arcan_mem_free(*ctx);
+/* stopping the writer flushes anything still queued */
+	struct arcan_dbh* dbh = *ctx;
+	if (dbh->op){
+		db_queue(dbh, dbh->op);
+		dbh->op = NULL;
+	}
+	db_writer_stop(dbh);
+
+	if (dbh == shared_handle)
+		shared_handle = NULL;
+
+	stmtcache_free(&dbh->stmts);
+	kv_flush(dbh);
+	sqlite3_close(dbh->dbh);
+	arcan_mem_free(dbh->applname);
+	arcan_mem_free(dbh);
 	*ctx = NULL;
 }
 
@@ -1099,6 +1613,7 @@ struct arcan_dbh* arcan_db_open(const char* fname, const char* applname)
 
 		db_void_query(res, "PRAGMA foreign_keys=ON;", false);
 		db_void_query(res, "PRAGMA synchronous=OFF;", false);
+		db_writer_start(res, fname);
 
 		return res;
 	}
@@ -43,6 +43,10 @@ static const int BAD_CONFIG = -1;
 /* Opens database and performs a sanity check,
  * Creates an entry for applname unless one already exists,
  * returns null IF fname can't be opened/read OR sanity check fails.
+ *
+ * A file backed database is switched to WAL journaling while it is open (see
+ * arcan_db_flush), there will be -wal and -shm files next to it. The previous
+ * journal mode is restored by arcan_db_close.
  */
 struct arcan_dbh* arcan_db_open(const char* fname, const char* applname);
 
@@ -61,6 +65,17 @@ void arcan_db_set_shared(struct arcan_dbh*);
  */
 void arcan_db_close(struct arcan_dbh**);
 
+/*
+ * Key/value writes (transactions and appl_kv) are committed in batches by
+ * a writer thread when the database is file backed. This blocks until all
+ * writes that have been queued so far are committed. Any other query on the
+ * handle implies this, as does arcan_db_close.
+ *
+ * Returns false if any queued write failed to commit since the last time a
+ * failure was returned from here, end_transaction or appl_kv.
+ */
+bool arcan_db_flush(struct arcan_dbh*);
+
 /*
  * Define this to add database features that should
  * only be present in a standalone application
@@ -174,7 +189,13 @@ void arcan_db_begin_transaction(struct arcan_dbh*, enum DB_KVTARGET,
  * in the transaction target.
  */
 void arcan_db_add_kvpair(struct arcan_dbh*, const char* key, const char* val);
-void arcan_db_end_transaction(struct arcan_dbh*);
+
+/*
+ * Commit or, with a writer thread, queue the transaction. Returns false if
+ * the commit failed or, when queued, if an earlier queued write failed (see
+ * arcan_db_flush).
+ */
+bool arcan_db_end_transaction(struct arcan_dbh*);
 
 /*
  * Retrieve a value from the specified keystore (id will be ignored
@@ -225,8 +246,10 @@ bool arcan_db_verifytarget(struct arcan_dbh* dbh, arcan_targetid);
 void arcan_db_dropappl(struct arcan_dbh* dbh, const char* appl);
 
 /*
- * Synchronously store/retrieve a key-value pair,
- * set to empty value to delete.
+ * Store a key-value pair, set to NULL value to delete. The value is visible
+ * to arcan_db_appl_val immediately while the write itself is queued (see
+ * arcan_db_flush). Returns false on failure, for a queued write that is the
+ * failure of an earlier one as with arcan_db_end_transaction.
  */
 bool arcan_db_appl_kv(struct arcan_dbh* dbh, const char* appl,
 	const char* key, const char* value);
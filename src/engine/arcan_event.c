@@ -72,17 +72,6 @@ static struct arcan_evctx default_evctx = {
  * cleanly based on a certain keybinding */
 static int panic_keysym = -1, panic_keymod = -1;
 
-/* fixed size 64 entries bitmap for dynamic event source tracking */
-struct evsrc_meta {
-	intptr_t tag;
-	mode_t mode;
-	bool mask;
-};
-
-static struct pollfd evsrc_pollset[64];
-static struct evsrc_meta evsrc_meta[64];
-static uint64_t evsrc_bitmap;
-
 arcan_evctx* arcan_event_defaultctx(){
 	return &default_evctx;
 }
@@ -265,6 +254,47 @@ static inline int queue_used(arcan_evctx* dq)
 	return rv;
 }
 
+/*
+ * Copy up to [lim] events out of [ctx] in at most two runs and publish the
+ * new front index once. For an external queue both indices come from shared
+ * memory and the slots taken are poisoned like in arcan_event_poll.
+ */
+static size_t queue_fetch(arcan_evctx* ctx, struct arcan_event* dst, size_t lim)
+{
+	size_t sz = ctx->local ? ctx->eventbuf_sz : PP_QUEUE_SZ;
+	unsigned front = *(ctx->front);
+	unsigned back = *(ctx->back);
+
+	if (!ctx->local){
+		FORCE_SYNCH();
+		if (front >= sz || back >= sz){
+			pull_killswitch(ctx);
+			return 0;
+		}
+	}
+
+	size_t n = (back + sz - front) % sz;
+	if (n > lim)
+		n = lim;
+	if (!n)
+		return 0;
+
+	size_t run = sz - front < n ? sz - front : n;
+	memcpy(dst, &ctx->eventbuf[front], run * sizeof(struct arcan_event));
+	if (n > run)
+		memcpy(&dst[run], ctx->eventbuf, (n - run) * sizeof(struct arcan_event));
+
+	if (!ctx->local){
+		memset(&ctx->eventbuf[front], 0xff, run * sizeof(struct arcan_event));
+		if (n > run)
+			memset(ctx->eventbuf, 0xff, (n - run) * sizeof(struct arcan_event));
+		FORCE_SYNCH();
+	}
+
+	*(ctx->front) = (front + n) % sz;
+	return n;
+}
+
 static bool append_bufferstream(struct arcan_frameserver* tgt, arcan_extevent* ev)
 {
 /* this assumes a certain ordering around fetching the handle and it being
@@ -341,10 +371,28 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 
 	size_t cap = floor((float)dstqueue->eventbuf_sz * sat);
 
-	while (!queue_empty(srcqueue) && queue_used(dstqueue) < cap){
-		arcan_event inev;
-		if (arcan_event_poll(srcqueue, &inev) == 0)
-			break;
+/* the source is fetched in batches that fit the destination budget, the
+ * filter and translation below still has to run on every event, but the
+ * shared queue is only touched (copy, poison, publish) once per batch. The
+ * budget is only checked between batches, a fetched batch has left the client
+ * queue and is delivered in full even if a drain callback filled the queue */
+	arcan_event batch[32];
+	size_t batch_ofs = 0, batch_n = 0;
+
+	for (;;){
+		if (batch_ofs == batch_n){
+			size_t used = queue_used(dstqueue);
+			if (used >= cap)
+				break;
+
+			size_t lim = cap - used;
+			batch_ofs = 0;
+			batch_n = queue_fetch(srcqueue, batch,
+				lim < COUNT_OF(batch) ? lim : COUNT_OF(batch));
+			if (!batch_n)
+				break;
+		}
+		arcan_event inev = batch[batch_ofs++];
 
 /* Ioevents have special behavior as the routed path (via frameserver callback
  * or global event handler) can be decided here: if raw transfers have been
@@ -467,11 +515,7 @@ int arcan_event_queuetransfer(arcan_evctx* dstqueue, arcan_evctx* srcqueue,
 		}
 		wake = true;
 
-/* it might be slightly faster to drain multiple events here, but since the
- * source might be mapped to an untrusted in-memory queue it would still take a
- * full filter+copy path - so likely not worth pursuing.
- *
- * There is a complex and subtle danger here:
+/* There is a complex and subtle danger here:
  *  0.Recall we are being called from the TRAMP_GUARD
  *    (against sigbus on the shared page).
  *
@@ -721,102 +765,6 @@ bool arcan_event_feed(struct arcan_evctx* ctx,
 		return true;
 }
 
-static int mode_to_poll(mode_t mode)
-{
-	if (mode == O_RDWR)
-		mode = POLLIN | POLLOUT;
-	else if (mode == O_WRONLY)
-		mode = POLLOUT;
-	else if (mode == O_RDONLY)
-		mode = POLLIN;
-	return mode | POLLERR | POLLHUP;
-}
-
-bool arcan_event_add_source(
-	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t otag, bool masked)
-{
-	int mask = 0;
-	mode = mode_to_poll(mode);
-
-/* allocate new */
-	uint64_t i = __builtin_ffsll(~evsrc_bitmap);
-	if (!i)
-		return false;
-
-	i--;
-	evsrc_pollset[i].fd = fd;
-	evsrc_pollset[i].events = mode;
-	evsrc_meta[i].mode = mode;
-	evsrc_meta[i].tag = otag;
-	evsrc_meta[i].mask = masked;
-	evsrc_bitmap |= (uint64_t)1 << i;
-
-	return true;
-}
-
-void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout)
-{
-	ssize_t nelem = poll(evsrc_pollset, 64, timeout);
-	if (nelem <= 0){
-		if (timeout > 0)
-			arcan_timesleep(timeout);
-		return;
-	}
-
-	for (size_t i = 0; i < 64; i++){
-		struct pollfd* ent = &evsrc_pollset[i];
-		if (ent->fd <= 0 || !ent->revents || evsrc_meta[i].mask)
-			continue;
-
-		struct arcan_event ev = (struct arcan_event){
-			.category = EVENT_SYSTEM,
-			.sys.data.fd = evsrc_pollset[i].fd,
-			.sys.data.otag = evsrc_meta[i].tag
-		};
-
-/* Note that we send IN/OUT even in the case of failure. This is to force the
- * recipient to use normal error handling for read/write to react to a
- * monitored source failing. */
-		if (ent->revents & POLLIN ||
-			((ent->revents & (POLLERR | POLLHUP)) && (ent->events & POLLIN))){
-				ev.sys.kind = EVENT_SYSTEM_DATA_IN;
-				arcan_event_denqueue(ctx, &ev);
-			}
-
-/* This is subtle - the events here go direct to drain. That means that
- * infinitely many calls to add_source and del_source can happen between these
- * two, possibly changing the otag being used to map to VM objects. Removing
- * the source is save though, as the pollset is cleared when the source is
- * removed, and this condition won't fire an extraneous event. */
-		if (ent->revents & POLLOUT ||
-			((ent->revents & (POLLERR | POLLHUP)) && (ent->events & POLLOUT))){
-			ev.sys.kind = EVENT_SYSTEM_DATA_OUT;
-			arcan_event_denqueue(ctx, &ev);
-		}
-	}
-}
-
-/* Remove a source previously added through add_source. Will return true if
- * the source existed and set the last known otag in *out if provided. */
-bool arcan_event_del_source(
-	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t* out)
-{
-	mode = mode_to_poll(mode);
-	for (uint64_t i = 0; i < 64; i++){
-		if (evsrc_pollset[i].fd == fd && evsrc_pollset[i].events == mode){
-			evsrc_pollset[i].fd = -1;
-			evsrc_bitmap &= ~((uint64_t)1 << i);
-			if (out)
-				*out = evsrc_meta[i].tag;
-			evsrc_meta[i] = (struct evsrc_meta){0};
-			evsrc_pollset[i] = (struct pollfd){0};
-			return true;
-		}
-	}
-
-	return false;
-}
-
 void arcan_event_setdrain(arcan_evctx* ctx, arcan_event_handler drain)
 {
 	if (!ctx->local)
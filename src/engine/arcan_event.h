@@ -67,10 +67,11 @@ bool arcan_event_add_source(
 bool arcan_event_del_source(
 	struct arcan_evctx*, int fd, mode_t mode, intptr_t* out);
 
-/* Work through the list of registered sources and queue events for the ones
- * that are readable/writable as EVENT_SYSTEM_DATA_IN/OUT. This is intended to
- * be run as part of the conductor scheduler. The internal queueing is
- * direct-to-drain. */
+/* Wait up to [timeout] for any of the registered sources to become readable/
+ * writable and queue events for the ones that are as EVENT_SYSTEM_DATA_IN/OUT.
+ * This is intended to be run as part of the conductor scheduler. The internal
+ * queueing is direct-to-drain. There is no fixed limit on the number of sources
+ * and the cost scales with the number of ready ones (see arcan_evsrc.c). */
 void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout);
 
 /*
@@ -0,0 +1,381 @@
+/*
+ * Copyright: Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Tracking for the dynamic event sources (arcan_event_add_source)
+ * that the conductor polls for readability/writability as part of scheduling.
+ *
+ * Sources are kept in a table indexed by descriptor, with one registration
+ * for each of the read, write and read/write modes. On linux the interest set
+ * lives in an epoll instance so that a poll only costs in proportion to the
+ * number of ready descriptors, elsewhere a packed pollfd set is rebuilt as
+ * sources come and go. Neither has a fixed cap on the number of sources.
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <poll.h>
+#include <errno.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_shmif.h"
+#include "arcan_event.h"
+
+/* read, write and read/write, indexed by (IN | OUT << 1) - 1 */
+#define EVSRC_MODES 3
+
+struct evsrc_reg {
+	intptr_t tag;
+	short events;
+	bool used;
+	bool mask;
+};
+
+struct evsrc_fd {
+	struct evsrc_reg reg[EVSRC_MODES];
+
+/* the events currently in the interest set, 0 if the descriptor is not in it */
+	short events;
+
+#ifdef __linux__
+/* epoll refuses regular files, poll reports those as always ready so we keep
+ * them aside and do the same */
+	bool always;
+#else
+	size_t pollind;
+#endif
+};
+
+static struct evsrc_fd* evsrc;
+static size_t evsrc_sz;
+
+#ifdef __linux__
+static int evsrc_epoll = -1;
+static int* evsrc_always;
+static size_t evsrc_always_n;
+static size_t evsrc_always_sz;
+#else
+static struct pollfd* evsrc_pollset;
+static size_t evsrc_pollset_n;
+static size_t evsrc_pollset_sz;
+#endif
+
+static int mode_to_poll(mode_t mode)
+{
+	if (mode == O_RDWR)
+		mode = POLLIN | POLLOUT;
+	else if (mode == O_WRONLY)
+		mode = POLLOUT;
+	else if (mode == O_RDONLY)
+		mode = POLLIN;
+	return mode | POLLERR | POLLHUP;
+}
+
+static int mode_slot(int events)
+{
+	return ((events & POLLIN ? 1 : 0) | (events & POLLOUT ? 2 : 0)) - 1;
+}
+
+static bool grow(void** buf, size_t* buf_sz, size_t need, size_t unit)
+{
+	if (need <= *buf_sz)
+		return true;
+
+	size_t new_sz = *buf_sz ? *buf_sz : 64;
+	while (new_sz < need)
+		new_sz <<= 1;
+
+	uint8_t* res = realloc(*buf, new_sz * unit);
+	if (!res)
+		return false;
+
+	memset(&res[*buf_sz * unit], '\0', (new_sz - *buf_sz) * unit);
+	*buf = res;
+	*buf_sz = new_sz;
+	return true;
+}
+
+static short interest(struct evsrc_fd* src)
+{
+	short events = 0;
+	for (size_t i = 0; i < EVSRC_MODES; i++)
+		if (src->reg[i].used && !src->reg[i].mask)
+			events |= src->reg[i].events & (POLLIN | POLLOUT);
+	return events;
+}
+
+#ifdef __linux__
+static void always_remove(int fd)
+{
+	for (size_t i = 0; i < evsrc_always_n; i++)
+		if (evsrc_always[i] == fd){
+			evsrc_always[i] = evsrc_always[--evsrc_always_n];
+			return;
+		}
+}
+
+static bool update_interest(int fd)
+{
+	struct evsrc_fd* src = &evsrc[fd];
+	short events = interest(src);
+
+	if (events == src->events)
+		return true;
+
+	if (src->always){
+		if (!events){
+			always_remove(fd);
+			src->always = false;
+		}
+		src->events = events;
+		return true;
+	}
+
+	struct epoll_event ev = {
+		.events = (events & POLLIN ? EPOLLIN : 0) | (events & POLLOUT ? EPOLLOUT : 0),
+		.data.fd = fd
+	};
+
+/* ENOENT means it is already gone, EBADF that it was closed before being
+ * removed, the source is forgotten either way but the latter is a caller bug */
+	if (!events){
+		src->events = 0;
+		if (-1 == epoll_ctl(evsrc_epoll, EPOLL_CTL_DEL, fd, NULL) && errno != ENOENT){
+			arcan_warning("event_del_source(%d): %s\n", fd, strerror(errno));
+			return false;
+		}
+		return true;
+	}
+
+/* the descriptor might have been closed and the number reused without the
+ * source being removed first, which drops it from epoll behind our back */
+	int rv;
+	if (src->events){
+		rv = epoll_ctl(evsrc_epoll, EPOLL_CTL_MOD, fd, &ev);
+		if (-1 == rv && errno == ENOENT)
+			rv = epoll_ctl(evsrc_epoll, EPOLL_CTL_ADD, fd, &ev);
+	}
+	else {
+		rv = epoll_ctl(evsrc_epoll, EPOLL_CTL_ADD, fd, &ev);
+		if (-1 == rv && errno == EEXIST)
+			rv = epoll_ctl(evsrc_epoll, EPOLL_CTL_MOD, fd, &ev);
+	}
+
+	if (-1 == rv && errno == EPERM){
+		if (!grow((void**)&evsrc_always,
+			&evsrc_always_sz, evsrc_always_n + 1, sizeof(int)))
+			return false;
+		evsrc_always[evsrc_always_n++] = fd;
+		src->always = true;
+		rv = 0;
+	}
+
+	if (-1 == rv)
+		return false;
+
+	src->events = events;
+	return true;
+}
+#else
+static bool update_interest(int fd)
+{
+	struct evsrc_fd* src = &evsrc[fd];
+	short events = interest(src);
+
+	if (events == src->events)
+		return true;
+
+/* swap the last entry into the hole so the set stays packed */
+	if (!events){
+		struct pollfd last = evsrc_pollset[--evsrc_pollset_n];
+		evsrc_pollset[src->pollind] = last;
+		evsrc[last.fd].pollind = src->pollind;
+		src->events = 0;
+		return true;
+	}
+
+	if (!src->events){
+		if (!grow((void**)&evsrc_pollset, &evsrc_pollset_sz,
+			evsrc_pollset_n + 1, sizeof(struct pollfd)))
+			return false;
+		src->pollind = evsrc_pollset_n++;
+	}
+
+	evsrc_pollset[src->pollind] = (struct pollfd){
+		.fd = fd,
+		.events = events
+	};
+	src->events = events;
+	return true;
+}
+#endif
+
+bool arcan_event_add_source(
+	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t otag, bool masked)
+{
+	int events = mode_to_poll(mode);
+	int slot = mode_slot(events);
+	if (fd < 0 || slot < 0)
+		return false;
+
+#ifdef __linux__
+	if (-1 == evsrc_epoll){
+		evsrc_epoll = epoll_create1(EPOLL_CLOEXEC);
+		if (-1 == evsrc_epoll)
+			return false;
+	}
+#endif
+
+	if (!grow((void**)&evsrc, &evsrc_sz, (size_t)fd + 1, sizeof(struct evsrc_fd)))
+		return false;
+
+	struct evsrc_reg old = evsrc[fd].reg[slot];
+	evsrc[fd].reg[slot] = (struct evsrc_reg){
+		.tag = otag,
+		.events = events,
+		.used = true,
+		.mask = masked
+	};
+
+	if (!update_interest(fd)){
+		evsrc[fd].reg[slot] = old;
+		return false;
+	}
+
+	return true;
+}
+
+bool arcan_event_del_source(
+	struct arcan_evctx* ctx, int fd, mode_t mode, intptr_t* out)
+{
+	int slot = mode_slot(mode_to_poll(mode));
+	if (fd < 0 || (size_t)fd >= evsrc_sz || slot < 0 || !evsrc[fd].reg[slot].used)
+		return false;
+
+	if (out)
+		*out = evsrc[fd].reg[slot].tag;
+
+	evsrc[fd].reg[slot] = (struct evsrc_reg){0};
+	update_interest(fd);
+	return true;
+}
+
+/* Note that we send IN/OUT even in the case of failure. This is to force the
+ * recipient to use normal error handling for read/write to react to a
+ * monitored source failing. */
+static void dispatch(struct arcan_evctx* ctx, int fd, short revents)
+{
+	for (size_t i = 0; i < EVSRC_MODES; i++){
+
+/* This is subtle - the events here go direct to drain. That means that
+ * infinitely many calls to add_source and del_source can happen between these
+ * two, possibly changing the otag being used to map to VM objects or growing
+ * the table. Always go through the table again rather than keep a reference,
+ * a removed registration won't fire an extraneous event. */
+		if ((size_t)fd >= evsrc_sz)
+			return;
+
+		struct evsrc_reg reg = evsrc[fd].reg[i];
+		if (!reg.used || reg.mask)
+			continue;
+
+/* the descriptor might be in the set for other modes as well */
+		short rev = revents & (reg.events | POLLERR | POLLHUP);
+
+		struct arcan_event ev = (struct arcan_event){
+			.category = EVENT_SYSTEM,
+			.sys.data.fd = fd,
+			.sys.data.otag = reg.tag
+		};
+
+		if (rev & POLLIN ||
+			((rev & (POLLERR | POLLHUP)) && (reg.events & POLLIN))){
+			ev.sys.kind = EVENT_SYSTEM_DATA_IN;
+			arcan_event_denqueue(ctx, &ev);
+		}
+
+		if ((size_t)fd >= evsrc_sz || !evsrc[fd].reg[i].used)
+			continue;
+
+		if (rev & POLLOUT ||
+			((rev & (POLLERR | POLLHUP)) && (reg.events & POLLOUT))){
+			ev.sys.kind = EVENT_SYSTEM_DATA_OUT;
+			ev.sys.data.otag = evsrc[fd].reg[i].tag;
+			arcan_event_denqueue(ctx, &ev);
+		}
+	}
+}
+
+#ifdef __linux__
+void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout)
+{
+	struct epoll_event evs[256];
+	ssize_t nelem = 0;
+
+/* the always-ready set is served first, poll would have returned at once */
+	size_t n_always = evsrc_always_n;
+	if (n_always)
+		timeout = 0;
+
+	if (-1 != evsrc_epoll)
+		nelem = epoll_wait(evsrc_epoll, evs, sizeof(evs) / sizeof(evs[0]), timeout);
+
+	if (nelem <= 0 && !n_always){
+		if (timeout > 0)
+			arcan_timesleep(timeout);
+		return;
+	}
+
+/* the set can change as we go, so index into it rather than walk a copy */
+	for (size_t i = 0; i < n_always && i < evsrc_always_n; i++){
+		int fd = evsrc_always[i];
+		dispatch(ctx, fd, evsrc[fd].events);
+	}
+
+	for (ssize_t i = 0; i < nelem; i++){
+		short revents =
+			(evs[i].events & EPOLLIN ? POLLIN : 0) |
+			(evs[i].events & EPOLLOUT ? POLLOUT : 0) |
+			(evs[i].events & EPOLLERR ? POLLERR : 0) |
+			(evs[i].events & EPOLLHUP ? POLLHUP : 0);
+		dispatch(ctx, evs[i].data.fd, revents);
+	}
+}
+#else
+void arcan_event_poll_sources(struct arcan_evctx* ctx, int timeout)
+{
+	ssize_t nelem = poll(evsrc_pollset, evsrc_pollset_n, timeout);
+	if (nelem <= 0){
+		if (timeout > 0)
+			arcan_timesleep(timeout);
+		return;
+	}
+
+/* dispatch can reshuffle the set, collect the ready ones first */
+	struct {
+		int fd;
+		short revents;
+	} ready[nelem];
+	size_t n_ready = 0;
+
+	for (size_t i = 0; i < evsrc_pollset_n && n_ready < nelem; i++){
+		if (evsrc_pollset[i].revents){
+			ready[n_ready].fd = evsrc_pollset[i].fd;
+			ready[n_ready++].revents = evsrc_pollset[i].revents;
+		}
+	}
+
+	for (size_t i = 0; i < n_ready; i++)
+		dispatch(ctx, ready[i].fd, ready[i].revents);
+}
+#endif
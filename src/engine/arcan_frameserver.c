@@ -255,6 +255,70 @@ void arcan_frameserver_close_bufferqueues(
 	}
 }
 
+/*
+ * Uncompressed planar 4:2:0 is announced through the venc substructure with
+ * the I420 or NV12 fourcc, the frame is then uploaded without conversion and
+ * unpacked by the matching builtin shader. There is no compressed passthrough
+ * here, so any other fourcc is -1 (rejected).
+ */
+static int planar_format(arcan_frameserver* src)
+{
+	struct arcan_shmif_venc* venc = src->desc.aext.venc;
+	if (!venc)
+		return 0;
+
+	uint8_t fourcc[4];
+	memcpy(fourcc, venc->fourcc, 4);
+
+	if (!fourcc[0])
+		return 0;
+	else if (memcmp(fourcc, "I420", 4) == 0)
+		return PLANAR_I420_2D;
+	else if (memcmp(fourcc, "NV12", 4) == 0)
+		return PLANAR_NV12_2D;
+
+	return -1;
+}
+
+static void planar_setup(arcan_frameserver* src,
+	struct agp_vstore* store, int format)
+{
+	if (!format){
+		if (src->desc.planar.format){
+			store->filtermode = src->desc.planar.filtermode;
+			agp_update_vstore(store, false);
+			arcan_video_setprogram(src->vid, agp_default_shader(BASIC_2D));
+		}
+		src->desc.planar.format = 0;
+		src->desc.planar.fail = false;
+		return;
+	}
+
+	if (!src->desc.planar.format)
+		src->desc.planar.filtermode = store->filtermode;
+
+	src->desc.planar.format = format;
+	src->desc.planar.fail = format == -1 ||
+		!src->desc.width || (src->desc.width % 8) ||
+		!src->desc.height || (src->desc.height % 4) ||
+		ARCAN_OK != arcan_video_setprogram(src->vid, agp_default_shader(format));
+
+/* same reaction as the other venc formats on something we can't use */
+	if (src->desc.planar.fail){
+		arcan_event_enqueue(&src->outqueue, &(struct arcan_event){
+			.category = EVENT_TARGET,
+			.tgt.kind = TARGET_COMMAND_BUFFER_FAIL
+		});
+		TRACE_MARK_ONESHOT("frameserver", "buffer-planar", TRACE_SYS_WARN,
+			src->vid, src->desc.width * src->desc.height, "unsupported venc format");
+		return;
+	}
+
+/* the object keeps the source dimensions, only the store is packed */
+	store->filtermode = ARCAN_VFILTER_NONE;
+	agp_resize_vstore(store, src->desc.width / 4, src->desc.height * 3 / 2);
+}
+
 /*
  * -1 : fail
  *  0 : ok, no-emit
@@ -280,6 +344,8 @@ static int push_buffer(arcan_frameserver* src,
 	if (src->shm.ptr->hints & SHMIF_RHINT_EMPTY)
 		goto commit_mask;
 
+	int planar = planar_format(src);
+
 /* If the HDR subprotocol is enabled, verify and translate into store metadata
  * - explicitly map the metadata format. There is only the one to chose from
  *   right now, but it wouldn't be surprising if that changes. */
@@ -301,10 +367,19 @@ static int push_buffer(arcan_frameserver* src,
 		};
 	}
 
+/* a planar source has its store packed, see planar_setup */
+	size_t store_w = src->desc.width;
+	size_t store_h = src->desc.height;
+	if (src->desc.planar.format && !src->desc.planar.fail){
+		store_w = store_w / 4;
+		store_h = store_h * 3 / 2;
+	}
+
 /* Need to do this check here as-well as in the regular frameserver tick
  * control because the backing store might have changed somehwere else. */
-	if (src->desc.width != store->w || src->desc.height != store->h ||
-		src->desc.hints != src->desc.pending_hints || src->desc.rz_flag){
+	if (store_w != store->w || store_h != store->h ||
+		src->desc.hints != src->desc.pending_hints || src->desc.rz_flag ||
+		planar != src->desc.planar.format){
 		src->desc.hints = src->desc.pending_hints;
 
 		TRACE_MARK_ONESHOT("frameserver", "buffer-resize", TRACE_SYS_DEFAULT,
@@ -327,6 +402,9 @@ static int push_buffer(arcan_frameserver* src,
  * tui calls to read the logical values inside _lua.c and for simple text
  * surfaces */
 		if (src->desc.hints & SHMIF_RHINT_TPACK){
+/* the raster here unpacks either format */
+			atomic_store(&src->shm.ptr->server_caps, SHMIF_SRVCAP_TPACK_V2);
+
 			if (!store->vinf.text.tpack.tui){
 				store->vinf.text.tpack.tui =
 					arcan_tui_setup(NULL, NULL,
@@ -359,13 +437,15 @@ static int push_buffer(arcan_frameserver* src,
 		else
 			arcan_event_enqueue(arcan_event_defaultctx(), &rezev);
 
-		store->vinf.text.d_fmt = (src->desc.hints & SHMIF_RHINT_IGNORE_ALPHA) ||
-			src->flags.no_alpha_copy ? GL_NOALPHA_PIXEL_FORMAT : GL_STORE_PIXEL_FORMAT;
+		store->vinf.text.d_fmt = !planar && (
+			(src->desc.hints & SHMIF_RHINT_IGNORE_ALPHA) || src->flags.no_alpha_copy) ?
+			GL_NOALPHA_PIXEL_FORMAT : GL_STORE_PIXEL_FORMAT;
 
 /* this might not take if the store is locked - i.e. GPU resources will not
  * match local copies, the main context where that matters is if the vobj is
  * mapped to an output display and thus has a fixed buffer resolution */
 		arcan_video_resizefeed(src->vid, src->desc.width, src->desc.height);
+		planar_setup(src, store, planar);
 
 		src->desc.rz_flag = false;
 		explicit = true;
@@ -515,6 +595,14 @@ static int push_buffer(arcan_frameserver* src,
 	stream.buf = buf;
 /* validate, fallback to fullsynch if we get bad values */
 
+	if (planar){
+		if (src->desc.planar.fail){
+			rv = 0;
+			goto commit_mask;
+		}
+		dirty = NULL;
+	}
+
 	if (dirty){
 		stream.x1 = dirty->x1; stream.w = dirty->x2 - dirty->x1;
 		stream.y1 = dirty->y1; stream.h = dirty->y2 - dirty->y1;
@@ -748,6 +836,101 @@ enum arcan_ffunc_rv arcan_frameserver_emptyframe FFUNC_HEAD
 	return FRV_NOFRAME;
 }
 
+static size_t timing_bucket(uint64_t v)
+{
+	if (v < FSRV_TIMING_SUB)
+		return v;
+
+	size_t e = 63 - __builtin_clzll(v);
+	size_t ind = (e - 2) * FSRV_TIMING_SUB + ((v >> (e - 3)) & (FSRV_TIMING_SUB - 1));
+	return ind < FSRV_TIMING_BUCKETS ? ind : FSRV_TIMING_BUCKETS - 1;
+}
+
+uint64_t arcan_frameserver_timing_bucketval(size_t ind)
+{
+	if (ind < FSRV_TIMING_SUB)
+		return ind;
+
+	size_t e = ind / FSRV_TIMING_SUB + 2;
+	return (uint64_t)(FSRV_TIMING_SUB + ind % FSRV_TIMING_SUB) << (e - 3);
+}
+
+static void timing_add(struct arcan_frameserver* tgt,
+	enum fsrv_timing_stage stage, uint64_t v)
+{
+	struct fsrv_histogram* hist = &tgt->timing.hist[stage];
+	if (!hist->count || v < hist->min)
+		hist->min = v;
+	if (v > hist->max)
+		hist->max = v;
+	hist->count++;
+	hist->sum += v;
+	hist->buckets[timing_bucket(v)]++;
+}
+
+uint64_t arcan_frameserver_timing_percentile(
+	struct fsrv_histogram* hist, float pct)
+{
+	if (!hist->count)
+		return 0;
+
+	uint64_t lim = (uint64_t)(pct * (float)hist->count);
+	if (lim >= hist->count)
+		lim = hist->count - 1;
+
+	uint64_t acc = 0;
+	for (size_t i = 0; i < FSRV_TIMING_BUCKETS; i++){
+		acc += hist->buckets[i];
+		if (acc > lim){
+			uint64_t val = arcan_frameserver_timing_bucketval(i);
+			return val < hist->min ? hist->min : (val > hist->max ? hist->max : val);
+		}
+	}
+
+	return hist->max;
+}
+
+void arcan_frameserver_timing_reset(struct arcan_frameserver* tgt)
+{
+	memset(tgt->timing.hist, '\0', sizeof(tgt->timing.hist));
+	tgt->timing.superseded = 0;
+	tgt->timing.deadline_hit = tgt->timing.deadline_miss = 0;
+	tgt->timing.readback_drop = 0;
+}
+
+void arcan_frameserver_timing_readback(
+	struct arcan_frameserver* tgt, uint64_t requested)
+{
+	if (!requested){
+		tgt->timing.readback_drop++;
+		return;
+	}
+
+	uint64_t now = arcan_timemicros();
+	timing_add(tgt, FSRV_TIMING_READBACK, now > requested ? now - requested : 0);
+}
+
+void arcan_frameserver_timing_present(
+	struct arcan_frameserver* tgt, uint64_t composed, uint64_t scanout)
+{
+	if (!tgt->timing.inflight)
+		return;
+
+/* the refresh that happened before the upload doesn't count, the frame is
+ * still waiting for one to include it and the next synch will get it */
+	if (composed < tgt->timing.inflight_ack)
+		return;
+
+	uint64_t ready = tgt->timing.inflight;
+	timing_add(tgt, FSRV_TIMING_COMPOSE, composed - ready);
+	timing_add(tgt, FSRV_TIMING_SCANOUT,
+		scanout > ready ? scanout - ready : 0);
+
+	TRACE_MARK_ONESHOT("frameserver", "latency-scanout",
+		TRACE_SYS_DEFAULT, tgt->vid, scanout > ready ? scanout - ready : 0, "");
+	tgt->timing.inflight = 0;
+}
+
 void arcan_frameserver_lock_buffers(int state)
 {
 	g_buffers_locked = state;
@@ -835,6 +1018,15 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
  * initiated or not */
 		rv = (tgt->shm.ptr->vready &&
 			!tgt->flags.release_pending) ? FRV_GOTFRAME : FRV_NOFRAME;
+
+/* first sighting of a ready frame starts its timing record, there is no
+ * reliable client side submit time to go from (vpts is in the client domain) */
+		if (rv == FRV_GOTFRAME && !tgt->timing.ready){
+			uint64_t now = arcan_timemicros();
+			if (tgt->timing.last_ready)
+				timing_add(tgt, FSRV_TIMING_INTERVAL, now - tgt->timing.last_ready);
+			tgt->timing.ready = tgt->timing.last_ready = now;
+		}
 	break;
 
 	case FFUNC_TICK:
@@ -884,12 +1076,27 @@ enum arcan_ffunc_rv arcan_frameserver_vdirect FFUNC_HEAD
 		if (g_buffers_locked == 1 || tgt->flags.locked)
 			goto no_out;
 
+		uint64_t upload = arcan_timemicros();
 		int buffer_status = push_buffer(tgt,
 			dst_store, shmpage->hints & SHMIF_RHINT_SUBREGION ? &dirty : NULL);
 
 		if (-1 == buffer_status)
 			goto no_out;
 
+/* a frame that gets replaced before it has been synched counts as superseded
+ * and is not part of the compose/scanout statistics */
+		uint64_t ack = arcan_timemicros();
+		uint64_t ready = tgt->timing.ready ? tgt->timing.ready : ack;
+		timing_add(tgt, FSRV_TIMING_ACK, ack - ready);
+		TRACE_MARK_ONESHOT("frameserver", "latency-ack",
+			TRACE_SYS_DEFAULT, tgt->vid, ack - ready, "");
+		if (tgt->timing.inflight)
+			tgt->timing.superseded++;
+		tgt->timing.inflight = ready;
+		tgt->timing.inflight_ack = ack;
+		tgt->timing.upload = ack - upload;
+		tgt->timing.ready = 0;
+
 /* TIMING/PRESENT:
  *     for tighter latency management, here is where the estimated next synch
  *     deadline for any output it is used on could/should be set, though it
@@ -1193,74 +1400,185 @@ no_out:
 	return rv;
 }
 
-/* assumptions:
- * buf_sz doesn't contain partial samples (% (bytes per sample * channels))
- * dst->amixer inaud is allocated and allocation count matches n_aids */
-static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
-	int16_t* buf, int nsamples)
+/* frames that have to be buffered by every source before mixing, and the
+ * chunk size the mixer works in (bounded stack scratch) */
+#define AMIXER_THRESHOLD 256
+#define AMIXER_BLOCK 512
+
+/* convert interleaved L/R SINT16 to planar float with gain into the source
+ * ring, samples that do not fit are dropped */
+static void amixer_push(struct frameserver_audsrc* cur,
+	const int16_t* buf, size_t nframes, unsigned rate)
 {
-/* formats; nsamples (samples in, 2 samples / frame)
- * cur->inbuf; samples converted to float with gain, 2 samples / frame)
- * dst->outbuf; SINT16, in bytes, ofset in bytes */
-	size_t minv = INT_MAX;
+	const size_t mask = AMIXER_RING_SZ - 1;
+	size_t space = AMIXER_RING_SZ - (cur->wr - cur->rd);
+	float lg = cur->l_gain * (1.0f / 32767.0f);
+	float rg = cur->r_gain * (1.0f / 32767.0f);
+
+	if (!rate || rate == ARCAN_SHMIF_SAMPLERATE){
+		if (nframes > space)
+			nframes = space;
+
+/* split on the ring wrap so both spans are straight loops */
+		size_t pos = cur->wr & mask;
+		size_t first = nframes < AMIXER_RING_SZ - pos ? nframes : AMIXER_RING_SZ - pos;
+		float* restrict l = &cur->inbuf[0][pos];
+		float* restrict r = &cur->inbuf[1][pos];
+		for (size_t i = 0; i < first; i++){
+			l[i] = buf[i * 2 + 0] * lg;
+			r[i] = buf[i * 2 + 1] * rg;
+		}
 
-/* 1. Convert to float and buffer. Find the lowest common number of samples
- * buffered. Truncate if needed. Assume source feeds L/R */
-	for (int i = 0; i < dst->amixer.n_aids; i++){
-		struct frameserver_audsrc* cur = dst->amixer.inaud + i;
+		l = cur->inbuf[0];
+		r = cur->inbuf[1];
+		buf += first * 2;
+		for (size_t i = 0; i < nframes - first; i++){
+			l[i] = buf[i * 2 + 0] * lg;
+			r[i] = buf[i * 2 + 1] * rg;
+		}
 
-		if (cur->src_aid == srcid){
-			int ulim = sizeof(cur->inbuf) / sizeof(float);
-			int count = 0;
+		cur->wr += nframes;
+		return;
+	}
 
-			while (nsamples-- && cur->inofs < ulim){
-				float val = *buf++;
-				cur->inbuf[cur->inofs++] =
-					(count++ % 2 ? cur->l_gain : cur->r_gain) * (val / 32767.0f);
-			}
-		}
+	if (!nframes)
+		return;
 
-		if (cur->inofs < minv)
-			minv = cur->inofs;
+	if (cur->rate != rate){
+		cur->rate = rate;
+		cur->phase = 0;
+		cur->last[0] = cur->last[1] = 0;
 	}
 
-/*
- * 2. If number of samples exceeds some threshold, mix (minv)
- * samples together and store in dst->outb Formulae used:
- * A = float(sampleA) * gainA.
- * B = float(sampleB) * gainB. Z = A + B - A * B
- */
-		if (minv != INT_MAX && minv > 512 && dst->sz_audb - dst->ofs_audb > 0){
-/* clamp */
-			if (dst->ofs_audb + minv * sizeof(uint16_t) > dst->sz_audb)
-				minv = (dst->sz_audb - dst->ofs_audb) / sizeof(uint16_t);
+/* position p interpolates between input frame p-1 and p, with -1 being the
+ * last frame of the previous feed */
+	double step = (double) rate / (double) ARCAN_SHMIF_SAMPLERATE;
+	double p = cur->phase;
+
+	while (space && p < nframes){
+		size_t ip = p;
+		float f = p - ip;
+		float l0 = ip ? buf[(ip - 1) * 2 + 0] : cur->last[0];
+		float r0 = ip ? buf[(ip - 1) * 2 + 1] : cur->last[1];
+		float l1 = buf[ip * 2 + 0];
+		float r1 = buf[ip * 2 + 1];
+
+		size_t pos = cur->wr & mask;
+		cur->inbuf[0][pos] = (l0 + (l1 - l0) * f) * lg;
+		cur->inbuf[1][pos] = (r0 + (r1 - r0) * f) * rg;
+		cur->wr++;
+		space--;
+		p += step;
+	}
 
-			for (int sc = 0; sc < minv; sc++){
-				float work_sample = 0;
+	cur->phase = p >= nframes ? p - nframes : 0;
+	cur->last[0] = buf[(nframes - 1) * 2 + 0];
+	cur->last[1] = buf[(nframes - 1) * 2 + 1];
+}
 
-			for (int i = 0; i < dst->amixer.n_aids; i++){
-				work_sample += dst->amixer.inaud[i].inbuf[sc] - (work_sample *
-					dst->amixer.inaud[i].inbuf[sc]);
+static void mix_span(float* restrict acc,
+	const float* restrict in, size_t n, enum amixer_law law)
+{
+	if (law == AMIXER_LAW_AB){
+		for (size_t i = 0; i < n; i++)
+			acc[i] = acc[i] + in[i] - acc[i] * in[i];
+	}
+	else {
+		for (size_t i = 0; i < n; i++)
+			acc[i] += in[i];
+	}
+}
+
+/* mix [nframes] from every source and append as interleaved SINT16 to the
+ * output buffer, caller guarantees that each source has that many buffered
+ * and that the output buffer has room */
+static void amixer_mix(arcan_frameserver* dst, size_t nframes)
+{
+	const size_t mask = AMIXER_RING_SZ - 1;
+	float acc[2][AMIXER_BLOCK];
+	int16_t out[AMIXER_BLOCK * 2];
+
+	while (nframes){
+		size_t n = nframes < AMIXER_BLOCK ? nframes : AMIXER_BLOCK;
+		memset(acc, '\0', sizeof(acc));
+
+		for (size_t i = 0; i < dst->amixer.n_aids; i++){
+			struct frameserver_audsrc* cur = &dst->amixer.inaud[i];
+			size_t pos = cur->rd & mask;
+			size_t first = n < AMIXER_RING_SZ - pos ? n : AMIXER_RING_SZ - pos;
+
+			for (size_t ch = 0; ch < 2; ch++){
+				mix_span(acc[ch], &cur->inbuf[ch][pos], first, dst->amixer.law);
+				mix_span(&acc[ch][first], cur->inbuf[ch], n - first, dst->amixer.law);
 			}
-/* clip output */
-			int16_t sample_conv = work_sample >= 1.0 ? 32767.0 :
-				(work_sample < -1.0 ? -32768 : work_sample * 32767);
-			memcpy(&dst->audb[dst->ofs_audb], &sample_conv, sizeof(int16_t));
-			dst->ofs_audb += sizeof(int16_t);
+			cur->rd += n;
 		}
-/* 2b. Reset intermediate buffers, slide if needed. */
-		for (int j = 0; j < dst->amixer.n_aids; j++){
-			struct frameserver_audsrc* cur = dst->amixer.inaud + j;
-			if (cur->inofs > minv){
-				memmove(cur->inbuf, &cur->inbuf[minv], (cur->inofs - minv) *
-					sizeof(float));
-				cur->inofs -= minv;
-			}
+
+/* block limiter: instant attack to the gain that keeps the peak in range,
+ * slow release back towards unity */
+		float gain = 1.0f;
+		if (dst->amixer.law == AMIXER_LAW_SUM){
+			float peak = 0;
+			for (size_t ch = 0; ch < 2; ch++)
+				for (size_t i = 0; i < n; i++){
+					float v = fabsf(acc[ch][i]);
+					peak = v > peak ? v : peak;
+				}
+
+			float target = peak > 1.0f ? 1.0f / peak : 1.0f;
+			if (target < dst->amixer.limiter)
+				dst->amixer.limiter = target;
 			else
-				cur->inofs = 0;
+				dst->amixer.limiter += (target - dst->amixer.limiter) * 0.1f;
+			gain = dst->amixer.limiter;
 		}
+
+/* clip output */
+		for (size_t ch = 0; ch < 2; ch++)
+			for (size_t i = 0; i < n; i++){
+				float v = acc[ch][i] * gain;
+				v = v > 1.0f ? 1.0f : (v < -1.0f ? -1.0f : v);
+				out[i * 2 + ch] = v * 32767.0f;
+			}
+
+		memcpy(&dst->audb[dst->ofs_audb], out, n * 2 * sizeof(int16_t));
+		dst->ofs_audb += n * 2 * sizeof(int16_t);
+		nframes -= n;
 	}
+}
 
+/* assumptions:
+ * buf_sz doesn't contain partial samples (% (bytes per sample * channels))
+ * dst->amixer inaud is allocated and allocation count matches n_aids */
+static void feed_amixer(arcan_frameserver* dst, arcan_aobj_id srcid,
+	int16_t* buf, size_t nframes, unsigned rate)
+{
+/* 1. Convert and buffer, then find the lowest common number of frames
+ * buffered across all sources. */
+	size_t minv = SIZE_MAX;
+
+	for (size_t i = 0; i < dst->amixer.n_aids; i++){
+		struct frameserver_audsrc* cur = dst->amixer.inaud + i;
+
+		if (cur->src_aid == srcid)
+			amixer_push(cur, buf, nframes, rate);
+
+		size_t avail = cur->wr - cur->rd;
+		if (avail < minv)
+			minv = avail;
+	}
+
+/* 2. If the number of frames exceeds some threshold, mix as many as the
+ * output buffer has room for, the rest stays in the rings. */
+	if (minv == SIZE_MAX || minv <= AMIXER_THRESHOLD ||
+		dst->sz_audb <= dst->ofs_audb)
+		return;
+
+	size_t room = (dst->sz_audb - dst->ofs_audb) / (2 * sizeof(int16_t));
+	if (minv > room)
+		minv = room;
+
+	amixer_mix(dst, minv);
 }
 
 void arcan_frameserver_update_mixweight(arcan_frameserver* dst,
@@ -1289,10 +1607,22 @@ void arcan_frameserver_avfeed_mixer(arcan_frameserver* dst, int n_sources,
 	for (int i = 0; i < n_sources; i++){
 		dst->amixer.inaud[i].l_gain  = 1.0;
 		dst->amixer.inaud[i].r_gain  = 1.0;
-		dst->amixer.inaud[i].inofs   = 0;
 		dst->amixer.inaud[i].src_aid = *sources++;
 	}
 
+/* the legacy A+B-AB law is kept as an option, it attenuates overlapping
+ * sources but distorts when they are loud */
+	uintptr_t tag;
+	char* law = NULL;
+	cfg_lookup_fun get_config = platform_config_lookup(&tag);
+	dst->amixer.law = AMIXER_LAW_SUM;
+	if (get_config("audio_mix_law", 0, &law, tag) && law){
+		if (strcmp(law, "ab") == 0)
+			dst->amixer.law = AMIXER_LAW_AB;
+		free(law);
+	}
+
+	dst->amixer.limiter = 1.0;
 	dst->amixer.n_aids = n_sources;
 }
 
@@ -1303,18 +1633,19 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
 	assert((intptr_t)(buf) % 4 == 0);
 
 /*
- * FIXME: This is a victim of a recent shmif refactor where we started to
- * allow negotating different samplerates. This should be complemented with
- * the speex- resampler that's in the codebase already
+ * a source at a non-native samplerate without a mixer goes through one so that
+ * it gets resampled like the rest, the mixer covers every hooked source as the
+ * ones missing from it would be dropped
  */
-	if (frequency != ARCAN_SHMIF_SAMPLERATE){
-		static bool warn;
-		if (!warn){
-			arcan_warning("arcan_frameserver_avfeedmon(), monitoring an audio feed\n"
-				"with a non-native samplerate, this is >currently< supported for\n"
-				"playback but not for recording (TOFIX).\n");
-			warn = true;
-		}
+	if (frequency != ARCAN_SHMIF_SAMPLERATE && !dst->amixer.n_aids){
+		int n = 0;
+		while (dst->alocks && dst->alocks[n])
+			n++;
+
+		if (n)
+			arcan_frameserver_avfeed_mixer(dst, n, dst->alocks);
+		else
+			arcan_frameserver_avfeed_mixer(dst, 1, &src);
 	}
 
 /*
@@ -1324,7 +1655,7 @@ void arcan_frameserver_avfeedmon(arcan_aobj_id src, uint8_t* buf,
  * sources
  */
 	if (dst->amixer.n_aids > 0){
-		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 1);
+		feed_amixer(dst, src, (int16_t*) buf, buf_sz >> 2, frequency);
 	}
 	else if (dst->ofs_audb + buf_sz < dst->sz_audb){
 			memcpy(dst->audb + dst->ofs_audb, buf, buf_sz);
@@ -88,6 +88,14 @@ struct arcan_frameserver_meta {
 		uint8_t gamma_map;
 	} aext;
 
+/* planar YUV (venc fourcc I420/NV12) currently mapped to the store, with the
+ * filter mode it had before as the packed store has to be sampled nearest */
+	struct {
+		int format;
+		bool fail;
+		int filtermode;
+	} planar;
+
 /* statistics for tracking performance / timing */
 	bool callback_framestate;
 	unsigned long long framecount;
@@ -105,12 +113,57 @@ struct arcan_frameserver_meta {
 	 unsigned recovery_tick;
 };
 
+/* recording mixer, each source is kept as planar float L/R with gain applied
+ * in a ring (power of two, free running rd/wr indices masked on access) */
+#define AMIXER_RING_SZ 4096
+
+enum amixer_law {
+/* plain sum followed by a block peak limiter */
+	AMIXER_LAW_SUM = 0,
+/* legacy A + B - AB */
+	AMIXER_LAW_AB = 1
+};
+
 struct frameserver_audsrc {
-	float inbuf[4096];
-	off_t inofs;
+	float inbuf[2][AMIXER_RING_SZ];
+	size_t rd, wr;
 	arcan_aobj_id src_aid;
 	float l_gain;
 	float r_gain;
+
+/* linear interpolation state for sources not at ARCAN_SHMIF_SAMPLERATE,
+ * phase is in input frames relative to the last sample of the previous feed */
+	unsigned rate;
+	double phase;
+	float last[2];
+};
+
+/* Per-client frame timing. Each stage is measured in microseconds from the
+ * point the frame was first seen as ready (vready) and accumulated into a
+ * log-linear histogram, 8 sub-buckets per power of two keeps a sample within
+ * 12.5% of its bucket and the range covers a few minutes. */
+#define FSRV_TIMING_SUB 8
+#define FSRV_TIMING_BUCKETS (27 * FSRV_TIMING_SUB)
+
+enum fsrv_timing_stage {
+/* contents uploaded and buffer released back to the client */
+	FSRV_TIMING_ACK = 0,
+/* composited as part of a video refresh */
+	FSRV_TIMING_COMPOSE,
+/* the platform synch that follows has completed */
+	FSRV_TIMING_SCANOUT,
+/* between consecutive frames being ready, i.e. pacing */
+	FSRV_TIMING_INTERVAL,
+/* output segments: readback requested until the contents were handed over */
+	FSRV_TIMING_READBACK,
+	FSRV_TIMING_ENDM
+};
+
+struct fsrv_histogram {
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min, max;
+	uint32_t buckets[FSRV_TIMING_BUCKETS];
 };
 
 struct arcan_frameserver {
@@ -206,6 +259,19 @@ struct arcan_frameserver {
 		bool vblank;
 	} clock;
 
+/* ready is stamped on the first poll that sees a frame, inflight is the
+ * ready/ack pair of the last uploaded frame until it has been presented,
+ * upload is the time spent in the transfer of that frame. The deadline
+ * counters are maintained by conductor strategies that predict delivery. */
+	struct {
+		uint64_t ready, last_ready;
+		uint64_t inflight, inflight_ack, upload;
+		uint64_t superseded;
+		uint64_t deadline_hit, deadline_miss;
+		uint64_t readback_drop;
+		struct fsrv_histogram hist[FSRV_TIMING_ENDM];
+	} timing;
+
 /* for monitoring hooks, 0 entry terminates. */
 	arcan_aobj_id* alocks;
 	arcan_aobj_id aid;
@@ -218,7 +284,8 @@ struct arcan_frameserver {
 /* for recording output where we need to mix multiple audio sources */
 	struct {
 		unsigned n_aids;
-		size_t max_bufsz;
+		enum amixer_law law;
+		float limiter;
 		struct frameserver_audsrc* inaud;
 	} amixer;
 
@@ -528,6 +595,37 @@ void arcan_frameserver_lock_buffers(int state);
  */
 int arcan_frameserver_releaselock(struct arcan_frameserver* tgt);
 
+/*
+ * Finish the timing record of the last uploaded frame, [composed] is when the
+ * last video refresh completed and [scanout] when the platform synch that
+ * followed returned (both arcan_timemicros). Used by the conductor after each
+ * display synch.
+ */
+void arcan_frameserver_timing_present(
+	struct arcan_frameserver* tgt, uint64_t composed, uint64_t scanout);
+
+/*
+ * Record the completion of a readback into an output segment that was
+ * requested at [requested] (arcan_timemicros), or with [requested] set to 0,
+ * a readback that was dropped as no readback buffer was available.
+ */
+void arcan_frameserver_timing_readback(
+	struct arcan_frameserver* tgt, uint64_t requested);
+
+/*
+ * Lower bound (us) of the histogram bucket that holds the [pct] (0..1)
+ * percentile of the samples in [hist], 0 if there are no samples.
+ */
+uint64_t arcan_frameserver_timing_percentile(
+	struct fsrv_histogram* hist, float pct);
+
+/*
+ * Convert between bucket index and the lower bound (us) of its range.
+ */
+uint64_t arcan_frameserver_timing_bucketval(size_t ind);
+
+void arcan_frameserver_timing_reset(struct arcan_frameserver* tgt);
+
 /*
  * helper functions that tie together the platform/.../frameserver.c
  * with allocation, member matching, presets etc.
@@ -58,7 +58,11 @@
 struct shm_handle {
 	struct arcan_shmif_page* ptr;
 	int handle;
+
+/* descriptor-passed segments carry their semaphores in a separate page
+ * (synch) rather than as named ones, handle is kept until it has been sent */
 	void* synch;
+	int synch_handle;
 	char* key;
 	size_t shmsize;
 };
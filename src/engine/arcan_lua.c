@@ -854,7 +854,7 @@ static int rawresource(lua_State* ctx)
 
 		close(luactx.rawres.fd);
 		luactx.rawres.fd = -1;
-		luactx.rawres.ofs = 0;
+		luactx.rawres.head = luactx.rawres.ofs = 0;
 		luactx.rawres.eofm = false;
 	}
 
@@ -1026,7 +1026,7 @@ static int rawclose(lua_State* ctx)
 	if (luactx.rawres.fd > 0){
 		close(luactx.rawres.fd);
 		luactx.rawres.fd = -1;
-		luactx.rawres.ofs = 0;
+		luactx.rawres.head = luactx.rawres.ofs = 0;
 		luactx.rawres.eofm = false;
 	}
 
@@ -3189,7 +3189,9 @@ static int launchdecode(lua_State* ctx)
 	struct arcan_frameserver* mvctx;
 	struct frameserver_envp args = {
 		.use_builtin = true,
-		.args.builtin.mode = "decode"
+		.args.builtin.mode = "decode",
+/* permits the planar YUV transfer mode (yuv= argument) */
+		.metamask = SHMIF_META_VENC
 	};
 
 	if (!fsrv_ok){
@@ -6196,8 +6198,7 @@ static int storekey(lua_State* ctx)
 			lua_pop(ctx, 1);
 		}
 
-		arcan_db_end_transaction(DBHANDLE);
-		lua_pushboolean(ctx, true);
+		lua_pushboolean(ctx, arcan_db_end_transaction(DBHANDLE));
 		LUA_ETRACE("store_key", NULL, 1);
 	}
 
@@ -6212,9 +6213,7 @@ static int storekey(lua_State* ctx)
 
 	arcan_db_begin_transaction(DBHANDLE, kvtgt, tid);
 	arcan_db_add_kvpair(DBHANDLE, keystr, valstr);
-	arcan_db_end_transaction(DBHANDLE);
-
-	lua_pushboolean(ctx, true);
+	lua_pushboolean(ctx, arcan_db_end_transaction(DBHANDLE));
 	LUA_ETRACE("store_key", NULL, 1);
 }
 
@@ -7323,6 +7322,7 @@ void arcan_lua_shutdown(lua_State* ctx)
 		close(luactx.rawres.fd);
 		luactx.rawres.fd = -1;
 	}
+	free(luactx.rawres.buf);
 
 /* only some properties are reset in order for certain state to carry over
  * between system_collapse calls and crash/script error recovery code */
@@ -8793,11 +8793,9 @@ static int targetstepframe(lua_State* ctx)
 		fsrv->desc.region_valid = true;
 	}
 
-/* cascade / repeat call protection, only request read if we aren't in that
- * state already - this is for the asynch behavior */
-	if (!FL_TEST(rtgt, TGTFL_READING)){
-		agp_request_readback(rtgt->color->vstore);
-		FL_SET(rtgt, TGTFL_READING);
+/* cascade / repeat call protection, only request read if there is a free
+ * readback buffer - this is for the asynch behavior */
+	if (arcan_vint_requestreadback(rtgt)){
 		rtgt->transfc++;
 		lua_pushboolean(ctx, true);
 	}
@@ -11069,9 +11067,60 @@ static int getapplarguments(lua_State* ctx)
 	LUA_ETRACE("appl_arguments", NULL, 1);
 }
 
+static void push_fsrvtiming(lua_State* ctx,
+	const char* key, struct fsrv_histogram* hist, int top)
+{
+	lua_pushstring(ctx, key);
+	lua_newtable(ctx);
+	int tbl = lua_gettop(ctx);
+	tblnum(ctx, "count", hist->count, tbl);
+	tblnum(ctx, "min", hist->min, tbl);
+	tblnum(ctx, "max", hist->max, tbl);
+	tblnum(ctx, "mean", hist->count ?
+		(double)hist->sum / (double)hist->count : 0, tbl);
+	tblnum(ctx, "p50", arcan_frameserver_timing_percentile(hist, 0.5), tbl);
+	tblnum(ctx, "p90", arcan_frameserver_timing_percentile(hist, 0.9), tbl);
+	tblnum(ctx, "p99", arcan_frameserver_timing_percentile(hist, 0.99), tbl);
+	tblnum(ctx, "p999", arcan_frameserver_timing_percentile(hist, 0.999), tbl);
+	lua_rawset(ctx, top);
+}
+
+static int getfsrvbench(lua_State* ctx)
+{
+	LUA_TRACE("benchmark_data");
+	arcan_vobject* vobj;
+	luaL_checkvid(ctx, 1, &vobj);
+
+	if (vobj->feed.state.tag != ARCAN_TAG_FRAMESERV)
+		arcan_fatal("benchmark_data(), specified vid (arg 1) not "
+			"associated with a frameserver.");
+
+	arcan_frameserver* fsrv = vobj->feed.state.ptr;
+	lua_newtable(ctx);
+	int top = lua_gettop(ctx);
+
+	push_fsrvtiming(ctx, "ack", &fsrv->timing.hist[FSRV_TIMING_ACK], top);
+	push_fsrvtiming(ctx, "compose", &fsrv->timing.hist[FSRV_TIMING_COMPOSE], top);
+	push_fsrvtiming(ctx, "scanout", &fsrv->timing.hist[FSRV_TIMING_SCANOUT], top);
+	push_fsrvtiming(ctx, "interval", &fsrv->timing.hist[FSRV_TIMING_INTERVAL], top);
+	push_fsrvtiming(ctx, "readback", &fsrv->timing.hist[FSRV_TIMING_READBACK], top);
+	tblnum(ctx, "superseded", fsrv->timing.superseded, top);
+	tblnum(ctx, "deadline_hit", fsrv->timing.deadline_hit, top);
+	tblnum(ctx, "deadline_miss", fsrv->timing.deadline_miss, top);
+	tblnum(ctx, "readback_drop", fsrv->timing.readback_drop, top);
+
+	if (luaL_optbnumber(ctx, 2, false))
+		arcan_frameserver_timing_reset(fsrv);
+
+	LUA_ETRACE("benchmark_data", NULL, 1);
+}
+
 static int getbenchvals(lua_State* ctx)
 {
 	LUA_TRACE("benchmark_data");
+	if (lua_type(ctx, 1) == LUA_TNUMBER)
+		return getfsrvbench(ctx);
+
 	size_t bench_sz = COUNT_OF(benchdata.ticktime);
 
 	lua_pushnumber(ctx, benchdata.tickcount);
@@ -11115,7 +11164,23 @@ static int getbenchvals(lua_State* ctx)
 		i = (i + 1) % bench_sz;
 	}
 
-	LUA_ETRACE("benchmark_data", NULL, 6);
+	struct conductor_synchstats synch;
+	arcan_conductor_synchstats(&synch);
+	lua_newtable(ctx);
+	top = lua_gettop(ctx);
+	tblnum(ctx, "frames", synch.frames, top);
+	tblnum(ctx, "missed", synch.missed, top);
+	tblnum(ctx, "client_hit", synch.client_hit, top);
+	tblnum(ctx, "client_miss", synch.client_miss, top);
+	tblnum(ctx, "margin", synch.margin, top);
+	tblnum(ctx, "compose", synch.compose, top);
+
+	struct agp_shader_stats ustats;
+	agp_shader_stats(&ustats, false);
+	tblnum(ctx, "uniforms", ustats.issued, top);
+	tblnum(ctx, "uniforms_skipped", ustats.skipped, top);
+
+	LUA_ETRACE("benchmark_data", NULL, 7);
 }
 
 static int timestamp(lua_State* ctx)
@@ -1622,6 +1622,15 @@ arcan_errc arcan_video_init(uint16_t width, uint16_t height, uint8_t bpp,
 		if (get_config("video_ignore_dirty", 0, NULL, tag)){
 			arcan_video_display.ignore_dirty = SIZE_MAX >> 1;
 		}
+
+/* more buffers let the readback of one frame overlap the rendering of the
+ * next few at the cost of latency and memory per readback target */
+		char* rbbuf = NULL;
+		arcan_video_display.readback_buffers = 3;
+		if (get_config("video_readback_buffers", 0, &rbbuf, tag) && rbbuf){
+			arcan_video_display.readback_buffers = strtoul(rbbuf, NULL, 10);
+			free(rbbuf);
+		}
 	}
 
 	if (!platform_video_init(width, height, bpp, fs, frames, caption)){
@@ -4396,10 +4405,30 @@ static inline bool process_counter(
 	return false;
 }
 
+static void readback_timing(struct rendertarget* tgt, uint64_t requested)
+{
+	arcan_vobject* vobj = tgt->color;
+	if (vobj->feed.state.tag == ARCAN_TAG_FRAMESERV && vobj->feed.state.ptr)
+		arcan_frameserver_timing_readback(vobj->feed.state.ptr, requested);
+}
+
+bool arcan_vint_requestreadback(struct rendertarget* tgt)
+{
+	struct agp_vstore* vstore = tgt->color->vstore;
+	agp_readback_buffers(vstore, arcan_video_display.readback_buffers);
+
+	if (!agp_request_readback(vstore)){
+		readback_timing(tgt, 0);
+		return false;
+	}
+
+	FL_SET(tgt, TGTFL_READING);
+	return true;
+}
+
 static inline void process_readback(struct rendertarget* tgt, float fract)
 {
-	if (!FL_TEST(tgt, TGTFL_READING) &&
-		process_counter(tgt, &tgt->readcnt, tgt->readback, fract)){
+	if (process_counter(tgt, &tgt->readcnt, tgt->readback, fract)){
 
 /* for handle passing we can go immediately, even though the asynch job
  * might not be done, that's up to the fences tied to the export */
@@ -4420,11 +4449,10 @@ static inline void process_readback(struct rendertarget* tgt, float fract)
 			}
 		}
 
-/* check again as the ffunc might av unset the hwreadback flag */
-		if (!tgt->hwreadback){
-			agp_request_readback(tgt->color->vstore);
-			FL_SET(tgt, TGTFL_READING);
-		}
+/* check again as the ffunc might av unset the hwreadback flag, with all the
+ * readback buffers pending the frame is dropped */
+		if (!tgt->hwreadback)
+			arcan_vint_requestreadback(tgt);
 	}
 }
 
@@ -5550,10 +5578,10 @@ arcan_errc arcan_video_screenshot(av_pixel** dptr, size_t* dsize)
 	return ARCAN_OK;
 }
 
-/* Check outstanding readbacks, map and feed onwards, ideally we should synch
- * this with a fence - but the platform GL etc. versioning restricts things for
- * the time being. Threaded- dispatch from the conductor is the right way
- * forward */
+/* Check outstanding readbacks, map and feed onwards. The platform keeps a
+ * ring of fenced buffers per store and only hands out the oldest one when its
+ * transfer has completed, so this never stalls on the GPU. Threaded- dispatch
+ * from the conductor is still the right way forward */
 void arcan_vint_pollreadback(struct rendertarget* tgt)
 {
 	if (!FL_TEST(tgt, TGTFL_READING))
@@ -5561,38 +5589,45 @@ void arcan_vint_pollreadback(struct rendertarget* tgt)
 
 	arcan_vobject* vobj = tgt->color;
 
+	for(;;){
 /* don't check the readback unless the client is ready, should possibly have a
  * timeout for this as well so we don't hold GL resources with an unwilling /
  * broken client, it's a hard tradeoff as streaming video encode might deal
  * well with the dropped frame at this stage, while a variable rate interactive
  * source may lose data */
-	arcan_vfunc_cb ffunc = NULL;
-	if (vobj->feed.ffunc){
-		ffunc = arcan_ffunc_lookup(vobj->feed.ffunc);
-		if (FRV_GOTFRAME == ffunc(
-			FFUNC_POLL, NULL, 0, 0, 0, 0, vobj->feed.state, vobj->cellid))
-			return;
-	}
+		if (vobj->feed.ffunc){
+			arcan_vfunc_cb ffunc = arcan_ffunc_lookup(vobj->feed.ffunc);
+			if (FRV_GOTFRAME == ffunc(
+				FFUNC_POLL, NULL, 0, 0, 0, 0, vobj->feed.state, vobj->cellid))
+				return;
+		}
 
 /* now we can check the readback, it is not safe to call poll, get results
  * and then call poll again, we have to release once retrieved */
-	struct asynch_readback_meta rbb = agp_poll_readback(vobj->vstore);
+		struct asynch_readback_meta rbb = agp_poll_readback(vobj->vstore);
 
-	if (rbb.ptr == NULL)
-		return;
+		if (rbb.ptr == NULL)
+			break;
 
 /* the ffunc might've disappeared, so disable the readback state */
-	if (!vobj->feed.ffunc)
-		tgt->readback = 0;
-	else{
+		if (!vobj->feed.ffunc){
+			tgt->readback = 0;
+			rbb.release(rbb.tag);
+			agp_readback_drop(vobj->vstore, false);
+			break;
+		}
+
 		arcan_ffunc_lookup(vobj->feed.ffunc)(
 			FFUNC_READBACK, rbb.ptr, rbb.w * rbb.h * sizeof(av_pixel),
 			rbb.w, rbb.h, 0, vobj->feed.state, vobj->cellid
 		);
+
+		rbb.release(rbb.tag);
+		readback_timing(tgt, rbb.requested);
 	}
 
-	rbb.release(rbb.tag);
-	FL_CLEAR(tgt, TGTFL_READING);
+	if (!agp_readback_pending(vobj->vstore))
+		FL_CLEAR(tgt, TGTFL_READING);
 }
 
 static size_t steptgt(float fract, struct rendertarget* tgt)
@@ -5629,6 +5664,7 @@ static size_t steptgt(float fract, struct rendertarget* tgt)
 unsigned arcan_vint_refresh(float fract, size_t* ndirty)
 {
 	long long int pre = arcan_timemillis();
+	uint64_t pre_us = arcan_timemicros();
 	TRACE_MARK_ENTER("video", "refresh", TRACE_SYS_DEFAULT, 0, 0, "");
 
 	size_t transfc = 0;
@@ -5682,6 +5718,11 @@ unsigned arcan_vint_refresh(float fract, size_t* ndirty)
 		arcan_video_display.ignore_dirty = platform_video_decay();
 	}
 
+	if (*ndirty){
+		arcan_video_display.refresh_us = arcan_timemicros();
+		arcan_video_display.refresh_cost_us = arcan_video_display.refresh_us - pre_us;
+	}
+
 	long long int post = arcan_timemillis();
 	TRACE_MARK_EXIT("video", "refresh", TRACE_SYS_DEFAULT, 0, 0, "");
 	return post - pre;
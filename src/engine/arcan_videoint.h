@@ -303,6 +303,16 @@ struct arcan_video_display {
  * rendertargets. */
 	uint64_t cookie;
 
+/* arcan_timemicros() of the last refresh that had something to draw, used to
+ * split composition from scanout in the frameserver frame timing, and the
+ * time (us) that refresh took, used by the conductor to model compose cost */
+	uint64_t refresh_us;
+	uint64_t refresh_cost_us;
+
+/* number of asynchronous readbacks that can be in flight for a rendertarget,
+ * (video_readback_buffers) */
+	size_t readback_buffers;
+
 	int dirty;
 	size_t ignore_dirty;
 	enum arcan_order3d order3d;
@@ -419,9 +429,15 @@ arcan_vobject* arcan_video_newvobject(arcan_vobj_id* id);
  */
 void arcan_vint_drop_vstore(struct agp_vstore* s);
 
-/* check if a pending readback is completed, and process it if it is. */
+/* feed completed readbacks, oldest first, while the recipient is ready */
 void arcan_vint_pollreadback(struct rendertarget* rtgt);
 
+/*
+ * Queue an asynchronous readback of the rendertarget color store, false if
+ * all readback buffers are still pending (counted as a dropped readback).
+ */
+bool arcan_vint_requestreadback(struct rendertarget* rtgt);
+
 /*
  * ensure that the video object pointed to by id is attached to the
  * currently active (main) rendergarget
@@ -105,6 +105,8 @@ int show_use(struct arcan_shmif_cont* cont, const char* msg)
 		" width   \t outw      \t scale output to a specific width\n"
 		" height  \t outh      \t scale output to a specific height\n"
 		" loop    \t           \t reset playback upon completion\n"
+		" yuv     \t i420, nv12\t deliver planar frames, converted server-side\n"
+		" vbufc   \t 1..3      \t video buffers (default: 1)\n"
 #ifdef HAVE_UVC
 		"---------\t-----------\t----------------\n");
 	uvc_append_help(stdout);
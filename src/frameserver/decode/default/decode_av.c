@@ -57,6 +57,11 @@ static struct {
 
 	volatile bool finished;
 	bool loop, force_paused;
+
+/* requested planar format ('I'420, 'N'V12 or 0) and if it is in use */
+	char planar;
+	bool planar_active;
+	size_t vbufc;
 } decctx;
 
 /*
@@ -76,29 +81,45 @@ static struct {
 
 static void process_inevq();
 
+/*
+ * Claim the planar format in the venc substructure, this fails if the server
+ * didn't accept the substructure (then we get packed RGBA) or refused the
+ * dimensions we aligned for it.
+ */
+static bool planar_setup(unsigned width, unsigned height)
+{
+	struct arcan_shmif_venc* venc =
+		arcan_shmif_substruct(&decctx.shmcont, SHMIF_META_VENC).venc;
+	if (!venc)
+		return false;
+
+	if (!decctx.planar || width % 8 || height % 4){
+		venc->fourcc[0] = 0;
+		return false;
+	}
+
+	memcpy(venc->fourcc, decctx.planar == 'N' ? "NV12" : "I420", 4);
+	venc->framesize = (size_t) width * height * 3 / 2;
+	return true;
+}
+
 static unsigned video_setup(void** ctx, char* chroma, unsigned* width,
 	unsigned* height, unsigned* pitches, unsigned* lines)
 {
 	unsigned rv = 1;
 	decctx.got_video = true;
 
-	if (SHMIF_RGBA(0x00, 0x00, 0xff, 0x00) == 0xff){
-		chroma[0] = 'B';
-		chroma[1] = 'G';
-		chroma[2] = 'R';
-		chroma[3] = 'A';
-	}
-	else {
-		chroma[0] = 'R';
-		chroma[1] = 'G';
-		chroma[2] = 'B';
-		chroma[3] = 'A';
+/* the planar formats need aligned dimensions, vlc will scale to fit */
+	if (decctx.planar){
+		*width = (*width + 7) & ~7;
+		*height = (*height + 3) & ~3;
 	}
 
 	arcan_shmif_lock(&decctx.shmcont);
 	if (!arcan_shmif_resize_ext(&decctx.shmcont,
 		*width, *height, (struct shmif_resize_ext){
-			.abuf_sz = 16384, .abuf_cnt = 12, .vbuf_cnt = 1})){
+			.abuf_sz = 16384, .abuf_cnt = 12, .vbuf_cnt = decctx.vbufc,
+			.meta = decctx.planar ? SHMIF_META_VENC : 0})){
 		LOG("(decode) shmpage setup failed, "
 			"requested: (%d x %d)\n", *width, *height);
 		rv = 0;
@@ -112,13 +133,38 @@ static unsigned video_setup(void** ctx, char* chroma, unsigned* width,
 		*width = decctx.shmcont.w;
 		*height = decctx.shmcont.h;
 	}
+
+	decctx.planar_active = rv && planar_setup(*width, *height);
+
+/* both planar formats are contiguous with the chroma plane(s) after luma */
+	if (decctx.planar_active && decctx.planar == 'N'){
+		memcpy(chroma, "NV12", 4);
+		pitches[0] = pitches[1] = *width;
+		lines[0] = *height;
+		lines[1] = *height / 2;
+	}
+	else if (decctx.planar_active){
+		memcpy(chroma, "I420", 4);
+		pitches[0] = *width;
+		pitches[1] = pitches[2] = *width / 2;
+		lines[0] = *height;
+		lines[1] = lines[2] = *height / 2;
+	}
 	else {
-		LOG("(decode) got ('%c', '%c', '%c', '%c') @ %u * %u\n",
-			chroma[0],chroma[1],chroma[2],chroma[3], *width, *height);
+		if (SHMIF_RGBA(0x00, 0x00, 0xff, 0x00) == 0xff)
+			memcpy(chroma, "BGRA", 4);
+		else
+			memcpy(chroma, "RGBA", 4);
+
+		*pitches = *width * 4;
+		*lines = *height;
 	}
 
-	*pitches = *width * 4;
-	*lines = *height;
+	if (rv){
+		LOG("(decode) got ('%c', '%c', '%c', '%c') @ %u * %u, %zu buffers\n",
+			chroma[0],chroma[1],chroma[2],chroma[3], *width, *height,
+			(size_t) decctx.vbufc);
+	}
 
 	arcan_shmif_unlock(&decctx.shmcont);
 	return rv;
@@ -328,11 +374,26 @@ static void video_cleanup(void* ctx)
 
 static void* video_lock(void* ctx, void** planes)
 {
-	return *planes = decctx.shmcont.vidp;
+	uint8_t* base = (uint8_t*) decctx.shmcont.vidp;
+	planes[0] = base;
+
+	if (decctx.planar_active){
+		size_t luma = decctx.shmcont.w * decctx.shmcont.h;
+		planes[1] = base + luma;
+		planes[2] = base + luma + (luma >> 2);
+	}
+
+	return base;
 }
 
+/* tag each frame with the media time, it ends up in the store vpts and in
+ * FRAME_DELIVERED. vlc calls this at the presentation time of the frame so the
+ * engine presenting on arrival is still in order, scheduling against the pts
+ * on the engine side is not done yet */
 static void video_display(void* ctx, void* picture)
 {
+	int64_t pts = libvlc_media_player_get_time(decctx.player);
+	atomic_store(&decctx.shmcont.addr->vpts, pts > 0 ? pts : 0);
 	arcan_shmif_signalV();
 }
 
@@ -533,6 +594,13 @@ static bool dispatch(arcan_event* ev)
 	case TARGET_COMMAND_STEPFRAME:
 	break;
 
+/* the server couldn't use the planar format, vlc can't renegotiate in the
+ * middle of a stream so this only takes effect on the next format setup */
+	case TARGET_COMMAND_BUFFER_FAIL:
+		LOG("planar transfer rejected, reverting to packed RGBA\n");
+		decctx.planar = 0;
+	break;
+
 	default:
 		LOG("unhandled target event (%s)\n", arcan_shmif_eventstr(ev, NULL, 0));
 	}
@@ -574,6 +642,20 @@ int decode_av(struct arcan_shmif_cont* cont, struct arg_arr* args)
 	});
 
 	decctx.shmcont = *cont;
+	decctx.vbufc = 1;
+
+/* frames are still shown as they are decoded rather than at their pts, so
+ * more buffers only add latency and memory until that changes, keep it at one
+ * unless asked for */
+	if (arg_lookup(args, "yuv", 0, &val)){
+		decctx.planar = val && strcmp(val, "nv12") == 0 ? 'N' : 'I';
+	}
+
+	if (arg_lookup(args, "vbufc", 0, &val) && val){
+		size_t bufc = strtoul(val, NULL, 10);
+		decctx.vbufc = bufc > 0 && bufc <= ARCAN_SHMIF_VBUFC_LIM ? bufc : 1;
+	}
+
 #ifdef __APPLE__
 	const char* paths[] = {
 		"/opt/local/lib/vlc/plugins",
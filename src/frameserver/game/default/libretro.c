@@ -20,6 +20,7 @@
 #include <dlfcn.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <time.h>
 
 #ifdef FRAMESERVER_LIBRETRO_3D
 #ifdef ENABLE_RETEXTURE
@@ -324,6 +325,82 @@ static void process_frames(int nframes, bool overrv, bool overra)
 	retro.skipframe_a = ca;
 }
 
+/*
+ * Run-ahead: present the frame [frames] steps into the future using the
+ * current input, hiding the internal input latency of the emulated system.
+ *
+ * Single instance: run the real frame (keeps audio, drops video), serialize,
+ * run ahead without audio and show the last frame, then restore.
+ *
+ * Second instance: a private copy of the core is loaded and fed the state of
+ * the primary each frame. The primary never gets restored, so cores that
+ * don't serialize their audio state cleanly won't glitch. Costs twice the
+ * memory and needs a core that survives being loaded twice.
+ */
+static struct {
+	int frames;
+	bool secondary;
+	bool optdirty;
+	char* state;
+
+	void* lib;
+	void (*run)();
+	bool (*deserialize)(const void*, size_t);
+	void (*set_ioport)(unsigned, unsigned);
+
+	long long serialize_us, deserialize_us, cost_us;
+} runahead;
+
+static long long timemicros()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (tp.tv_sec * 1000000) + (tp.tv_nsec / 1000);
+}
+
+static void run_ahead()
+{
+	bool cv = retro.skipframe_v;
+	bool ca = retro.skipframe_a;
+	long long start = timemicros();
+
+/* the real frame, this one consumes the input and produces the audio */
+	retro.skipframe_v = true;
+	retro.run();
+
+	long long ts = timemicros();
+	if (!retro.serialize(runahead.state, retro.state_sz)){
+		LOG("run-ahead: core failed to serialize, disabling\n");
+		runahead.frames = 0;
+		retro.skipframe_v = cv;
+		return;
+	}
+	runahead.serialize_us = timemicros() - ts;
+
+	if (runahead.secondary){
+		ts = timemicros();
+		runahead.deserialize(runahead.state, retro.state_sz);
+		runahead.deserialize_us = timemicros() - ts;
+	}
+
+	void (*run)() = runahead.secondary ? runahead.run : retro.run;
+	retro.skipframe_a = true;
+	for (int i = 0; i < runahead.frames; i++){
+		retro.skipframe_v = i < runahead.frames - 1 ? true : cv;
+		run();
+	}
+
+	if (!runahead.secondary){
+		ts = timemicros();
+		retro.deserialize(runahead.state, retro.state_sz);
+		runahead.deserialize_us = timemicros() - ts;
+	}
+
+	retro.skipframe_v = cv;
+	retro.skipframe_a = ca;
+	runahead.cost_us = timemicros() - start;
+}
+
 #define RGB565(b, g, r) ((uint16_t)(((uint8_t)(r) >> 3) << 11) | \
 								(((uint8_t)(g) >> 2) << 5) | ((uint8_t)(b) >> 3))
 
@@ -1097,6 +1174,111 @@ static int16_t libretro_inputstate(unsigned port, unsigned dev,
 	return rv;
 }
 
+/* the second instance shares the environment, but must not announce options
+ * or claim resources a second time */
+static bool runahead_setenv(unsigned cmd, void* data)
+{
+	switch (cmd){
+	case RETRO_ENVIRONMENT_SET_VARIABLES:
+	case RETRO_ENVIRONMENT_SET_SUPPORT_NO_GAME:
+		return true;
+
+	case RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE:
+		if (data)
+			*(bool*)data = runahead.optdirty;
+		runahead.optdirty = false;
+		return true;
+
+	case RETRO_ENVIRONMENT_SET_HW_RENDER | RETRO_ENVIRONMENT_EXPERIMENTAL:
+	case RETRO_ENVIRONMENT_SET_HW_RENDER:
+		return false;
+
+	default:
+		return libretro_setenv(cmd, data);
+	}
+}
+
+/* dlopen on the same path returns the same handle, so load the second
+ * instance from a private copy of the core */
+static bool runahead_load_secondary(const char* libname)
+{
+	char tmpl[] = "/tmp/arcan_runahead_XXXXXX";
+	int dfd = mkstemp(tmpl);
+	if (-1 == dfd)
+		return false;
+
+	int sfd = open(libname, O_RDONLY | O_CLOEXEC);
+	if (-1 == sfd){
+		unlink(tmpl);
+		close(dfd);
+		return false;
+	}
+
+	char buf[65536];
+	ssize_t nr;
+	bool ok = true;
+	while (ok && (nr = read(sfd, buf, sizeof(buf))) != 0){
+		if (-1 == nr){
+			if (errno == EINTR)
+				continue;
+			ok = false;
+			break;
+		}
+		ok = write_handle(buf, nr, dfd, false);
+	}
+	close(sfd);
+	close(dfd);
+
+	void* lib = ok ? dlopen(tmpl, RTLD_NOW | RTLD_LOCAL) : NULL;
+	unlink(tmpl);
+	if (!lib){
+		LOG("run-ahead: couldn't load second instance (%s)\n", dlerror());
+		return false;
+	}
+
+	void (*set_env)(retro_environment_t) = dlsym(lib, "retro_set_environment");
+	void (*initf)() = dlsym(lib, "retro_init");
+	bool (*load_game)(const struct retro_game_info*) = dlsym(lib, "retro_load_game");
+	void (*set_video)(retro_video_refresh_t) = dlsym(lib, "retro_set_video_refresh");
+	void (*set_abatch)(retro_audio_sample_batch_t) = dlsym(lib, "retro_set_audio_sample_batch");
+	void (*set_asample)(retro_audio_sample_t) = dlsym(lib, "retro_set_audio_sample");
+	void (*set_poll)(retro_input_poll_t) = dlsym(lib, "retro_set_input_poll");
+	void (*set_state)(retro_input_state_t) = dlsym(lib, "retro_set_input_state");
+	runahead.run = dlsym(lib, "retro_run");
+	runahead.deserialize = dlsym(lib, "retro_unserialize");
+	runahead.set_ioport = dlsym(lib, "retro_set_controller_port_device");
+
+	if (!set_env || !initf || !load_game || !set_video || !set_abatch ||
+		!set_asample || !set_poll || !set_state || !runahead.run ||
+		!runahead.deserialize || !runahead.set_ioport){
+		LOG("run-ahead: second instance is missing symbols\n");
+		goto fail;
+	}
+
+	set_env(runahead_setenv);
+	initf();
+	set_video(libretro_vidcb);
+	set_abatch(libretro_audcb);
+	set_asample(libretro_audscb);
+	set_poll(libretro_pollcb);
+	set_state(libretro_inputstate);
+
+	if (!load_game(&retro.gameinfo)){
+		LOG("run-ahead: second instance rejected the resource\n");
+		goto fail;
+	}
+
+	runahead.lib = lib;
+	return true;
+
+fail:
+	runahead.run = NULL;
+	runahead.deserialize = NULL;
+	runahead.set_ioport = NULL;
+	dlclose(lib);
+	return false;
+}
+
 static int remaptbl[] = {
 	RETRO_DEVICE_ID_JOYPAD_A,
 	RETRO_DEVICE_ID_JOYPAD_B,
@@ -1328,11 +1510,14 @@ static inline void targetev(arcan_event* ev)
 
 		case TARGET_COMMAND_COREOPT:
 			retro.optdirty = true;
+			runahead.optdirty = true;
 			update_corearg(tgt->code, tgt->message);
 		break;
 
 		case TARGET_COMMAND_SETIODEV:
 			retro.set_ioport(tgt->ioevs[0].iv, tgt->ioevs[1].iv);
+			if (runahead.set_ioport)
+				runahead.set_ioport(tgt->ioevs[0].iv, tgt->ioevs[1].iv);
 		break;
 
 /* should also emit a corresponding event back with the current framenumber */
@@ -1682,6 +1867,8 @@ static void dump_help()
 		" vbufc   \t num       \t (1) 1..4 - number of video buffers\n"
 		" abufc   \t num       \t (8) 1..16 - number of audio buffers\n"
 		" abufsz  \t num       \t audio buffer size in bytes (default = probe)\n"
+		" runahead\t num       \t 0..4 - present frames ahead, needs savestates\n"
+		" runahead_secondary \t \t run ahead on a second instance of the core\n"
     " noreset \t           \t (3D) disable context reset calls\n"
     "---------\t-----------\t-----------------\n"
 	);
@@ -1725,6 +1912,12 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 		retro.def_abuf_sz = strtoul(val, NULL, 10);
 	}
 
+	if (arg_lookup(args, "runahead", 0, &val)){
+		long n = val && val[0] ? strtol(val, NULL, 10) : 1;
+		runahead.frames = n <= 0 ? 0 : (n > 4 ? 4 : n);
+		runahead.secondary = arg_lookup(args, "runahead_secondary", 0, NULL);
+	}
+
 /* system directory doesn't really match any of arcan namespaces,
  * provide some kind of global-  user overridable way */
 	const char* spath = getenv("ARCAN_LIBRETRO_SYSPATH");
@@ -1830,6 +2023,21 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 	if (retro.state_sz > 0)
 		retro.rollback_state = malloc(retro.state_sz);
 
+	if (runahead.frames){
+		if (!retro.state_sz || !(runahead.state = malloc(retro.state_sz))){
+			LOG("run-ahead requested, but core lacks savestate support\n");
+			runahead.frames = 0;
+		}
+		else if (runahead.secondary && (retro.in_3d ||
+			!runahead_load_secondary(libname))){
+			LOG("run-ahead: falling back to single instance\n");
+			runahead.secondary = false;
+		}
+		else
+			LOG("run-ahead: %d frames, %s instance\n", runahead.frames,
+				runahead.secondary ? "second" : "single");
+	}
+
 /* basetime is used as epoch for all other timing calculations, run
  * an initial frame because sometimes first run can introduce a large stall */
 	retro.skipframe_v = retro.skipframe_a = true;
@@ -1860,7 +2068,7 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
 				TARGET_SKIP_STEP + 1, false);
 
 		else if (retro.skipmode <= TARGET_SKIP_ROLLBACK &&
-			retro.dirty_input){
+			retro.dirty_input && !runahead.frames){
 /* last entry will always be the current front */
 			retro.deserialize(retro.rollback_state +
 				retro.state_sz * retro.rollback_front, retro.state_sz);
@@ -1877,7 +2085,10 @@ int	afsrv_game(struct arcan_shmif_cont* cont, struct arg_arr* args)
  * testing by adding delays at various key synchronization points */
 		start = arcan_timemillis();
 			add_jitter(retro.jitterstep);
-			process_frames(1, false, false);
+			if (runahead.frames)
+				run_ahead();
+			else
+				process_frames(1, false, false);
 		stop = arcan_timemillis();
 		retro.framecost = stop - start;
 		if (retro.sync_data){
@@ -1939,7 +2150,8 @@ static void push_stats()
 		"Mode: %d, Preaudio: %d\n Jitter: %d/%d\n"
 		"(A,V - A/V) %lld, %lld - %lld\n"
 		"Real (Hz): %f\n"
-		"cost,wake,xfer: %d, %d, %d ms \n",
+		"cost,wake,xfer: %d, %d, %d ms \n"
+		"Runahead: %d%s, ser/deser/total: %lld, %lld, %lld us\n",
 		(char*)retro.sysinfo.library_name,
 		(char*)retro.sysinfo.library_version,
 		(char*)retro.colorspace,
@@ -1951,7 +2163,9 @@ static void push_stats()
 		retro.aframecount / retro.vframecount,
 		1000.0f * (float)retro.aframecount /
 			(float)(timestamp - retro.basetime),
-		retro.framecost, retro.prewake, retro.transfercost
+		retro.framecost, retro.prewake, retro.transfercost,
+		runahead.frames, runahead.secondary ? " (2nd)" : "",
+		runahead.serialize_us, runahead.deserialize_us, runahead.cost_us
 	);
 
 	if (!retro.sync_data->update(
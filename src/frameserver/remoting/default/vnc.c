@@ -61,7 +61,15 @@ static rfbBool client_resize(struct _rfbClient* client)
 
 	vncctx.shmcont.hints = SHMIF_RHINT_SUBREGION | SHMIF_RHINT_IGNORE_ALPHA;
 
-	if (!arcan_shmif_resize(&vncctx.shmcont, neww, newh)){
+/* the remote desktop can be large and resize often, reserve the segment */
+	if (!arcan_shmif_resize_ext(&vncctx.shmcont, neww, newh,
+		(struct shmif_resize_ext){
+			.abuf_sz = vncctx.shmcont.addr->abufsize,
+			.vbuf_cnt = -1,
+			.abuf_cnt = -1,
+			.samplerate = -1,
+			.flags = SHMIF_RESIZE_RESERVE
+		})){
 		LOG("client requested a resize outside "
 			"accepted dimensions (%d, %d)\n", neww, newh);
 		return false;
@@ -920,7 +920,7 @@ static int tsm_draw_callback(struct tsm_screen* screen, uint32_t id,
 		tui->front[pos].draw_ch = tui->front[pos].ch = *ch;
 		tui->front[pos].attr = *attr;
 		tui->front[pos].fstamp = tui->fstamp;
-		tui->dirty |= DIRTY_PARTIAL;
+		tui_screen_dirty_rows(tui, y, y);
 	}
 
 	return 0;
@@ -98,6 +98,8 @@ static void speex_free (void *ptr) {free(ptr);}
 
 #ifdef _USE_SSE
 #include "resample_sse.h"
+#elif !defined(FIXED_POINT) && !defined(RESAMPLE_NO_SIMD)
+#include "resample_simd.h"
 #endif
 
 /* Numer of elements to allocate on the stack */
@@ -338,7 +340,6 @@ static int resampler_basic_direct_single(SpeexResamplerState *st, spx_uint32_t c
    const int frac_advance = st->frac_advance;
    const spx_uint32_t den_rate = st->den_rate;
    spx_word32_t sum;
-   int j;
 
    while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
    {
@@ -346,6 +347,7 @@ static int resampler_basic_direct_single(SpeexResamplerState *st, spx_uint32_t c
       const spx_word16_t *iptr = & in[last_sample];
 
 #ifndef OVERRIDE_INNER_PRODUCT_SINGLE
+      int j;
       sum = 0;
       for(j=0;j<N;j++) sum += MULT16_16(sinc[j], iptr[j]);
 
@@ -395,7 +397,6 @@ static int resampler_basic_direct_double(SpeexResamplerState *st, spx_uint32_t c
    const int frac_advance = st->frac_advance;
    const spx_uint32_t den_rate = st->den_rate;
    double sum;
-   int j;
 
    while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
    {
@@ -403,6 +404,7 @@ static int resampler_basic_direct_double(SpeexResamplerState *st, spx_uint32_t c
       const spx_word16_t *iptr = & in[last_sample];
 
 #ifndef OVERRIDE_INNER_PRODUCT_DOUBLE
+      int j;
       double accum[4] = {0,0,0,0};
 
       for(j=0;j<N;j+=4) {
@@ -432,6 +434,41 @@ static int resampler_basic_direct_double(SpeexResamplerState *st, spx_uint32_t c
 }
 #endif
 
+#if !defined(FIXED_POINT) && defined(OVERRIDE_INNER_PRODUCT_SINGLE)
+/* Integer ratio upsampling (num_rate == 1, e.g. 44.1k->88.2k, 48k->96k): every
+   input position produces den_rate outputs, one per table phase, so walk the
+   phases over the same input window rather than stepping the fraction per
+   output sample. */
+static int resampler_basic_direct_upsample(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
+{
+   const int N = st->filt_len;
+   int out_sample = 0;
+   int last_sample = st->last_sample[channel_index];
+   spx_uint32_t samp_frac_num = st->samp_frac_num[channel_index];
+   const spx_word16_t *sinc_table = st->sinc_table;
+   const int out_stride = st->out_stride;
+   const spx_uint32_t den_rate = st->den_rate;
+
+   while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
+   {
+      const spx_word16_t *iptr = & in[last_sample];
+
+      for (; samp_frac_num < den_rate && out_sample < (spx_int32_t)*out_len; samp_frac_num++)
+         out[out_stride * out_sample++] = inner_product_single(&sinc_table[samp_frac_num*N], iptr, N);
+
+      if (samp_frac_num >= den_rate)
+      {
+         samp_frac_num = 0;
+         last_sample++;
+      }
+   }
+
+   st->last_sample[channel_index] = last_sample;
+   st->samp_frac_num[channel_index] = samp_frac_num;
+   return out_sample;
+}
+#endif
+
 static int resampler_basic_interpolate_single(SpeexResamplerState *st, spx_uint32_t channel_index, const spx_word16_t *in, spx_uint32_t *in_len, spx_word16_t *out, spx_uint32_t *out_len)
 {
    const int N = st->filt_len;
@@ -442,7 +479,6 @@ static int resampler_basic_interpolate_single(SpeexResamplerState *st, spx_uint3
    const int int_advance = st->int_advance;
    const int frac_advance = st->frac_advance;
    const spx_uint32_t den_rate = st->den_rate;
-   int j;
    spx_word32_t sum;
 
    while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
@@ -459,6 +495,7 @@ static int resampler_basic_interpolate_single(SpeexResamplerState *st, spx_uint3
 
 
 #ifndef OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+      int j;
       spx_word32_t accum[4] = {0,0,0,0};
 
       for(j=0;j<N;j++) {
@@ -504,7 +541,6 @@ static int resampler_basic_interpolate_double(SpeexResamplerState *st, spx_uint3
    const int int_advance = st->int_advance;
    const int frac_advance = st->frac_advance;
    const spx_uint32_t den_rate = st->den_rate;
-   int j;
    spx_word32_t sum;
 
    while (!(last_sample >= (spx_int32_t)*in_len || out_sample >= (spx_int32_t)*out_len))
@@ -521,6 +557,7 @@ static int resampler_basic_interpolate_double(SpeexResamplerState *st, spx_uint3
 
 
 #ifndef OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
+      int j;
       double accum[4] = {0,0,0,0};
 
       for(j=0;j<N;j++) {
@@ -611,6 +648,10 @@ static void update_filter(SpeexResamplerState *st)
          st->resampler_ptr = resampler_basic_direct_double;
       else
          st->resampler_ptr = resampler_basic_direct_single;
+#ifdef OVERRIDE_INNER_PRODUCT_SINGLE
+      if (st->quality<=8 && st->num_rate == 1)
+         st->resampler_ptr = resampler_basic_direct_upsample;
+#endif
 #endif
       /*fprintf (stderr, "resampler uses direct sinc table and normalised cutoff %f\n", cutoff);*/
    } else {
@@ -737,6 +778,14 @@ EXPORT SpeexResamplerState *speex_resampler_init_frac(spx_uint32_t nb_channels,
          *err = RESAMPLER_ERR_INVALID_ARG;
       return NULL;
    }
+#if !defined(_USE_SSE) && !defined(FIXED_POINT) && !defined(RESAMPLE_NO_SIMD)
+   static int simd_probed;
+   if (!simd_probed)
+   {
+      resample_simd_init();
+      simd_probed = 1;
+   }
+#endif
    st = (SpeexResamplerState *)speex_alloc(sizeof(SpeexResamplerState));
    st->initialised = 0;
    st->started = 0;
@@ -1136,3 +1185,16 @@ EXPORT const char *speex_resampler_strerror(int err)
          return "Unknown error. Bad error code or strange version mismatch.";
    }
 }
+
+EXPORT const char *speex_resampler_kernel(int scalar)
+{
+#if !defined(_USE_SSE) && !defined(FIXED_POINT) && !defined(RESAMPLE_NO_SIMD)
+   if (scalar)
+      resample_simd_scalar();
+   else
+      resample_simd_init();
+   return resample_simd_kernel();
+#else
+   return "scalar";
+#endif
+}
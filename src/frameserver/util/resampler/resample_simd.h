@@ -0,0 +1,294 @@
+/* Runtime dispatched inner products for the floating point resampler.
+
+   Same contract as resample_sse.h in upstream speex: defining the
+   OVERRIDE_* macros replaces the scalar loops in resample.c with the
+   functions below. The scalar versions are kept here as the fallback, the
+   vector ones are picked once by resample_simd_init:
+
+      x86-64  - AVX2+FMA if the CPU reports both, otherwise scalar.
+      aarch64 - NEON, always present.
+
+   Define RESAMPLE_NO_SIMD to build without any of this.
+*/
+
+#ifndef RESAMPLE_SIMD_H
+#define RESAMPLE_SIMD_H
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RESAMPLE_SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define RESAMPLE_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#define OVERRIDE_INNER_PRODUCT_SINGLE
+#define OVERRIDE_INNER_PRODUCT_DOUBLE
+#define OVERRIDE_INTERPOLATE_PRODUCT_SINGLE
+#define OVERRIDE_INTERPOLATE_PRODUCT_DOUBLE
+
+typedef float (*inner_single_fn)(const float *a, const float *b, unsigned int len);
+typedef double (*inner_double_fn)(const float *a, const float *b, unsigned int len);
+typedef float (*interp_single_fn)(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac);
+typedef double (*interp_double_fn)(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac);
+
+static float inner_product_single_c(const float *a, const float *b, unsigned int len)
+{
+   float sum = 0;
+   unsigned int i;
+   for (i=0;i<len;i++)
+      sum += a[i]*b[i];
+   return sum;
+}
+
+static double inner_product_double_c(const float *a, const float *b, unsigned int len)
+{
+   double accum[4] = {0,0,0,0};
+   unsigned int i;
+   for (i=0;i+3<len;i+=4)
+   {
+      accum[0] += a[i]*b[i];
+      accum[1] += a[i+1]*b[i+1];
+      accum[2] += a[i+2]*b[i+2];
+      accum[3] += a[i+3]*b[i+3];
+   }
+   for (;i<len;i++)
+      accum[0] += a[i]*b[i];
+   return accum[0] + accum[1] + accum[2] + accum[3];
+}
+
+static float interpolate_product_single_c(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac)
+{
+   float accum[4] = {0,0,0,0};
+   unsigned int i;
+   for (i=0;i<len;i++)
+   {
+      const float curr = a[i];
+      accum[0] += curr*b[i*oversample+0];
+      accum[1] += curr*b[i*oversample+1];
+      accum[2] += curr*b[i*oversample+2];
+      accum[3] += curr*b[i*oversample+3];
+   }
+   return frac[0]*accum[0] + frac[1]*accum[1] + frac[2]*accum[2] + frac[3]*accum[3];
+}
+
+static double interpolate_product_double_c(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac)
+{
+   double accum[4] = {0,0,0,0};
+   unsigned int i;
+   for (i=0;i<len;i++)
+   {
+      const double curr = a[i];
+      accum[0] += curr*b[i*oversample+0];
+      accum[1] += curr*b[i*oversample+1];
+      accum[2] += curr*b[i*oversample+2];
+      accum[3] += curr*b[i*oversample+3];
+   }
+   return frac[0]*accum[0] + frac[1]*accum[1] + frac[2]*accum[2] + frac[3]*accum[3];
+}
+
+#ifdef RESAMPLE_SIMD_AVX2
+#define AVX2_FN __attribute__((target("avx2,fma")))
+
+AVX2_FN static inline float hsum_ps(__m256 v)
+{
+   __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+   s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+   s = _mm_add_ss(s, _mm_movehdup_ps(s));
+   return _mm_cvtss_f32(s);
+}
+
+AVX2_FN static inline double hsum_pd(__m256d v)
+{
+   __m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+   s = _mm_add_sd(s, _mm_unpackhi_pd(s, s));
+   return _mm_cvtsd_f64(s);
+}
+
+AVX2_FN static float inner_product_single_avx2(const float *a, const float *b, unsigned int len)
+{
+   __m256 acc0 = _mm256_setzero_ps();
+   __m256 acc1 = _mm256_setzero_ps();
+   unsigned int i = 0;
+   for (;i+15<len;i+=16)
+   {
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), acc0);
+      acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8), acc1);
+   }
+   for (;i+7<len;i+=8)
+      acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i), acc0);
+
+   float sum = hsum_ps(_mm256_add_ps(acc0, acc1));
+   for (;i<len;i++)
+      sum += a[i]*b[i];
+   return sum;
+}
+
+AVX2_FN static double inner_product_double_avx2(const float *a, const float *b, unsigned int len)
+{
+   __m256d acc0 = _mm256_setzero_pd();
+   __m256d acc1 = _mm256_setzero_pd();
+   unsigned int i = 0;
+   for (;i+7<len;i+=8)
+   {
+      __m256 va = _mm256_loadu_ps(a+i);
+      __m256 vb = _mm256_loadu_ps(b+i);
+      acc0 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(va)),
+         _mm256_cvtps_pd(_mm256_castps256_ps128(vb)), acc0);
+      acc1 = _mm256_fmadd_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(va, 1)),
+         _mm256_cvtps_pd(_mm256_extractf128_ps(vb, 1)), acc1);
+   }
+
+   double sum = hsum_pd(_mm256_add_pd(acc0, acc1));
+   for (;i<len;i++)
+      sum += (double)a[i]*b[i];
+   return sum;
+}
+
+/* the four interpolation taps are contiguous in the table, so each input
+   sample is one broadcast and one 4-wide fma */
+AVX2_FN static float interpolate_product_single_avx2(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac)
+{
+   __m128 acc = _mm_setzero_ps();
+   unsigned int i;
+   for (i=0;i<len;i++)
+      acc = _mm_fmadd_ps(_mm_set1_ps(a[i]), _mm_loadu_ps(b+i*oversample), acc);
+
+   acc = _mm_mul_ps(acc, _mm_loadu_ps(frac));
+   acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+   acc = _mm_add_ss(acc, _mm_movehdup_ps(acc));
+   return _mm_cvtss_f32(acc);
+}
+
+AVX2_FN static double interpolate_product_double_avx2(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac)
+{
+   __m256d acc = _mm256_setzero_pd();
+   unsigned int i;
+   for (i=0;i<len;i++)
+      acc = _mm256_fmadd_pd(_mm256_set1_pd(a[i]),
+         _mm256_cvtps_pd(_mm_loadu_ps(b+i*oversample)), acc);
+
+   return hsum_pd(_mm256_mul_pd(acc, _mm256_cvtps_pd(_mm_loadu_ps(frac))));
+}
+#endif
+
+#ifdef RESAMPLE_SIMD_NEON
+static float inner_product_single_neon(const float *a, const float *b, unsigned int len)
+{
+   float32x4_t acc0 = vdupq_n_f32(0);
+   float32x4_t acc1 = vdupq_n_f32(0);
+   unsigned int i = 0;
+   for (;i+7<len;i+=8)
+   {
+      acc0 = vfmaq_f32(acc0, vld1q_f32(a+i), vld1q_f32(b+i));
+      acc1 = vfmaq_f32(acc1, vld1q_f32(a+i+4), vld1q_f32(b+i+4));
+   }
+   for (;i+3<len;i+=4)
+      acc0 = vfmaq_f32(acc0, vld1q_f32(a+i), vld1q_f32(b+i));
+
+   float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+   for (;i<len;i++)
+      sum += a[i]*b[i];
+   return sum;
+}
+
+static double inner_product_double_neon(const float *a, const float *b, unsigned int len)
+{
+   float64x2_t acc0 = vdupq_n_f64(0);
+   float64x2_t acc1 = vdupq_n_f64(0);
+   unsigned int i = 0;
+   for (;i+3<len;i+=4)
+   {
+      float32x4_t va = vld1q_f32(a+i);
+      float32x4_t vb = vld1q_f32(b+i);
+      acc0 = vfmaq_f64(acc0, vcvt_f64_f32(vget_low_f32(va)), vcvt_f64_f32(vget_low_f32(vb)));
+      acc1 = vfmaq_f64(acc1, vcvt_high_f64_f32(va), vcvt_high_f64_f32(vb));
+   }
+
+   double sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+   for (;i<len;i++)
+      sum += (double)a[i]*b[i];
+   return sum;
+}
+
+static float interpolate_product_single_neon(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac)
+{
+   float32x4_t acc = vdupq_n_f32(0);
+   unsigned int i;
+   for (i=0;i<len;i++)
+      acc = vfmaq_n_f32(acc, vld1q_f32(b+i*oversample), a[i]);
+   return vaddvq_f32(vmulq_f32(acc, vld1q_f32(frac)));
+}
+
+static double interpolate_product_double_neon(const float *a, const float *b,
+   unsigned int len, spx_uint32_t oversample, const float *frac)
+{
+   float64x2_t lo = vdupq_n_f64(0);
+   float64x2_t hi = vdupq_n_f64(0);
+   unsigned int i;
+   for (i=0;i<len;i++)
+   {
+      float32x4_t vb = vld1q_f32(b+i*oversample);
+      lo = vfmaq_n_f64(lo, vcvt_f64_f32(vget_low_f32(vb)), a[i]);
+      hi = vfmaq_n_f64(hi, vcvt_high_f64_f32(vb), a[i]);
+   }
+   float32x4_t vf = vld1q_f32(frac);
+   lo = vmulq_f64(lo, vcvt_f64_f32(vget_low_f32(vf)));
+   hi = vmulq_f64(hi, vcvt_high_f64_f32(vf));
+   return vaddvq_f64(vaddq_f64(lo, hi));
+}
+#endif
+
+static inner_single_fn inner_product_single = inner_product_single_c;
+static inner_double_fn inner_product_double = inner_product_double_c;
+static interp_single_fn interpolate_product_single = interpolate_product_single_c;
+static interp_double_fn interpolate_product_double = interpolate_product_double_c;
+
+static void resample_simd_scalar(void)
+{
+   inner_product_single = inner_product_single_c;
+   inner_product_double = inner_product_double_c;
+   interpolate_product_single = interpolate_product_single_c;
+   interpolate_product_double = interpolate_product_double_c;
+}
+
+/* idempotent, racing callers all store the same pointers */
+static void resample_simd_init(void)
+{
+#ifdef RESAMPLE_SIMD_AVX2
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+   {
+      inner_product_single = inner_product_single_avx2;
+      inner_product_double = inner_product_double_avx2;
+      interpolate_product_single = interpolate_product_single_avx2;
+      interpolate_product_double = interpolate_product_double_avx2;
+   }
+#elif defined(RESAMPLE_SIMD_NEON)
+   inner_product_single = inner_product_single_neon;
+   inner_product_double = inner_product_double_neon;
+   interpolate_product_single = interpolate_product_single_neon;
+   interpolate_product_double = interpolate_product_double_neon;
+#endif
+}
+
+static const char *resample_simd_kernel(void)
+{
+#ifdef RESAMPLE_SIMD_AVX2
+   if (inner_product_single == inner_product_single_avx2)
+      return "avx2+fma";
+#elif defined(RESAMPLE_SIMD_NEON)
+   if (inner_product_single == inner_product_single_neon)
+      return "neon";
+#endif
+   return "scalar";
+}
+
+#endif
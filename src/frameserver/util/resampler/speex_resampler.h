@@ -79,6 +79,7 @@
 #define speex_resampler_skip_zeros CAT_PREFIX(RANDOM_PREFIX,_resampler_skip_zeros)
 #define speex_resampler_reset_mem CAT_PREFIX(RANDOM_PREFIX,_resampler_reset_mem)
 #define speex_resampler_strerror CAT_PREFIX(RANDOM_PREFIX,_resampler_strerror)
+#define speex_resampler_kernel CAT_PREFIX(RANDOM_PREFIX,_resampler_kernel)
 
 #define spx_int16_t short
 #define spx_int32_t int
@@ -340,6 +341,14 @@ int speex_resampler_reset_mem(SpeexResamplerState *st);
  */
 const char *speex_resampler_strerror(int err);
 
+/** Select the inner product kernels used by all resamplers. By default the
+ * fastest one the CPU supports is picked on first init.
+ * @param scalar Force the scalar reference kernels (1), or use the best
+ *               available (0).
+ * @return Name of the active kernel ("scalar", "avx2+fma", "neon")
+ */
+const char *speex_resampler_kernel(int scalar);
+
 #ifdef __cplusplus
 }
 #endif
@@ -22,6 +22,14 @@
 #include "arcan_general.h"
 #include "arcan_video.h"
 #include "arcan_videoint.h"
+#include "glyuv.h"
+#include "readback.h"
+
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
 
 static const char* defvprg =
 "#version 120\n"
@@ -55,6 +63,17 @@ const char* defcfprg =
 "   gl_FragColor = vec4(obj_col.rgb, obj_opacity);\n"
 "}\n";
 
+static const char* i420fprg =
+"#version 120\n"
+PLANAR_SWIZZLE
+PLANAR_FPRG_BODY;
+
+static const char* nv12fprg =
+"#version 120\n"
+"#define NV12\n"
+PLANAR_SWIZZLE
+PLANAR_FPRG_BODY;
+
 const char * defcvprg =
 "#version 120\n"
 "uniform mat4 modelview;\n"
@@ -93,6 +112,10 @@ agp_shader_id agp_default_shader(enum SHADER_TYPES type)
 		shids[COLOR_2D] = agp_shader_build(
 			"DEFAULT_COLOR", NULL, defcvprg, defcfprg);
 		shids[BASIC_3D] = shids[BASIC_2D];
+		shids[PLANAR_I420_2D] = agp_shader_build(
+			"PLANAR_I420", NULL, defvprg, i420fprg);
+		shids[PLANAR_NV12_2D] = agp_shader_build(
+			"PLANAR_NV12", NULL, defvprg, nv12fprg);
 		defshdr_build = true;
 	}
 
@@ -139,22 +162,6 @@ const char* agp_shader_language()
 	return "GLSL120";
 }
 
-static void pbo_alloc_read(struct agp_vstore* store)
-{
-	GLuint pboid;
-	struct agp_fenv* env = agp_env();
-	env->gen_buffers(1, &pboid);
-	store->vinf.text.rid = pboid;
-
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, pboid);
-	env->buffer_data(GL_PIXEL_PACK_BUFFER,
-		store->w * store->h * store->bpp, NULL, GL_STREAM_COPY);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-
-	verbose_print("allocated %zu*%zu read-pbo",
-		(size_t) store->w, (size_t) store->h);
-}
-
 static void pbo_alloc_write(struct agp_vstore* store)
 {
 	GLuint pboid;
@@ -178,11 +185,6 @@ static void rebuild_pbo(struct agp_vstore* s)
 		env->delete_buffers(1, &s->vinf.text.wid);
 		pbo_alloc_write(s);
 	}
-
-	if (s->vinf.text.rid){
-		env->delete_buffers(1, &s->vinf.text.rid);
-		pbo_alloc_read(s);
-	}
 }
 
 static void set_pixel_store(size_t w, struct stream_meta const meta)
@@ -486,16 +488,6 @@ void agp_stream_commit(struct agp_vstore* s, struct stream_meta meta)
 {
 }
 
-static void default_release(void* tag)
-{
-	if (!tag)
-		return;
-	struct agp_fenv* env = agp_env();
-
-	env->unmap_buffer(GL_PIXEL_PACK_BUFFER);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-}
-
 void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 {
 	struct agp_fenv* env = agp_env();
@@ -510,42 +502,100 @@ void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 	agp_update_vstore(s, true);
 }
 
-void agp_request_readback(struct agp_vstore* store)
+bool agp_readback_slot_alloc(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
 {
-	if (!store || store->txmapped != TXSTATE_TEX2D)
-		return;
+	GLuint pboid;
 	struct agp_fenv* env = agp_env();
+	env->gen_buffers(1, &pboid);
+	slot->buffer = pboid;
 
-	if (!store->vinf.text.rid)
-		pbo_alloc_read(store);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, pboid);
+	env->buffer_data(GL_PIXEL_PACK_BUFFER,
+		slot->w * slot->h * sizeof(av_pixel), NULL, GL_STREAM_READ);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	verbose_print("allocated %zu*%zu read-pbo", slot->w, slot->h);
+	return true;
+}
+
+static void drop_fence(struct agp_readback_slot* slot)
+{
+	struct agp_fenv* env = agp_env();
+	if (slot->fence && env->delete_sync)
+		env->delete_sync((void*) slot->fence);
+	slot->fence = 0;
+}
+
+void agp_readback_slot_free(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	struct agp_fenv* env = agp_env();
+	GLuint pboid = slot->buffer;
+
+	drop_fence(slot);
+	env->delete_buffers(1, &pboid);
+	slot->buffer = 0;
+}
+
+bool agp_readback_slot_pack(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	struct agp_fenv* env = agp_env();
 
-	verbose_print("(%"PRIxPTR":glid %u) getTexImage2D => PBO",
-		(uintptr_t) store, (unsigned) store->vinf.text.glid);
+	verbose_print("(%"PRIxPTR":glid %u) getTexImage2D => PBO %u",
+		(uintptr_t) store, (unsigned) store->vinf.text.glid, (unsigned) slot->buffer);
 
 	env->bind_texture(GL_TEXTURE_2D, agp_resolve_texid(store));
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, store->vinf.text.rid);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
 	env->get_tex_image(GL_TEXTURE_2D, 0, GL_PIXEL_FORMAT, GL_UNSIGNED_BYTE, NULL);
 	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 	env->bind_texture(GL_TEXTURE_2D, 0);
+
+	drop_fence(slot);
+	if (env->fence_sync)
+		slot->fence = (uintptr_t)
+			env->fence_sync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	return true;
 }
 
-struct asynch_readback_meta agp_poll_readback(struct agp_vstore* store)
+bool agp_readback_slot_ready(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
 {
+/* without sync objects there is no way of knowing, map and block */
+	if (!slot->fence)
+		return true;
+
+/* the flush bit makes sure the fence itself reaches the GPU so that we don't
+ * wait forever on something that sits in the command buffer, a failed wait
+ * is treated as done and the map will block instead */
 	struct agp_fenv* env = agp_env();
-	struct asynch_readback_meta res = {
-	.release = default_release
-	};
+	GLenum rv = env->client_wait_sync(
+		(void*) slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
 
-	if (!store || store->txmapped != TXSTATE_TEX2D ||
-		store->vinf.text.rid == GL_NONE)
-		return res;
+	return rv != GL_TIMEOUT_EXPIRED;
+}
 
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, store->vinf.text.rid);
+av_pixel* agp_readback_slot_map(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	struct agp_fenv* env = agp_env();
+	drop_fence(slot);
 
-	res.w = store->w;
-	res.h = store->h;
-	res.tag = (void*) 0xdeadbeef;
-	res.ptr = (av_pixel*) env->map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_WRITE);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+	av_pixel* res = env->map_buffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+	if (!res)
+		env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
 
 	return res;
 }
+
+void agp_readback_slot_unmap(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	struct agp_fenv* env = agp_env();
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+	env->unmap_buffer(GL_PIXEL_PACK_BUFFER);
+	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+}
@@ -23,6 +23,8 @@
 #include "arcan_general.h"
 #include "arcan_video.h"
 #include "arcan_videoint.h"
+#include "glyuv.h"
+#include "readback.h"
 
 #ifdef GLES3
 #include <GLES3/gl3.h>
@@ -77,6 +79,29 @@ const char* defcfprg =
 "   gl_FragColor = vec4(obj_col.rgb, obj_opacity);\n"
 "}\n";
 
+/* the planar unpacking addresses individual bytes in 4k sources, which is
+ * past what mediump can represent exactly */
+static const char* i420fprg =
+"#version 100\n"
+"#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+"precision highp float;\n"
+"#else\n"
+"precision mediump float;\n"
+"#endif\n"
+PLANAR_SWIZZLE
+PLANAR_FPRG_BODY;
+
+static const char* nv12fprg =
+"#version 100\n"
+"#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+"precision highp float;\n"
+"#else\n"
+"precision mediump float;\n"
+"#endif\n"
+"#define NV12\n"
+PLANAR_SWIZZLE
+PLANAR_FPRG_BODY;
+
 const char * defcvprg =
 "#version 100\n"
 "precision mediump float;\n"
@@ -99,6 +124,10 @@ agp_shader_id agp_default_shader(enum SHADER_TYPES type)
 		shids[COLOR_2D] = agp_shader_build(
 			"DEFAULT_COLOR", NULL, defcvprg, defcfprg);
 		shids[BASIC_3D] = shids[BASIC_2D];
+		shids[PLANAR_I420_2D] = agp_shader_build(
+			"PLANAR_I420", NULL, defvprg, i420fprg);
+		shids[PLANAR_NV12_2D] = agp_shader_build(
+			"PLANAR_NV12", NULL, defvprg, nv12fprg);
 		defshdr_build = true;
 	}
 
@@ -203,11 +232,6 @@ void agp_readback_synchronous(struct agp_vstore* dst)
 	arcan_warning("agp(gles) - readbacks not supported\n");
 }
 
-void agp_request_readback(struct agp_vstore* store)
-{
-	arcan_warning("agp(gles) - readbacks not supported\n");
-}
-
 struct asynch_readback_meta argp_buffer_readback_asynchronous(
 	struct agp_vstore* dst, bool poll)
 {
@@ -215,25 +239,44 @@ struct asynch_readback_meta argp_buffer_readback_asynchronous(
 	return res;
 }
 
-static void default_release(void* tag)
+/* the readback ring has no backing here, see the note above */
+bool agp_readback_slot_alloc(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
 {
-#ifdef GLES3
-	if (!tag)
-		return;
-	struct agp_fenv* env = agp_env();
+	static bool warned;
+	if (!warned){
+		arcan_warning("agp(gles) - readbacks not supported\n");
+		warned = true;
+	}
+	return false;
+}
 
-	env->unmap_buffer(GL_PIXEL_PACK_BUFFER);
-	env->bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
-#endif
+void agp_readback_slot_free(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
 }
 
-struct asynch_readback_meta agp_poll_readback(struct agp_vstore* store)
+bool agp_readback_slot_pack(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
 {
-	struct asynch_readback_meta res = {
-	.release = default_release
-	};
+	return false;
+}
 
-	return res;
+bool agp_readback_slot_ready(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	return false;
+}
+
+av_pixel* agp_readback_slot_map(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	return NULL;
+}
+
+void agp_readback_slot_unmap(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
 }
 
 void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
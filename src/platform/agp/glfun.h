@@ -59,6 +59,11 @@ struct agp_fenv {
 	void (*bind_buffer) (GLenum, GLuint);
 	void* (*map_buffer) (GLenum, GLenum);
 
+/* fences (3.2 / ARB_sync), optional - GLsync is an opaque pointer */
+	void* (*fence_sync) (GLenum, GLbitfield);
+	GLenum (*client_wait_sync) (void*, GLbitfield, uint64_t);
+	void (*delete_sync) (void*);
+
 /* FBOs */
 	void (*gen_framebuffers) (GLsizei, GLuint*);
 	void (*bind_framebuffer) (GLenum, GLuint);
@@ -102,6 +102,22 @@ void agp_glinit_fenv(struct agp_fenv* dst,
 	dst->map_buffer =
 		(void*(*)(GLenum, GLenum))
 			lookup(tag, "glMapBuffer");
+
+/* without these readbacks fall back to blocking in map */
+	dst->fence_sync =
+		(void*(*)(GLenum, GLbitfield))
+			lookup_opt(tag, "glFenceSync");
+	dst->client_wait_sync =
+		(GLenum(*)(void*, GLbitfield, uint64_t))
+			lookup_opt(tag, "glClientWaitSync");
+	dst->delete_sync =
+		(void(*)(void*))
+			lookup_opt(tag, "glDeleteSync");
+	if (!dst->fence_sync || !dst->client_wait_sync || !dst->delete_sync){
+		dst->fence_sync = NULL;
+		dst->client_wait_sync = NULL;
+		dst->delete_sync = NULL;
+	}
 #endif
 /* FBOs */
 	dst->gen_framebuffers =
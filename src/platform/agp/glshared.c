@@ -1197,10 +1197,7 @@ void agp_null_vstore(struct agp_vstore* store)
 	store->vinf.text.glid_proxy = NULL;
 
 /* null out any pending PBOs as well, those get re-allocated on demand */
-	if (GL_NONE != store->vinf.text.rid){
-		env->delete_buffers(1, &store->vinf.text.rid);
-		store->vinf.text.rid = GL_NONE;
-	}
+	agp_readback_drop(store, false);
 
 #ifndef GLES2
 	if (GL_NONE != store->vinf.text.wid){
@@ -1745,7 +1742,11 @@ static void setup_transfer(struct agp_mesh_store* base, enum agp_mesh_flags fl)
 
 void agp_drop_vstore(struct agp_vstore* s)
 {
-	if (!s || s->vinf.text.glid == GL_NONE)
+	if (!s)
+		return;
+
+	agp_readback_drop(s, true);
+	if (s->vinf.text.glid == GL_NONE)
 		return;
 	struct agp_fenv* env = agp_env();
 
@@ -1775,11 +1776,6 @@ void agp_drop_vstore(struct agp_vstore* s)
 	env->delete_textures(1, &s->vinf.text.glid);
 	s->vinf.text.glid = GL_NONE;
 
-	if (GL_NONE != s->vinf.text.rid){
-		env->delete_buffers(1, &s->vinf.text.rid);
-		s->vinf.text.rid = GL_NONE;
-	}
-
 #ifndef GLES2
 	if (GL_NONE != s->vinf.text.wid){
 		env->delete_buffers(1, &s->vinf.text.wid);
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2024, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Fragment program body for the builtin planar YUV shaders.
+ *
+ * The store for a planar (I420 or NV12) source is the raw frame uploaded
+ * as-is into a packed 8-bit RGBA texture that is (w / 4) * (h * 3 / 2)
+ * texels, with the luma plane first followed by the chroma plane(s) in the
+ * normal contiguous layout. The source dimensions are recovered from the
+ * storage size, which requires w % 8 == 0 and h % 4 == 0 (checked when the
+ * store is set up). As the packed texels can't be interpolated by the
+ * sampler, the store is set to nearest filtering and bilinear filtering is
+ * done here per plane instead.
+ *
+ * Prefix with the version/precision header, a BYTES(c) swizzle that maps
+ * a sampled texel back to memory byte order, and NV12 defined for the
+ * interleaved chroma variant.
+ */
+#ifndef HAVE_GLYUV
+#define HAVE_GLYUV
+
+#if GL_PIXEL_FORMAT == 0x80E1
+#define PLANAR_SWIZZLE "#define BYTES(c) c.bgra\n"
+#else
+#define PLANAR_SWIZZLE "#define BYTES(c) c.rgba\n"
+#endif
+
+#define PLANAR_FPRG_BODY \
+"uniform sampler2D map_diffuse;\n"\
+"uniform vec2 obj_storage_sz;\n"\
+"uniform float obj_opacity;\n"\
+"varying vec2 texco;\n"\
+\
+"float fetch(vec2 p){\n"\
+"	float tx = floor(p.x * 0.25);\n"\
+"	vec4 c = texture2D(map_diffuse, (vec2(tx, p.y) + 0.5) / obj_storage_sz);\n"\
+"	return dot(BYTES(c),\n"\
+"		vec4(equal(vec4(p.x - tx * 4.0), vec4(0.0, 1.0, 2.0, 3.0))));\n"\
+"}\n"\
+\
+"vec2 fetch_uv(vec2 p, vec2 sz){\n"\
+"#ifdef NV12\n"\
+"	float row = sz.y + p.y;\n"\
+"	return vec2(fetch(vec2(p.x * 2.0, row)), fetch(vec2(p.x * 2.0 + 1.0, row)));\n"\
+"#else\n"\
+"	vec2 u = vec2(mod(p.y, 2.0) * sz.x * 0.5 + p.x, sz.y + floor(p.y * 0.5));\n"\
+"	return vec2(fetch(u), fetch(u + vec2(0.0, sz.y * 0.25)));\n"\
+"#endif\n"\
+"}\n"\
+\
+"float luma(vec2 sz){\n"\
+"	vec2 p = texco * sz - 0.5;\n"\
+"	vec2 f = fract(p);\n"\
+"	vec2 a = clamp(floor(p), vec2(0.0), sz - 1.0);\n"\
+"	vec2 b = clamp(floor(p) + 1.0, vec2(0.0), sz - 1.0);\n"\
+"	return mix(\n"\
+"		mix(fetch(a), fetch(vec2(b.x, a.y)), f.x),\n"\
+"		mix(fetch(vec2(a.x, b.y)), fetch(b), f.x), f.y);\n"\
+"}\n"\
+\
+"vec2 chroma(vec2 sz){\n"\
+"	vec2 csz = sz * 0.5;\n"\
+"	vec2 p = texco * csz - 0.5;\n"\
+"	vec2 f = fract(p);\n"\
+"	vec2 a = clamp(floor(p), vec2(0.0), csz - 1.0);\n"\
+"	vec2 b = clamp(floor(p) + 1.0, vec2(0.0), csz - 1.0);\n"\
+"	return mix(\n"\
+"		mix(fetch_uv(a, sz), fetch_uv(vec2(b.x, a.y), sz), f.x),\n"\
+"		mix(fetch_uv(vec2(a.x, b.y), sz), fetch_uv(b, sz), f.x), f.y);\n"\
+"}\n"\
+\
+"void main(){\n"\
+"	vec2 sz = vec2(obj_storage_sz.x * 4.0, floor(obj_storage_sz.y / 1.5 + 0.5));\n"\
+"	float y = 1.1644 * (luma(sz) - 0.0627);\n"\
+"	vec2 uv = chroma(sz) - 0.502;\n"\
+"	vec3 col;\n"\
+"	if (sz.y >= 720.0)\n"\
+"		col = vec3(y + 1.7927 * uv.y,\n"\
+"			y - 0.2132 * uv.x - 0.5329 * uv.y, y + 2.1124 * uv.x);\n"\
+"	else\n"\
+"		col = vec3(y + 1.5960 * uv.y,\n"\
+"			y - 0.3918 * uv.x - 0.8130 * uv.y, y + 2.0172 * uv.x);\n"\
+"	gl_FragColor = vec4(clamp(col, 0.0, 1.0), obj_opacity);\n"\
+"}\n"
+
+#endif
@@ -0,0 +1,195 @@
+/*
+ * Copyright 2024, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Shared readback ring management, see readback.h
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../platform_types.h"
+#include "../video_platform.h"
+#include "../platform.h"
+
+#include "readback.h"
+
+/* same clock as arcan_timemicros, which isn't there when the AGP sources are
+ * built into shmif-ext */
+static uint64_t now_us()
+{
+	struct timespec tp;
+	clock_gettime(CLOCK_MONOTONIC, &tp);
+	return (uint64_t) tp.tv_sec * 1000000 + tp.tv_nsec / 1000;
+}
+
+static struct agp_readback* get_ring(struct agp_vstore* store, bool alloc)
+{
+/* vinf is only the text form for these */
+	if (store->txmapped != TXSTATE_TEX2D)
+		return NULL;
+
+	if (store->vinf.text.readback || !alloc)
+		return store->vinf.text.readback;
+
+	struct agp_readback* rb = malloc(sizeof(struct agp_readback));
+	if (!rb)
+		return NULL;
+
+	*rb = (struct agp_readback){
+		.store = store,
+		.n = 1
+	};
+	store->vinf.text.readback = rb;
+	return rb;
+}
+
+static void consume(struct agp_readback* rb)
+{
+	rb->head = (rb->head + 1) % rb->n;
+	rb->pending--;
+}
+
+static void release(void* tag)
+{
+	struct agp_readback* rb = tag;
+	if (!rb || !rb->mapped)
+		return;
+
+	agp_readback_slot_unmap(rb->store, &rb->slots[rb->head]);
+	rb->mapped = false;
+	consume(rb);
+}
+
+bool agp_request_readback(struct agp_vstore* store)
+{
+	if (!store)
+		return false;
+
+	struct agp_readback* rb = get_ring(store, true);
+	if (!rb || rb->pending >= rb->n)
+		return false;
+
+	struct agp_readback_slot* slot = &rb->slots[(rb->head + rb->pending) % rb->n];
+
+/* the store might have been resized since the slot was last used, the pending
+ * ones keep their old dimensions and are delivered as such */
+	if (slot->buffer && (slot->w != store->w || slot->h != store->h))
+		agp_readback_slot_free(store, slot);
+
+	if (!slot->buffer){
+		slot->w = store->w;
+		slot->h = store->h;
+		if (!agp_readback_slot_alloc(store, slot)){
+			*slot = (struct agp_readback_slot){0};
+			return false;
+		}
+	}
+
+	if (!agp_readback_slot_pack(store, slot))
+		return false;
+
+	slot->requested = now_us();
+	rb->pending++;
+	return true;
+}
+
+struct asynch_readback_meta agp_poll_readback(struct agp_vstore* store)
+{
+	struct asynch_readback_meta res = {
+		.release = release
+	};
+
+	struct agp_readback* rb = store ? get_ring(store, false) : NULL;
+	if (!rb || !rb->pending || rb->mapped)
+		return res;
+
+/* fences signal in submission order so only the oldest needs checking */
+	struct agp_readback_slot* slot = &rb->slots[rb->head];
+	if (!agp_readback_slot_ready(store, slot))
+		return res;
+
+	res.ptr = agp_readback_slot_map(store, slot);
+	if (!res.ptr){
+		consume(rb);
+		return res;
+	}
+
+	rb->mapped = true;
+	res.w = slot->w;
+	res.h = slot->h;
+	res.stride = slot->w * sizeof(av_pixel);
+	res.buf_sz = res.stride * slot->h;
+	res.requested = slot->requested;
+	res.tag = rb;
+
+	return res;
+}
+
+void agp_readback_buffers(struct agp_vstore* store, size_t n)
+{
+	if (!store)
+		return;
+
+	if (n < 1)
+		n = 1;
+	else if (n > AGP_READBACK_MAX)
+		n = AGP_READBACK_MAX;
+
+	struct agp_readback* rb = get_ring(store, n > 1);
+	if (!rb || rb->n == n || rb->mapped)
+		return;
+
+/* rotate the pending slots to the front so the ring order survives the change
+ * in modulo, if they don't fit the newest ones are discarded */
+	struct agp_readback_slot tmp[AGP_READBACK_MAX];
+	for (size_t i = 0; i < rb->n; i++)
+		tmp[i] = rb->slots[(rb->head + i) % rb->n];
+	memcpy(rb->slots, tmp, sizeof(struct agp_readback_slot) * rb->n);
+	rb->head = 0;
+
+	if (rb->pending > n)
+		rb->pending = n;
+
+	for (size_t i = n; i < AGP_READBACK_MAX; i++){
+		if (rb->slots[i].buffer)
+			agp_readback_slot_free(store, &rb->slots[i]);
+		rb->slots[i] = (struct agp_readback_slot){0};
+	}
+
+	rb->n = n;
+}
+
+size_t agp_readback_pending(struct agp_vstore* store)
+{
+	struct agp_readback* rb = store ? get_ring(store, false) : NULL;
+	return rb ? rb->pending : 0;
+}
+
+void agp_readback_drop(struct agp_vstore* store, bool full)
+{
+	struct agp_readback* rb = store ? get_ring(store, false) : NULL;
+	if (!rb)
+		return;
+
+	if (rb->mapped)
+		agp_readback_slot_unmap(store, &rb->slots[rb->head]);
+
+	for (size_t i = 0; i < AGP_READBACK_MAX; i++){
+		if (rb->slots[i].buffer)
+			agp_readback_slot_free(store, &rb->slots[i]);
+		rb->slots[i] = (struct agp_readback_slot){0};
+	}
+
+	rb->head = rb->pending = 0;
+	rb->mapped = false;
+
+	if (full){
+		free(rb);
+		store->vinf.text.readback = NULL;
+	}
+}
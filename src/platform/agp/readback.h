@@ -0,0 +1,82 @@
+/*
+ * Copyright 2024, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Ring of asynchronous readback buffers per vstore.
+ *
+ * agp_request_readback packs the current contents of the store into the next
+ * free slot and tags it with a fence, agp_poll_readback checks the fence of
+ * the oldest slot and maps it when signalled. With more than one slot the copy
+ * for one frame can be in flight while the next is being rendered, instead of
+ * the mapping stalling on the transfer or the request being dropped.
+ *
+ * The ring itself (readback.c) is shared, the slot storage and the fences are
+ * provided by each AGP implementation through the agp_readback_slot_ hooks.
+ */
+#ifndef HAVE_AGP_READBACK
+#define HAVE_AGP_READBACK
+
+struct agp_readback_slot {
+/* backend handle to the storage (PBO id, host buffer, ...) and its size */
+	uintptr_t buffer;
+	size_t w, h;
+
+/* backend fence for the pending pack, 0 if none */
+	uintptr_t fence;
+
+/* arcan_timemicros() at request */
+	uint64_t requested;
+};
+
+struct agp_readback {
+	struct agp_vstore* store;
+
+/* configured ring size, slots beyond it are freed as they come free */
+	size_t n;
+
+/* oldest pending slot and the number of pending ones from there */
+	size_t head;
+	size_t pending;
+
+/* set between a successful poll and the matching release */
+	bool mapped;
+
+	struct agp_readback_slot slots[AGP_READBACK_MAX];
+};
+
+/*
+ * Allocate storage for [slot] that fits the current dimensions of [store],
+ * return false if readbacks are not possible.
+ */
+bool agp_readback_slot_alloc(
+	struct agp_vstore* store, struct agp_readback_slot* slot);
+
+/*
+ * Release the storage and any pending fence of [slot].
+ */
+void agp_readback_slot_free(
+	struct agp_vstore* store, struct agp_readback_slot* slot);
+
+/*
+ * Queue a copy of the contents of [store] into [slot] and set slot->fence.
+ */
+bool agp_readback_slot_pack(
+	struct agp_vstore* store, struct agp_readback_slot* slot);
+
+/*
+ * Non-blocking check if the copy queued by pack has completed.
+ */
+bool agp_readback_slot_ready(
+	struct agp_vstore* store, struct agp_readback_slot* slot);
+
+/*
+ * Map / unmap the slot contents for reading. Only one slot per store is
+ * mapped at any one time.
+ */
+av_pixel* agp_readback_slot_map(
+	struct agp_vstore* store, struct agp_readback_slot* slot);
+
+void agp_readback_slot_unmap(
+	struct agp_vstore* store, struct agp_readback_slot* slot);
+
+#endif
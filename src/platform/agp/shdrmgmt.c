@@ -144,6 +144,23 @@ struct shaderv {
 	struct shaderv* next;
 };
 
+/*
+ * Shadow of the value last uploaded to a uniform location in a program, as
+ * uniform state is per program object this lets group switches and repeated
+ * forceunif calls skip values that are already there.
+ */
+struct shadowv {
+	bool valid;
+	enum shdrutype type;
+	uint8_t data[64];
+};
+
+/* locations are normally packed from 0, anything beyond this goes uncached */
+#define SHADOW_LIMIT 1024
+
+/* env_gen value for 'never uploaded' */
+#define GEN_NONE UINT64_MAX
+
 /*
  * SLOTS allocation is terrible; we should replace this with a more
  * normal grow-by-n.
@@ -158,6 +175,13 @@ struct shader_cont {
 /* match attrsymtbl */
 	GLint attributes[9];
 
+/* generation of each environment value the program was last given */
+	uint64_t env_gen[sizeof(ofstbl) / sizeof(ofstbl[0])];
+
+/* indexed by uniform location */
+	struct shadowv* shadow;
+	size_t shadow_sz;
+
 	struct arcan_strarr ugroups;
 };
 
@@ -176,6 +200,12 @@ static struct {
 	size_t ofs;
 	agp_shader_id active_prg;
 	struct shader_envts context;
+
+/* bumped whenever the matching context value changes */
+	uint64_t gen[TBLSIZE];
+	uint64_t gen_counter;
+
+	struct agp_shader_stats stats;
 	char guard;
 } shdr_global = {.active_prg = BROKEN_SHADER, .guard = 64};
 
@@ -223,6 +253,106 @@ static void setv(GLint loc, enum shdrutype kind, void* val,
 	}
 }
 
+static struct shadowv* shadow_get(struct shader_cont* cur, GLint loc)
+{
+	if (loc < 0 || loc >= SHADOW_LIMIT)
+		return NULL;
+
+	if ((size_t) loc >= cur->shadow_sz){
+		size_t new_sz = cur->shadow_sz ? cur->shadow_sz : 16;
+		while (new_sz <= (size_t) loc)
+			new_sz <<= 1;
+
+		struct shadowv* new = realloc(cur->shadow, new_sz * sizeof(struct shadowv));
+		if (!new)
+			return NULL;
+
+		memset(&new[cur->shadow_sz], '\0',
+			(new_sz - cur->shadow_sz) * sizeof(struct shadowv));
+		cur->shadow = new;
+		cur->shadow_sz = new_sz;
+	}
+
+	return &cur->shadow[loc];
+}
+
+/* forget everything the program is believed to hold, for (re-)link */
+static void reset_cache(struct shader_cont* cur)
+{
+	for (size_t i = 0; i < TBLSIZE; i++)
+		cur->env_gen[i] = GEN_NONE;
+
+	free(cur->shadow);
+	cur->shadow = NULL;
+	cur->shadow_sz = 0;
+}
+
+/*
+ * Upload environment value [i] to [cur] (the bound program) unless it already
+ * has the current generation of it.
+ */
+static void set_envslot(struct shader_cont* cur, size_t i)
+{
+	GLint loc = cur->locations[i];
+	if (loc < 0)
+		return;
+
+	if (cur->env_gen[i] == shdr_global.gen[i]){
+		shdr_global.stats.skipped++;
+		return;
+	}
+
+	setv(loc, typetbl[i],
+		(char*)(&shdr_global.context) + ofstbl[i], symtbl[i], cur->label);
+	cur->env_gen[i] = shdr_global.gen[i];
+	shdr_global.stats.issued++;
+	counttbl[i]++;
+
+/* a custom uniform might alias the same name and location */
+	if ((size_t) loc < cur->shadow_sz)
+		cur->shadow[loc].valid = false;
+}
+
+/*
+ * Upload a custom (group) uniform to [cur] (the bound program) unless the
+ * location already holds the same value.
+ */
+static void set_custom(struct shader_cont* cur,
+	GLint loc, enum shdrutype type, void* val, const char* label)
+{
+	if (loc < 0)
+		return;
+
+	struct shadowv* sv = shadow_get(cur, loc);
+	if (sv && sv->valid && sv->type == type &&
+		memcmp(sv->data, val, sizetbl[type]) == 0){
+		shdr_global.stats.skipped++;
+		return;
+	}
+
+	setv(loc, type, val, label, cur->label);
+	shdr_global.stats.issued++;
+
+	if (sv){
+		sv->valid = true;
+		sv->type = type;
+		memcpy(sv->data, val, sizetbl[type]);
+	}
+
+	for (size_t i = 0; i < TBLSIZE; i++)
+		if (cur->locations[i] == loc)
+			cur->env_gen[i] = GEN_NONE;
+}
+
+void agp_shader_stats(struct agp_shader_stats* out, bool reset)
+{
+	if (out)
+		*out = shdr_global.stats;
+
+	if (reset)
+		shdr_global.stats = (struct agp_shader_stats){0};
+}
+
 static void destroy_shader(struct shader_cont* cur)
 {
 	if (!cur->label)
@@ -250,6 +380,7 @@ static void destroy_shader(struct shader_cont* cur)
  * arcan_mem_freearr here as that would be a double-free, just free
  * the array */
 	arcan_mem_free(cur->ugroups.data);
+	free(cur->shadow);
 	memset(cur, 0, sizeof(struct shader_cont));
 }
 
@@ -259,7 +390,9 @@ bool agp_shader_destroy(agp_shader_id shid)
 	if (!agp_shader_valid(shid) ||
 		shid == agp_default_shader(BASIC_2D) ||
 		shid == agp_default_shader(BASIC_3D) ||
-		shid == agp_default_shader(COLOR_2D))
+		shid == agp_default_shader(COLOR_2D) ||
+		shid == agp_default_shader(PLANAR_I420_2D) ||
+		shid == agp_default_shader(PLANAR_NV12_2D))
 		return false;
 
 	struct shader_cont* cur = &shdr_global.slots[SHADER_INDEX(shid)];
@@ -313,18 +446,12 @@ int agp_shader_activate(agp_shader_id shid)
 #endif
 
 /*
- * While we chould practically just update the uniforms that has actually
- * changed since the last push as we keep a cache, the incentive is rather
- * small (uniform- set on a bound shader is among the cheaper state changes
- * possible).
+ * Only push the environment values that have changed since the program last
+ * had them, with many objects sharing a few shaders most of these are the
+ * same from one activation to the next.
  */
-		for (size_t i = 0; i < sizeof(ofstbl) / sizeof(ofstbl[0]); i++){
-			if (cur->locations[i] >= 0){
-				setv(cur->locations[i], typetbl[i], (char*)(&shdr_global.context)
-					+ ofstbl[i], symtbl[i], cur->label);
-				counttbl[i]++;
-			}
-		}
+		for (size_t i = 0; i < sizeof(ofstbl) / sizeof(ofstbl[0]); i++)
+			set_envslot(cur, i);
 
 /* activate any persistant values */
 		if (cur->ugroups.limit < GROUP_INDEX(shid)){
@@ -335,8 +462,8 @@ int agp_shader_activate(agp_shader_id shid)
 		struct shaderv* current = cur->ugroups.cdata[GROUP_INDEX(shid)];
 
 		while (current){
-			setv(current->loc, current->type, (void*) current->data,
-				current->label, cur->label);
+			set_custom(cur, current->loc, current->type,
+				(void*) current->data, current->label);
 			current = current->next;
 		}
 	}
@@ -459,6 +586,7 @@ agp_shader_id agp_shader_build(const char* tag,
 /* reset everything to NULL */
 		}
 		arcan_mem_free(cur->ugroups.data);
+		free(cur->shadow);
 		*cur = (struct shader_cont){};
 	}
 
@@ -466,6 +594,7 @@ agp_shader_id agp_shader_build(const char* tag,
 	int global_lim = sizeof(ofstbl) / sizeof(ofstbl[0]);
 	for (int i = 0; i < global_lim; i++)
 		cur->locations[i] = -1;
+	reset_cache(cur);
 
 	if (build_shader(tag, &cur->prg_container, &cur->obj_vertex,
 		&cur->obj_fragment, vert, frag) == false)
@@ -518,28 +647,24 @@ agp_shader_id agp_shader_build(const char* tag,
 
 int agp_shader_envv(enum agp_shader_envts slot, void* value, size_t size)
 {
-	memcpy((char*) (&shdr_global.context) + ofstbl[slot], value, size);
+	char* dst = (char*) (&shdr_global.context) + ofstbl[slot];
+	if (memcmp(dst, value, size) != 0){
+		memcpy(dst, value, size);
+		shdr_global.gen[slot] = ++shdr_global.gen_counter;
+	}
+
 	int rv = counttbl[slot];
 	counttbl[slot] = 0;
 
 	if (BROKEN_SHADER == shdr_global.active_prg)
 		return rv;
 
-	int glloc = shdr_global.slots[
-		SHADER_INDEX(shdr_global.active_prg)].locations[slot];
-
 /*
  * reflect change in current active shader, the others will be changed on
  * activation
  */
-	if (glloc != -1){
-		assert(size == sizetbl[ typetbl[slot] ]);
-		setv(glloc, typetbl[slot], value, symtbl[slot],
-			shdr_global.slots[SHADER_INDEX(shdr_global.active_prg)].label );
-		counttbl[slot]++;
-
-		return rv;
-	}
+	assert(size == sizetbl[ typetbl[slot] ]);
+	set_envslot(&shdr_global.slots[SHADER_INDEX(shdr_global.active_prg)], slot);
 
 	return rv;
 }
@@ -639,7 +764,7 @@ void agp_shader_forceunif(const char* label, enum shdrutype type, void* value)
 	memcpy((*current)->data, value, sizetbl[type]);
 
 	if (loc >= 0){
-		setv(loc, type, value, label, slot->label);
+		set_custom(slot, loc, type, value, label);
 	}
 #ifdef DEBUG
 	else
@@ -798,5 +923,6 @@ void agp_shader_rebuild_all()
 			cur->vertex,
 			cur->fragment
 		);
+		reset_cache(cur);
 	}
 }
@@ -1,3 +1,4 @@
+/*
  * License: 3-Clause BSD, see COPYING file in arcan source repository.
  * Reference: http://arcan-fe.com
  */
@@ -18,6 +19,8 @@
 #include "arcan_video.h"
 #include "arcan_videoint.h"
 
+#include "readback.h"
+
 agp_shader_id agp_default_shader(enum SHADER_TYPES type)
 {
 	return 1;
@@ -52,7 +55,10 @@ void agp_shader_source(enum SHADER_TYPES type,
 
 const char** agp_envopts()
 {
-	static const char* env[] = {NULL};
+	static const char* env[] = {
+		"ARCAN_GRAPHICS_READBACK_DELAY=ms", "completion time for simulated asynch readbacks",
+		NULL
+	};
 	return env;
 }
 
@@ -62,6 +68,7 @@ void agp_readback_synchronous(struct agp_vstore* dst)
 
 void agp_drop_vstore(struct agp_vstore* s)
 {
+	agp_readback_drop(s, true);
 }
 
 struct stream_meta agp_stream_prepare(struct agp_vstore* s,
@@ -83,14 +90,75 @@ void agp_resize_vstore(struct agp_vstore* s, size_t w, size_t h)
 {
 }
 
-void agp_request_readback(struct agp_vstore* s)
+/*
+ * Readbacks are simulated with host memory slots that copy the raw store
+ * contents, if any, and a 'fence' that is the time the copy is considered
+ * complete. This lets the readback path be exercised headless with
+ * graphics_readback_delay standing in for the GPU transfer.
+ */
+static uint64_t readback_delay()
+{
+	static bool got_delay;
+	static uint64_t delay;
+
+	if (!got_delay){
+		uintptr_t tag;
+		char* val;
+		cfg_lookup_fun get_config = platform_config_lookup(&tag);
+		if (get_config("graphics_readback_delay", 0, &val, tag) && val){
+			delay = strtoul(val, NULL, 10);
+			free(val);
+		}
+		got_delay = true;
+	}
+
+	return delay;
+}
+
+bool agp_readback_slot_alloc(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	slot->buffer = (uintptr_t) malloc(slot->w * slot->h * sizeof(av_pixel));
+	return slot->buffer != 0;
+}
+
+void agp_readback_slot_free(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	free((void*) slot->buffer);
+	slot->buffer = 0;
+	slot->fence = 0;
+}
+
+bool agp_readback_slot_pack(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	size_t sz = slot->w * slot->h * sizeof(av_pixel);
+	if (store->vinf.text.raw && store->vinf.text.s_raw >= sz)
+		memcpy((void*) slot->buffer, store->vinf.text.raw, sz);
+	else
+		memset((void*) slot->buffer, '\0', sz);
+
+	slot->fence = arcan_timemillis() + readback_delay();
+	return true;
+}
+
+bool agp_readback_slot_ready(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
+{
+	return (uint64_t) arcan_timemillis() >= slot->fence;
+}
+
+av_pixel* agp_readback_slot_map(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
 {
+	slot->fence = 0;
+	return (av_pixel*) slot->buffer;
 }
 
-struct asynch_readback_meta agp_poll_readback(struct agp_vstore* t)
+void agp_readback_slot_unmap(
+	struct agp_vstore* store, struct agp_readback_slot* slot)
 {
-	struct asynch_readback_meta res = {0};
-	return res;
 }
 
 void agp_empty_vstore(struct agp_vstore* vs, size_t w, size_t h)
@@ -130,6 +198,7 @@ void agp_pipeline_hint(enum pipeline_mode mode)
 
 void agp_null_vstore(struct agp_vstore* store)
 {
+	agp_readback_drop(store, false);
 }
 
 void agp_resize_rendertarget(
@@ -143,7 +212,7 @@ void agp_activate_vstore_multi(struct agp_vstore** backing, size_t n)
 
 void agp_update_vstore(struct agp_vstore* s, bool copy)
 {
-	FLAG_DIRTY();
+	FLAG_DIRTY(NULL);
 }
 
 void agp_prepare_stencil()
@@ -227,6 +296,12 @@ void agp_shader_forceunif(const char* label, enum shdrutype type, void* val)
 {
 }
 
+void agp_shader_stats(struct agp_shader_stats* out, bool reset)
+{
+	if (out)
+		*out = (struct agp_shader_stats){0};
+}
+
 agp_shader_id agp_shader_lookup(const char* tag)
 {
 	return BROKEN_SHADER;
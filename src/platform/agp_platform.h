@@ -43,11 +43,14 @@ typedef uint32_t agp_shader_id;
  * Retrieve the default shader for a specific purpose,
  * BASIC_2D => single textured, alpha in obj_opacity
  * COLOR_2D => not textured, color channel in uniforms
+ * PLANAR_I420_2D, PLANAR_NV12_2D => BASIC_2D for a packed planar YUV store
  */
 enum SHADER_TYPES {
 	BASIC_2D = 0,
 	COLOR_2D,
 	BASIC_3D,
+	PLANAR_I420_2D,
+	PLANAR_NV12_2D,
 	SHADER_TYPE_ENDM
 };
 agp_shader_id agp_default_shader(enum SHADER_TYPES);
@@ -285,22 +288,55 @@ struct asynch_readback_meta {
 	size_t h;
 	size_t stride;
 
+/* arcan_timemicros() when the readback was requested */
+	uint64_t requested;
+
 	void (*release)(void* tag);
 	void* tag;
 };
 
 /*
- * Check if a pending readback request has been completed.
+ * Upper bound on the number of readbacks that can be in flight for the
+ * same store, see agp_readback_buffers.
+ */
+#ifndef AGP_READBACK_MAX
+#define AGP_READBACK_MAX 8
+#endif
+
+/*
+ * Check if the oldest pending readback request has been completed.
  * In that case, [meta.ptr] will be !NULL and the caller is expected to:
  * meta.release(meta.tag); when finished using the contents of [meta.ptr]
+ * before polling again. Completed readbacks are returned in the order they
+ * were requested.
  */
 struct asynch_readback_meta agp_poll_readback(struct agp_vstore*);
 
 /*
- * Initiate a new asynchronous readback.
- * if one is already pending, this is a no-operation.
+ * Initiate a new asynchronous readback. Returns false if the request could
+ * not be queued, i.e. all readback buffers for the store are still pending
+ * or the platform lacks support.
+ */
+bool agp_request_readback(struct agp_vstore*);
+
+/*
+ * Set the number of buffers (1..AGP_READBACK_MAX) that readbacks for the
+ * store rotate between, letting the transfer of one frame overlap with the
+ * rendering of the next ones. Default is 1. Pending readbacks are kept.
+ */
+void agp_readback_buffers(struct agp_vstore*, size_t n);
+
+/*
+ * Number of readback requests that are still in flight or waiting to be
+ * collected through agp_poll_readback.
+ */
+size_t agp_readback_pending(struct agp_vstore*);
+
+/*
+ * Release all readback buffers, pending readbacks are discarded. If [full]
+ * is set the buffer count configuration is reset as well.
  */
-void agp_request_readback(struct agp_vstore*);
+void agp_readback_drop(struct agp_vstore*, bool full);
 
 /*
  * For clipping and similar operations where we want to
@@ -667,6 +703,17 @@ void agp_vstore_copyreg(
  */
 void agp_shader_forceunif(const char* label, enum shdrutype type, void* value);
 
+/*
+ * Uniform uploads that were issued to the graphics layer and those that were
+ * skipped as the program already had the value, either through envv,
+ * forceunif or shader activation. Accumulated until read with [reset] set.
+ */
+struct agp_shader_stats {
+	uint64_t issued;
+	uint64_t skipped;
+};
+void agp_shader_stats(struct agp_shader_stats* out, bool reset);
+
 struct agp_render_options {
 	int line_width;
 };
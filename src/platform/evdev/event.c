@@ -16,6 +16,9 @@
 #include <errno.h>
 #include <poll.h>
 #include <glob.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include <sys/types.h>
 #include <sys/param.h>
@@ -91,6 +94,50 @@ gstate = {
 	.notify = -1,
 };
 
+/*
+ * With event_input_thread set, the device nodes, inotify and the EACCES retry
+ * queue are serviced from a separate thread that blocks in poll instead of
+ * being sampled once per conductor pass. Translated events go through a
+ * single producer, single consumer ring that platform_event_process drains.
+ *
+ * The lock covers iodev/gstate and is taken by the public entry points that
+ * touch them. It is recursive as got_device calls back into the translation
+ * entry point.
+ */
+#define INPUT_RING_SZ 512
+
+/* slots at the end of the ring that relative motion may not use, so that a
+ * burst of motion can not crowd out buttons and keys */
+#define INPUT_RING_RESERVE 64
+
+static struct {
+	bool active;
+	pthread_t pth;
+	pthread_mutex_t lock;
+	int wakeup[2];
+	_Atomic bool quit;
+	struct arcan_evctx* ctx;
+
+	_Atomic size_t head, tail;
+	_Atomic size_t dropped;
+	arcan_event ring[INPUT_RING_SZ];
+
+/* relative mouse motion is held back until the end of the current batch, or
+ * until something else arrives, and merged per axis in the meanwhile */
+	bool motion_pending[2];
+	arcan_event motion[2];
+
+/* releases that did not fit are held here in order and go into the ring
+ * first when the consumer has caught up, they are never dropped as that
+ * would leave a key or button stuck */
+	arcan_event* backlog;
+	size_t backlog_used, backlog_sz;
+} ithread = {
+	.wakeup = {-1, -1}
+};
+
+static _Thread_local bool in_ithread;
+
 static const char* envopts[] = {
 	"scandir=path/to/folder", "Directory to monitor for device node hotplug "
 		"(Default: "NOTIFY_SCAN_DIR")",
@@ -99,6 +146,7 @@ static const char* envopts[] = {
 	"evdev_keyboard=label", "Force device matching 'label' as a keyboard",
 	"evdev_game=label", "Force device matching 'label' as a game device",
 	"evdev_mouse=label", "Force device matching 'label' as a mouse",
+	"input_thread", "Read and translate device input on a separate thread",
 #ifdef HAVE_XKBCOMMON
 	"", "",
 	"[XKB db keys]", "(libkbcommon specific, no ARCAN_ env prefix)",
@@ -219,6 +267,147 @@ struct devnode {
 
 static void got_device(struct arcan_evctx* ctx, int fd, const char*);
 
+static void lock_iodev()
+{
+	if (ithread.active)
+		pthread_mutex_lock(&ithread.lock);
+}
+
+static void unlock_iodev()
+{
+	if (ithread.active)
+		pthread_mutex_unlock(&ithread.lock);
+}
+
+static uint64_t input_ts(struct input_event* ev)
+{
+#ifdef input_event_sec
+	return (uint64_t) ev->input_event_sec * 1000 + ev->input_event_usec / 1000;
+#else
+	return (uint64_t) ev->time.tv_sec * 1000 + ev->time.tv_usec / 1000;
+#endif
+}
+
+static bool is_release(arcan_event* ev)
+{
+	switch (ev->io.datatype){
+	case EVENT_IDATATYPE_DIGITAL:
+		return !ev->io.input.digital.active;
+	case EVENT_IDATATYPE_TRANSLATED:
+		return !ev->io.input.translated.active;
+	case EVENT_IDATATYPE_TOUCH:
+		return !ev->io.input.touch.active;
+	default:
+		return false;
+	}
+}
+
+static bool ring_put(arcan_event* ev, size_t lim)
+{
+	size_t head = atomic_load_explicit(&ithread.head, memory_order_relaxed);
+	size_t tail = atomic_load_explicit(&ithread.tail, memory_order_acquire);
+
+	if (head - tail >= lim)
+		return false;
+
+	ithread.ring[head % INPUT_RING_SZ] = *ev;
+	atomic_store_explicit(&ithread.head, head + 1, memory_order_release);
+	return true;
+}
+
+static void flush_backlog()
+{
+	size_t i = 0;
+	while (i < ithread.backlog_used && ring_put(&ithread.backlog[i], INPUT_RING_SZ))
+		i++;
+
+	memmove(ithread.backlog, &ithread.backlog[i],
+		sizeof(arcan_event) * (ithread.backlog_used - i));
+	ithread.backlog_used -= i;
+}
+
+static void ring_push(arcan_event* ev, bool motion)
+{
+	flush_backlog();
+
+/* anything after a held back release has to wait behind it to keep the order,
+ * only releases are worth keeping until then */
+	if (!ithread.backlog_used &&
+		ring_put(ev, motion ? INPUT_RING_SZ - INPUT_RING_RESERVE : INPUT_RING_SZ))
+		return;
+
+	if (!is_release(ev)){
+		atomic_fetch_add(&ithread.dropped, 1);
+		return;
+	}
+
+	if (ithread.backlog_used == ithread.backlog_sz){
+		size_t nsz = ithread.backlog_sz ? ithread.backlog_sz * 2 : 32;
+		arcan_event* nb = realloc(ithread.backlog, sizeof(arcan_event) * nsz);
+		if (!nb){
+			atomic_fetch_add(&ithread.dropped, 1);
+			return;
+		}
+		ithread.backlog = nb;
+		ithread.backlog_sz = nsz;
+	}
+
+	ithread.backlog[ithread.backlog_used++] = *ev;
+}
+
+static void flush_motion()
+{
+	for (size_t i = 0; i < 2; i++)
+		if (ithread.motion_pending[i]){
+			ring_push(&ithread.motion[i], true);
+			ithread.motion_pending[i] = false;
+		}
+}
+
+static void coalesce_motion(arcan_event* ev)
+{
+	size_t ind = ev->io.subid & 1;
+	arcan_event* dst = &ithread.motion[ind];
+
+	if (ithread.motion_pending[ind] && dst->io.devid != ev->io.devid)
+		flush_motion();
+
+	if (!ithread.motion_pending[ind]){
+		*dst = *ev;
+		ithread.motion_pending[ind] = true;
+		return;
+	}
+
+	int sum = dst->io.input.analog.axisval[0] + ev->io.input.analog.axisval[0];
+	dst->io.input.analog.axisval[0] = sum < INT16_MIN ?
+		INT16_MIN : (sum > INT16_MAX ? INT16_MAX : sum);
+	dst->io.input.analog.axisval[1] = ev->io.input.analog.axisval[1];
+	dst->io.pts = ev->io.pts;
+}
+
+/* all translated input goes through here, on the input thread it is queued
+ * for platform_event_process, otherwise forwarded directly */
+static void emit_event(struct arcan_evctx* ctx, arcan_event* ev)
+{
+	if (!ev->io.pts)
+		ev->io.pts = arcan_timemillis();
+
+	if (!in_ithread){
+		arcan_event_enqueue(ctx, ev);
+		return;
+	}
+
+	if (ev->io.kind == EVENT_IO_AXIS_MOVE &&
+		ev->io.devkind == EVENT_IDEVKIND_MOUSE &&
+		ev->io.input.analog.gotrel && ev->io.subid <= 1){
+		coalesce_motion(ev);
+		return;
+	}
+
+	flush_motion();
+	ring_push(ev, false);
+}
+
 /* for other platforms and legacy, devid used to be allocated sequentially
  * and swept linear, even though this platform do not work like that and we
  * have a dynamic set of devices. For this reason, we split the 16 bit space
@@ -466,17 +655,21 @@ arcan_errc platform_event_analogstate(int devid, int axisid,
 	int* kernel_size, enum ARCAN_ANALOGFILTER_KIND* mode)
 {
 	bool gotnode;
+	lock_iodev();
 	struct axis_opts* axis = find_axis(devid, axisid, &gotnode);
 
-	if (!axis)
+	if (!axis){
+		unlock_iodev();
 		return gotnode ?
 			ARCAN_ERRC_BAD_RESOURCE : ARCAN_ERRC_NO_SUCH_OBJECT;
+	}
 
 	*lower_bound = axis->lower;
 	*upper_bound = axis->upper;
 	*deadzone = axis->deadzone;
 	*kernel_size = axis->kernel_sz;
 	*mode = axis->mode;
+	unlock_iodev();
 
 	return ARCAN_OK;
 }
@@ -494,7 +687,7 @@ void platform_event_analogall(bool enable, bool mouse)
 }
 
 static void disconnect(struct arcan_evctx* ctx, struct devnode* node);
-void platform_event_analogfilter(int devid,
+static void analogfilter(int devid,
 	int axisid, int lower_bound, int upper_bound, int deadzone,
 	int buffer_sz, enum ARCAN_ANALOGFILTER_KIND kind)
 {
@@ -526,6 +719,15 @@ void platform_event_analogfilter(int devid,
 	set_analogstate(axis,lower_bound, upper_bound, deadzone, buffer_sz, kind);
 }
 
+void platform_event_analogfilter(int devid,
+	int axisid, int lower_bound, int upper_bound, int deadzone,
+	int buffer_sz, enum ARCAN_ANALOGFILTER_KIND kind)
+{
+	lock_iodev();
+	analogfilter(devid, axisid, lower_bound, upper_bound, deadzone, buffer_sz, kind);
+	unlock_iodev();
+}
+
 static bool discovered(struct arcan_evctx* ctx,
 	const char* name, size_t name_len, bool nopending)
 {
@@ -536,13 +738,16 @@ static bool discovered(struct arcan_evctx* ctx,
  * has a whitelist that is rather picky about which devices it will open */
 	snprintf(buffer, sizeof(buffer), "%s/%.*s", notify_scan_dir, (int)name_len, name);
 
-	TRACE_MARK_ENTER("event", "open-device", TRACE_SYS_DEFAULT, 0, 0, name);
+/* the trace writer is not thread-safe, only mark when on the main thread */
+	if (!in_ithread)
+		TRACE_MARK_ENTER("event", "open-device", TRACE_SYS_DEFAULT, 0, 0, name);
 
 	int fd = platform_device_open(
 		readlink(buffer, outbuffer, sizeof(outbuffer)) > 0 ?
 			outbuffer : buffer, O_NONBLOCK| O_RDWR);
 
-	TRACE_MARK_EXIT("event", "open-device", TRACE_SYS_DEFAULT, 0, fd, name);
+	if (!in_ithread)
+		TRACE_MARK_EXIT("event", "open-device", TRACE_SYS_DEFAULT, 0, fd, name);
 
 	verbose_print("input: trying to add %s/%.*s",
 		notify_scan_dir, (int)name_len, name);
@@ -633,7 +838,7 @@ static void disconnect(struct arcan_evctx* ctx, struct devnode* node)
 	};
 	snprintf((char*) &addev.io.label, sizeof(addev.io.label) /
 		sizeof(addev.io.label[0]), "%s", node->label);
-	arcan_event_enqueue(ctx, &addev);
+	emit_event(ctx, &addev);
 
 	for (size_t i = 0; i < iodev.sz_nodes; i++)
 		if (node->devnum == iodev.nodes[i].devnum){
@@ -702,7 +907,7 @@ static void do_led(struct devnode* node)
 	}
 }
 
-void platform_event_process(struct arcan_evctx* ctx)
+static void scan_notify(struct arcan_evctx* ctx)
 {
 /* lovely little variable length field at end of struct here /sarcasm,
  * could get away with running the notify polling less often than once
@@ -727,17 +932,10 @@ void platform_event_process(struct arcan_evctx* ctx)
 			}
 	}
 #endif
-	TRACE_MARK_ENTER("event", "flush-pending-in", TRACE_SYS_DEFAULT, 0, 0, "flush-in");
-
-	if (gstate.pending)
-		process_pending(ctx);
-
-	int nr = poll(iodev.pollset, iodev.sz_nodes * 2, 0);
-	if (nr <= 0){
-		TRACE_MARK_EXIT("event", "flush-pending-in", TRACE_SYS_FAST, 0, 0, "flush-in");
-		return;
-	}
+}
 
+static void dispatch_pollset(struct arcan_evctx* ctx)
+{
 	for (size_t i = 0; i < iodev.sz_nodes; i++){
 /* recall, sz_nodes is half the count, i + sz_nodes = alt-dev index */
 		if (iodev.pollset[i+iodev.sz_nodes].revents & POLLIN){
@@ -764,22 +962,185 @@ void platform_event_process(struct arcan_evctx* ctx)
 			}
 		}
 	}
+}
+
+static void* input_thread(void* arg)
+{
+	struct arcan_evctx* ctx = arg;
+	struct pollfd* set = NULL;
+	size_t set_sz = 0;
+	in_ithread = true;
+
+	while (!atomic_load(&ithread.quit)){
+		pthread_mutex_lock(&ithread.lock);
+		size_t n = iodev.sz_nodes * 2;
+		if (n + 2 > set_sz){
+			struct pollfd* ns = realloc(set, sizeof(struct pollfd) * (n + 2));
+			if (!ns){
+				pthread_mutex_unlock(&ithread.lock);
+				arcan_timesleep(default_eacces_delay);
+				continue;
+			}
+			set = ns;
+			set_sz = n + 2;
+		}
+
+/* the pollset itself can be reallocated by a rescan while we wait */
+		if (n)
+			memcpy(set, iodev.pollset, sizeof(struct pollfd) * n);
+		set[n] = (struct pollfd){.fd = ithread.wakeup[0], .events = POLLIN};
+		set[n+1] = (struct pollfd){.fd = gstate.notify, .events = POLLIN};
+		int timeout = gstate.pending ? default_eacces_delay : -1;
+
+/* held back releases are retried as soon as the consumer could have drained */
+		if (ithread.backlog_used)
+			timeout = 1;
+		pthread_mutex_unlock(&ithread.lock);
+
+		if (-1 == poll(set, n + 2, timeout) && errno != EINTR)
+			break;
+
+		if (set[n].revents & POLLIN){
+			char buf[64];
+			while (read(ithread.wakeup[0], buf, sizeof(buf)) > 0){}
+		}
+
+		pthread_mutex_lock(&ithread.lock);
+		if (set[n+1].revents & POLLIN)
+			scan_notify(ctx);
+
+		if (gstate.pending)
+			process_pending(ctx);
+
+/* on a changed set the revents are stale, the next pass picks them up */
+		if (n == iodev.sz_nodes * 2){
+			for (size_t i = 0; i < n; i++)
+				iodev.pollset[i].revents =
+					iodev.pollset[i].fd == set[i].fd ? set[i].revents : 0;
+			dispatch_pollset(ctx);
+		}
+
+		flush_motion();
+		flush_backlog();
+		pthread_mutex_unlock(&ithread.lock);
+	}
+
+	free(set);
+	return NULL;
+}
+
+static void wakeup_ithread()
+{
+	if (ithread.active && -1 == write(ithread.wakeup[1], "", 1) && errno != EAGAIN)
+		arcan_warning("evdev: couldn't wake input thread (%s)\n", strerror(errno));
+}
+
+static void start_ithread(struct arcan_evctx* ctx)
+{
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&ithread.lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+
+	if (-1 == pipe2(ithread.wakeup, O_NONBLOCK | O_CLOEXEC)){
+		arcan_warning("evdev: input thread disabled, pipe failed (%s)\n",
+			strerror(errno));
+		pthread_mutex_destroy(&ithread.lock);
+		return;
+	}
+
+	atomic_store(&ithread.quit, false);
+	atomic_store(&ithread.head, 0);
+	atomic_store(&ithread.tail, 0);
+	ithread.ctx = ctx;
+	ithread.active = true;
+
+	if (0 != pthread_create(&ithread.pth, NULL, input_thread, ctx)){
+		arcan_warning("evdev: couldn't spawn input thread\n");
+		ithread.active = false;
+		close(ithread.wakeup[0]);
+		close(ithread.wakeup[1]);
+		ithread.wakeup[0] = ithread.wakeup[1] = -1;
+		pthread_mutex_destroy(&ithread.lock);
+	}
+}
+
+static void stop_ithread()
+{
+	if (!ithread.active)
+		return;
+
+	atomic_store(&ithread.quit, true);
+	wakeup_ithread();
+	pthread_join(ithread.pth, NULL);
+
+	ithread.active = false;
+	close(ithread.wakeup[0]);
+	close(ithread.wakeup[1]);
+	ithread.wakeup[0] = ithread.wakeup[1] = -1;
+	ithread.motion_pending[0] = ithread.motion_pending[1] = false;
+	free(ithread.backlog);
+	ithread.backlog = NULL;
+	ithread.backlog_used = ithread.backlog_sz = 0;
+	pthread_mutex_destroy(&ithread.lock);
+}
+
+static void drain_ithread(struct arcan_evctx* ctx)
+{
+	size_t tail = atomic_load_explicit(&ithread.tail, memory_order_relaxed);
+	size_t head = atomic_load_explicit(&ithread.head, memory_order_acquire);
+
+	while (tail != head){
+		arcan_event_enqueue(ctx, &ithread.ring[tail % INPUT_RING_SZ]);
+		tail++;
+	}
+
+	atomic_store_explicit(&ithread.tail, tail, memory_order_release);
+
+	size_t dropped = atomic_exchange(&ithread.dropped, 0);
+	if (dropped)
+		debug_print("input thread ring full, %zu events dropped", dropped);
+}
+
+void platform_event_process(struct arcan_evctx* ctx)
+{
+	if (ithread.active){
+		drain_ithread(ctx);
+		return;
+	}
+
+	scan_notify(ctx);
+	TRACE_MARK_ENTER("event", "flush-pending-in", TRACE_SYS_DEFAULT, 0, 0, "flush-in");
+
+	if (gstate.pending)
+		process_pending(ctx);
+
+	int nr = poll(iodev.pollset, iodev.sz_nodes * 2, 0);
+	if (nr <= 0){
+		TRACE_MARK_EXIT("event", "flush-pending-in", TRACE_SYS_FAST, 0, 0, "flush-in");
+		return;
+	}
+
+	dispatch_pollset(ctx);
 	TRACE_MARK_EXIT("event", "flush-pending-in", TRACE_SYS_DEFAULT, 0, 0, "flush-in");
 }
 
 void platform_event_samplebase(int devid, float xyz[3])
 {
+	lock_iodev();
 	struct devnode* node = lookup_devnode(devid);
-	if (!node || node->type != DEVNODE_MOUSE)
-		return;
-
-	node->cursor.mx = xyz[0];
-	node->cursor.my = xyz[1];
+	if (node && node->type == DEVNODE_MOUSE){
+		node->cursor.mx = xyz[0];
+		node->cursor.my = xyz[1];
+	}
+	unlock_iodev();
 }
 
 void platform_event_keyrepeat(struct arcan_evctx* ctx, int* period, int* delay)
 {
 	bool upd = false;
+	lock_iodev();
 
 	if (*period < 0){
 		*period = iodev.period;
@@ -801,8 +1162,10 @@ void platform_event_keyrepeat(struct arcan_evctx* ctx, int* period, int* delay)
 		upd = true;
 	}
 
-	if (!upd)
+	if (!upd){
+		unlock_iodev();
 		return;
+	}
 
 	for (size_t i = 0; i < iodev.sz_nodes; i++)
 		if (iodev.nodes[i].type == DEVNODE_KEYBOARD){
@@ -819,6 +1182,7 @@ void platform_event_keyrepeat(struct arcan_evctx* ctx, int* period, int* delay)
 			if (-1 == write(iodev.nodes[i].handle,&ev,sizeof(struct input_event)))
 				verbose_print("linux/event: keyrepeat fail (%s)\n", strerror(errno));
 		}
+	unlock_iodev();
 }
 
 static const char* lookup_type(int val)
@@ -1108,11 +1472,11 @@ static void send_device_added(struct arcan_evctx* ctx, struct devnode* node)
 	};
 	snprintf((char*) &addev.io.label, sizeof(addev.io.label) /
 		sizeof(addev.io.label[0]), "%s", node->label);
-	arcan_event_enqueue(ctx, &addev);
+	emit_event(ctx, &addev);
 }
 
 
-int platform_event_translation(
+static int translation(
 	int devid, int action, const char** arg, const char** err)
 {
 	struct devnode* node = NULL;
@@ -1236,6 +1600,15 @@ int platform_event_translation(
 	return false;
 }
 
+int platform_event_translation(
+	int devid, int action, const char** arg, const char** err)
+{
+	lock_iodev();
+	int rv = translation(devid, action, arg, err);
+	unlock_iodev();
+	return rv;
+}
+
 int platform_event_device_request(int space, const char* path)
 {
 	return -EINVAL;
@@ -1283,6 +1656,10 @@ static void got_device(struct arcan_evctx* ctx, int fd, const char* path)
  */
 	struct evhandler eh = lookup_dev_handler(node.label);
 
+/* match arcan_timemillis so the event timestamps can be compared directly */
+	int clk = CLOCK_MONOTONIC;
+	ioctl(fd, EVIOCSCLOCKID, &clk);
+
 /* [eh] may contain overrides, but we still need to probe the driver state for
  * axes etc. and allocate accordingly */
 	node.type = DEVNODE_GAME;
@@ -1416,6 +1793,7 @@ void platform_event_rescan_idev(struct arcan_evctx* ctx)
 	char ibuf [strlen(notify_scan_dir) + sizeof("/*")];
 	glob_t res = {0};
 	snprintf(ibuf, sizeof(ibuf), "%s/*", notify_scan_dir);
+	lock_iodev();
 
 	if (glob(ibuf, 0, NULL, &res) == 0){
 		char** beg = res.gl_pathv;
@@ -1430,6 +1808,10 @@ void platform_event_rescan_idev(struct arcan_evctx* ctx)
 		globfree(&res);
 	}
 
+/* new nodes need to go into the set the input thread is waiting on */
+	unlock_iodev();
+	wakeup_ithread();
+
 	verbose_print("input: couldn't scan %s", notify_scan_dir);
 }
 
@@ -1503,6 +1885,7 @@ static void defhandler_kbd(
 	};
 
 	for (size_t i = 0; i < evs / sizeof(struct input_event); i++){
+		newev.io.pts = input_ts(&inev[i]);
 		switch(inev[i].type){
 		case EV_KEY:
 		newev.io.input.translated.scancode = inev[i].code;
@@ -1553,14 +1936,14 @@ static void defhandler_kbd(
 			if (iodev.period){
 				newev.io.input.translated.modifiers |= ARKMOD_REPEAT;
 				newev.io.input.translated.active = false;
-				arcan_event_enqueue(out, &newev);
+				emit_event(out, &newev);
 				newev.io.input.translated.active = true;
-				arcan_event_enqueue(out, &newev);
+				emit_event(out, &newev);
 			}
 		}
 		else{
 			newev.io.input.translated.active = inev[i].value != 0;
-			arcan_event_enqueue(out, &newev);
+			emit_event(out, &newev);
 		}
 
 		break;
@@ -1595,7 +1978,7 @@ static void flush_pending(
 	newev.io.input.touch.pressure = node->touch.pressure;
 	newev.io.input.touch.size = node->touch.size;
 
-	arcan_event_enqueue(ctx, &newev);
+	emit_event(ctx, &newev);
 	node->touch.pending = false;
 	node->touch.active = true;
 }
@@ -1688,13 +2071,13 @@ static void decode_hat(struct arcan_evctx* ctx,
 		if (node->game.hats[ind] != 0){
 			newev.io.subid = base + ind;
 			node->game.hats[ind] = 0;
-			arcan_event_enqueue(ctx, &newev);
+			emit_event(ctx, &newev);
 		}
 
 		if (node->game.hats[ind+1] != 0){
 			newev.io.subid = base + ind + 1;
 			node->game.hats[ind+1] = 0;
-			arcan_event_enqueue(ctx, &newev);
+			emit_event(ctx, &newev);
 		}
 
 		return;
@@ -1706,7 +2089,7 @@ static void decode_hat(struct arcan_evctx* ctx,
 	node->game.hats[ind] = val;
 	newev.io.input.digital.active = true;
 	newev.io.subid = base + ind;
-	arcan_event_enqueue(ctx, &newev);
+	emit_event(ctx, &newev);
 }
 
 static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
@@ -1733,6 +2116,7 @@ static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 	short samplev;
 
 	for (size_t i = 0; i < evs / sizeof(struct input_event); i++){
+		newev.io.pts = input_ts(&inev[i]);
 		switch(inev[i].type){
 		case EV_KEY:
 			if (inev[i].code >= BTN_TOUCH)
@@ -1750,7 +2134,7 @@ static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 			newev.io.input.digital.active = inev[i].value;
 			newev.io.subid = inev[i].code;
 			newev.io.devid = node->devnum;
-			arcan_event_enqueue(ctx, &newev);
+			emit_event(ctx, &newev);
 		break;
 
 		case EV_SW:
@@ -1759,7 +2143,7 @@ static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 			newev.io.input.digital.active = inev[i].value;
 			newev.io.subid = inev[i].code;
 			newev.io.devid = node->devnum;
-			arcan_event_enqueue(ctx, &newev);
+			emit_event(ctx, &newev);
 		break;
 
 		case EV_REL:
@@ -1784,7 +2168,7 @@ static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 				newev.io.devid = node->devnum;
 				newev.io.input.analog.axisval[0] = samplev;
 				newev.io.input.analog.nvalues = 2;
-				arcan_event_enqueue(ctx, &newev);
+				emit_event(ctx, &newev);
 			}
 			else if ((inev[i].code >= ABS_X && inev[i].code <= ABS_Y) ||
 				(inev[i].code >= ABS_MT_SLOT && inev[i].code <= ABS_MT_TOOL_Y)){
@@ -1808,7 +2192,7 @@ static void defhandler_game(struct arcan_evctx* ctx, struct devnode* node)
 				newev.io.devid = node->devnum;
 				newev.io.input.analog.axisval[0] = inev[i].value;
 				newev.io.input.analog.nvalues = 1;
-				arcan_event_enqueue(ctx, &newev);
+				emit_event(ctx, &newev);
 			}
 			else {
 				verbose_print("kind=game:device=%d:rel:code=%d:status=unknown", node->devnum, inev[i].code);
@@ -1863,6 +2247,7 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 
 	for (size_t i = 0; i < evs / sizeof(struct input_event); i++){
 		int vofs = 0;
+		newev.io.pts = input_ts(&inev[i]);
 
 		switch(inev[i].type){
 		case EV_KEY:
@@ -1875,7 +2260,7 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 			newev.io.input.digital.active = inev[i].value;
 			newev.io.subid = samplev;
 
-			arcan_event_enqueue(ctx, &newev);
+			emit_event(ctx, &newev);
 		break;
 		case EV_REL:
 			switch (inev[i].code){
@@ -1886,9 +2271,9 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 				newev.io.datatype = EVENT_IDATATYPE_DIGITAL;
 				newev.io.input.digital.active = 1;
 				newev.io.subid = vofs + (inev[i].value > 0 ? 256 : 257);
-				arcan_event_enqueue(ctx, &newev);
+				emit_event(ctx, &newev);
 				newev.io.input.digital.active = 0;
-				arcan_event_enqueue(ctx, &newev);
+				emit_event(ctx, &newev);
 			break;
 
 			case REL_X:
@@ -1906,7 +2291,7 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 					newev.io.input.analog.axisval[1] = node->cursor.mx;
 					newev.io.input.analog.nvalues = 2;
 
-					arcan_event_enqueue(ctx, &newev);
+					emit_event(ctx, &newev);
 				}
 			break;
 			case REL_Y:
@@ -1922,7 +2307,7 @@ static void defhandler_mouse(struct arcan_evctx* ctx,
 					newev.io.input.analog.axisval[1] = node->cursor.my;
 					newev.io.input.analog.nvalues = 2;
 
-					arcan_event_enqueue(ctx, &newev);
+					emit_event(ctx, &newev);
 				}
 			break;
 			default:
@@ -1948,11 +2333,19 @@ static void defhandler_null(struct arcan_evctx* out,
 
 const char* platform_event_devlabel(int devid)
 {
+/* the node can move on hotplug, so copy while the lock is held */
+	static char label[sizeof(((struct devnode*)0)->label)];
+
+	lock_iodev();
 	struct devnode* node = lookup_devnode(devid);
-	if (!node)
+	if (!node){
+		unlock_iodev();
 		return NULL;
+	}
 
-	return node->label;
+	snprintf(label, sizeof(label), "%s", node->label);
+	unlock_iodev();
+	return label;
 }
 
 /*
@@ -1967,6 +2360,8 @@ void platform_event_reset(struct arcan_evctx* ctx)
 
 void platform_event_deinit(struct arcan_evctx* ctx)
 {
+/* anything still in the ring is dropped along with the device state */
+	stop_ithread();
 	platform_device_release("TTY", -1);
 
 /* note, we purposely leak (let it disappear on close) to avoid the races and
@@ -1995,11 +2390,11 @@ void platform_event_deinit(struct arcan_evctx* ctx)
 
 void platform_device_lock(int devind, bool state)
 {
+	lock_iodev();
 	struct devnode* node = lookup_devnode(devind);
-	if (!node || !node->handle)
-		return;
-
-	ioctl(node->handle, EVIOCGRAB, state? 1 : 0);
+	if (node && node->handle)
+		ioctl(node->handle, EVIOCGRAB, state? 1 : 0);
+	unlock_iodev();
 
 /*
  * doesn't make sense outside some window systems, might be useful to propagate
@@ -2013,6 +2408,7 @@ enum PLATFORM_EVENT_CAPABILITIES platform_event_capabilities(const char** out)
 	if (out)
 		*out = "evdev";
 
+	lock_iodev();
 	for (size_t i = 0; i < iodev.n_devs; i++){
 		if (iodev.nodes[i].handle)
 			switch(iodev.nodes[i].type){
@@ -2036,6 +2432,7 @@ enum PLATFORM_EVENT_CAPABILITIES platform_event_capabilities(const char** out)
 			break;
 		}
 	}
+	unlock_iodev();
 
 	return rv;
 }
@@ -2140,4 +2537,7 @@ void platform_event_init(arcan_evctx* ctx)
 #endif
 
 	platform_event_rescan_idev(ctx);
+
+	if (get_config("event_input_thread", 0, NULL, tag))
+		start_ithread(ctx);
 }
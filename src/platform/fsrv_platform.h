@@ -176,6 +176,31 @@ size_t platform_fsrv_default_abufsize(size_t new_sz);
  */
 size_t platform_fsrv_display_limit(size_t new_sz);
 
+/*
+ * Hand new segments to clients as descriptors over the socket rather than as
+ * named shared memory the client opens itself. This requires clients that use
+ * a libarcan-shmif of the same version, older ones fail to attach, so it is
+ * off by default. Returns the previous state, platforms without support for
+ * it always return false and ignore [enable].
+ */
+bool platform_fsrv_segment_fdpass(bool enable);
+
+/*
+ * Set the number of segments of the default size that are kept allocated and
+ * faulted in ahead of time so that new connections and subsegments can be
+ * handed one without paying the setup cost. Returns the previous value, the
+ * default is 4 and the upper limit is platform defined, 0 disables the pool.
+ * The pool is only used for descriptor-passed segments.
+ */
+size_t platform_fsrv_segment_pool(size_t n);
+
+/*
+ * Top up the segment pool with at most [n] new segments, this is costly and
+ * should be called outside of latency sensitive paths. Returns the number of
+ * segments that were added.
+ */
+size_t platform_fsrv_segment_pool_refill(size_t n);
+
 /*
  * Try and populate [dst] with the contents of the frameserver last words.
  * Requires [n] > 0 and sizeof(dst) to be at least [n].
@@ -244,6 +244,7 @@ struct drm_hdr_meta {
 };
 
 struct agp_vstore;
+struct agp_readback;
 struct agp_vstore {
 	size_t refcount;
 	uint32_t update_ts;
@@ -255,8 +256,9 @@ struct agp_vstore {
 			unsigned glid;
 			unsigned* glid_proxy;
 
-/* used for PBO transfers */
-			unsigned rid, wid;
+/* used for PBO transfers, readbacks rotate between a set of buffers */
+			struct agp_readback* readback;
+			unsigned wid;
 
 /* intermediate storage for reconstructing lost context */
 			uint32_t s_raw;
@@ -77,6 +77,51 @@ static void afree(void* p)
 static size_t default_abuf_sz = 512;
 static size_t default_disp_lim = 8;
 
+/*
+ * Where anonymous memory objects are available, segments can be passed as
+ * descriptors over the socket instead of being opened by name on the client
+ * side. The semaphores then live in a small shared page of their own (not in
+ * the segment as that can be moved on resize) as process-shared unnamed ones.
+ *
+ * Clients built against an older libarcan-shmif only know how to open the
+ * named objects, so this is off unless enabled with
+ * platform_fsrv_segment_fdpass.
+ */
+#if defined(MFD_CLOEXEC) && !defined(ARCAN_SHMIF_OVERCOMMIT)
+#define FSRV_MEMFD
+#endif
+static bool segment_fdpass;
+#define SYNCH_PAGE_SZ (3 * sizeof(sem_t))
+
+/*
+ * Segments that have been marked with SHMIF_RESIZE_RESERVE grow in steps of this
+ * (a common huge page size) plus half of the requested size in headroom, and
+ * don't shrink, so that resizes within the reservation only move offsets.
+ */
+#define SEGMENT_RESERVE_ALIGN (2 * 1024 * 1024)
+
+/*
+ * Segments of the default size that have been allocated and faulted in ahead
+ * of time so that a new connection doesn't have to pay for it, see
+ * platform_fsrv_segment_pool.
+ */
+#define SEGMENT_POOL_LIM 32
+#define SEGMENT_POOL_DEFAULT 4
+struct pooled_segment {
+	int handle;
+	int synch_handle;
+	void* ptr;
+	void* synch;
+};
+
+static struct {
+	size_t limit;
+	size_t count;
+	struct pooled_segment seg[SEGMENT_POOL_LIM];
+} segment_pool = {
+	.limit = SEGMENT_POOL_DEFAULT
+};
+
 /*
  * Provide a size calculation for the specified subprotocol in the context of a
  * specific frameserver. 0 if unknown protocol or not applicable.  The dofs
@@ -151,9 +196,13 @@ static void dropshared_keyed(char** key)
 		return;
 
 	char* work = *key;
+	size_t chpos = strlen(work) - 1;
+
+/* descriptor-passed segment, there are no names to unlink */
+	if (work[chpos] == 'f')
+		goto out;
 
 	shm_unlink(work);
-	size_t chpos = strlen(work) - 1;
 	work[chpos] = 'a';
 	arcan_sem_unlink(NULL, work);
 	work[chpos] = 'e';
@@ -161,10 +210,28 @@ static void dropshared_keyed(char** key)
 	work[chpos] = 'v';
 	arcan_sem_unlink(NULL, work);
 
+out:
 	arcan_mem_free(work);
 	*key = NULL;
 }
 
+static void drop_synch(arcan_frameserver* src)
+{
+	if (!src->shm.synch){
+		sem_close(src->async);
+		sem_close(src->vsync);
+		sem_close(src->esync);
+		return;
+	}
+
+	munmap(src->shm.synch, SYNCH_PAGE_SZ);
+	if (-1 != src->shm.synch_handle)
+		close(src->shm.synch_handle);
+
+	src->shm.synch = NULL;
+	src->shm.synch_handle = -1;
+}
+
 /*
  * the rather odd structure we want for poll on the verify socket
  */
@@ -241,9 +308,7 @@ bool platform_fsrv_destroy_local(arcan_frameserver* src)
 		src->dpipe = BADFD;
 	}
 
-	sem_close(src->async);
-	sem_close(src->vsync);
-	sem_close(src->esync);
+	drop_synch(src);
 
 	struct arcan_shmif_page* shmpage = src->shm.ptr;
 
@@ -354,9 +419,7 @@ void platform_fsrv_dropshared(arcan_frameserver* src)
 		src->sockkey = NULL;
 	}
 
-	sem_close(src->async);
-	sem_close(src->vsync);
-	sem_close(src->esync);
+	drop_synch(src);
 
 	struct arcan_shmif_page* shmpage = src->shm.ptr;
 
@@ -572,6 +635,188 @@ static bool findshmkey(arcan_frameserver* ctx, int* dfd, mode_t mode){
 	return false;
 }
 
+#ifdef FSRV_MEMFD
+/*
+ * Create the anonymous segment and synch page, the segment is left empty for
+ * the caller to size and map.
+ */
+static bool memfd_segment(struct pooled_segment* dst)
+{
+	*dst = (struct pooled_segment){
+		.handle = -1,
+		.synch_handle = -1
+	};
+
+	dst->synch_handle = memfd_create("arcan_shmif_synch", MFD_CLOEXEC);
+	if (-1 == dst->synch_handle)
+		return false;
+
+	if (-1 == ftruncate(dst->synch_handle, SYNCH_PAGE_SZ))
+		goto fail;
+
+	dst->synch = mmap(NULL, SYNCH_PAGE_SZ,
+		PROT_READ | PROT_WRITE, MAP_SHARED, dst->synch_handle, 0);
+	if (MAP_FAILED == dst->synch){
+		dst->synch = NULL;
+		goto fail;
+	}
+
+/* same order and initial values as the named v, a, e set */
+	sem_t* sems = dst->synch;
+	if (-1 == sem_init(&sems[0], 1, 0) ||
+		-1 == sem_init(&sems[1], 1, 0) || -1 == sem_init(&sems[2], 1, 1))
+		goto fail;
+
+	dst->handle = memfd_create("arcan_shmif", MFD_CLOEXEC);
+	if (-1 != dst->handle)
+		return true;
+
+fail:
+	arcan_warning("memfd_segment() -- couldn't create segment: %s\n",
+		strerror(errno));
+	if (dst->synch)
+		munmap(dst->synch, SYNCH_PAGE_SZ);
+	close(dst->synch_handle);
+	dst->synch = NULL;
+	dst->synch_handle = -1;
+	return false;
+}
+
+/*
+ * The key tells the client that the segment follows on the socket (the 'f'
+ * suffix) and which shmif version it is for, as a client that predates this
+ * can't map the segment to find the version in the page itself. The rest is
+ * kept for tracing / debugging.
+ */
+static void attach_segment(arcan_frameserver* ctx, struct pooled_segment* seg)
+{
+	char playbuf[sizeof("/arcan_%i_%i_%d.%df") + 16];
+	snprintf(playbuf, sizeof(playbuf), "/arcan_%i_%i_%d.%df",
+		(int)(getpid() % 1000), rand() % 100000,
+		ASHMIF_VERSION_MAJOR, ASHMIF_VERSION_MINOR);
+
+	ctx->shm.key = strdup(playbuf);
+	ctx->shm.handle = seg->handle;
+	ctx->shm.synch = seg->synch;
+	ctx->shm.synch_handle = seg->synch_handle;
+
+	sem_t* sems = seg->synch;
+	ctx->vsync = &sems[0];
+	ctx->async = &sems[1];
+	ctx->esync = &sems[2];
+}
+#endif
+
+static bool memfd_alloc(arcan_frameserver* ctx, int* dfd)
+{
+#ifdef FSRV_MEMFD
+	struct pooled_segment seg;
+	if (!segment_fdpass || !memfd_segment(&seg))
+		return false;
+
+	attach_segment(ctx, &seg);
+	*dfd = seg.handle;
+	return true;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Pooled segments are already sized to the default and mapped, so any request
+ * that fits can use one as is, and the contents are known to be cleared.
+ */
+static bool pool_take(arcan_frameserver* ctx)
+{
+#ifdef FSRV_MEMFD
+	if (!segment_fdpass ||
+		!segment_pool.count || ctx->shm.shmsize > ARCAN_SHMPAGE_START_SZ)
+		return false;
+
+	struct pooled_segment* seg = &segment_pool.seg[--segment_pool.count];
+	attach_segment(ctx, seg);
+	ctx->shm.ptr = seg->ptr;
+	ctx->shm.shmsize = ARCAN_SHMPAGE_START_SZ;
+	return true;
+#else
+	return false;
+#endif
+}
+
+size_t platform_fsrv_segment_pool(size_t n)
+{
+	size_t res = segment_pool.limit;
+	segment_pool.limit = n > SEGMENT_POOL_LIM ? SEGMENT_POOL_LIM : n;
+
+	while (segment_pool.count > segment_pool.limit){
+		struct pooled_segment* seg = &segment_pool.seg[--segment_pool.count];
+		munmap(seg->ptr, ARCAN_SHMPAGE_START_SZ);
+		munmap(seg->synch, SYNCH_PAGE_SZ);
+		close(seg->handle);
+		close(seg->synch_handle);
+	}
+
+	return res;
+}
+
+bool platform_fsrv_segment_fdpass(bool enable)
+{
+	bool res = segment_fdpass;
+#ifdef FSRV_MEMFD
+	segment_fdpass = enable;
+#endif
+	return res;
+}
+
+size_t platform_fsrv_segment_pool_refill(size_t n)
+{
+	size_t added = 0;
+
+#ifdef FSRV_MEMFD
+	while (segment_fdpass &&
+		added < n && segment_pool.count < segment_pool.limit){
+		struct pooled_segment seg;
+		if (!memfd_segment(&seg))
+			break;
+
+		seg.ptr = MAP_FAILED;
+		if (-1 != ftruncate(seg.handle, ARCAN_SHMPAGE_START_SZ))
+			seg.ptr = mmap(NULL, ARCAN_SHMPAGE_START_SZ,
+				PROT_READ | PROT_WRITE, MAP_SHARED, seg.handle, 0);
+
+		if (MAP_FAILED == seg.ptr){
+			munmap(seg.synch, SYNCH_PAGE_SZ);
+			close(seg.handle);
+			close(seg.synch_handle);
+			break;
+		}
+
+/* this is the part that is expensive on the spawn path, fault it in now */
+		memset(seg.ptr, '\0', ARCAN_SHMPAGE_START_SZ);
+		segment_pool.seg[segment_pool.count++] = seg;
+		added++;
+	}
+#endif
+
+	return added;
+}
+
+/*
+ * Send the synch page and segment descriptors that the client expects to
+ * follow the key of a descriptor-passed segment, the synch descriptor has no
+ * use on our end after this.
+ */
+static void push_handles(arcan_frameserver* ctx, int sock)
+{
+	if (!ctx->shm.synch || -1 == ctx->shm.synch_handle)
+		return;
+
+	arcan_pushhandle(ctx->shm.synch_handle, sock);
+	arcan_pushhandle(ctx->shm.handle, sock);
+	close(ctx->shm.synch_handle);
+	ctx->shm.synch_handle = -1;
+}
+
 static bool sockpair_alloc(int* dst, size_t n, bool cloexec)
 {
 	bool res = false;
@@ -703,10 +948,14 @@ static bool shmalloc(arcan_frameserver* ctx,
 	if (0 == ctx->shm.shmsize)
 		ctx->shm.shmsize = ARCAN_SHMPAGE_START_SZ;
 
-	struct arcan_shmif_page* shmpage;
+	struct arcan_shmif_page* shmpage = NULL;
 	int shmfd = 0;
 
-	if (!findshmkey(ctx, &shmfd, ctx->sockmode))
+/* prefer a pre-faulted segment, then an anonymous one, then a named one */
+	bool pooled = pool_take(ctx);
+	if (pooled)
+		shmfd = ctx->shm.handle;
+	else if (!memfd_alloc(ctx, &shmfd) && !findshmkey(ctx, &shmfd, ctx->sockmode))
 		return false;
 
 	if (namedsocket)
@@ -715,16 +964,21 @@ static bool shmalloc(arcan_frameserver* ctx,
 
 /* max videoframesize + DTS + structure + maxaudioframesize,
 * start with max, then truncate down to whatever is actually used */
-	int rc = ftruncate(shmfd, ctx->shm.shmsize);
-	if (-1 == rc){
-		arcan_warning("platform_fsrv_spawn_server(unix) -- allocating"
-		" (%d) shared memory failed (%d).\n", ctx->shm.shmsize, errno);
-		goto fail;
+	if (pooled){
+		shmpage = ctx->shm.ptr;
 	}
+	else {
+		int rc = ftruncate(shmfd, ctx->shm.shmsize);
+		if (-1 == rc){
+			arcan_warning("platform_fsrv_spawn_server(unix) -- allocating"
+			" (%d) shared memory failed (%d).\n", ctx->shm.shmsize, errno);
+			goto fail;
+		}
 
-	ctx->shm.handle = shmfd;
-	shmpage = (void*) mmap(
-		NULL, ctx->shm.shmsize, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+		ctx->shm.handle = shmfd;
+		shmpage = (void*) mmap(
+			NULL, ctx->shm.shmsize, PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+	}
 
 	if (MAP_FAILED == shmpage){
 		arcan_warning("platform_fsrv_spawn_server(unix) -- couldn't "
@@ -733,11 +987,13 @@ fail:
 /* subtle edge case, dropshared_keyed only unlinks, it doesn't
  * close the memory descriptor or the semaphores, so those will
  * leak even if we unlink */
+		if (pooled)
+			munmap(ctx->shm.ptr, ctx->shm.shmsize);
+		ctx->shm.ptr = NULL;
+
 		if (shmfd != -1){
 			close(shmfd);
-			sem_close(ctx->vsync);
-			sem_close(ctx->async);
-			sem_close(ctx->esync);
+			drop_synch(ctx);
 		}
 		dropshared_keyed(&ctx->shm.key);
 		return false;
@@ -754,11 +1010,13 @@ fail:
 
 /* tiny race condition SIGBUS window here */
 	platform_fsrv_enter(ctx, out);
-		memset(shmpage, '\0', ctx->shm.shmsize);
+		if (!pooled)
+			memset(shmpage, '\0', ctx->shm.shmsize);
 		shmpage->dms = true;
 		shmpage->parent = getpid();
 		shmpage->major = ASHMIF_VERSION_MAJOR;
 		shmpage->minor = ASHMIF_VERSION_MINOR;
+		shmpage->server_caps = 0;
 		shmpage->segment_size = ctx->shm.shmsize;
 		shmpage->segment_token = ctx->cookie;
 		shmpage->cookie = arcan_shmif_cookie();
@@ -1013,7 +1271,8 @@ struct arcan_frameserver* platform_fsrv_spawn_subsegment(
  * find shm etc. We re-use the same name- allocation approach for convenience -
  * in spite of the risk of someone racing a segment intended for another. Part
  * of this is OSX not supporting unnamed semaphores on shared memory pages
- * (seriously).
+ * (seriously). Where those are supported, the segment and its semaphores are
+ * sent ahead on the new socket instead and the key just marks it as such.
  */
 	int sockp[4] = {-1, -1};
 	if (!sockpair_alloc(sockp, 1, true)){
@@ -1027,6 +1286,7 @@ struct arcan_frameserver* platform_fsrv_spawn_subsegment(
  * sending on additional descriptor in advance.
  */
 	newseg->dpipe = sockp[0];
+	push_handles(newseg, newseg->dpipe);
 	arcan_pushhandle(sockp[1], ctx->dpipe);
 	close(sockp[1]);
 
@@ -1183,6 +1443,8 @@ send_key:
 		errno = EBADF;
 		return -1;
 	}
+
+	push_handles(tgt, tgt->dpipe);
 	return 0;
 }
 
@@ -1303,6 +1565,26 @@ size_t platform_fsrv_display_limit(size_t new_sz)
 	return res;
 }
 
+static size_t reserve_size(size_t sz)
+{
+	size_t res = sz + sz / 2;
+	res = (res + SEGMENT_RESERVE_ALIGN - 1) & ~(SEGMENT_RESERVE_ALIGN - 1);
+	return res > ARCAN_SHMPAGE_MAX_SZ ? (size_t) ARCAN_SHMPAGE_MAX_SZ : res;
+}
+
+/*
+ * Ask for transparent huge pages on the mapping (shmem needs shmem_enabled
+ * set to advise or better for this to have an effect), this is done on both
+ * ends as the huge page mapping is per process.
+ */
+static void advise_huge(void* ptr, size_t sz)
+{
+#ifdef MADV_HUGEPAGE
+	if (sz >= SEGMENT_RESERVE_ALIGN)
+		madvise(ptr, sz, MADV_HUGEPAGE);
+#endif
+}
+
 int platform_fsrv_resynch(struct arcan_frameserver* s)
 {
 	int state = 0;
@@ -1319,6 +1601,7 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 	size_t rows = atomic_load(&shmpage->rows);
 	size_t cols = atomic_load(&shmpage->cols);
 	unsigned aproto = atomic_load(&shmpage->apad_type) & s->metamask;
+	bool reserve = atomic_load(&shmpage->resize_flags) & SHMIF_RESIZE_RESERVE;
 
 	vbufc = vbufc > FSRV_MAX_VBUFC ? FSRV_MAX_VBUFC : vbufc;
 	abufc = abufc > FSRV_MAX_ABUFC ? FSRV_MAX_ABUFC : abufc;
@@ -1364,6 +1647,12 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 /* no remapping required, resize effect is insignificant or impossible */
 	bool rmap = (shmsz > src->shmsize || shmsz < (float) src->shmsize * 0.8);
 
+/* reserved segments only grow, and then with headroom */
+	if (reserve){
+		rmap = shmsz > src->shmsize;
+		shmsz = rmap ? reserve_size(shmsz) : src->shmsize;
+	}
+
 /* special case, no remap supported */
 #ifdef ARCAN_SHMIF_OVERCOMMIT
 	rmap = false;
@@ -1406,6 +1695,8 @@ int platform_fsrv_resynch(struct arcan_frameserver* s)
 		goto fail;
 	}
 #endif
+		if (reserve)
+			advise_huge(src->ptr, shmsz);
 	}
 
 	shmpage = src->ptr;
@@ -1540,6 +1831,7 @@ struct arcan_frameserver* platform_fsrv_spawn_server(
 
 	newseg->dpipe = sockp[0];
 	*childfd = sockp[1];
+	push_handles(newseg, newseg->dpipe);
 
 	return newseg;
 }
@@ -1147,8 +1147,43 @@ int arcan_shmif_tryenqueue(
 	return enqueue_internal(c, src, true);
 }
 
+/*
+ * Keys with an 'f' suffix refer to a segment that the server sends on the
+ * socket as descriptors (synch page, then the segment itself) rather than as
+ * named objects.
+ */
+static bool descriptor_key(const char* key)
+{
+	size_t len = strcspn(key, ":");
+	return len > 0 && key[len-1] == 'f';
+}
+
+/*
+ * These keys also carry the shmif version of the server (_major.minorf), as
+ * the page can't be mapped to check it there unless the descriptors that
+ * follow are taken in the way this version expects.
+ */
+static bool descriptor_version(const char* key, int* major, int* minor)
+{
+	size_t len = strcspn(key, ":");
+	const char* ver = NULL;
+	for (size_t i = 0; i < len; i++)
+		if (key[i] == '_')
+			ver = &key[i+1];
+
+	if (!ver || 2 != sscanf(ver, "%d.%df", major, minor)){
+		*major = *minor = -1;
+		return false;
+	}
+
+	return *major == ASHMIF_VERSION_MAJOR && *minor == ASHMIF_VERSION_MINOR;
+}
+
 static void unlink_keyed(const char* key)
 {
+	if (descriptor_key(key))
+		return;
+
 	shm_unlink(key);
 	size_t slen = strlen(key) + 1;
 	char work[slen];
@@ -1199,13 +1234,100 @@ static bool ensure_stdio()
 	return true;
 }
 
-static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
+static int fetch_handle_wait(int sock)
+{
+	struct pollfd pfd = {
+		.fd = sock,
+		.events = POLLIN
+	};
+
+	if (1 != poll(&pfd, 1, 1000))
+		return -1;
+
+	return arcan_fetchhandle(sock, true);
+}
+
+/*
+ * Take the key as received from the server and, if it is a descriptor one,
+ * fetch the descriptors that follow it on [sock] and append them to the key
+ * (key:synch:segment) so that _acquire can map it without the socket.
+ * Returns a dynamically allocated copy of the key or NULL on failure.
+ */
+static char* keyed_handles(int sock, const char* key)
+{
+	if (!descriptor_key(key))
+		return strdup(key);
+
+	int major, minor;
+	if (!descriptor_version(key, &major, &minor)){
+		debug_print(FATAL, NULL, "version mismatch, server: %d.%d (-1: unknown), "
+			"client: %d.%d", major, minor, ASHMIF_VERSION_MAJOR, ASHMIF_VERSION_MINOR);
+		return NULL;
+	}
+
+	int synch = fetch_handle_wait(sock);
+	int shm = -1 != synch ? fetch_handle_wait(sock) : -1;
+	char* res = NULL;
+
+	if (-1 != shm){
+		size_t sz = strlen(key) + 24;
+		res = malloc(sz);
+		if (res){
+			snprintf(res, sz, "%s:%d:%d", key, synch, shm);
+			return res;
+		}
+	}
+
+	debug_print(FATAL, NULL, "missing segment descriptors for key: %s", key);
+	if (-1 != synch)
+		close(synch);
+	if (-1 != shm)
+		close(shm);
+
+	return NULL;
+}
+
+static int open_keyed(const char* shmkey, void** synch)
+{
+	*synch = NULL;
+	if (!descriptor_key(shmkey))
+		return shm_open(shmkey, O_RDWR, 0700);
+
+	int synchfd, fd;
+	const char* sep = strchr(shmkey, ':');
+	if (!sep || 2 != sscanf(sep, ":%d:%d", &synchfd, &fd)){
+		errno = EINVAL;
+		return -1;
+	}
+
+	*synch = mmap(NULL,
+		3 * sizeof(sem_t), PROT_READ | PROT_WRITE, MAP_SHARED, synchfd, 0);
+	close(synchfd);
+
+	if (MAP_FAILED == *synch){
+		*synch = NULL;
+		close(fd);
+		return -1;
+	}
+
+/* see the note on stdio below, we can't re-open the passed descriptor */
+	if (fd <= STDERR_FILENO){
+		int nfd = fcntl(fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+		close(fd);
+		fd = nfd;
+	}
+
+	return fd;
+}
+
+static void map_shared(
+	const char* shmkey, struct arcan_shmif_cont* dst, void** synch)
 {
 	assert(shmkey);
 	assert(strlen(shmkey) > 0);
 
 	int fd = -1;
-	fd = shm_open(shmkey, O_RDWR, 0700);
+	fd = open_keyed(shmkey, synch);
 
 /* This has happened, and while 'technically' legal - it can (and will in most
  * cases) lead to nasty bugs. Since we need to keep the descriptor around in
@@ -1213,7 +1335,7 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
  * printf to stdout, stderr - potentially causing a write into the shared
  * memory page. The server side will likely detect this due to the validation
  * cookie failing, causing it to terminate the connection. */
-	if (fd <= STDERR_FILENO){
+	if (fd <= STDERR_FILENO && !*synch){
 		close(fd);
 		if (!ensure_stdio())
 			return;
@@ -1223,6 +1345,10 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 	if (-1 == fd){
 		debug_print(FATAL,
 			dst, "couldn't open keyfile (%s): %s", shmkey, strerror(errno));
+		if (*synch){
+			munmap(*synch, 3 * sizeof(sem_t));
+			*synch = NULL;
+		}
 		return;
 	}
 
@@ -1230,9 +1356,15 @@ static void map_shared(const char* shmkey, struct arcan_shmif_cont* dst)
 		PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	dst->shmh = fd;
 
-/* step 2, semaphore handles */
+/* step 2, semaphore handles, either in the synch page or named */
 	size_t slen = strlen(shmkey) + 1;
-	if (slen > 1){
+	if (*synch){
+		sem_t* sems = *synch;
+		dst->vsem = &sems[0];
+		dst->asem = &sems[1];
+		dst->esem = &sems[2];
+	}
+	else if (slen > 1){
 		char work[slen];
 		snprintf(work, slen, "%s", shmkey);
 		slen -= 2;
@@ -1269,6 +1401,10 @@ map_fail:
 			"	(%s), reason: %s", shmkey, strerror(errno));
 		close(fd);
 		dst->addr = NULL;
+		if (*synch){
+			munmap(*synch, 3 * sizeof(sem_t));
+			*synch = NULL;
+		}
 		return;
 	}
 }
@@ -1408,7 +1544,11 @@ retry:
 
 /* 4. omitted, just return a copy of the key and let someone else perform the
  * arcan_shmif_acquire call. Just set the env. */
-	res = strdup(wbuf);
+	res = keyed_handles(sock, wbuf);
+	if (!res){
+		close(sock);
+		goto end;
+	}
 
 	*conn_ch = sock;
 
@@ -1488,6 +1628,7 @@ static struct arcan_shmif_cont shmif_acquire_int(
 		return res;
 
 	bool privps = false;
+	void* synch = NULL;
 
 /* different path based on an acquire from a NEWSEGMENT event or if it comes
  * from a _connect (via _open) call */
@@ -1506,10 +1647,15 @@ static struct arcan_shmif_cont shmif_acquire_int(
 				gs->pseg.epipe, gs->pseg.key, COUNT_OF(gs->pseg.key)-1);
 		}
 
-		map_shared(gs->pseg.key, &res);
 		key_used = gs->pseg.key;
 		debug_print(INFO, parent, "newsegment_shm_key:%s", key_used);
 
+		char* key = keyed_handles(gs->pseg.epipe, gs->pseg.key);
+		if (key){
+			map_shared(key, &res, &synch);
+			free(key);
+		}
+
 		if (!(flags & SHMIF_DONT_UNLINK))
 			unlink_keyed(gs->pseg.key);
 
@@ -1522,7 +1668,7 @@ static struct arcan_shmif_cont shmif_acquire_int(
 	else{
 		debug_print(INFO, parent, "acquire_shm_key:%s", shmkey);
 		key_used = shmkey;
-		map_shared(shmkey, &res);
+		map_shared(shmkey, &res, &synch);
 		if (!(flags & SHMIF_DONT_UNLINK))
 			unlink_keyed(shmkey);
 	}
@@ -1550,6 +1696,7 @@ static struct arcan_shmif_cont shmif_acquire_int(
 			.exitf = exitf
 		},
 		.flags = flags,
+		.synch = synch,
 		.pev = {.fd = BADFD},
 		.pseg = {.epipe = BADFD},
 	};
@@ -2023,9 +2170,15 @@ void arcan_shmif_drop(struct arcan_shmif_cont* inctx)
 	close(inctx->epipe);
 	close(inctx->shmh);
 
-	sem_close(inctx->asem);
-	sem_close(inctx->esem);
-	sem_close(inctx->vsem);
+	if (gstr->synch){
+		munmap(gstr->synch, 3 * sizeof(sem_t));
+		gstr->synch = NULL;
+	}
+	else {
+		sem_close(inctx->asem);
+		sem_close(inctx->esem);
+		sem_close(inctx->vsem);
+	}
 
 	if (gstr->args){
 		arg_cleanup(gstr->args);
@@ -2114,7 +2267,8 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 
 	bool dimensions_changed = width != arg->w || height != arg->h;
 	bool bufcnt_changed = vidc != priv->vbuf_cnt || audc != priv->abuf_cnt;
-	bool hints_changed = arg->addr->hints != arg->hints;
+	bool hints_changed = arg->addr->hints != arg->hints ||
+		atomic_load(&arg->addr->resize_flags) != ext.flags;
 	bool bufsz_changed = abufsz && arg->addr->abufsize != abufsz;
 
 /* don't negotiate unless the goals have changed */
@@ -2131,7 +2285,9 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 
 /* synchronize hints as _ORIGO_LL and similar changes only synch on resize */
 	atomic_store(&arg->addr->hints, arg->hints);
+	atomic_store(&arg->addr->resize_flags, ext.flags);
 	atomic_store(&arg->addr->apad_type, adata);
+	priv->resize_flags = ext.flags;
 
 	if (samplerate < 0)
 		atomic_store(&arg->addr->audiorate, arg->samplerate);
@@ -2161,11 +2317,11 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
  * behavior have been verified properly */
 	FORCE_SYNCH();
 	arg->addr->resized = 1;
-	do{
-		if (0 == arcan_sem_trywait(arg->vsem))
-			arcan_timesleep(16);
-	}
-	while (arg->addr->resized > 0 && check_dms(arg));
+
+/* the server posts vsem when the resize has been processed, the guard thread
+ * does the same if the connection dies, so block rather than poll */
+	while (arg->addr->resized > 0 && check_dms(arg))
+		arcan_sem_wait(arg->vsem);
 
 /* post-size data commit is the last fragile moment server-side */
 	if (!check_dms(arg)){
@@ -2193,9 +2349,17 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
  */
 	uintptr_t old_addr = (uintptr_t) arg->addr;
 
-	if (arg->shmsize != arg->addr->segment_size){
-		size_t new_sz = arg->addr->segment_size;
+/* a reserved segment is mapped in full, so only remap when it has grown past
+ * what we have mapped and then pick up the new reservation */
+	size_t new_sz = arg->addr->segment_size;
+	bool reserve = ext.flags & SHMIF_RESIZE_RESERVE;
+	bool remap = reserve ? new_sz > arg->shmsize : new_sz != arg->shmsize;
+
+	if (remap){
 		struct shmif_hidden* gs = priv;
+		struct stat buf;
+		if (reserve && 0 == fstat(arg->shmh, &buf) && buf.st_size > new_sz)
+			new_sz = buf.st_size;
 
 		if (gs->guard.active)
 			pthread_mutex_lock(&gs->guard.synch);
@@ -2208,6 +2372,10 @@ static bool shmif_resize(struct arcan_shmif_cont* arg,
 			debug_print(FATAL, arg, "segment couldn't be remapped");
 			return false;
 		}
+#ifdef MADV_HUGEPAGE
+		if (reserve)
+			madvise(arg->addr, arg->shmsize, MADV_HUGEPAGE);
+#endif
 
 		atomic_store(&gs->guard.dms, (uint8_t*) &arg->addr->dms);
 		if (gs->guard.active)
@@ -2248,6 +2416,7 @@ bool arcan_shmif_resize(struct arcan_shmif_cont* arg,
 		.vbuf_cnt = -1,
 		.abuf_cnt = -1,
 		.samplerate = -1,
+		.flags = arg->priv ? arg->priv->resize_flags : 0
 	});
 }
 
@@ -2689,6 +2858,7 @@ enum shmif_migrate_status arcan_shmif_migrate(
 		.abuf_cnt = P->abuf_cnt,
 		.samplerate = cont->samplerate,
 		.meta = P->atype,
+		.flags = P->resize_flags,
 		.rows = atomic_load(&cont->addr->rows),
 		.cols = atomic_load(&cont->addr->cols)
 	};
@@ -3133,7 +3303,11 @@ static char* spawn_arcan_net(
 /* note: should possibly pass some error data from arcan-net here
  * so we can propagate an error message */
 
-	return strdup(wbuf);
+	char* res = keyed_handles(*dsock, wbuf);
+	if (!res)
+		close(*dsock);
+
+	return res;
 }
 
 struct arcan_shmif_cont arcan_shmif_open_ext(enum ARCAN_FLAGS flags,
@@ -3166,12 +3340,12 @@ struct arcan_shmif_cont arcan_shmif_open_ext(enum ARCAN_FLAGS flags,
 	if (getenv("ARCAN_SOCKIN_FD")){
 		dpipe = (int) strtol(getenv("ARCAN_SOCKIN_FD"), NULL, 10);
 		if (getenv("ARCAN_SHMKEY")){
-			keyfile = strdup(getenv("ARCAN_SHMKEY"));
+			keyfile = keyed_handles(dpipe, getenv("ARCAN_SHMKEY"));
 		}
 		else {
 			char wbuf[PP_SHMPAGE_SHMKEYLIM+1];
 			if (get_shmkey_from_socket(dpipe, wbuf, PP_SHMPAGE_SHMKEYLIM)){
-				keyfile = strdup(wbuf);
+				keyfile = keyed_handles(dpipe, wbuf);
 			}
 		}
 		unsetenv("ARCAN_SOCKIN_FD");
@@ -545,10 +545,42 @@ enum shmif_ext_meta {
  * stream forward this without decoding. If the sink detects an unrecoverable
  * error in the stream, BUFFER_FAIL will be emitted back. Compressed and raw
  * formats can be toggled by setting a valid or empty ({0}) fourcc.
+ *
+ * The fourccs I420 and NV12 are uncompressed planar 4:2:0 in the normal
+ * contiguous layout (luma pitch = width, no padding) and let the server do
+ * the colour conversion. These require width % 8 == 0 and height % 4 == 0.
  */
 	SHMIF_META_VENC = 32
 };
 
+/*
+ * [flags] in the extended resize, these concern the segment itself rather
+ * than the buffer contents (see the rhint_mask for those).
+ */
+enum shmif_resize_flags {
+/*
+ * The segment is large or expected to be resized often (capture, remoting,
+ * spanning several displays). The server end may then over-reserve the
+ * segment so that later _resize calls that fit within the reservation only
+ * update buffer offsets and don't need a remap, and may ask for it to be
+ * backed by huge pages. Reserved segments are not shrunk.
+ */
+	SHMIF_RESIZE_RESERVE = 1
+};
+
+/*
+ * [server_caps] in the page, set by the server end for features that whatever
+ * consumes the buffers is known to handle. These can appear after the segment
+ * has been mapped (e.g. a network peer announcing its version), so check them
+ * per frame.
+ */
+enum shmif_server_caps {
+/*
+ * TPACK buffers may use the v2 (RPACK_V2) cell format, v1 otherwise.
+ */
+	SHMIF_SRVCAP_TPACK_V2 = 1
+};
+
 /*
  * The acknowledged mask is reflected in cont->adata, and may subsequently
  * affect apad and apad_type in the addr-> substructure as well.
@@ -574,6 +606,9 @@ struct shmif_resize_ext {
  * is used for calculating the size of the apad region reserved for vobj */
 	size_t nops;
 	size_t op_fm;
+
+/* bitmask of shmif_resize_flags, plain _resize calls keep the last set */
+	uint32_t flags;
 };
 
 /* extended resize that allows better buffering and format controls,
@@ -1025,6 +1060,16 @@ struct arcan_shmif_page {
  */
 	volatile _Atomic uint_least8_t hints;
 
+/* [FSRV-SET (resize), ARCAN-ACK]
+ * shmif_resize_flags from the last extended resize.
+ */
+	volatile _Atomic uint_least32_t resize_flags;
+
+/* [ARCAN-SET]
+ * shmif_server_caps, see the enum for details.
+ */
+	volatile _Atomic uint_least32_t server_caps;
+
 /*
  * see dirty- field in _cont, manipulate there, not here.
  */
@@ -45,6 +45,11 @@ struct shmifsrv_client {
 	pid_t pid;
 	size_t errors;
 	uint64_t cookie;
+
+/* ingoing event accounting, rate is sampled over one second windows */
+	struct shmifsrv_evstats evstats;
+	int64_t ev_window;
+	size_t ev_window_count;
 };
 
 static struct shmifsrv_client* alloc_client()
@@ -231,6 +236,55 @@ env.type ? env.type : SEGID_UNKNOWN, env.init_w, env.init_h, 0, &childend);
 	return res;
 }
 
+/*
+ * Clients can only ever send EXTERNAL/IO events upwards, but the category is
+ * passed through untouched - only reject what can't be a category at all so
+ * that consumers switching on it won't trip on garbage. Written so that the
+ * common all-good case is a branch-free reduction over the batch.
+ */
+static inline bool bad_category(int cat)
+{
+	return cat <= 0 || cat > EVENT_EXTERNAL || (cat & (cat - 1));
+}
+
+static size_t filter_events(struct arcan_event* ev, size_t n)
+{
+	int bad = 0;
+	for (size_t i = 0; i < n; i++)
+		bad |= bad_category(ev[i].category);
+
+	if (!bad)
+		return n;
+
+	size_t out = 0;
+	for (size_t i = 0; i < n; i++){
+		if (!bad_category(ev[i].category))
+			ev[out++] = ev[i];
+	}
+	return out;
+}
+
+static void update_evstats(struct shmifsrv_client* cl, size_t used, size_t n)
+{
+	if (used > cl->evstats.max_used)
+		cl->evstats.max_used = used;
+	cl->evstats.events += n;
+	cl->ev_window_count += n;
+
+#ifndef SHMIFSRV_EXTERNAL_CLOCK
+	int64_t now = arcan_timemillis();
+	if (!cl->ev_window || now < cl->ev_window){
+		cl->ev_window = now;
+		cl->ev_window_count = n;
+	}
+	else if (now - cl->ev_window >= 1000){
+		cl->evstats.rate = cl->ev_window_count * 1000 / (now - cl->ev_window);
+		cl->ev_window = now;
+		cl->ev_window_count = 0;
+	}
+#endif
+}
+
 size_t shmifsrv_dequeue_events(
 	struct shmifsrv_client* cl, struct arcan_event* newev, size_t limit)
 {
@@ -239,23 +293,46 @@ size_t shmifsrv_dequeue_events(
 
 	if (shmifsrv_enter(cl)){
 		size_t count = 0;
+		struct arcan_event* evq = cl->con->shm.ptr->parentevq.evqueue;
 		uint8_t front = cl->con->shm.ptr->parentevq.front;
 		uint8_t back = cl->con->shm.ptr->parentevq.back;
-		if (front > PP_QUEUE_SZ || back > PP_QUEUE_SZ){
+		if (front >= PP_QUEUE_SZ || back >= PP_QUEUE_SZ){
 			cl->errors++;
 			shmifsrv_leave();
 			return 0;
 		}
+		asm volatile("": : :"memory");
+		__sync_synchronize();
+
+		size_t used = (back + PP_QUEUE_SZ - front) % PP_QUEUE_SZ;
+		size_t max_used = used;
+
+/* copy the ring in at most two runs, then filter the local copy - if that
+ * dropped something and there is more in the ring, go again so that a caller
+ * asking for one event at a time doesn't stop on a rejected one */
+		while (count < limit && used){
+			size_t n = limit - count < used ? limit - count : used;
+			size_t run = PP_QUEUE_SZ - front < n ? PP_QUEUE_SZ - front : n;
+
+			memcpy(&newev[count], &evq[front], run * sizeof(struct arcan_event));
+			if (n > run)
+				memcpy(&newev[count + run], evq, (n - run) * sizeof(struct arcan_event));
 
-		while (count < limit && front != back){
-			newev[count++] = cl->con->shm.ptr->parentevq.evqueue[front];
-			front = (front + 1) % PP_QUEUE_SZ;
+			front = (front + n) % PP_QUEUE_SZ;
+			used -= n;
+
+			size_t kept = filter_events(&newev[count], n);
+			cl->evstats.dropped += n - kept;
+			count += kept;
 		}
+
 		asm volatile("": : :"memory");
 		__sync_synchronize();
 		cl->con->shm.ptr->parentevq.front = front;
 		arcan_sem_post(cl->con->esync);
 		shmifsrv_leave();
+
+		update_evstats(cl, max_used, count);
 		return count;
 	}
 	else{
@@ -264,6 +341,16 @@ size_t shmifsrv_dequeue_events(
 	}
 }
 
+bool shmifsrv_client_evstats(
+	struct shmifsrv_client* cl, struct shmifsrv_evstats* out)
+{
+	if (!cl || !out)
+		return false;
+
+	*out = cl->evstats;
+	return true;
+}
+
 static void autoclock_frame(arcan_frameserver* tgt)
 {
 	if (!tgt->clock.left)
@@ -448,6 +535,14 @@ void shmifsrv_client_protomask(struct shmifsrv_client* cl, unsigned mask)
 	cl->con->metamask = mask;
 }
 
+void shmifsrv_client_caps(struct shmifsrv_client* cl, unsigned caps)
+{
+	if (!cl || !cl->con || !cl->con->shm.ptr)
+		return;
+
+	atomic_store(&cl->con->shm.ptr->server_caps, caps);
+}
+
 void shmifsrv_video_step(struct shmifsrv_client* cl)
 {
 /* signal that we're done with the buffer */
@@ -507,6 +602,11 @@ struct shmifsrv_vbuffer shmifsrv_video(struct shmifsrv_client* cl)
 	res.buffer = cl->con->vbufs[vready];
 	res.region = atomic_load(&cl->con->shm.ptr->dirty);
 
+/* tpack contents are variable length, the consumer needs the upper bound */
+	if (res.flags.tpack)
+		res.buffer_sz = arcan_shmif_vbufsz(0, cl->con->desc.hints,
+			res.w, res.h, cl->con->desc.rows, cl->con->desc.cols);
+
 /* if we have negotiated compressed passthrough, set res.flags, copy /verify
  * framesize - if that fails, we need to propagate the bufferfail so the client
  * produces a new uncompressed one */
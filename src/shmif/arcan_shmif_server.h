@@ -231,10 +231,30 @@ bool shmifsrv_enqueue_multipart_message(
  * return the numbers of actual events dequeued. This will perform no additional
  * tracking or management, only raw event access. For assistance with state
  * tracking, feed the events through shmifsrv_process_event.
+ *
+ * Prefer a larger [limit] over repeated calls for one event, the queue is then
+ * copied out in bulk and the client is signalled once. Events that doesn't
+ * carry a valid category are dropped and accounted for in the client evstats.
  */
 size_t shmifsrv_dequeue_events(
 	struct shmifsrv_client*, struct arcan_event* newev, size_t limit);
 
+/*
+ * Ingoing event counters for a client:
+ * events   - total number of events dequeued
+ * dropped  - events rejected when dequeued
+ * rate     - events/second over the last completed one second window
+ * max_used - highest number of pending events seen in the queue
+ */
+struct shmifsrv_evstats {
+	uint64_t events;
+	uint64_t dropped;
+	size_t rate;
+	size_t max_used;
+};
+bool shmifsrv_client_evstats(
+	struct shmifsrv_client*, struct shmifsrv_evstats* out);
+
 /*
  * Retrieve the currently registered type for a client
  */
@@ -246,6 +266,12 @@ enum ARCAN_SEGID shmifsrv_client_type(struct shmifsrv_client* cl);
  */
 void shmifsrv_client_protomask(struct shmifsrv_client* cl, unsigned mask);
 
+/*
+ * Set the shmif_server_caps (arcan_shmif_control.h) the client may use,
+ * none are set by default.
+ */
+void shmifsrv_client_caps(struct shmifsrv_client* cl, unsigned caps);
+
 /*
  * Handle some of the normal state-tracking events (e.g. CLOCKREQ,
  * BUFFERSTREAM, FLUSHAUD). Returns true if the event was consumed and no
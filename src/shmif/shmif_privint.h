@@ -84,11 +84,16 @@ struct shmif_hidden {
  * and be left to the user. In these scenarios we need to keep the key around. */
 	char* shm_key;
 
+/* Descriptor-passed segments have their semaphores in a separate shared page
+ * rather than as named ones, this is set to that mapping */
+	void* synch;
+
 /* User- provided setup flags and segment types are kept / tracked in order
  * to re-issue events on a hard reset or migration */
 	enum ARCAN_FLAGS flags;
 	int type;
 	enum shmif_ext_meta atype;
+	uint32_t resize_flags;
 	uint64_t guid[2];
 
 /* The ingoing and outgoing event queues */
@@ -4,6 +4,11 @@
 #include <pthread.h>
 #include <errno.h>
 #include <assert.h>
+#include <stddef.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 typedef void* TTF_Font;
 #include "../raster/raster.h"
@@ -17,16 +22,19 @@ static void resize_cellbuffer(struct tui_context* tui)
 
 	tui->base = NULL;
 
+/* the per-row dirty flags are kept at the end of the same allocation */
 	size_t buffer_sz = 2 * tui->rows * tui->cols * sizeof(struct tui_cell);
 	size_t rbuf_sz = tui_screen_tpack_sz(tui);
+	tui->dirty_rows = NULL;
 
-	tui->base = malloc(buffer_sz);
+	tui->base = malloc(buffer_sz + tui->rows);
 	if (!tui->base){
 		LOG("couldn't allocate screen buffers\n");
 		return;
 	}
 
-	memset(tui->base, '\0', buffer_sz);
+	memset(tui->base, '\0', buffer_sz + tui->rows);
+	tui->dirty_rows = (uint8_t*) tui->base + buffer_sz;
 
 	if (tui->acon.vidb)
 		memset(tui->acon.vidb, '\0', rbuf_sz);
@@ -36,6 +44,30 @@ static void resize_cellbuffer(struct tui_context* tui)
 	tui->dirty |= DIRTY_FULL;
 }
 
+/* Only the attributes (minus padding) and the code are compared, the rest is
+ * derived or bookkeeping. With SSE2 the first 16 bytes of the cell are
+ * compared at once with the padding bytes (9, 10, 11) masked out. */
+#ifdef __SSE2__
+_Static_assert(offsetof(struct tui_cell, ch) == 12 &&
+	offsetof(struct tui_screen_attr, custom_id) == 8, "tui_cell layout");
+
+static inline bool cell_equal(const struct tui_cell* a, const struct tui_cell* b)
+{
+	__m128i va = _mm_loadu_si128((const __m128i*) a);
+	__m128i vb = _mm_loadu_si128((const __m128i*) b);
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) | 0x0e00) == 0xffff;
+}
+#else
+static inline bool cell_equal(const struct tui_cell* a, const struct tui_cell* b)
+{
+	uint64_t wa, wb;
+	memcpy(&wa, &a->attr, 8);
+	memcpy(&wb, &b->attr, 8);
+	return !((wa ^ wb) |
+		(a->attr.custom_id ^ b->attr.custom_id) | (a->ch ^ b->ch));
+}
+#endif
+
 /* sweep a row from a start offset until the first deviation
  * between front and back offset */
 static ssize_t find_row_ofs(
@@ -46,14 +78,36 @@ static ssize_t find_row_ofs(
 	struct tui_cell* back = &tui->back[pos];
 
 	for (pos = ofs; pos < tui->cols; pos++){
-		if (!tui_attr_equal(front[pos].attr,
-			back[pos].attr) || front[pos].ch != back[pos].ch){
+		if (!cell_equal(&front[pos], &back[pos]))
 			return pos;
-		}
 	}
 	return -1;
 }
 
+/* rows that haven't been written to since the last synch can be skipped */
+static bool row_dirty(struct tui_context* tui, size_t row)
+{
+	return !tui->dirty_rows || tui->dirty_rows[row];
+}
+
+static void row_synch(struct tui_context* tui)
+{
+	memcpy(tui->back, tui->front,
+		tui->rows * tui->cols * sizeof(struct tui_cell));
+	if (tui->dirty_rows)
+		memset(tui->dirty_rows, '\0', tui->rows);
+}
+
+void tui_screen_dirty_rows(struct tui_context* tui, size_t y1, size_t y2)
+{
+	tui->dirty |= DIRTY_PARTIAL;
+	if (!tui->dirty_rows)
+		return;
+
+	for (; y1 <= y2 && y1 < tui->rows; y1++)
+		tui->dirty_rows[y1] = 1;
+}
+
 static void pack_u32(uint32_t src, uint8_t* outb)
 {
 	outb[0] = (uint8_t)(src >> 0);
@@ -163,6 +217,381 @@ size_t tui_screen_tpack_sz(struct tui_context* tui)
 	;
 }
 
+/* state for building the runs of a v2 tpack */
+struct tpack_enc {
+	uint8_t* out;
+	size_t ofs;
+	size_t cap;
+	bool fail;
+
+	uint8_t pal[255][3];
+	size_t n_pal;
+	size_t pal_last;
+
+/* colors and attributes of the last non-skip run */
+	uint8_t attr[8];
+	bool have_attr;
+
+	size_t run_ofs;
+	size_t cp_ofs;
+	size_t run_n;
+	uint8_t run_flags;
+	uint32_t run_ch;
+	bool repeat;
+};
+
+static void enc_put(struct tpack_enc* E, const uint8_t* buf, size_t n)
+{
+	if (E->fail || E->cap - E->ofs < n){
+		E->fail = true;
+		return;
+	}
+
+	memcpy(&E->out[E->ofs], buf, n);
+	E->ofs += n;
+}
+
+static int enc_color(struct tpack_enc* E, const uint8_t rgb[static 3])
+{
+/* runs of the same color tend to alternate between a few entries */
+	if (E->pal_last < E->n_pal && memcmp(E->pal[E->pal_last], rgb, 3) == 0)
+		return E->pal_last;
+
+	for (size_t i = 0; i < E->n_pal; i++)
+		if (memcmp(E->pal[i], rgb, 3) == 0){
+			E->pal_last = i;
+			return i;
+		}
+
+	if (E->n_pal == 255)
+		return -1;
+
+	memcpy(E->pal[E->n_pal], rgb, 3);
+	E->pal_last = E->n_pal;
+	return E->n_pal++;
+}
+
+static void enc_close(struct tpack_enc* E)
+{
+	if (!E->run_n || E->fail)
+		return;
+
+/* all codes turned out the same, keep only the first */
+	if (!(E->run_flags & RRUN_SKIP) && E->run_n > 1 && E->repeat){
+		E->run_flags |= RRUN_REPEAT;
+		E->ofs = E->cp_ofs + (E->run_flags & RRUN_CH8 ? 1 : 4);
+	}
+
+	E->out[E->run_ofs + 0] = E->run_n;
+	E->out[E->run_ofs + 1] = E->run_flags;
+	E->run_n = 0;
+}
+
+static void enc_skip(struct tpack_enc* E)
+{
+	if (E->run_n && (E->run_flags & RRUN_SKIP) && E->run_n < 255){
+		E->run_n++;
+		return;
+	}
+
+	enc_close(E);
+	uint8_t run[2] = {0, RRUN_SKIP};
+	E->run_ofs = E->ofs;
+	enc_put(E, run, 2);
+	E->run_flags = RRUN_SKIP;
+	E->run_n = 1;
+}
+
+static void enc_code(struct tpack_enc* E, uint32_t ch)
+{
+	if (E->run_flags & RRUN_CH8){
+		uint8_t cp = ch;
+		enc_put(E, &cp, 1);
+	}
+	else {
+		uint8_t cp[4];
+		pack_u32(ch, cp);
+		enc_put(E, cp, 4);
+	}
+}
+
+static void enc_cell(struct tpack_enc* E, uint8_t rcell[static 12])
+{
+	uint32_t ch;
+	unpack_u32(&ch, &rcell[8]);
+	bool same = E->have_attr && memcmp(E->attr, rcell, 8) == 0;
+
+/* extend the current run */
+	if (same && E->run_n && E->run_n < 255 && !(E->run_flags & RRUN_SKIP) &&
+		(ch < 256 || !(E->run_flags & RRUN_CH8))){
+		if (ch != E->run_ch)
+			E->repeat = false;
+		enc_code(E, ch);
+		E->run_n++;
+		return;
+	}
+
+	enc_close(E);
+
+	uint8_t run[10] = {0, ch < 256 ? RRUN_CH8 : 0};
+	size_t run_sz = 2;
+
+	if (same)
+		run[1] |= RRUN_SAME;
+	else {
+		run[run_sz++] = rcell[6];
+		run[run_sz++] = rcell[7];
+
+		int ind = enc_color(E, &rcell[0]);
+		if (-1 == ind){
+			run[1] |= RRUN_FC_RGB;
+			memcpy(&run[run_sz], &rcell[0], 3);
+			run_sz += 3;
+		}
+		else
+			run[run_sz++] = ind;
+
+		ind = enc_color(E, &rcell[3]);
+		if (-1 == ind){
+			run[1] |= RRUN_BC_RGB;
+			memcpy(&run[run_sz], &rcell[3], 3);
+			run_sz += 3;
+		}
+		else
+			run[run_sz++] = ind;
+
+		memcpy(E->attr, rcell, 8);
+		E->have_attr = true;
+	}
+
+	E->run_ofs = E->ofs;
+	enc_put(E, run, run_sz);
+
+	E->run_flags = run[1];
+	E->run_n = 1;
+	E->run_ch = ch;
+	E->repeat = true;
+	E->cp_ofs = E->ofs;
+	enc_code(E, ch);
+}
+
+static void enc_line(struct tpack_enc* E, size_t line_ofs,
+	struct tui_raster_line* line, struct tui_raster_header* hdr)
+{
+	enc_close(E);
+	if (E->fail)
+		return;
+
+	memcpy(&E->out[line_ofs], line, sizeof(struct tui_raster_line));
+	hdr->cells += line->ncells;
+	hdr->lines++;
+}
+
+static size_t enc_line_begin(struct tpack_enc* E)
+{
+	size_t line_ofs = E->ofs;
+	struct tui_raster_line line = {0};
+	enc_put(E, (uint8_t*) &line, sizeof(line));
+	return line_ofs;
+}
+
+static void tpack_cursor_state(
+	struct tui_context* tui, struct tui_raster_header* hdr)
+{
+/* figure out what shape we want it in, style, blink rate etc. are
+ * all controlled 'raster' side. */
+	if (tui->dirty & DIRTY_CURSOR){
+		if (tui->cursor_off || tui->cursor_hard_off || tui->sbofs){
+			hdr->cursor_state = CURSOR_NONE;
+		}
+		else {
+			hdr->cursor_state = tui->defocus ? CURSOR_INACTIVE : CURSOR_ACTIVE;
+		}
+	}
+
+	hdr->cursor_state |= CURSOR_EXTHDRv1;
+
+	if (!tui->cursor)
+		hdr->cursor_state |= CURSOR_BLOCK;
+	else
+		hdr->cursor_state |=
+			(tui->cursor & (CURSOR_BLOCK | CURSOR_BAR | CURSOR_UNDER | CURSOR_HOLLOW));
+}
+
+static void tpack_header(
+	struct tui_context* tui, struct tui_raster_header* hdr, uint8_t* rbuf)
+{
+/* NOTE: REPLACE WITH PROPER PACKING */
+	memcpy(rbuf, hdr, sizeof(struct tui_raster_header));
+	if (tui->cursor_color_override){
+		rbuf[sizeof(*hdr)+0] = tui->cursor_color[0];
+		rbuf[sizeof(*hdr)+1] = tui->cursor_color[1];
+		rbuf[sizeof(*hdr)+2] = tui->cursor_color[2];
+	}
+	else {
+		rbuf[sizeof(*hdr)+0] = tui->colors[TUI_COL_CURSOR].rgb[0];
+		rbuf[sizeof(*hdr)+1] = tui->colors[TUI_COL_CURSOR].rgb[1];
+		rbuf[sizeof(*hdr)+2] = tui->colors[TUI_COL_CURSOR].rgb[2];
+	}
+}
+
+/*
+ * Same structure as the v1 packing in tui_screen_tpack, but with the cells
+ * as runs of shared attributes and colors as indices into a palette at the
+ * end of the buffer. The worst case can exceed that of v1 (which is what the
+ * buffer is sized for), so nothing in [tui] is modified until the pack has
+ * been completed and 0 means the caller should fall back to v1.
+ */
+static size_t tpack_v2(struct tui_context* tui,
+	struct tpack_gen_opts opts, uint8_t* rbuf, size_t rbuf_sz)
+{
+	if (rbuf_sz < raster_hdr_sz + 3)
+		return 0;
+
+	struct tui_raster_header hdr = {.flags = RPACK_V2};
+	arcan_tui_get_color(tui, TUI_COL_BG, hdr.bgc);
+	hdr.bgc[3] = tui->alpha;
+
+	struct tpack_enc E = {
+		.out = rbuf,
+		.ofs = sizeof(hdr) + 3,
+		.cap = rbuf_sz
+	};
+
+	uint8_t rcell[12];
+	bool last_cursor = tui->last_cursor.active;
+
+	if (opts.back){
+		opts.full = true;
+		opts.synch = false;
+	}
+
+	if (opts.full || (tui->dirty & DIRTY_FULL)){
+		struct tui_cell* front = opts.back ? tui->back : tui->front;
+
+		last_cursor = false;
+		hdr.flags |= RPACK_IFRAME;
+
+		for (size_t row = 0; row < tui->rows && !E.fail; row++){
+			size_t line_ofs = enc_line_begin(&E);
+			struct tui_raster_line line = {
+				.start_line = row,
+				.ncells = tui->cols
+			};
+
+			for (size_t col = 0; col < tui->cols; col++){
+				cell_to_rcell(tui, front++, rcell, 0);
+				enc_cell(&E, rcell);
+			}
+
+			enc_line(&E, line_ofs, &line, &hdr);
+		}
+	}
+
+/* delta update, the gaps between mismatches become skip runs */
+	else if (tui->dirty & DIRTY_PARTIAL){
+		for (size_t row = 0; row < tui->rows && !E.fail; row++){
+			if (!row_dirty(tui, row))
+				continue;
+
+			ssize_t ofs = find_row_ofs(tui, row, 0);
+			if (-1 == ofs)
+				continue;
+
+			size_t row_base = row * tui->cols;
+			size_t line_ofs = enc_line_begin(&E);
+			struct tui_raster_line line = {
+				.start_line = row,
+				.offset = ofs
+			};
+
+			while (ofs != -1){
+/* if we overdraw the save-cursor position, don't emit the glyph again */
+				if (last_cursor &&
+					tui->last_cursor.row == row && tui->last_cursor.col == ofs)
+					last_cursor = false;
+
+				cell_to_rcell(tui, &tui->front[row_base + ofs], rcell, 0);
+				enc_cell(&E, rcell);
+				line.ncells++;
+
+				ssize_t last_ofs = ofs;
+				ofs = find_row_ofs(tui, row, ofs+1);
+				if (-1 == ofs)
+					break;
+
+				for (; last_ofs + 1 != ofs; last_ofs++){
+					enc_skip(&E);
+					line.ncells++;
+				}
+			}
+
+			enc_line(&E, line_ofs, &line, &hdr);
+		}
+
+		hdr.flags |= RPACK_DFRAME;
+	}
+
+	size_t cx = tui->cx, cy = tui->cy;
+	if (tui->dirty & DIRTY_CURSOR){
+		if (tui->dirty == DIRTY_CURSOR)
+			hdr.flags |= RPACK_DFRAME;
+
+/* restore the last cursor position, then send the new one */
+		if (last_cursor &&
+			(tui->last_cursor.col != tui->cx || tui->last_cursor.row != tui->cy)){
+			struct tui_raster_line line = {
+				.ncells = 1,
+				.start_line = tui->last_cursor.row,
+				.offset = tui->last_cursor.col
+			};
+			size_t line_ofs = enc_line_begin(&E);
+			cell_to_rcell(tui, &tui->front[
+				line.start_line * tui->cols + line.offset], rcell, 0);
+			enc_cell(&E, rcell);
+			enc_line(&E, line_ofs, &line, &hdr);
+		}
+
+		if (tui->hooks.cursor_lookup)
+			tui->hooks.cursor_lookup(tui, &cx, &cy);
+
+		struct tui_raster_line line = {
+			.ncells = 1,
+			.start_line = cy,
+			.offset = cx
+		};
+		size_t line_ofs = enc_line_begin(&E);
+		cell_to_rcell(tui, &tui->front[
+			line.start_line * tui->cols + line.offset], rcell, 1);
+		enc_cell(&E, rcell);
+		enc_line(&E, line_ofs, &line, &hdr);
+	}
+
+	enc_put(&E, (uint8_t*) E.pal, E.n_pal * 3);
+	uint8_t n_pal = E.n_pal;
+	enc_put(&E, &n_pal, 1);
+
+	if (E.fail)
+		return 0;
+
+/* commit the state changes the v1 path would have done while packing */
+	if (opts.synch)
+		row_synch(tui);
+
+	tui->last_cursor.active = last_cursor;
+	if (tui->dirty & DIRTY_CURSOR){
+		tui->last_cursor.row = cy;
+		tui->last_cursor.col = cx;
+		tui->last_cursor.active = true;
+	}
+
+	hdr.data_sz = E.ofs;
+	tpack_cursor_state(tui, &hdr);
+	tpack_header(tui, &hdr, rbuf);
+
+	return E.ofs;
+}
+
 size_t tui_screen_tpack(struct tui_context* tui,
 	struct tpack_gen_opts opts, uint8_t* rbuf, size_t rbuf_sz)
 {
@@ -170,6 +599,12 @@ size_t tui_screen_tpack(struct tui_context* tui,
 	if (!opts.full && tui->dirty == DIRTY_NONE)
 		return 0;
 
+	if (!opts.compat){
+		size_t rv = tpack_v2(tui, opts, rbuf, rbuf_sz);
+		if (rv)
+			return rv;
+	}
+
 /* header gets written to the buffer last */
 	struct tui_raster_header hdr = {};
 	arcan_tui_get_color(tui, TUI_COL_BG, hdr.bgc);
@@ -218,12 +653,21 @@ size_t tui_screen_tpack(struct tui_context* tui,
 				front++;
 			}
 		}
+
+		if (opts.synch && tui->dirty_rows)
+			memset(tui->dirty_rows, '\0', tui->rows);
 	}
 
 /* delta update, find_row_ofs gives the next mismatch on the row */
 	else if (tui->dirty & DIRTY_PARTIAL){
 		for (size_t row = 0; row < tui->rows; row++){
+			if (!row_dirty(tui, row))
+				continue;
+
 			ssize_t ofs = find_row_ofs(tui, row, 0);
+			if (opts.synch && tui->dirty_rows)
+				tui->dirty_rows[row] = 0;
+
 			if (-1 == ofs)
 				continue;
 
@@ -334,42 +778,15 @@ size_t tui_screen_tpack(struct tui_context* tui,
 		outsz += cell_to_rcell(tui, &tui->front[
 			line.start_line * tui->cols + line.offset], &out[outsz], 1);
 
-/* figure out what shape we want it in, style, blink rate etc. are
- * all controlled 'raster' side. */
-		if (tui->cursor_off || tui->cursor_hard_off || tui->sbofs){
-			hdr.cursor_state = CURSOR_NONE;
-		}
-		else {
-			hdr.cursor_state = tui->defocus ? CURSOR_INACTIVE : CURSOR_ACTIVE;
-		}
-
 		tui->last_cursor.active = true;
 	}
 
 	hdr.data_sz = hdr.lines * raster_line_sz +
 		hdr.cells * raster_cell_sz + raster_hdr_sz + 3;
 
-	hdr.cursor_state |= CURSOR_EXTHDRv1;
-
-	if (!tui->cursor)
-		hdr.cursor_state |= CURSOR_BLOCK;
-	else
-		hdr.cursor_state |=
-			(tui->cursor & (CURSOR_BLOCK | CURSOR_BAR | CURSOR_UNDER | CURSOR_HOLLOW));
-
 /* write the header and return */
-/* NOTE: REPLACE WITH PROPER PACKING */
-	memcpy(rbuf, &hdr, sizeof(hdr));
-	if (tui->cursor_color_override){
-		rbuf[sizeof(hdr)+0] = tui->cursor_color[0];
-		rbuf[sizeof(hdr)+1] = tui->cursor_color[1];
-		rbuf[sizeof(hdr)+2] = tui->cursor_color[2];
-	}
-	else {
-		rbuf[sizeof(hdr)+0] = tui->colors[TUI_COL_CURSOR].rgb[0];
-		rbuf[sizeof(hdr)+1] = tui->colors[TUI_COL_CURSOR].rgb[1];
-		rbuf[sizeof(hdr)+2] = tui->colors[TUI_COL_CURSOR].rgb[2];
-	}
+	tpack_cursor_state(tui, &hdr);
+	tpack_header(tui, &hdr, rbuf);
 
 	return outsz;
 }
@@ -415,30 +832,11 @@ int tui_tpack_unpack(struct tui_context* C,
 	uint8_t* buf, size_t buf_sz, size_t x, size_t y, size_t x2, size_t y2)
 {
 	struct tui_raster_header hdr;
-	if (!buf_sz || buf_sz < sizeof(struct tui_raster_header))
-		return -1;
+	struct tui_raster_unpack src;
 
 /* just verbatim the same as raster_tobuf, but unpacks cell into C instead */
-	memcpy(&hdr, buf, sizeof(struct tui_raster_header));
-
-/* recalculate and compare */
-	size_t hdr_ver_sz = hdr.lines * raster_line_sz +
-		hdr.cells * raster_cell_sz + raster_hdr_sz;
-
-	if (hdr.cursor_state & CURSOR_EXTHDRv1)
-		hdr_ver_sz += 3;
-
-	if (hdr.data_sz > buf_sz || hdr.data_sz != hdr_ver_sz){
+	if (!tui_raster_unpack_header(&src, &hdr, buf, buf_sz))
 		return -1;
-	}
-
-	buf_sz -= sizeof(struct tui_raster_header);
-	buf += sizeof(struct tui_raster_header);
-
-	if (hdr.cursor_state & CURSOR_EXTHDRv1){
-		buf_sz -= 3;
-		buf += 3;
-	}
 
 /* if it is not a delta frame, just clear region to bgcolor first and
  * make sure the window size match (unless w, h are set) */
@@ -482,22 +880,18 @@ int tui_tpack_unpack(struct tui_context* C,
 		y2 = C->rows;
 
 	for (size_t i = 0; i < hdr.lines; i++){
-		if (buf_sz < sizeof(struct tui_raster_line))
-			return -1;
-
 /* read / unpack line metadata */
 		struct tui_raster_line line;
+		if (!tui_raster_unpack_line(&src, &line))
+			return -1;
 
-		memcpy(&line, buf, sizeof(struct tui_raster_line));
-		buf += sizeof(line);
-
-		for (size_t i = line.offset; line.ncells && buf_sz >= raster_cell_sz; i++){
+		uint8_t rcell[12];
+		for (size_t i = line.offset;
+			line.ncells && tui_raster_unpack_cell(&src, rcell); i++){
 			line.ncells--;
 
 /* extract each cell */
-			struct tui_cell cell = rcell_to_cell(buf);
-			buf += raster_cell_sz;
-			buf_sz -= raster_cell_sz;
+			struct tui_cell cell = rcell_to_cell(rcell);
 
 /* just write cell into C if it is within the clipping region */
 			if (line.start_line < y2 && i < x2){
@@ -521,8 +915,13 @@ int tui_screen_refresh(struct tui_context* tui)
 		return -1;
 	}
 
+/* v2 only when the server end says it can be consumed, a forwarding proxy
+ * can't know until the other end has announced its version */
+	bool v2 = atomic_load(&tui->acon.addr->server_caps) & SHMIF_SRVCAP_TPACK_V2;
+
 	size_t rv = tui_screen_tpack(tui,
-		(struct tpack_gen_opts){.synch = true}, tui->acon.vidb, tui->acon.vbufsize);
+		(struct tpack_gen_opts){.synch = true, .compat = !v2},
+		tui->acon.vidb, tui->acon.vbufsize);
 	tui->dirty = DIRTY_NONE;
 
 	if (!rv)
@@ -4,6 +4,16 @@
 #define LUACTX_OPEN_FILES 64
 #endif
 
+/* line-buffered input starts out with this much and grows (doubling) when a
+ * single line does not fit, up to the cap where it is returned in pieces */
+#ifndef NBIO_BUFFER_BASE
+#define NBIO_BUFFER_BASE 65536
+#endif
+
+#ifndef NBIO_BUFFER_CAP
+#define NBIO_BUFFER_CAP (1024 * 1024)
+#endif
+
 struct io_job;
 struct io_job {
 	char* buf;
@@ -17,7 +27,6 @@ struct nonblock_io {
 
 	bool eofm;
 	bool lfstrip;
-	off_t ofs;
 	char lfch;
 
 	int fd; /* will be read from */
@@ -35,8 +44,13 @@ struct nonblock_io {
 	intptr_t data_handler; /* callback on_data_in */
 	intptr_t write_handler; /* callback when queue flushed */
 
-/* in line-buffered mode, this is used for input */
-	char buf[4096];
+/* in line-buffered mode, this is used for input with [head, ofs) pending,
+ * allocated on the first read and released on close */
+	char* buf;
+	size_t buf_sz;
+	size_t buf_cap;
+	size_t head;
+	size_t ofs;
 
 	uint32_t canary_post;
 };
@@ -66,9 +80,10 @@ void alt_nbio_register(lua_State* ctx,
  * If line-buffering is set, the type of the top argument will determine
  * the line processing behaviour:
  *
- *  table    : append (n-indexed)
- *  function : callback(line, eof)
- *  else     : return line, alive
+ *  table, function : append (n-indexed), then callback(table, eof) once
+ *  table           : append (n-indexed)
+ *  function        : callback(line, eof)
+ *  else            : return line, alive
  *
  * The object property lfstrip will provide the strings without linefeeds
  * if set. This is to reduce excessive copying / postprocessing.
@@ -23,8 +23,32 @@ struct cell {
 	uint8_t attr_ext;
 };
 
+/*
+ * Rasterized cells for vector fonts, keyed on code, style and colors. The
+ * raster context is shared by everything drawing with the same set of fonts
+ * (one per font group in the engine), and terminals tend to use few color
+ * combinations, so most cells become row copies rather than going through
+ * freetype, blending and style switches every time they change.
+ */
+#define GLYPH_CACHE_SLOTS 4096
+#define GLYPH_CACHE_LIMIT (4 * 1024 * 1024)
+
+struct glyph_slot {
+	uint32_t ucs4;
+	uint8_t style;
+	shmif_pixel fc, bc;
+	shmif_pixel* px;
+};
+
+struct glyph_cache {
+	struct glyph_slot slots[GLYPH_CACHE_SLOTS];
+	size_t used, limit;
+	shmif_pixel* scratch;
+};
+
 struct tui_raster_context {
 	struct tui_font* fonts[4];
+	struct glyph_cache* glyphs;
 	int last_style;
 	int cursor_state;
 
@@ -49,12 +73,28 @@ struct tui_raster_context {
 	size_t max_x, max_y;
 };
 
+static void glyph_cache_reset(struct tui_raster_context* ctx)
+{
+	if (!ctx->glyphs)
+		return;
+
+	for (size_t i = 0; i < GLYPH_CACHE_SLOTS; i++){
+		free(ctx->glyphs->slots[i].px);
+		ctx->glyphs->slots[i] = (struct glyph_slot){0};
+	}
+
+	free(ctx->glyphs->scratch);
+	ctx->glyphs->scratch = NULL;
+	ctx->glyphs->used = 0;
+}
+
 void tui_raster_setfont(
 	struct tui_raster_context* ctx, struct tui_font** src, size_t n_fonts)
 {
 	for (size_t i = 0; i < 4; i++)
 		ctx->fonts[i] = i < n_fonts ? src[i] : NULL;
 	ctx->last_style = -1;
+	glyph_cache_reset(ctx);
 }
 
 struct tui_raster_context* tui_raster_setup(size_t cell_w, size_t cell_h)
@@ -82,6 +122,9 @@ void tui_raster_get_cell_size(
 
 void tui_raster_cell_size(struct tui_raster_context* ctx, size_t w, size_t h)
 {
+/* this is also the signal that the font or hinting has changed */
+	glyph_cache_reset(ctx);
+
 	ctx->cell_w = w;
 	ctx->cell_h = h;
 }
@@ -119,6 +162,176 @@ static void unpack_cell(uint8_t unpack[static 12], struct cell* dst, uint8_t alp
 	unpack_u32(&dst->ucs4, &unpack[8]);
 }
 
+bool tui_raster_unpack_header(struct tui_raster_unpack* dst,
+	struct tui_raster_header* hdr, uint8_t* buf, size_t buf_sz)
+{
+	if (!buf_sz || buf_sz < sizeof(struct tui_raster_header))
+		return false;
+
+	memcpy(hdr, buf, sizeof(struct tui_raster_header));
+	*dst = (struct tui_raster_unpack){0};
+
+	size_t hdr_sz = raster_hdr_sz;
+	if (hdr->cursor_state & CURSOR_EXTHDRv1){
+		dst->cursor = &buf[hdr_sz];
+		hdr_sz += 3;
+	}
+
+	if (hdr->data_sz > buf_sz || hdr->data_sz < hdr_sz)
+		return false;
+
+/* the caller might provide a larger input buffer than what the header sets,
+ * and that will still clamp/drop-out etc. but mismatch between the header
+ * fields is, of course, not permitted. */
+	if (!(hdr->flags & RPACK_V2)){
+		size_t hdr_ver_sz = hdr->lines * raster_line_sz +
+			hdr->cells * raster_cell_sz + hdr_sz;
+
+		if (hdr->data_sz != hdr_ver_sz)
+			return false;
+
+		dst->buf = &buf[hdr_sz];
+		dst->buf_sz = hdr->data_sz - hdr_sz;
+		return true;
+	}
+
+/* v2 ends with the palette and its length */
+	if (hdr->data_sz == hdr_sz)
+		return false;
+
+	dst->v2 = true;
+	dst->n_pal = buf[hdr->data_sz - 1];
+
+	size_t pal_sz = dst->n_pal * 3 + 1;
+	if (hdr->data_sz - hdr_sz < pal_sz)
+		return false;
+
+	dst->pal = &buf[hdr->data_sz - pal_sz];
+	dst->buf = &buf[hdr_sz];
+	dst->buf_sz = hdr->data_sz - hdr_sz - pal_sz;
+
+	return true;
+}
+
+bool tui_raster_unpack_line(
+	struct tui_raster_unpack* src, struct tui_raster_line* line)
+{
+	if (src->buf_sz < raster_line_sz)
+		return false;
+
+	memcpy(line, src->buf, raster_line_sz);
+	src->buf += raster_line_sz;
+	src->buf_sz -= raster_line_sz;
+
+/* runs never continue across lines */
+	src->run_n = 0;
+	return true;
+}
+
+static bool unpack_color(
+	struct tui_raster_unpack* src, bool rgb, uint8_t** in, uint8_t* dst)
+{
+	uint8_t* col = *in;
+
+	if (!rgb){
+		if (*col >= src->n_pal)
+			return false;
+		col = &src->pal[*col * 3];
+		*in += 1;
+	}
+	else
+		*in += 3;
+
+	dst[0] = col[0];
+	dst[1] = col[1];
+	dst[2] = col[2];
+	return true;
+}
+
+static bool unpack_run(struct tui_raster_unpack* src)
+{
+	if (src->buf_sz < 2 || !src->buf[0])
+		return false;
+
+	size_t n = src->buf[0];
+	uint8_t flags = src->buf[1];
+	src->buf += 2;
+	src->buf_sz -= 2;
+
+	if (!(flags & (RRUN_SKIP | RRUN_SAME))){
+		size_t need = 2 +
+			(flags & RRUN_FC_RGB ? 3 : 1) + (flags & RRUN_BC_RGB ? 3 : 1);
+
+		if (src->buf_sz < need)
+			return false;
+
+		uint8_t* in = src->buf;
+		src->run_cell[6] = *in++;
+		src->run_cell[7] = *in++;
+
+		if (!unpack_color(src, flags & RRUN_FC_RGB, &in, &src->run_cell[0]) ||
+			!unpack_color(src, flags & RRUN_BC_RGB, &in, &src->run_cell[3]))
+			return false;
+
+		src->buf += need;
+		src->buf_sz -= need;
+	}
+
+	if (!(flags & RRUN_SKIP)){
+		size_t cp_sz = (flags & RRUN_CH8 ? 1 : 4) * (flags & RRUN_REPEAT ? 1 : n);
+		if (src->buf_sz < cp_sz)
+			return false;
+
+		src->run_cp = src->buf;
+		src->buf += cp_sz;
+		src->buf_sz -= cp_sz;
+	}
+
+	src->run_n = n;
+	src->run_flags = flags;
+	return true;
+}
+
+bool tui_raster_unpack_cell(
+	struct tui_raster_unpack* src, uint8_t cell[static 12])
+{
+	if (!src->v2){
+		if (src->buf_sz < raster_cell_sz)
+			return false;
+
+		memcpy(cell, src->buf, raster_cell_sz);
+		src->buf += raster_cell_sz;
+		src->buf_sz -= raster_cell_sz;
+		return true;
+	}
+
+	if (!src->run_n && !unpack_run(src))
+		return false;
+
+	src->run_n--;
+
+/* same 'skip-draw' cell as the v1 encoder emits */
+	if (src->run_flags & RRUN_SKIP){
+		memset(cell, '\0', raster_cell_sz);
+		cell[6] = CATTR_SKIP;
+		return true;
+	}
+
+	memcpy(cell, src->run_cell, 8);
+
+	if (src->run_flags & RRUN_CH8){
+		cell[8] = src->run_cp[0];
+		cell[9] = cell[10] = cell[11] = 0;
+	}
+	else
+		memcpy(&cell[8], src->run_cp, 4);
+
+	if (!(src->run_flags & RRUN_REPEAT))
+		src->run_cp += src->run_flags & RRUN_CH8 ? 1 : 4;
+
+	return true;
+}
+
 static void drawborder_edge(
 	struct tui_raster_context* ctx, struct cell* cell, shmif_pixel* vidp,
 	size_t pitch, int x, int y, size_t maxx, size_t maxy, int bv)
@@ -203,6 +416,126 @@ static void drawcursor_px(
 	}
 }
 
+static void set_style(
+	struct tui_raster_context* ctx, TTF_Font** fonts, int style)
+{
+/* seriously expensive so only perform if we actually need to as it can cause a
+ * glyph cache flush (bold / italic / ...), other option would be to run
+ * separate glyph caches on the different style options.. */
+	if (style != ctx->last_style){
+		ctx->last_style = style;
+		TTF_SetFontStyle(fonts[0], style);
+		if (fonts[1])
+			TTF_SetFontStyle(fonts[1], style);
+	}
+}
+
+static struct glyph_slot* glyph_lookup(struct glyph_cache* cache,
+	uint32_t ucs4, uint8_t style, shmif_pixel fc, shmif_pixel bc)
+{
+	size_t ind = ((ucs4 * 2654435761u) ^ (fc * 40503u) ^ (bc * 9973u) ^ style);
+	ind &= GLYPH_CACHE_SLOTS - 1;
+
+	for (;;){
+		struct glyph_slot* slot = &cache->slots[ind];
+		if (!slot->px || (slot->ucs4 == ucs4 &&
+			slot->style == style && slot->fc == fc && slot->bc == bc))
+			return slot;
+		ind = (ind + 1) & (GLYPH_CACHE_SLOTS - 1);
+	}
+}
+
+/*
+ * Same drawing as the uncached path but into a scratch row that is padded by
+ * a cell on each side so glyph overhang doesn't wrap into the next row.
+ */
+static bool glyph_build(struct tui_raster_context* ctx, struct glyph_slot* slot,
+	TTF_Font** fonts, size_t nfonts, uint32_t ucs4, int style,
+	uint8_t fg[4], uint8_t bg[4], shmif_pixel fc, shmif_pixel bc)
+{
+	size_t stride = ctx->cell_w * 3;
+	shmif_pixel* scratch = ctx->glyphs->scratch;
+	shmif_pixel* px = malloc(ctx->cell_w * ctx->cell_h * sizeof(shmif_pixel));
+	if (!px)
+		return false;
+
+	draw_box_px(scratch, stride, stride, ctx->cell_h,
+		0, 0, stride, ctx->cell_h, bc);
+
+	set_style(ctx, fonts, style);
+
+	int adv = 0;
+	unsigned xs = 0;
+	unsigned ind = 0;
+	TTF_RenderUNICODEglyph(&scratch[ctx->cell_w],
+		ctx->cell_w, ctx->cell_h, stride, fonts, nfonts, ucs4, &xs,
+		fg, bg, true, true, style, &adv, &ind
+	);
+
+	for (size_t y = 0; y < ctx->cell_h; y++)
+		memcpy(&px[y * ctx->cell_w], &scratch[y * stride + ctx->cell_w],
+			ctx->cell_w * sizeof(shmif_pixel));
+
+	*slot = (struct glyph_slot){
+		.ucs4 = ucs4,
+		.style = style,
+		.fc = fc,
+		.bc = bc,
+		.px = px
+	};
+	ctx->glyphs->used++;
+
+	return true;
+}
+
+/*
+ * Draw from the glyph cache, returns false if the glyph should go the
+ * direct route.
+ */
+static bool drawglyph_cached(struct tui_raster_context* ctx,
+	TTF_Font** fonts, size_t nfonts, uint32_t ucs4, int style,
+	shmif_pixel* vidp, size_t pitch, shmif_pixel fc, shmif_pixel bc)
+{
+	size_t cell_sz = ctx->cell_w * ctx->cell_h * sizeof(shmif_pixel);
+
+	if (!ctx->glyphs){
+		ctx->glyphs = malloc(sizeof(struct glyph_cache));
+		if (!ctx->glyphs)
+			return false;
+		*ctx->glyphs = (struct glyph_cache){0};
+	}
+
+/* keep the probe sequences short and the memory bounded for large cells,
+ * starting over is cheap compared to tracking use */
+	ctx->glyphs->limit = GLYPH_CACHE_LIMIT / (cell_sz ? cell_sz : 1);
+	if (ctx->glyphs->limit > GLYPH_CACHE_SLOTS - (GLYPH_CACHE_SLOTS >> 2))
+		ctx->glyphs->limit = GLYPH_CACHE_SLOTS - (GLYPH_CACHE_SLOTS >> 2);
+
+	if (ctx->glyphs->used >= ctx->glyphs->limit)
+		glyph_cache_reset(ctx);
+
+	if (!ctx->glyphs->scratch){
+		ctx->glyphs->scratch = malloc(cell_sz * 3);
+		if (!ctx->glyphs->scratch)
+			return false;
+	}
+
+	struct glyph_slot* slot = glyph_lookup(ctx->glyphs, ucs4, style, fc, bc);
+	if (!slot->px){
+		uint8_t fg[4], bg[4];
+		SHMIF_RGBA_DECOMP(fc, &fg[0], &fg[1], &fg[2], &fg[3]);
+		SHMIF_RGBA_DECOMP(bc, &bg[0], &bg[1], &bg[2], &bg[3]);
+		if (!glyph_build(ctx, slot, fonts, nfonts, ucs4, style, fg, bg, fc, bc))
+			return false;
+	}
+
+	for (size_t y = 0; y < ctx->cell_h; y++)
+		memcpy(&vidp[y * pitch], &slot->px[y * ctx->cell_w],
+			ctx->cell_w * sizeof(shmif_pixel));
+
+	return true;
+}
+
 static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 	shmif_pixel* vidp, size_t pitch, int x, int y, size_t maxx, size_t maxy)
 {
@@ -260,8 +593,18 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 			draw_cursor = true;
 	}
 
-	draw_box_px(vidp,
-		pitch, maxx, maxy, x, y, ctx->cell_w, ctx->cell_h, bc);
+	int prem = TTF_STYLE_NORMAL;
+	prem    |= TTF_STYLE_ITALIC * !!(cell->attr & CATTR_ITALIC);
+	prem    |= TTF_STYLE_BOLD   * !!(cell->attr & CATTR_BOLD);
+
+/* each cell is drawn on its own without kerning state from the previous one,
+ * so the result only depends on code, style and colors */
+	bool cached = cell->ucs4 && drawglyph_cached(ctx, fonts, nfonts,
+		cell->ucs4, prem, &vidp[y * pitch + x], pitch, cell->fc, bc);
+
+	if (!cached)
+		draw_box_px(vidp,
+			pitch, maxx, maxy, x, y, ctx->cell_w, ctx->cell_h, bc);
 
 /* fast-path, just clear to background and draw line attrs */
 	if (!cell->ucs4){
@@ -273,34 +616,23 @@ static size_t drawglyph(struct tui_raster_context* ctx, struct cell* cell,
 		return ctx->cell_w;
 	}
 
-	int prem = TTF_STYLE_NORMAL;
-	prem    |= TTF_STYLE_ITALIC * !!(cell->attr & CATTR_ITALIC);
-	prem    |= TTF_STYLE_BOLD   * !!(cell->attr & CATTR_BOLD);
-
-/* seriously expensive so only perform if we actually need to as it can cause a
- * glyph cache flush (bold / italic / ...), other option would be to run
- * separate glyph caches on the different style options.. */
-	if (prem != ctx->last_style){
-		ctx->last_style = prem;
-		TTF_SetFontStyle(fonts[0], prem);
-		if (fonts[1])
-			TTF_SetFontStyle(fonts[1], prem);
-	}
-
-	uint8_t fg[4], bg[4];
-	SHMIF_RGBA_DECOMP(cell->fc, &fg[0], &fg[1], &fg[2], &fg[3]);
-	SHMIF_RGBA_DECOMP(bc, &bg[0], &bg[1], &bg[2], &bg[3]);
+	if (!cached){
+		uint8_t fg[4], bg[4];
+		SHMIF_RGBA_DECOMP(cell->fc, &fg[0], &fg[1], &fg[2], &fg[3]);
+		SHMIF_RGBA_DECOMP(bc, &bg[0], &bg[1], &bg[2], &bg[3]);
+		set_style(ctx, fonts, prem);
 
 	/* these are mainly used as state machine for kernel / shaping,
 	 * we need the 'x-start' position from the previous glyph and commit
 	 * that to the line-offset table for coordinate translation */
-	int adv = 0;
-	unsigned xs = 0;
-	unsigned ind = 0;
-	TTF_RenderUNICODEglyph(&vidp[y * pitch + x],
-		ctx->cell_w, ctx->cell_h, pitch, fonts, nfonts, cell->ucs4, &xs,
-		fg, bg, true, true, ctx->last_style, &adv, &ind
-	);
+		int adv = 0;
+		unsigned xs = 0;
+		unsigned ind = 0;
+		TTF_RenderUNICODEglyph(&vidp[y * pitch + x],
+			ctx->cell_w, ctx->cell_h, pitch, fonts, nfonts, cell->ucs4, &xs,
+			fg, bg, true, true, ctx->last_style, &adv, &ind
+		);
+	}
 
 /* add line-marks, this actually does not belong here, it should be part of the
  * style marker to the TTF_RenderUNICODEglyph - the code should be added as
@@ -331,32 +663,14 @@ static int raster_tobuf(
 	uint8_t* buf, size_t buf_sz)
 {
 	struct tui_raster_header hdr;
-	if (!buf_sz || buf_sz < sizeof(struct tui_raster_header))
-		return -1;
-
+	struct tui_raster_unpack src;
 	bool update = false;
-	memcpy(&hdr, buf, sizeof(struct tui_raster_header));
-	bool extcursor = !!(hdr.cursor_state & CURSOR_EXTHDRv1);
 
-/* the caller might provide a larger input buffer than what the header sets,
- * and that will still clamp/drop-out etc. but mismatch between the header
- * fields is, of course, not permitted. */
-	size_t hdr_ver_sz = hdr.lines * raster_line_sz +
-		hdr.cells * raster_cell_sz + raster_hdr_sz +
-		extcursor * 3;
-
-	if (hdr.data_sz > buf_sz || hdr.data_sz != hdr_ver_sz){
+	if (!tui_raster_unpack_header(&src, &hdr, buf, buf_sz))
 		return -1;
-	}
 
-	buf_sz -= sizeof(struct tui_raster_header);
-	buf += sizeof(struct tui_raster_header);
-
-	if (extcursor){
-		tui_raster_cursor_color(ctx, buf);
-		buf_sz -= 3;
-		buf += 3;
-	}
+	if (src.cursor)
+		tui_raster_cursor_color(ctx, src.cursor);
 
 	shmif_pixel bgc = SHMIF_RGBA(hdr.bgc[0], hdr.bgc[1], hdr.bgc[2], hdr.bgc[3]);
 
@@ -398,15 +712,11 @@ static int raster_tobuf(
 	size_t last_line = 0;
 	size_t draw_y = 0;
 
-	for (size_t i = 0; i < hdr.lines && buf_sz; i++){
-		if (buf_sz < sizeof(struct tui_raster_line))
-			return -1;
-
+	for (size_t i = 0; i < hdr.lines && src.buf_sz; i++){
 /* read / unpack line metadata */
 		struct tui_raster_line line;
-
-		memcpy(&line, buf, sizeof(struct tui_raster_line));
-		buf += sizeof(line);
+		if (!tui_raster_unpack_line(&src, &line))
+			return -1;
 
 /* remember the lower line we were at, these are not always ordered */
 		if (line.start_line > last_line)
@@ -441,14 +751,14 @@ static int raster_tobuf(
 			*x1 = draw_x;
 		}
 
-		for (size_t i = line.offset; line.ncells && buf_sz >= raster_cell_sz; i++){
+		uint8_t rcell[12];
+		for (size_t i = line.offset;
+			line.ncells && tui_raster_unpack_cell(&src, rcell); i++){
 			line.ncells--;
 
 /* extract each cell */
 			struct cell cell;
-			unpack_cell(buf, &cell, hdr.bgc[3]);
-			buf += raster_cell_sz;
-			buf_sz -= raster_cell_sz;
+			unpack_cell(rcell, &cell, hdr.bgc[3]);
 
 /* outsource cursor? then invoke external - for more custom cursors that cover
  * a larger area or multiple cursors on the same buffer, these need to be
@@ -568,5 +878,7 @@ void tui_raster_free(struct tui_raster_context* ctx)
 	if (!ctx)
 		return;
 
+	glyph_cache_reset(ctx);
+	free(ctx->glyphs);
 	free(ctx);
 }
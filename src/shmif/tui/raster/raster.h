@@ -57,6 +57,22 @@
  * bit 4: border-left
  * bit 5: border-top
  * bit 6: treat color as palette reference (first byte of front_color)
+ *
+ * With RPACK_V2 set in the header flags, the cells of each line are instead
+ * packed as runs of cells that share colors and attributes:
+ *
+ * 1 byte  number of cells in the run (1..255)
+ * 1 byte  run flags (enum raster_run)
+ * 2 bytes attribute bitmap            (unless RRUN_SKIP or RRUN_SAME)
+ * 1 or 3  front_color palette index or rgb (unless RRUN_SKIP or RRUN_SAME)
+ * 1 or 3  back_color palette index or rgb  (unless RRUN_SKIP or RRUN_SAME)
+ * n * 1|4 ucs4 codes, or just one with RRUN_REPEAT (unless RRUN_SKIP)
+ *
+ * Runs do not cross line records. The palette is local to the buffer and
+ * placed last: n * 3 bytes rgb followed by 1 byte n. A line with multiple
+ * changed spans is sent as one line record with skip runs between the spans,
+ * which is cheaper than a new line header. data_sz covers all of this and is
+ * authoritative as the size can no longer be derived from lines and cells.
  */
 #include "raster_const.h"
 
@@ -81,6 +97,15 @@ enum cell_extr_attr {
 	CEATTR_BORDER_ALL   = 60
 };
 
+enum raster_run {
+	RRUN_SKIP   = 1,  /* leave cells as is, nothing follows the run header */
+	RRUN_FC_RGB = 2,  /* front color is rgb rather than a palette index */
+	RRUN_BC_RGB = 4,  /* back color is rgb rather than a palette index */
+	RRUN_CH8    = 8,  /* codes are single bytes */
+	RRUN_REPEAT = 16, /* one code is repeated for all cells in the run */
+	RRUN_SAME   = 32  /* reuse colors and attributes of the last run */
+};
+
 enum raster_content {
 /* monospaces, left to right, 1 data cell to 1 visible cell on a virtual grid */
 	LINE_NORMAL = 0,
@@ -135,7 +160,8 @@ struct tui_font {
 
 enum raster_flags {
 	RPACK_IFRAME = 1,
-	RPACK_DFRAME = 2
+	RPACK_DFRAME = 2,
+	RPACK_V2     = 4
 };
 
 struct cursor_header {
@@ -161,6 +187,37 @@ struct __attribute__((packed)) tui_raster_header {
 	uint8_t cursor_state;
 };
 
+/*
+ * Cursor for walking the lines and cells of a packed buffer regardless of
+ * version, cells are returned in the v1 (12 byte) form.
+ */
+struct tui_raster_unpack {
+	uint8_t* buf;
+	size_t buf_sz;
+
+/* ext- cursor color, if provided */
+	uint8_t* cursor;
+
+	bool v2;
+	uint8_t* pal;
+	size_t n_pal;
+
+	size_t run_n;
+	uint8_t run_flags;
+	uint8_t* run_cp;
+	uint8_t run_cell[8];
+};
+
+/* Validate the header and sizes of [buf] and prepare [dst] for walking it */
+bool tui_raster_unpack_header(struct tui_raster_unpack* dst,
+	struct tui_raster_header* hdr, uint8_t* buf, size_t buf_sz);
+
+bool tui_raster_unpack_line(
+	struct tui_raster_unpack* src, struct tui_raster_line* line);
+
+bool tui_raster_unpack_cell(
+	struct tui_raster_unpack* src, uint8_t cell[static 12]);
+
 /* Build a new raster context based on the provided set of fonts,
  * this needs to be reset/rebuilt on font changes */
 struct tui_raster_context* tui_raster_setup(size_t cell_w, size_t cell_h);
@@ -189,7 +246,8 @@ int tui_raster_render(struct tui_raster_context* ctx,
 	struct arcan_shmif_cont* dst, uint8_t* buf, size_t buf_sz);
 #endif
 
-/* Called when the cell size has unexpectedly changed */
+/* Called when the cell size has unexpectedly changed, or the fonts have
+ * been modified in place (size, hinting), drops cached glyphs */
 void tui_raster_cell_size(struct tui_raster_context* ctx, size_t w, size_t h);
 
 void tui_raster_get_cell_size(
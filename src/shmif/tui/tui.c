@@ -161,7 +161,7 @@ static void write_front_checked(struct tui_context* c,
 	data->draw_ch = data->ch = uc;
 	if (attr)
 		data->attr = *attr;
-	c->dirty |= DIRTY_PARTIAL;
+	tui_screen_dirty_rows(c, c->cy, c->cy);
 }
 
 size_t arcan_tui_ucs4utf8(uint32_t cp, char dst[static 4])
@@ -824,6 +824,8 @@ void arcan_tui_eraseattr_region(struct tui_context* c,
 				data->fstamp = c->fstamp;
 			}
 		}
+
+	tui_screen_dirty_rows(c, y1, y2);
 }
 
 void arcan_tui_erase_region(struct tui_context* c,
@@ -906,6 +908,7 @@ void arcan_tui_writeattr_at(struct tui_context* c,
 	assert(c->screen == NULL);
 	if (x < c->cols && y < c->rows){
 		c->front[y * c->cols + x].attr = *attr;
+		tui_screen_dirty_rows(c, y, y);
 	}
 
 	flag_cursor(c);
@@ -1195,7 +1198,7 @@ bool arcan_tui_tpack(struct tui_context* tui, uint8_t** rbuf, size_t* rbuf_sz)
 		return false;
 
 	*rbuf_sz = tui_screen_tpack(tui,
-		(struct tpack_gen_opts){.full = true}, *rbuf, cap);
+		(struct tpack_gen_opts){.full = true, .compat = true}, *rbuf, cap);
 
 	return true;
 }
@@ -1254,7 +1257,7 @@ void arcan_tui_screencopy(
 		}
 	}
 
-	dst->dirty = true;
+	tui_screen_dirty_rows(dst, d_y1, d_y1 + (s_y2 - s_y1));
 }
 
 void arcan_tui_write_border(
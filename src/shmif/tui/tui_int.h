@@ -42,6 +42,9 @@ struct tui_context {
 	struct tui_cell* base;
 	struct tui_cell* front;
 	struct tui_cell* back;
+
+/* rows written to since the front was last synched to back, also in BASE */
+	uint8_t* dirty_rows;
 	struct tui_screen_attr defattr;
 	uint8_t fstamp;
 
@@ -181,6 +184,13 @@ int tui_screen_refresh(struct tui_context* tui);
  */
 void tui_screen_resized(struct tui_context* tui);
 
+/*
+ * mark rows [y1..y2] in the front buffer as written to, this needs to be
+ * called by everything that modifies front or the change can be missed in
+ * a delta update
+ */
+void tui_screen_dirty_rows(struct tui_context* tui, size_t y1, size_t y2);
+
 /*
  * this is normally called from within refresh, but can be used to obtain
  * a tpack representation of the screen front-buffer or back buffer.
@@ -193,11 +203,15 @@ void tui_screen_resized(struct tui_context* tui);
  *
  * if [back] is set, the contents of the back buffer will be used
  *                   rather than the front buffer
+ *
+ * if [compat] is set, the fixed size v1 cell format will be used even
+ *                     if the more compact v2 (RPACK_V2) would fit
  */
 struct tpack_gen_opts {
 	bool full;
 	bool synch;
 	bool back;
+	bool compat;
 };
 
 size_t tui_screen_tpack_sz(struct tui_context*);
@@ -25,6 +25,7 @@ static void progress_report(float progress);
  */
 int image_size_limit_mb = 64;
 bool disable_syscall_flt = false;
+int imgload_workers = 0;
 
 /*
  * all the context needed for one window, could theoretically be used for
@@ -49,8 +50,9 @@ struct draw_state {
 	int blit_ind;
 	float dpi;
 
-/* loading/ resource management state */
-	int wnd_lim, wnd_fwd, wnd_pending, wnd_act;
+/* loading/ resource management state, the window covers wnd_back items
+ * behind and wnd_fwd items ahead of the playlist position */
+	int wnd_lim, wnd_fwd, wnd_back, wnd_pending, wnd_act;
 	int wnd_prev, wnd_next;
 	int timeout;
 	bool stdin_pending, loaded, animated, vector;
@@ -84,7 +86,7 @@ void debug_message(const char* msg, ...)
 }
 
 static void blit(struct arcan_shmif_cont* dst,
-	const struct img_data* const src, const struct draw_state* const state)
+	const struct img_state* const src, const struct draw_state* const state)
 {
 /* draw pad color if the active image is incorrect */
 	if (!src || !src->ready){
@@ -157,6 +159,7 @@ static void blit(struct arcan_shmif_cont* dst,
 	int pad_w = dst->w - dw;
 	int pad_h = dst->h - dh;
 	int src_stride = src->w * 4;
+	const uint8_t* pixels = (const uint8_t*) src->out->buf;
 
 /* early out, no transform */
 	if (dw == dst->w && dh == dst->h &&
@@ -164,7 +167,7 @@ static void blit(struct arcan_shmif_cont* dst,
 		debug_message("full-blit[%d*%d]\n", (int)dst->w, (int)dst->h);
 		for (size_t row = 0; row < dst->h; row++)
 			memcpy(&dst->vidp[row*dst->pitch],
-				&src->buf[row*src_stride], src_stride);
+				&pixels[row*src_stride], src_stride);
 		goto done;
 	}
 
@@ -176,7 +179,7 @@ static void blit(struct arcan_shmif_cont* dst,
 		(int)src->w, (int)src->x, (int)src->h, (int)src->y,
 		(int)dw, (int)dh, pad_w, pad_h);
 	stbir_resize_uint8(
-		&src->buf[src->y * src_stride + src->x],
+		&pixels[src->y * src_stride + src->x],
 		src->w - src->x, src->h - src->y,
 		src_stride,
 		(uint8_t*) &dst->vidp[pad_pre_y * dst->pitch + pad_pre_x],
@@ -290,14 +293,14 @@ static bool poll_pl(struct draw_state* ds, int step)
 	bool update = false;
 	for (size_t i = 0; i < ds->pl_size && ds->wnd_pending; i++){
 		struct img_state* is = &ds->playlist[i];
-		if (is->proc)
+		if (is->pending)
 			update |= update_item(ds, is, step);
 	}
 
 /* special treatment for the currently selected index, have a retry timer
  * on failure, update ident with current load status */
 	struct img_state* cur = &ds->playlist[ds->pl_ind];
-	if (!ds->loaded && (cur->broken || (cur->out && cur->out->ready))){
+	if (!ds->loaded && (cur->broken || cur->ready)){
 		set_ident(ds->con, (char*) cur->msg, cur->fname);
 		ds->loaded = update = true;
 	}
@@ -310,11 +313,12 @@ static bool poll_pl(struct draw_state* ds, int step)
 	return update;
 }
 
-/* used to spawn a new worker process */
+/* used to queue an item with the decoder pool */
 static bool try_dispatch(struct draw_state* ds, int ind, int prio_d)
 {
-/* already loaded and acknowledged? */
-	if (ds->playlist[ind].out && ds->playlist[ind].life >= 0)
+/* already loaded/queued and acknowledged? */
+	if ((ds->playlist[ind].out || ds->playlist[ind].pending) &&
+		ds->playlist[ind].life >= 0)
 		return false;
 
 /* or stdin- slot one is already being loaded from standard input */
@@ -342,8 +346,9 @@ static bool try_dispatch(struct draw_state* ds, int ind, int prio_d)
 
 static void reset_slot(struct draw_state* ds, int ind)
 {
-	if (ind >= 0 && ind < ds->pl_size && ds->playlist[ind].out){
-		if (ds->playlist[ind].proc)
+	if (ind >= 0 && ind < ds->pl_size &&
+		(ds->playlist[ind].out || ds->playlist[ind].pending)){
+		if (ds->playlist[ind].pending)
 			ds->wnd_pending--;
 		else if (!ds->playlist[ind].broken)
 			ds->wnd_act--;
@@ -352,57 +357,33 @@ static void reset_slot(struct draw_state* ds, int ind)
 	}
 }
 
-static void clean_queue(struct draw_state* ds)
+/* playlist index at [ofs] steps from the current position, stepping back
+ * always wraps (as with PREV) while stepping forward only does if looping */
+static int window_pos(struct draw_state* ds, int ofs)
 {
-/* scan horizon to determine the number of entries to drop, assumptions from
- * caller is that we're in a state where entries actually need to be dropped */
-	size_t fwd = ds->pl_ind;
-	size_t ntr = ds->wnd_fwd;
-
-/* A special case to consider: when we step backwards in playlist and exceeds
- * the window, that'll cause the window to grow outside bounds.  This is
- * accepted (for now) on the motivation that the forward direction is more
- * important and is the expected use-case. To change this, simply take
- * step- direction into account. */
-	while (ntr){
-		if (!ds->playlist[fwd].out)
-			if (!ds->playlist[fwd].broken)
-				break;
-		ntr--;
-		fwd = fwd + 1;
-		if (fwd == ds->pl_size){
-			if (ds->loop)
-				fwd = 0;
-			else {
-				ntr = 0;
-			}
-		}
+	int pos = ds->pl_ind + ofs;
+	if (pos >= ds->pl_size){
+		if (!ds->loop)
+			return -1;
+		pos %= ds->pl_size;
 	}
-	debug_message("clean_queue(%zu)\n", ntr);
+	else if (pos < 0)
+		pos = ds->pl_size - (-pos % ds->pl_size);
 
-	if (!ntr)
-		return;
+	return pos % ds->pl_size;
+}
 
-/* find oldest item */
-	size_t back = ds->pl_ind > 0 ? ds->pl_ind - 1 : ds->pl_size - 1;
-	while (ds->playlist[back].out || ds->playlist[back].broken)
-		back = back > 0 ? back - 1 : ds->pl_size - 1;
-
-/* and start the purge */
-	while (ntr){
-		if (ds->playlist[back].out){
-			debug_message("unloading tail@%zu (%s), left: %zu\n",
-				back, ds->playlist[back].fname, ntr);
-			reset_slot(ds, back);
-			ntr--;
-		}
-		back = (back + 1) % ds->pl_size;
-	}
+static bool in_window(struct draw_state* ds, int ind)
+{
+	for (int i = -ds->wnd_back; i <= ds->wnd_fwd; i++)
+		if (window_pos(ds, i) == ind)
+			return true;
+	return false;
 }
 
 static bool set_playlist_pos(struct draw_state* ds, int new_i)
 {
-	size_t pos;
+	int pos;
 
 /* range-check, if we don't loop, return to start */
 	if (new_i < 0)
@@ -420,15 +401,7 @@ static bool set_playlist_pos(struct draw_state* ds, int new_i)
 		}
 	}
 
-/* if we land outside the previous window, full-reset everything */
-	if (ds->wnd_lim && abs(new_i - ds->pl_ind) > ds->wnd_lim){
-		for (size_t i = 0; i < ds->pl_size; i++)
-			reset_slot(ds, i);
-		ds->wnd_act = 0;
-		ds->wnd_pending = 0;
-	}
-
-/* first dispatch the currently requested slot at normal priority */
+/* first dispatch the currently requested slot at the front of the queue */
 	ds->pl_ind = new_i;
 	struct img_state* cur = &ds->playlist[ds->pl_ind];
 	if (!cur->out){
@@ -436,23 +409,28 @@ static bool set_playlist_pos(struct draw_state* ds, int new_i)
 		try_dispatch(ds, ds->pl_ind, 0);
 	}
 
-/* if we overshoot or are at capacity, start flushing out */
-	if (ds->wnd_lim && ds->pl_size > ds->wnd_lim &&
-		ds->wnd_pending + ds->wnd_act >= ds->wnd_lim){
-		clean_queue(ds);
+/* drop everything that has fallen outside the window, this also covers
+ * jumping far away from the previous position */
+	if (ds->wnd_lim && ds->pl_size > ds->wnd_lim){
+		for (int i = 0; i < ds->pl_size; i++)
+			if (!in_window(ds, i))
+				reset_slot(ds, i);
 	}
 
-/* and then fill up with lesser priority, note that there is a slight degrade
- * if we step from the currently loaded into one that is pending as the
- * priority for that one, though the effect should be minimal enough to not
- * bothering with renicing */
-	pos = (new_i + 1) % ds->pl_size;
+/* and then prefetch the rest of the window behind the current one in the
+ * queue, ahead first as that is the expected direction, then behind */
+	for (int i = 1; i <= ds->wnd_fwd; i++){
+		if (-1 != (pos = window_pos(ds, i))){
+			debug_message("attempt to queue (%s)\n", ds->playlist[pos].fname);
+			try_dispatch(ds, pos, 1);
+		}
+	}
 
-	while (pos != new_i &&
-		(ds->wnd_act + ds->wnd_pending < ds->wnd_lim || !ds->wnd_lim)){
-		debug_message("attempt to queue (%s)\n", ds->playlist[pos].fname);
-		try_dispatch(ds, pos, 1);
-		pos = (pos + 1) % ds->pl_size;
+	for (int i = 1; i <= ds->wnd_back; i++){
+		if (-1 != (pos = window_pos(ds, -i)) && pos != ds->pl_ind){
+			debug_message("attempt to queue (%s)\n", ds->playlist[pos].fname);
+			try_dispatch(ds, pos, 1);
+		}
 	}
 
 	debug_message("position set to (%d, act: %d/%d, pending: %d)\n",
@@ -650,6 +628,7 @@ static int show_use(const char* msg)
 "-m num \t--limit-mem   \tSet loader process memory limit to [num] MB\n"
 "-r num \t--readahead   \tSet the playlist window queue size\n"
 "-T sec \t--timeout     \tSet unresponsive worker kill- timeout\n"
+"-w num \t--workers     \tSet the number of decoder processes (default: cores, max 4)\n"
 "-H     \t--vr          \tSet stereoscopic mode, prefix files with l: or r:\n"
 #ifdef ENABLE_SECCOMP
 "-X    \t--no-sysflt   \tDisable seccomp- syscall filtering\n"
@@ -685,6 +664,7 @@ static const struct option longopts[] = {
 	{"timeout", required_argument, NULL, 'T'},
 	{"limit-mem", required_argument, NULL, 'm'},
 	{"readahead", required_argument, NULL, 'r'},
+	{"workers", required_argument, NULL, 'w'},
 	{"padcol", required_argument, NULL, 'p'},
 	{"no-sysflt", no_argument, NULL, 'X'},
 	{"server-size", no_argument, NULL, 'S'},
@@ -694,26 +674,17 @@ static const struct option longopts[] = {
 	{ NULL, no_argument, NULL, 0 }
 };
 
-/* wait but using the epipe and multiplex with current playlist item */
+/* wait but using the epipe and multiplex with the busy decoder workers */
 static void wait_for_event(struct draw_state* ds)
 {
 	short pollev = POLLIN | POLLERR | POLLNVAL | POLLHUP;
-	struct pollfd fds[2] = {
+	struct pollfd fds[IMGLOAD_MAX_WORKERS + 1] = {
 	{
 		.events = pollev,
 		.fd = ds->con->epipe
 	},
-	{
-		.events = pollev,
-		.fd = -1
-	},
 	};
-	size_t pollsz = 1;
-	int plfd = ds->playlist[ds->pl_ind].sigfd;
-	if (plfd > 0){
-		fds[1].fd = plfd;
-		pollsz++;
-	}
+	size_t pollsz = 1 + imgload_pollfds(&fds[1], IMGLOAD_MAX_WORKERS);
 
 /* don't care about the result, only used for sleep / wake */
 	poll(fds, pollsz, -1);
@@ -739,7 +710,7 @@ int main(int argc, char** argv)
 	int segid = SEGID_MEDIA;
 
 	while((ch = getopt_long(argc, argv,
-		"p:ihlt:bd:T:m:r:XSHd:a", longopts, NULL)) >= 0)
+		"p:ihlt:bd:T:m:r:w:XSHd:a", longopts, NULL)) >= 0)
 		switch(ch){
 		case 'h' : return show_use(""); break;
 		case 't' : ds.init_timer = strtoul(optarg, NULL, 10) * 5; break;
@@ -758,6 +729,7 @@ int main(int argc, char** argv)
 		case 'a' : ds.aspect_ratio = true; break;
 		case 'm' : image_size_limit_mb = strtoul(optarg, NULL, 10); break;
 		case 'r' : ds.wnd_lim = strtoul(optarg, NULL, 10); break;
+		case 'w' : imgload_workers = strtoul(optarg, NULL, 10); break;
 		case 'X' : disable_syscall_flt = true; break;
 		case 'N' : ds.handover_exec = true; break;
 		case 'H' :
@@ -835,9 +807,14 @@ int main(int argc, char** argv)
 		}
 	}
 
-/* sanity- clamp, always preload something*/
-	if (ds.wnd_lim)
-		ds.wnd_fwd = ds.wnd_lim > 2 ? ds.wnd_lim - 2 : 2;
+/* sanity- clamp, always preload something ahead and keep one behind if
+ * there is room for it, no limit means everything ahead */
+	if (ds.wnd_lim){
+		ds.wnd_fwd = ds.wnd_lim > 2 ? ds.wnd_lim - 2 : ds.wnd_lim - 1;
+		ds.wnd_back = ds.wnd_lim - 1 - ds.wnd_fwd;
+	}
+	else
+		ds.wnd_fwd = ds.pl_size - 1;
 
 	struct arcan_shmif_cont cont = arcan_shmif_open_ext(
 		SHMIF_ACQUIRE_FATALFAIL, NULL, (struct shmif_open_ext){
@@ -904,12 +881,12 @@ int main(int argc, char** argv)
  * other context, can do on a secondary thread */
 		struct img_state* cur = &ds.playlist[ds.pl_ind];
 
-		if (dirty && !cur->broken && cur->out && cur->out->ready){
+		if (dirty && !cur->broken && cur->ready){
 			set_ident(ds.con, "", cur->fname);
 
 			if (ds.pl_ind != ds.blit_ind){
 				ds.blit_ind = ds.pl_ind;
-				blit(&cont, (struct img_data*) cur->out, &ds);
+				blit(&cont, cur, &ds);
 			}
 		}
 	}
@@ -917,6 +894,7 @@ int main(int argc, char** argv)
 /* reset the entire playlist so leak detection is useful */
 	for (size_t i = 0; i < ds.pl_size; i++)
 		imgload_reset(&ds.playlist[i]);
+	imgload_shutdown();
 
 	arcan_shmif_drop(&cont);
 	if (ds.con_right)
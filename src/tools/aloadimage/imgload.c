@@ -2,7 +2,7 @@
  * Copyright 2017-2018, Björn Ståhl
  * License: 3-Clause BSD, see COPYING file in arcan source repository
  * Reference: http://arcan-fe.com, README.MD
- * Description: fork()+sandbox asynch- image loading wrapper around stbi
+ * Description: sandboxed worker-pool asynch- image loading wrapper around stbi
  * Bad assumption with a 4 bpp fixed output format (needs revision for
  * float,...) and needs a wider range of sandbox- format supports. If/ when
  * good enough, this can be re-worked into main arcan to replace the _img
@@ -16,6 +16,9 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <signal.h>
 #ifdef ENABLE_SECCOMP
 #include <sys/prctl.h>
@@ -39,95 +42,419 @@
 #include "stb_image.h"
 #include "imgload.h"
 
-bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
+/*
+ * Decoder processes are forked on demand and then kept around, each one owns
+ * one end of a socketpair over which it receives a job (the source descriptor
+ * and the descriptor of the shared buffer to decode into) and replies with a
+ * single status byte. The buffers are recycled between jobs so that a
+ * slideshow doesn't pay for fork, sandbox setup and faulting in a fresh
+ * mapping on every image.
+ */
+struct imgload_buffer {
+	int fd;
+	size_t sz;
+	struct img_data* addr;
+	struct imgload_buffer* next;
+	struct imgload_buffer* next_all;
+};
+
+struct imgload_worker {
+	pid_t pid;
+	int sock;
+	bool busy;
+
+/* job is cleared if the img_state is reset while the worker is busy */
+	struct img_state* job;
+	struct imgload_buffer* buffer;
+};
+
+struct job_msg {
+	float density;
+	size_t buf_lim;
+};
+
+static struct imgload_worker workers[IMGLOAD_MAX_WORKERS];
+static struct arcan_shmif_cont* pool_con;
+
+static struct img_state* queue_head;
+static struct img_state* queue_tail;
+
+/* every buffer, so that they can be unmapped in new workers, and the ones
+ * currently up for grabs */
+static struct imgload_buffer* all_buffers;
+static struct imgload_buffer* free_buffers;
+static size_t n_free;
+
+static size_t pool_size()
+{
+	if (imgload_workers > 0)
+		return imgload_workers > IMGLOAD_MAX_WORKERS ?
+			IMGLOAD_MAX_WORKERS : imgload_workers;
+
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n < 1 ? 1 : (n > 4 ? 4 : n);
+}
+
+static int buffer_handle()
+{
+#ifdef MFD_CLOEXEC
+	return memfd_create("aloadimage", MFD_CLOEXEC);
+#else
+	char name[32];
+	for (size_t i = 0; i < 10; i++){
+		snprintf(name, sizeof(name), "/aloadimage_%d_%d", (int)getpid(), rand());
+		int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (-1 != fd){
+			shm_unlink(name);
+			fcntl(fd, F_SETFD, FD_CLOEXEC);
+			return fd;
+		}
+	}
+	return -1;
+#endif
+}
+
+static void buffer_destroy(struct imgload_buffer* buf)
+{
+	struct imgload_buffer** cur = &all_buffers;
+	while (*cur && *cur != buf)
+		cur = &(*cur)->next_all;
+	if (*cur)
+		*cur = buf->next_all;
+
+	munmap(buf->addr, buf->sz);
+	close(buf->fd);
+	free(buf);
+}
+
+static struct imgload_buffer* buffer_get()
 {
-/* pre-alloc the upper limit for the return- image, we'll munmap when
- * finished to look less memory hungry */
-	if (tgt->out)
-		munmap((void*)tgt->out, tgt->buf_lim);
-	tgt->buf_lim = image_size_limit_mb * 1024 * 1024;
-	tgt->out = mmap(NULL, tgt->buf_lim,
-		PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
-	if (!tgt->out)
+	size_t sz = (size_t) image_size_limit_mb * 1024 * 1024;
+
+	while (free_buffers){
+		struct imgload_buffer* buf = free_buffers;
+		free_buffers = buf->next;
+		n_free--;
+
+		if (buf->sz == sz){
+			memset(buf->addr, '\0', sizeof(struct img_data));
+			return buf;
+		}
+		buffer_destroy(buf);
+	}
+
+/* the size is an upper limit, only the pages that get written to are backed */
+	struct imgload_buffer* buf = malloc(sizeof(struct imgload_buffer));
+	if (!buf)
+		return NULL;
+
+	*buf = (struct imgload_buffer){.sz = sz};
+	buf->fd = buffer_handle();
+	if (-1 == buf->fd){
+		free(buf);
+		return NULL;
+	}
+
+	if (-1 == ftruncate(buf->fd, sz)){
+		close(buf->fd);
+		free(buf);
+		return NULL;
+	}
+
+	buf->addr = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_SHARED, buf->fd, 0);
+	if (MAP_FAILED == buf->addr){
+		close(buf->fd);
+		free(buf);
+		return NULL;
+	}
+
+	buf->next_all = all_buffers;
+	all_buffers = buf;
+	return buf;
+}
+
+/* keep enough around to cover the workers in flight and a few steps */
+static void buffer_release(struct imgload_buffer* buf)
+{
+	if (n_free >= pool_size() + 2){
+		buffer_destroy(buf);
+		return;
+	}
+
+	buf->next = free_buffers;
+	free_buffers = buf;
+	n_free++;
+}
+
+static bool send_job(int sock, struct job_msg* job, int fds[2])
+{
+	struct iovec iov = {
+		.iov_base = job,
+		.iov_len = sizeof(struct job_msg)
+	};
+
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+		struct cmsghdr align;
+	} ctrl;
+	memset(&ctrl, '\0', sizeof(ctrl));
+
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = ctrl.buf,
+		.msg_controllen = sizeof(ctrl.buf)
+	};
+
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int) * 2);
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * 2);
+
+	ssize_t rv;
+	while (-1 == (rv = sendmsg(sock, &msg, MSG_NOSIGNAL)) && errno == EINTR){}
+	return rv == sizeof(struct job_msg);
+}
+
+static bool recv_job(int sock, struct job_msg* job, int fds[2])
+{
+	struct iovec iov = {
+		.iov_base = job,
+		.iov_len = sizeof(struct job_msg)
+	};
+
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 2)];
+		struct cmsghdr align;
+	} ctrl;
+
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = ctrl.buf,
+		.msg_controllen = sizeof(ctrl.buf)
+	};
+
+	ssize_t rv;
+	while (-1 == (rv = recvmsg(sock, &msg, 0)) && errno == EINTR){}
+	if (rv != sizeof(struct job_msg))
 		return false;
-	memset((void*)tgt->out, '\0', sizeof(struct img_data));
 
-/* aliveness descriptor to multiplex with */
-	int pair[2] = {-1, -1};
-	pipe(pair);
-	tgt->sigfd = pair[1];
+	struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+		cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int) * 2))
+		return false;
 
-/* spawn our worker process */
-	tgt->proc = fork();
-	if (-1 == tgt->proc){
-		munmap((void*)tgt->out, tgt->buf_lim);
-		tgt->out = NULL;
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * 2);
+	return true;
+}
+
+/* read the whole source into memory so the parsers don't need any syscalls
+ * beyond read, capped to the output size as anything larger is a bomb */
+static uint8_t* read_source(int fd, size_t lim, size_t* out_sz)
+{
+	size_t sz = 65536, ofs = 0;
+	uint8_t* buf = malloc(sz + 1);
+	if (!buf)
+		return NULL;
+
+	for(;;){
+		if (ofs == sz){
+			if (sz >= lim)
+				break;
+			uint8_t* nbuf = realloc(buf, sz * 2 + 1);
+			if (!nbuf)
+				break;
+			buf = nbuf;
+			sz *= 2;
+		}
+
+		ssize_t nr = read(fd, &buf[ofs], sz - ofs);
+		if (nr > 0)
+			ofs += nr;
+		else if (0 == nr || errno != EINTR)
+			break;
+	}
+
+/* nanosvg wants a string */
+	buf[ofs] = '\0';
+	*out_sz = ofs;
+	return buf;
+}
+
+static void set_msg(struct img_data* out, const char* msg)
+{
+	size_t i = 0;
+	for (; i < sizeof(out->msg) - 1 && msg && msg[i]; i++)
+		out->msg[i] = msg[i];
+	out->msg[i] = '\0';
+}
+
+/* Decent optimizations still not in place here:
+ * 1. custom 'upper limit' malloc so we can drop the mmap/brk/munmap syscalls
+ * 2. patch stbi- to use a separate allocator for our output buffer so that
+ *    the decode writes directly to out->buf, saving us a memcpy.
+ *
+ * the repacking is done to make sure that the channel-order matches the shmif
+ * format as we don't have controls for specifying that in stbi- right now
+ */
+static bool decode(int fd, struct img_data* out, size_t lim, float density)
+{
+	size_t in_sz;
+	lim -= sizeof(struct img_data);
+	uint8_t* in = read_source(fd, lim, &in_sz);
+	if (!in){
+		set_msg(out, "out of memory");
+		return false;
+	}
+
+	if (in_sz < 8){
+		free(in);
+		set_msg(out, "short read");
 		return false;
 	}
-/* parent */
-	else if (0 != tgt->proc)
+
+/* peek on the first characters and see if we have xml/svg */
+	if (strncmp((char*)in, "<?xml", 5) == 0 || strncmp((char*)in, "<svg", 4) == 0){
+		NSVGimage* image = nsvgParse((char*)in, "px", density);
+		free(in);
+		if (!image){
+			set_msg(out, "invalid svg");
+			return false;
+		}
+
+		size_t w = image->width;
+		size_t h = image->height;
+		if (w * h * sizeof(shmif_pixel) > lim){
+			nsvgDelete(image);
+			set_msg(out, "too large");
+			return false;
+		}
+
+		struct NSVGrasterizer* rast = nsvgCreateRasterizer();
+		if (rast){
+			nsvgRasterize(rast, image,
+				0, 0, 1, (unsigned char*)out->buf, w, h, w * sizeof(shmif_pixel));
+			nsvgDeleteRasterizer(rast);
+		}
+		nsvgDelete(image);
+
+		out->w = w;
+		out->h = h;
+		out->buf_sz = w * h * 4;
+		out->vector = true;
+		out->ready = true;
+		out->msg[0] = '\0';
 		return true;
+	}
 
-/* start with the most risk- prone, original fopen */
-	FILE* inf;
-	if (-1 != tgt->fd)
-		inf = fdopen(tgt->fd, "r");
-	else if (tgt->is_stdin)
-		inf = stdin;
-	else
-		inf = fopen(tgt->fname, "r");
+/* else just assume stbi- can handle it */
+	int dw, dh;
+	shmif_pixel* buf = (shmif_pixel*)
+		stbi_load_from_memory(in, in_sz, &dw, &dh, NULL, sizeof(shmif_pixel));
+	free(in);
+
+	if (!buf){
+		set_msg(out, stbi_failure_reason());
+		return false;
+	}
+
+	if ((size_t)dw * dh * sizeof(shmif_pixel) > lim){
+		stbi_image_free(buf);
+		set_msg(out, "too large");
+		return false;
+	}
+
+	shmif_pixel* src = buf;
+	shmif_pixel* dst = (shmif_pixel*) out->buf;
+	for (size_t i = (size_t)dw * dh; i > 0; i--){
+		uint8_t r = ((*src) & 0x000000ff);
+		uint8_t g = ((*src) & 0x0000ff00) >> 8;
+		uint8_t b = ((*src) & 0x00ff0000) >> 16;
+		uint8_t a = ((*src) & 0xff000000) >> 24;
+		src++;
+		*dst++ = SHMIF_RGBA(r, g, b, a);
+	}
+	stbi_image_free(buf);
+
+	out->w = dw;
+	out->h = dh;
+	out->buf_sz = dw * dh * 4;
+	out->msg[0] = '\0';
+	out->ready = true;
+	return true;
+}
+
+static void close_from(int fd)
+{
+#if defined(__OpenBSD__) || defined(__FreeBSD__)
+	closefrom(fd);
+#else
+#if defined(__linux__) && defined(SYS_close_range)
+	if (0 == syscall(SYS_close_range, fd, ~0U, 0))
+		return;
+#endif
+	struct rlimit rl;
+	int lim = 1024;
+	if (0 == getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur != RLIM_INFINITY)
+		lim = rl.rlim_cur;
+	for (; fd < lim; fd++)
+		close(fd);
+#endif
+}
+
+/* the socket ends up on descriptor 3 and everything above it is closed, the
+ * only way in after this are the descriptors passed with each job */
+static void worker_sandbox(struct arcan_shmif_cont* con, int sock)
+{
+	if (sock != 3){
+		dup2(sock, 3);
+		close(sock);
+	}
 
 /* close the parent pipes in the safest way possible, if that fails, accept UB
  * and kill the streams (other option would be replacing with memstreams) */
 	int nfd = open("/dev/null", O_RDWR);
 	if (-1 != nfd){
-		if (inf != stdin){
-			dup2(nfd, STDIN_FILENO);
-		}
+		dup2(nfd, STDIN_FILENO);
 		dup2(nfd, STDOUT_FILENO);
 		dup2(nfd, STDERR_FILENO);
-		close(nfd);
+		if (nfd > STDERR_FILENO)
+			close(nfd);
 	}
 	else{
-		if (inf != stdin)
-			fclose(stdin);
+		fclose(stdin);
 		fclose(stderr);
 		fclose(stdout);
 	}
 
-	if (p)
-		nice(p);
+/* Other playlist items, fonts and the shmif descriptors don't survive this.
+ * That leaves the memory pages of our parent, env, copy of stack etc. Hence
+ * why the sandbox should not have any write channel beyond the status reply
+ * (though cache- timing invalidation style side channel communication is
+ * also a possibility). Long lived workers do mean that a compromised one gets
+ * to see the images that come after it, and as it can keep a mapping of the
+ * buffers it decoded into, alter their pixels after the fact. The header is
+ * copied and checked when the job is handed back, so it can't change sizes
+ * that have already been accepted. */
+	close_from(4);
 
 /* drop shm-con so that it's not around anymore - owning the parser won't grant
  * us direct access to the shm- connection and with the syscalls eliminated, it
  * can't be re-opened */
-	if (con){
+	if (con && con->addr){
 		munmap(con->addr, con->shmsize);
-		close(con->epipe);
-		close(con->shmh);
 		memset(con, '\0', sizeof(struct arcan_shmif_cont));
 	}
 
-/* There is a possiblity of other descriptors being leaked here, e.g. fonts or
- * other playlist items that were retrieved from shmif as cloexec does not
- * apply to fork. The non-portable option would be to dup into 1 and then
- * closefrom(2).
- *
- * The 'correct' option would be to track and manually close.
- *
- * The more tedious approach would be to have a re-exec mode, re-exec ourselves,
- * mmap the buffer to decode into and go from there.
- *
- * Now, we accept the risk of the contents of other descriptors being
- * accessible from the sandbox, though the more serious configurations (seccmp)
- * should block out most means to do anything as long as a descriptor defined
- * playlist item doesn't come from a file.
- *
- * It is also possible to leak some information as a lot of the memory pages of
- * our parent, env, copy of stack etc. Hence why the sandbox should not have any
- * write channel (though cache- timing invalidation style side channel
- * communication is also a possibility).
- */
+/* nor the decoded images of other items */
+	while (all_buffers){
+		struct imgload_buffer* buf = all_buffers;
+		all_buffers = buf->next_all;
+		munmap(buf->addr, buf->sz);
+	}
+	free_buffers = NULL;
 
 /* someone might've needed to be careless and run as root. Now we have the file
  * so that shouldn't matter. If these call fail, they fail - it's added safety,
@@ -135,14 +462,15 @@ bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
 	if (-1 == setgid(65534)){}
 	if (-1 == setuid(65534)){}
 
-/* set some limits that will make things worse even if we don't have seccmp */
+/* set some limits that will make things worse even if we don't have seccmp,
+ * the descriptor limit leaves room for the two that come with each job */
 	setrlimit(RLIMIT_CORE, &(struct rlimit){});
 	setrlimit(RLIMIT_FSIZE, &(struct rlimit){});
-	setrlimit(RLIMIT_NOFILE, &(struct rlimit){});
+	setrlimit(RLIMIT_NOFILE, &(struct rlimit){.rlim_cur = 6, .rlim_max = 6});
 	setrlimit(RLIMIT_NPROC, &(struct rlimit){});
 
 #ifdef __OpenBSD__
-	if(-1 == pledge("stdio", "")){
+	if(-1 == pledge("stdio recvfd", "")){
 		_exit(EXIT_FAILURE);
 	}
 
@@ -154,12 +482,12 @@ bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
 		prctl(PR_SET_DUMPABLE, 0);
 		scmp_filter_ctx flt = seccomp_init(SCMP_ACT_KILL);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(mmap), 0);
+		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(mremap), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(brk), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(exit), 0);
-		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(fstat), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(read), 0);
+		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(recvmsg), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(munmap), 0);
-		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(lseek), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(exit_group), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(close), 0);
 		seccomp_rule_add(flt, SCMP_ACT_ALLOW, SCMP_SYS(write), 0);
@@ -167,183 +495,404 @@ bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
 		seccomp_load(flt);
 	}
 #endif
+}
 
-/* now we're in the dangerous part, stbi_load_from_file - though the source is
- * just a filestream, we need to return the decoded buffer somehow. STBI may
- * need intermediate allocations and we can't really tell, so unfortunately we
- * waste an extra memcpy.
- *
- * Decent optimizations needed here and not in place now:
- * 1. custom 'upper limit' malloc so we can drop the mmap/brk/munmap syscalls
- * 2. patch stbi- to use a separate allocator for our output buffer so
- *    that the decode writes directly to tgt->out->buf, saving us a
- *    memcpy.
- * 3. pre-mmaping file and using stbi-load-from-memory could drop the
- *    fstat/read/lseek syscalls as well.
- *
- * The custom allocator will likely also be needed for this to work in a
- * multithreaded setting.
- *
- * the repacking is done to make sure that the channel-order matches the shmif
- * format as we don't have controls for specifying that in stbi- right now
- */
+static void worker_loop(int sock)
+{
+	struct job_msg job;
+	int fds[2];
 
-/* peek on the first characters and see if we have xml/svg */
-	char hdr[8];
-	if (1 != fread(hdr, 8, 1, inf))
-		exit(EXIT_FAILURE);
-	if (strncmp(hdr, "<?xml", 5) == 0 || strncmp(hdr, "<svg", 4) == 0){
-		fseek(inf, 0, SEEK_SET);
-		NSVGimage* image = nsvgParseFromFile(inf, "px", tgt->density);
-		if (image){
-			size_t w = image->width;
-			size_t h = image->height;
-			struct NSVGrasterizer* rast = nsvgCreateRasterizer();
-			nsvgRasterize(rast, image,
-				0, 0, 1, (unsigned char*)tgt->out->buf, w, h, w * sizeof(shmif_pixel));
-			tgt->out->w = w;
-			tgt->out->h = h;
-			tgt->out->buf_sz = w * h * 4;
-			tgt->out->vector = true;
-			tgt->out->ready = true;
-			tgt->out->msg[0] = '\0';
-			exit(EXIT_SUCCESS);
+/* the parent closing its end is the signal to shut down */
+	while (recv_job(sock, &job, fds)){
+		uint8_t rc = 1;
+
+		struct img_data* out =
+			mmap(NULL, job.buf_lim, PROT_READ | PROT_WRITE, MAP_SHARED, fds[1], 0);
+		close(fds[1]);
+
+		if (MAP_FAILED != out){
+			if (decode(fds[0], out, job.buf_lim, job.density))
+				rc = 0;
+			munmap(out, job.buf_lim);
 		}
+		close(fds[0]);
+
+		if (1 != write(sock, &rc, 1))
+			break;
 	}
 
-/* else just assume stbi- can handle it */
-	fseek(inf, 0, SEEK_SET);
+	_exit(EXIT_SUCCESS);
+}
 
-	int dw, dh;
-	shmif_pixel* buf = (shmif_pixel*)
-		stbi_load_from_file(inf, &dw, &dh, NULL, sizeof(shmif_pixel));
-	shmif_pixel* out = (shmif_pixel*) tgt->out->buf;
-	tgt->out->w = dw;
-	tgt->out->h = dh;
-	tgt->out->buf_sz = dw * dh * 4;
-	tgt->out->msg[0] = '\0';
-
-	if (buf){
-		for (size_t i = dw * dh; i > 0; i--){
-			uint8_t r = ((*buf) & 0x000000ff);
-			uint8_t g = ((*buf) & 0x0000ff00) >> 8;
-			uint8_t b = ((*buf) & 0x00ff0000) >> 16;
-			uint8_t a = ((*buf) & 0xff000000) >> 24;
-			buf++;
-			*out++ = SHMIF_RGBA(r, g, b, a);
-		}
-		tgt->out->ready = true;
-		exit(EXIT_SUCCESS);
+static bool worker_spawn(struct imgload_worker* w)
+{
+	int pair[2];
+	if (-1 == socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair))
+		return false;
+
+	pid_t pid = fork();
+	if (-1 == pid){
+		close(pair[0]);
+		close(pair[1]);
+		return false;
 	}
-	else{
-		size_t i = 0;
-		for (; i < sizeof(tgt->out->msg) && stbi__g_failure_reason[i]; i++)
-			tgt->out->msg[i] = stbi__g_failure_reason[i];
+
+	if (0 == pid){
+		close(pair[0]);
+		worker_sandbox(pool_con, pair[1]);
+		worker_loop(3);
+	}
+
+	close(pair[1]);
+	fcntl(pair[0], F_SETFD, FD_CLOEXEC);
+	*w = (struct imgload_worker){
+		.pid = pid,
+		.sock = pair[0]
+	};
+
+	debug_message("decoder worker (%d) spawned\n", (int)pid);
+	return true;
+}
+
+static void worker_kill(struct imgload_worker* w, bool force)
+{
+	if (!w->pid)
+		return;
+
+	if (force)
+		kill(w->pid, SIGKILL);
+	close(w->sock);
+	while (-1 == waitpid(w->pid, NULL, 0) && errno == EINTR){}
+
+	if (w->buffer)
+		buffer_release(w->buffer);
+
+	*w = (struct imgload_worker){0};
+}
+
+static void queue_add(struct img_state* tgt, bool front)
+{
+	tgt->queue_next = NULL;
+	if (!queue_head){
+		queue_head = queue_tail = tgt;
+	}
+	else if (front){
+		tgt->queue_next = queue_head;
+		queue_head = tgt;
+	}
+	else {
+		queue_tail->queue_next = tgt;
+		queue_tail = tgt;
+	}
+}
+
+static void queue_remove(struct img_state* tgt)
+{
+	struct img_state* prev = NULL;
+	for (struct img_state* cur = queue_head; cur; prev = cur, cur = cur->queue_next){
+		if (cur != tgt)
+			continue;
+
+		if (prev)
+			prev->queue_next = cur->queue_next;
+		else
+			queue_head = cur->queue_next;
+
+		if (queue_tail == cur)
+			queue_tail = prev;
+
+		cur->queue_next = NULL;
+		return;
 	}
-	exit(EXIT_FAILURE);
 }
 
 static void mark_finished(struct img_state* tgt, bool broken)
 {
 	tgt->broken = broken;
-	if (-1 != tgt->sigfd){
-		close(tgt->sigfd);
-		tgt->sigfd = -1;
+	tgt->pending = false;
+	tgt->worker = NULL;
+}
+
+/* copy+filter the error message from the (untrusted) buffer */
+static void copy_msg(struct img_state* tgt, volatile struct img_data* src)
+{
+	size_t i = 0, j = 0;
+	uint8_t ch;
+	while (j < sizeof(tgt->msg)-1 && i < sizeof(src->msg) && (ch = src->msg[i])){
+		if (isprint(ch))
+			tgt->msg[j++] = ch;
+		i++;
 	}
+	tgt->msg[j] = '\0';
 }
 
-bool imgload_poll(struct img_state* tgt)
+static void worker_done(struct imgload_worker* w, bool ok)
 {
-	if (!tgt->proc || !tgt->out)
-		return true;
+	struct img_state* tgt = w->job;
+	struct imgload_buffer* buf = w->buffer;
+	w->job = NULL;
+	w->buffer = NULL;
+	w->busy = false;
 
-	int sc = 0;
-	int rc;
-	while ((rc = waitpid(tgt->proc, &sc, WNOHANG)) == -1 && errno == EINTR){}
-/* failed */
-	if (rc == -1){
-		snprintf((char*)tgt->msg, sizeof(tgt->msg), "(%s)", strerror(errno));
+/* reset while we were busy, just recycle */
+	if (!tgt){
+		buffer_release(buf);
+		return;
+	}
+
+	if (!ok){
+		copy_msg(tgt, buf->addr);
+		debug_message("%s failed, (reason: %s)\n", tgt->fname, tgt->msg);
+		buffer_release(buf);
 		mark_finished(tgt, true);
-		return true;
+		return;
 	}
 
-/* nothing new */
-	if (rc == 0)
-		return false;
+/* read the header once, the worker can keep changing it after this */
+	volatile struct img_data* hdr = buf->addr;
+	bool ready = hdr->ready;
+	int out_w = hdr->w;
+	int out_h = hdr->h;
+	size_t out_sz = hdr->buf_sz;
 
 /* client tries to exceed buffer, signs of a troublemaker */
-	size_t out_sz = tgt->out->buf_sz;
-	if (out_sz > tgt->buf_lim){
-		munmap((void*)tgt->out, tgt->buf_lim);
-		tgt->proc = 0;
-		tgt->out = NULL;
+	if (out_sz > buf->sz - sizeof(struct img_data)){
 		snprintf((char*)tgt->msg, sizeof(tgt->msg),
 			"(%zuMiB>%zuMiB)",
 			(size_t)((out_sz+1) / (1024 * 1024)),
-			(size_t)((tgt->buf_lim+1) / (1024 * 1024))
+			(size_t)((buf->sz+1) / (1024 * 1024))
 		);
+		buffer_release(buf);
 		mark_finished(tgt, true);
-		return true;
+		return;
 	}
 
-/* copy+filter error message on failure */
-	if (sc != EXIT_SUCCESS){
-		size_t i = 0, j = 0;
-		uint8_t ch;
-		while (j < sizeof(tgt->msg)-1 &&
-			i < sizeof(tgt->out->msg) && (ch = tgt->out->msg[i])){
-			if (isprint(ch))
-				tgt->msg[j++] = ch;
-			i++;
-		}
-		debug_message("%s failed, (reason: %s)\n", tgt->fname, tgt->msg);
-		munmap((void*)tgt->out, tgt->buf_lim);
-		tgt->out = NULL;
-		tgt->buf_lim = 0;
+	if (!ready || out_w <= 0 || out_h <= 0 ||
+		(size_t) out_w > out_sz / 4 / (size_t) out_h){
+		snprintf((char*)tgt->msg, sizeof(tgt->msg), "(bad header)");
+		buffer_release(buf);
 		mark_finished(tgt, true);
-		return true;
+		return;
 	}
-	tgt->proc = 0;
-	tgt->out->x = tgt->out->y = 0;
 
-/* unmap extra data, align with page size */
-	uintptr_t system_page_size = sysconf(_SC_PAGE_SIZE);
-	uintptr_t base = (uintptr_t) tgt->out;
-	uintptr_t end = base + sizeof(struct img_data) + out_sz;
-	if (end % system_page_size != 0)
-		end += system_page_size - end % system_page_size;
+	tgt->buffer = buf;
+	tgt->buf_lim = buf->sz;
+	tgt->out = buf->addr;
+	tgt->ready = true;
+	tgt->w = out_w;
+	tgt->h = out_h;
+	tgt->x = tgt->y = 0;
+	tgt->buf_sz = out_sz;
 
-/* if fork/exec/... are not closed off, there's the sigbus possiblity left,
- * though DOS isn't much of a threat model here, our real worry is code-exec */
-	size_t ntr = tgt->buf_lim - (end - base);
-/* Odd case where we we couldn't poke hole in the mapping, simply skip the
- * truncate step. This affects accounting in playlists slightly */
-	if (0 == munmap((void*) end, ntr))
-		tgt->buf_lim -= ntr;
-
-	debug_message("%s loaded (total: %zu, max: %zu, remove: %zu\n",
-		tgt->fname, out_sz, tgt->buf_lim, ntr);
+	debug_message("%s loaded (total: %zu, max: %zu)\n",
+		tgt->fname, out_sz, tgt->buf_lim);
 
 	mark_finished(tgt, false);
+}
+
+/* the worker went away with a job, treat as a failed decode */
+static void worker_died(struct imgload_worker* w)
+{
+	struct img_state* tgt = w->job;
+	debug_message("decoder worker (%d) died\n", (int)w->pid);
+
+	if (tgt){
+		copy_msg(tgt, w->buffer->addr);
+		if (!tgt->msg[0])
+			snprintf((char*)tgt->msg, sizeof(tgt->msg), "(decoder died)");
+		mark_finished(tgt, true);
+	}
+
+	w->job = NULL;
+	worker_kill(w, true);
+}
+
+static struct imgload_worker* worker_idle()
+{
+	size_t lim = pool_size();
+	for (size_t i = 0; i < lim; i++)
+		if (workers[i].pid && !workers[i].busy)
+			return &workers[i];
+
+	for (size_t i = 0; i < lim; i++)
+		if (!workers[i].pid && worker_spawn(&workers[i]))
+			return &workers[i];
+
+	return NULL;
+}
+
+/* the job is either handed to [w] or marked as broken */
+static void dispatch(struct imgload_worker* w, struct img_state* tgt)
+{
+	int fd = -1;
+	bool own = false;
+
+	if (-1 != tgt->fd){
+		fd = tgt->fd;
+		lseek(fd, 0, SEEK_SET);
+	}
+	else if (tgt->is_stdin)
+		fd = STDIN_FILENO;
+	else {
+		fd = open(tgt->fname, O_RDONLY | O_CLOEXEC);
+		own = true;
+	}
+
+	if (-1 == fd){
+		snprintf((char*)tgt->msg, sizeof(tgt->msg), "(%s)", strerror(errno));
+		mark_finished(tgt, true);
+		return;
+	}
+
+	struct imgload_buffer* buf = buffer_get();
+	if (!buf){
+		if (own)
+			close(fd);
+		snprintf((char*)tgt->msg, sizeof(tgt->msg), "(out of memory)");
+		mark_finished(tgt, true);
+		return;
+	}
+
+	struct job_msg job = {
+		.density = tgt->density,
+		.buf_lim = buf->sz
+	};
+
+	bool ok = send_job(w->sock, &job, (int[]){fd, buf->fd});
+	int err = errno;
+	if (own)
+		close(fd);
+
+/* don't retry, a bad source descriptor would fail the same way again */
+	if (!ok){
+		snprintf((char*)tgt->msg, sizeof(tgt->msg), "(%s)", strerror(err));
+		buffer_release(buf);
+		worker_kill(w, true);
+		mark_finished(tgt, true);
+		return;
+	}
+
+	w->busy = true;
+	w->job = tgt;
+	w->buffer = buf;
+	tgt->worker = w;
+}
+
+static void pump()
+{
+	size_t lim = pool_size();
+	for (size_t i = 0; i < IMGLOAD_MAX_WORKERS; i++){
+		struct imgload_worker* w = &workers[i];
+		if (!w->pid || !w->busy)
+			continue;
+
+		uint8_t rc;
+		ssize_t nr = recv(w->sock, &rc, 1, MSG_DONTWAIT);
+		if (1 == nr)
+			worker_done(w, rc == 0);
+		else if (0 == nr || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			worker_died(w);
+	}
+
+	while (queue_head){
+		struct imgload_worker* w = worker_idle();
+
+/* nothing idle and nothing busy either means we can't fork */
+		if (!w){
+			bool alive = false;
+			for (size_t i = 0; i < lim && !alive; i++)
+				alive = workers[i].pid != 0;
+			if (alive)
+				break;
+
+			struct img_state* tgt = queue_head;
+			queue_remove(tgt);
+			snprintf((char*)tgt->msg, sizeof(tgt->msg), "(no decoder)");
+			mark_finished(tgt, true);
+			continue;
+		}
+
+		struct img_state* tgt = queue_head;
+		queue_remove(tgt);
+		dispatch(w, tgt);
+	}
+}
+
+bool imgload_spawn(struct arcan_shmif_cont* con, struct img_state* tgt, int p)
+{
+	if (tgt->pending || tgt->buffer)
+		imgload_reset(tgt);
+
+	pool_con = con;
+	tgt->pending = true;
+	tgt->broken = false;
+	tgt->msg[0] = '\0';
+	queue_add(tgt, p == 0);
+
+	pump();
 	return true;
 }
+
+bool imgload_poll(struct img_state* tgt)
+{
+	if (!tgt->pending)
+		return true;
+
+	pump();
+	return !tgt->pending;
+}
+
+size_t imgload_pollfds(struct pollfd* fds, size_t lim)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < IMGLOAD_MAX_WORKERS && n < lim; i++)
+		if (workers[i].pid && workers[i].busy)
+			fds[n++] = (struct pollfd){
+				.fd = workers[i].sock,
+				.events = POLLIN | POLLERR | POLLHUP
+			};
+	return n;
+}
+
 /*
  * reset the contents of imgload so that it can be used for a new imgload_spawn
- * only run after imgload_poll has returned true once.
  */
 void imgload_reset(struct img_state* tgt)
 {
-	if (tgt->proc){
-		debug_message("reset on living source, killing: %s\n", tgt->fname);
-		kill(tgt->proc, SIGKILL);
-		while (-1 == waitpid(tgt->proc, NULL, 0) && errno == EINTR){}
-		tgt->proc = 0;
+	if (tgt->pending){
+		if (tgt->worker){
+			debug_message("reset on living source, killing: %s\n", tgt->fname);
+			tgt->worker->job = NULL;
+			worker_kill(tgt->worker, true);
+		}
+		else
+			queue_remove(tgt);
+		tgt->pending = false;
+		tgt->worker = NULL;
 	}
 
 	tgt->broken = false;
-	if (tgt->out){
-		munmap((void*)tgt->out, tgt->buf_lim);
+	if (tgt->buffer){
+		buffer_release(tgt->buffer);
+		tgt->buffer = NULL;
 		tgt->out = NULL;
 		tgt->buf_lim = 0;
 	}
+
+	tgt->ready = false;
+	tgt->w = tgt->h = tgt->x = tgt->y = 0;
+	tgt->buf_sz = 0;
+}
+
+void imgload_shutdown()
+{
+	for (size_t i = 0; i < IMGLOAD_MAX_WORKERS; i++)
+		worker_kill(&workers[i], false);
+
+	while (free_buffers){
+		struct imgload_buffer* buf = free_buffers;
+		free_buffers = buf->next;
+		buffer_destroy(buf);
+	}
+	n_free = 0;
 }
@@ -19,12 +19,23 @@ struct img_data {
 	uint8_t _Alignas(64) buf[];
 };
 
-/* container for fork-load img */
+/*
+ * number of long-lived decoder processes to keep around, 0 picks one from
+ * the number of online cores
+ */
+extern int imgload_workers;
+
+/* upper bound for imgload_workers */
+#define IMGLOAD_MAX_WORKERS 16
+
+struct imgload_buffer;
+struct imgload_worker;
+
+/* container for pool-load img */
 struct img_state {
 /* SETUP_SET */
 	const char* fname;
 	int fd;
-	int sigfd;
 	bool is_stdin;
 	int life;
 	float density;
@@ -32,35 +43,61 @@ struct img_state {
 
 /* SETUP_GET */
 	bool broken;
+	bool pending;
 	size_t buf_lim;
-	pid_t proc;
 	uint8_t msg[48];
 	volatile struct img_data* out;
+
+/* copied out of [out] and validated when the decode finishes, the worker can
+ * still write to the shared buffer so only the pixels are read from there */
+	bool ready;
+	int w, h, x, y;
+	size_t buf_sz;
+
+/* private to imgload */
+	struct imgload_buffer* buffer;
+	struct imgload_worker* worker;
+	struct img_state* queue_next;
 };
 
 void debug_message(const char*, ...);
 
 /*
- * fork() into an img- loader process that builds/populates img_state.
+ * Queue [tgt] for decoding in one of the sandboxed decoder processes. These
+ * are forked on demand (up to imgload_workers) and then kept around between
+ * jobs, as are the shared buffers they decode into.
+ *
  * only keep one [is_stdin=true] pending at a time (else they fight eachother)
  *
- * the [prio_d] can be used to set the priority of the new process
+ * [prio_d] = 0 puts the job at the front of the queue, anything else at the
+ * back.
  *
- * returns false if we couldn't spawn a new process
- * (out of memory, file descriptors or pids)
+ * returns false if the job couldn't be queued.
  */
 bool imgload_spawn(struct arcan_shmif_cont*, struct img_state*, int prio_d);
 
 /*
- * Check if [tgt] has finished working, set timeout to wait/kill if the task
- * is not finished within [timeout] miliseconds.
+ * Collect finished jobs, hand queued ones to idle workers and check if [tgt]
+ * has finished working.
  *
- * returns [true] if [tgt] has terminated and was collected, [false] otherwise.
+ * returns [true] if [tgt] is no longer pending, [false] otherwise.
  */
 bool imgload_poll(struct img_state* tgt);
 
 /*
  * Drop the resources bound to an imgload_spawn call, if the decode process
- * hasn't finished, it will be killed off.
+ * hasn't finished, it will be killed off and replaced on demand.
  */
 void imgload_reset(struct img_state* tgt);
+
+/*
+ * Fill out [fds] with the descriptors of busy decoder processes, these
+ * become readable when a job finishes. Returns the number of entries used.
+ */
+size_t imgload_pollfds(struct pollfd* fds, size_t lim);
+
+/*
+ * Terminate the decoder processes and release recycled buffers, any
+ * img_state should have been reset before this.
+ */
+void imgload_shutdown();
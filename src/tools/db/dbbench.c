@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024, Björn Ståhl
+ * License: 3-Clause BSD, see COPYING file in arcan source repository.
+ * Reference: http://arcan-fe.com
+ * Description: Micro-benchmark for the arcan_db key/value paths, measures
+ * the time the caller is blocked for the common script patterns (store_key,
+ * get_key and target lookups) and how long the queued writes take to land.
+ *
+ * Usage: arcan_db_bench [dbfile, default ./dbbench.sqlite] [n, default 10000]
+ */
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "arcan_mem.h"
+#include "arcan_db.h"
+
+void arcan_warning(const char*, ...);
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char* label, size_t n, double elapsed)
+{
+	printf("%-28s %8zu ops %10.3f ms %10.2f us/op\n",
+		label, n, elapsed * 1000.0, n ? elapsed * 1e6 / n : 0);
+}
+
+int main(int argc, char** argv)
+{
+	const char* fname = argc > 1 ? argv[1] : "dbbench.sqlite";
+	size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 10000;
+	if (!n)
+		n = 10000;
+
+	unlink(fname);
+	struct arcan_dbh* dbh = arcan_db_open(fname, "arcan");
+	if (!dbh){
+		fprintf(stderr, "couldn't open/create %s\n", fname);
+		return EXIT_FAILURE;
+	}
+
+	char key[32], val[32];
+
+/* one store_key(k, v) per call, the common settings-persist pattern */
+	double start = now();
+	for (size_t i = 0; i < n; i++){
+		snprintf(key, sizeof(key), "key_%zu", i % 512);
+		snprintf(val, sizeof(val), "%zu", i);
+		arcan_db_appl_kv(dbh, "arcan", key, val);
+	}
+	report("appl_kv (caller)", n, now() - start);
+
+	start = now();
+	arcan_db_flush(dbh);
+	report("appl_kv (flush)", n, now() - start);
+
+/* store_key with a table, n/16 transactions of 16 keys */
+	start = now();
+	for (size_t i = 0; i < n / 16; i++){
+		arcan_db_begin_transaction(dbh, DVT_APPL,
+			(union arcan_dbtrans_id){.applname = "arcan"});
+		for (size_t j = 0; j < 16; j++){
+			snprintf(key, sizeof(key), "tkey_%zu", j);
+			snprintf(val, sizeof(val), "%zu", i);
+			arcan_db_add_kvpair(dbh, key, val);
+		}
+		arcan_db_end_transaction(dbh);
+	}
+	report("transaction x16 (caller)", n / 16, now() - start);
+
+	start = now();
+	arcan_db_flush(dbh);
+	report("transaction x16 (flush)", n / 16, now() - start);
+
+/* get_key on recently written keys */
+	start = now();
+	for (size_t i = 0; i < n; i++){
+		snprintf(key, sizeof(key), "key_%zu", i % 512);
+		free(arcan_db_appl_val(dbh, "arcan", key));
+	}
+	report("appl_val (hot)", n, now() - start);
+
+/* and on keys that were never written */
+	start = now();
+	for (size_t i = 0; i < n; i++){
+		snprintf(key, sizeof(key), "missing_%zu", i % 512);
+		free(arcan_db_appl_val(dbh, "arcan", key));
+	}
+	report("appl_val (missing)", n, now() - start);
+
+/* lookups that go to the database every time */
+	const char* args[] = {"a", "b"};
+	arcan_db_addtarget(dbh, "bench", "bench", "/bin/true", args, 2, BFRM_BIN);
+	start = now();
+	for (size_t i = 0; i < n; i++)
+		arcan_db_targetid(dbh, "bench", NULL);
+	report("targetid", n, now() - start);
+
+	start = now();
+	arcan_db_close(&dbh);
+	report("close", 1, now() - start);
+
+/* reopen so that reads have to go to the file */
+	dbh = arcan_db_open(fname, "arcan");
+	if (!dbh){
+		fprintf(stderr, "couldn't reopen %s\n", fname);
+		return EXIT_FAILURE;
+	}
+
+	start = now();
+	for (size_t i = 0; i < n; i++){
+		snprintf(key, sizeof(key), "key_%zu", i % 512);
+		free(arcan_db_appl_val(dbh, "arcan", key));
+	}
+	report("appl_val (reopened)", n, now() - start);
+
+	snprintf(key, sizeof(key), "key_%zu", (n - 1) % 512);
+	char* last = arcan_db_appl_val(dbh, "arcan", key);
+	snprintf(val, sizeof(val), "%zu", n - 1);
+	bool ok = last && strcmp(last, val) == 0;
+	free(last);
+
+	arcan_db_close(&dbh);
+	unlink(fname);
+
+	if (!ok){
+		fprintf(stderr, "last written value didn't persist\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -820,6 +820,7 @@ int main(int argc, char* argv[])
 		}
 		free(inbuf);
 
+		arcan_db_close(&dbhandle);
 		return EXIT_SUCCESS;
 	}
 
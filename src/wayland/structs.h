@@ -221,6 +221,14 @@ struct comp_surf {
  */
 	bool shm_gl_fail;
 
+/*
+ * video buffer of the surface connection that the last commit filled with a
+ * wl_shm copy, NULL if it was anything else (handle passing, drm, dma-buf or
+ * a clear). Only then does the buffer still hold the previous frame so that
+ * a new commit can copy just the damaged region.
+ */
+	shmif_pixel* shm_vidp;
+
 /*
  * Just keep this fugly thing here as it is on par with wl_list masturbation,
  * the protocol is just riddled with unbounded allocations because all the bad
@@ -92,6 +92,7 @@ static void surf_attach(struct wl_client* cl,
 /* follow up on the explanation above, push a fully translucent buffer */
 	else if (surf->is_subsurface && changed){
 		surf->acon.hints |= SHMIF_RHINT_IGNORE_ALPHA;
+		surf->shm_vidp = NULL;
 		for (size_t y = 0; y < surf->acon.h; y++)
 			memset(&surf->acon.vidb[y * surf->acon.stride], '\0', surf->acon.stride);
 		arcan_shmif_dirty(&surf->acon, 0, 0, surf->acon.w, surf->acon.h, 0);
@@ -448,10 +449,19 @@ static bool push_shm(struct wl_client* cl,
 	void* data = wl_shm_buffer_get_data(shm_buf);
 	int stride = wl_shm_buffer_get_stride(shm_buf);
 
+/* Damage is accumulated into the dirty region of the surface connection, and
+ * with the single video buffer the previous contents are still there if the
+ * last commit was a shm copy into it, so only the damaged part needs to be
+ * copied. On resize, a commit without damage, after any other kind of commit
+ * or for a surface that draws into another connection (cursor) it's all of it */
+	bool full = acon != &surf->acon || surf->shm_vidp != acon->vidp ||
+		acon->dirty.x1 >= acon->dirty.x2 || acon->dirty.y1 >= acon->dirty.y2;
+
 	if (acon->w != w || acon->h != h){
 		trace(TRACE_SURF,
 			"surf_commit(shm, resize to: %zu, %zu)", (size_t)w, (size_t)h);
 		arcan_shmif_resize(acon, w, h);
+		full = true;
 	}
 
 /* resize failed, this will only happen when growing, thus we can crop */
@@ -464,8 +474,11 @@ static bool push_shm(struct wl_client* cl,
  * as the hint is checked on each frame */
 	synch_acon_alpha(acon, fmt_has_alpha(fmt, surf));
 	wl_shm_buffer_begin_access(shm_buf);
-	if (shm_to_gl(acon, surf, w, h, fmt, data, stride))
+	if (shm_to_gl(acon, surf, w, h, fmt, data, stride)){
+		if (acon == &surf->acon)
+			surf->shm_vidp = NULL;
 		goto out;
+	}
 
 /* two other options to avoid repacking, one is to actually use this signal-
  * handle facility to send a descriptor, and mark the type as the WL shared
@@ -477,18 +490,32 @@ static bool push_shm(struct wl_client* cl,
  * and use a rare linuxism known as process_vm_writev and process_vm_readv
  * and send the pointers that way. One might call that one exotic.
  */
-	if (stride != acon->stride){
-		trace(TRACE_SURF,"surf_commit(stride-mismatch)");
-		for (size_t row = 0; row < h; row++){
-			memcpy(&acon->vidp[row * acon->pitch],
-				&((uint8_t*)data)[row * stride],
-				w * sizeof(shmif_pixel)
+	size_t x1 = 0, y1 = 0, x2 = w, y2 = h;
+	if (!full){
+		x1 = acon->dirty.x1 < w ? acon->dirty.x1 : w;
+		y1 = acon->dirty.y1 < h ? acon->dirty.y1 : h;
+		x2 = acon->dirty.x2 < w ? acon->dirty.x2 : w;
+		y2 = acon->dirty.y2 < h ? acon->dirty.y2 : h;
+	}
+	else if (acon->hints & SHMIF_RHINT_SUBREGION)
+		arcan_shmif_dirty(acon, 0, 0, w, h, 0);
+
+	if (full && stride == acon->stride)
+		memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
+	else {
+		if (stride != acon->stride)
+			trace(TRACE_SURF,"surf_commit(stride-mismatch)");
+
+		for (size_t row = y1; row < y2; row++){
+			memcpy(&acon->vidp[row * acon->pitch + x1],
+				&((uint8_t*)data)[row * stride + x1 * sizeof(shmif_pixel)],
+				(x2 - x1) * sizeof(shmif_pixel)
 			);
 		}
 	}
-	else
-		memcpy(acon->vidp, data, w * h * sizeof(shmif_pixel));
 
+	if (acon == &surf->acon)
+		surf->shm_vidp = acon->vidp;
 	arcan_shmif_signal(acon, SHMIF_SIGVID | SHMIF_SIGBLK_NONE);
 
 out:
@@ -591,8 +618,14 @@ static void surf_commit(struct wl_client* cl, struct wl_resource* res)
  * order shm -> drm -> dma-buf.
  */
 
+	bool shm = push_shm(cl, acon, buf, surf);
+
+/* only a shm copy into the surface connection leaves a frame to build on */
+	if (!shm && acon == &surf->acon)
+		surf->shm_vidp = NULL;
+
 	if (
-		!push_shm(cl, acon, buf, surf) &&
+		!shm &&
 		!push_drm(cl, acon, buf, surf) &&
 		!push_dma(cl, acon, buf, surf)){
 		trace(TRACE_SURF, "surf_commit(unknown:%s)", surf->tracetag);
@@ -0,0 +1,201 @@
+/*
+ * Test and micro-benchmark for the engine event source registry
+ * (src/engine/arcan_evsrc.c). Registers a large number of pipes, checks that
+ * only the ready ones are reported with the right tag and mode, that masked
+ * and removed sources stay quiet, and measures the cost of an idle poll and of
+ * dispatching a handful of ready sources.
+ *
+ * Usage: evsrc_speed [number of pipes, default 4096]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdarg.h>
+#include <sys/resource.h>
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_shmif.h"
+#include "arcan_event.h"
+
+static size_t n_in, n_out;
+static intptr_t last_tag;
+static bool bad_tag;
+
+/* the registry dispatches direct to drain, count instead */
+int arcan_event_denqueue(struct arcan_evctx* ctx, const struct arcan_event* const ev)
+{
+	if (ev->sys.kind == EVENT_SYSTEM_DATA_IN)
+		n_in++;
+	else if (ev->sys.kind == EVENT_SYSTEM_DATA_OUT)
+		n_out++;
+
+	if (ev->sys.data.otag != (intptr_t) ev->sys.data.fd + 1000000)
+		bad_tag = true;
+
+	last_tag = ev->sys.data.otag;
+	return 0;
+}
+
+void arcan_timesleep(unsigned long val)
+{
+	struct timespec ts = {.tv_nsec = val * 1000000};
+	nanosleep(&ts, NULL);
+}
+
+void arcan_warning(const char* msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	vfprintf(stderr, msg, args);
+	va_end(args);
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void reset()
+{
+	n_in = n_out = 0;
+	bad_tag = false;
+}
+
+#define CHECK(X, ...) do { if (!(X)){\
+	fprintf(stderr, __VA_ARGS__); return EXIT_FAILURE; } } while(0)
+
+int main(int argc, char** argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 4096;
+	if (!n)
+		n = 4096;
+
+	struct rlimit rl;
+	getrlimit(RLIMIT_NOFILE, &rl);
+	if (rl.rlim_cur < n * 2 + 64){
+		rl.rlim_cur = rl.rlim_max < n * 2 + 64 ? rl.rlim_max : n * 2 + 64;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if (rl.rlim_cur < n * 2 + 64){
+			n = (rl.rlim_cur - 64) / 2;
+			printf("descriptor limit, using %zu pipes\n", n);
+		}
+	}
+
+	int (*pipes)[2] = malloc(sizeof(int[2]) * n);
+	CHECK(pipes, "out of memory\n");
+
+	struct arcan_evctx* ctx = NULL;
+	double start = now();
+	for (size_t i = 0; i < n; i++){
+		CHECK(0 == pipe(pipes[i]), "pipe failed at %zu\n", i);
+		int fd = pipes[i][0];
+		CHECK(arcan_event_add_source(ctx, fd, O_RDONLY, fd + 1000000, false),
+			"add_source failed at %zu\n", i);
+	}
+	double elapsed = now() - start;
+	printf("%-24s %8zu %10.3f us/op\n", "add_source", n, elapsed * 1e6 / n);
+
+/* nothing ready, nothing reported */
+	reset();
+	size_t rounds = 1000;
+	start = now();
+	for (size_t i = 0; i < rounds; i++)
+		arcan_event_poll_sources(ctx, 0);
+	elapsed = now() - start;
+	printf("%-24s %8zu %10.3f us/op\n", "poll (idle)", rounds, elapsed * 1e6 / rounds);
+	CHECK(!n_in && !n_out, "idle poll reported %zu/%zu\n", n_in, n_out);
+
+/* make a few spread out pipes readable */
+	size_t n_ready = n < 16 ? n : 16;
+	for (size_t i = 0; i < n_ready; i++)
+		CHECK(1 == write(pipes[i * (n / n_ready)][1], "x", 1), "write failed\n");
+
+	reset();
+	start = now();
+	for (size_t i = 0; i < rounds; i++)
+		arcan_event_poll_sources(ctx, 0);
+	elapsed = now() - start;
+	printf("%-24s %8zu %10.3f us/op\n", "poll (16 ready)", rounds, elapsed * 1e6 / rounds);
+	CHECK(n_in == n_ready * rounds && !n_out && !bad_tag,
+		"expected %zu in, got %zu in, %zu out, tags %s\n",
+		n_ready * rounds, n_in, n_out, bad_tag ? "bad" : "ok");
+
+/* removed sources go quiet and return their tag */
+	for (size_t i = 0; i < n_ready; i++){
+		int fd = pipes[i * (n / n_ready)][0];
+		intptr_t tag = 0;
+		CHECK(arcan_event_del_source(ctx, fd, O_RDONLY, &tag) && tag == fd + 1000000,
+			"del_source failed for %d\n", fd);
+		CHECK(!arcan_event_del_source(ctx, fd, O_RDONLY, NULL),
+			"del_source twice succeeded for %d\n", fd);
+	}
+	reset();
+	arcan_event_poll_sources(ctx, 0);
+	CHECK(!n_in && !n_out, "removed sources reported %zu/%zu\n", n_in, n_out);
+
+/* masked sources are tracked but never reported */
+	int fd = pipes[0][0];
+	CHECK(arcan_event_add_source(ctx, fd, O_RDONLY, fd + 1000000, true),
+		"masked add_source failed\n");
+	reset();
+	arcan_event_poll_sources(ctx, 0);
+	CHECK(!n_in && !n_out, "masked source reported\n");
+	arcan_event_del_source(ctx, fd, O_RDONLY, NULL);
+
+/* the same descriptor in two modes only reports the matching one */
+	fd = pipes[1][1];
+	CHECK(arcan_event_add_source(ctx, fd, O_WRONLY, fd + 1000000, false),
+		"write add_source failed\n");
+	reset();
+	arcan_event_poll_sources(ctx, 0);
+	CHECK(n_out == 1 && !n_in && last_tag == fd + 1000000,
+		"write source reported %zu in, %zu out\n", n_in, n_out);
+	arcan_event_del_source(ctx, fd, O_WRONLY, NULL);
+
+/* closing the write end is reported as data-in (and the read fails) */
+	close(pipes[n - 1][1]);
+	reset();
+	arcan_event_poll_sources(ctx, 0);
+	CHECK(n_in == 1 && !n_out, "hangup reported %zu in, %zu out\n", n_in, n_out);
+
+/* timeout is still honoured with no ready sources */
+	arcan_event_del_source(ctx, pipes[n - 1][0], O_RDONLY, NULL);
+	reset();
+	start = now();
+	arcan_event_poll_sources(ctx, 20);
+	elapsed = now() - start;
+	CHECK(elapsed >= 0.015 && !n_in && !n_out, "timeout not honoured\n");
+
+/* regular files can't be waited on and are always ready, as with poll() */
+	FILE* tmpf = tmpfile();
+	CHECK(tmpf, "tmpfile failed\n");
+	fd = fileno(tmpf);
+	CHECK(arcan_event_add_source(ctx, fd, O_RDONLY, fd + 1000000, false),
+		"file add_source failed\n");
+	reset();
+	arcan_event_poll_sources(ctx, 0);
+	CHECK(n_in == 1 && !n_out, "file source reported %zu in, %zu out\n", n_in, n_out);
+	arcan_event_del_source(ctx, fd, O_RDONLY, NULL);
+	fclose(tmpf);
+
+	start = now();
+	for (size_t i = 0; i < n; i++){
+		arcan_event_del_source(ctx, pipes[i][0], O_RDONLY, NULL);
+		close(pipes[i][0]);
+		if (i != n - 1)
+			close(pipes[i][1]);
+	}
+	elapsed = now() - start;
+	printf("%-24s %8zu %10.3f us/op\n", "del_source + close", n, elapsed * 1e6 / n);
+
+	free(pipes);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,396 @@
+/*
+ * Headless benchmark for the aloadimage decoder pool (src/tools/aloadimage,
+ * imgload.c). Walks a playlist of images the way a slideshow would, keeping a
+ * window of items queued ahead of the current one, and reports images/s along
+ * with the peak resident size of this process and of the largest decoder.
+ *
+ * Without a directory, a set of PNG and JPEG files is generated into a
+ * temporary one first (uncompressed deflate and DC-only baseline, as there
+ * are no encoders around to link).
+ *
+ * Usage: imgload_speed [images, default 200] [workers, default 0=auto]
+ *                      [window, default 5] [directory]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include <arcan_shmif.h>
+#include "imgload.h"
+
+#define GEN_W 800
+#define GEN_H 600
+
+int image_size_limit_mb = 64;
+bool disable_syscall_flt = false;
+int imgload_workers = 0;
+
+void debug_message(const char* msg, ...)
+{
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void pixel(size_t x, size_t y, size_t seed, uint8_t out[3])
+{
+	out[0] = (x + seed * 13) & 0xff;
+	out[1] = (y + seed * 7) & 0xff;
+	out[2] = ((x ^ y) + seed) & 0xff;
+}
+
+static uint32_t crc_tbl[256];
+
+static uint32_t crc32(uint32_t crc, const uint8_t* buf, size_t len)
+{
+	if (!crc_tbl[1])
+		for (uint32_t i = 0; i < 256; i++){
+			uint32_t c = i;
+			for (size_t j = 0; j < 8; j++)
+				c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crc_tbl[i] = c;
+		}
+
+	crc = ~crc;
+	for (size_t i = 0; i < len; i++)
+		crc = crc_tbl[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void put32(FILE* fout, uint32_t v)
+{
+	uint8_t b[4] = {v >> 24, v >> 16, v >> 8, v};
+	fwrite(b, 4, 1, fout);
+}
+
+static void png_chunk(FILE* fout, const char* type, const uint8_t* buf, size_t len)
+{
+	put32(fout, len);
+	fwrite(type, 4, 1, fout);
+	fwrite(buf, len, 1, fout);
+	uint32_t crc = crc32(0, (const uint8_t*) type, 4);
+	put32(fout, crc32(crc, buf, len));
+}
+
+static bool write_png(const char* path, size_t w, size_t h, size_t seed)
+{
+	FILE* fout = fopen(path, "w");
+	if (!fout)
+		return false;
+
+	fwrite("\x89PNG\r\n\x1a\n", 8, 1, fout);
+	uint8_t ihdr[13] = {
+		w >> 24, w >> 16, w >> 8, w, h >> 24, h >> 16, h >> 8, h, 8, 2, 0, 0, 0};
+	png_chunk(fout, "IHDR", ihdr, sizeof(ihdr));
+
+/* filter byte + rgb per row */
+	size_t raw_sz = h * (w * 3 + 1);
+	uint8_t* raw = malloc(raw_sz);
+	uint8_t* cur = raw;
+	for (size_t y = 0; y < h; y++){
+		*cur++ = 0;
+		for (size_t x = 0; x < w; x++, cur += 3)
+			pixel(x, y, seed, cur);
+	}
+
+/* zlib stream of stored blocks */
+	size_t nblocks = (raw_sz + 65534) / 65535;
+	size_t z_sz = 2 + nblocks * 5 + raw_sz + 4;
+	uint8_t* z = malloc(z_sz);
+	uint8_t* zc = z;
+	*zc++ = 0x78;
+	*zc++ = 0x01;
+	uint32_t s1 = 1, s2 = 0;
+	for (size_t ofs = 0; ofs < raw_sz;){
+		size_t len = raw_sz - ofs > 65535 ? 65535 : raw_sz - ofs;
+		*zc++ = ofs + len == raw_sz;
+		*zc++ = len & 0xff;
+		*zc++ = len >> 8;
+		*zc++ = ~len & 0xff;
+		*zc++ = (~len >> 8) & 0xff;
+		for (size_t i = 0; i < len; i++){
+			s1 = (s1 + raw[ofs + i]) % 65521;
+			s2 = (s2 + s1) % 65521;
+		}
+		memcpy(zc, &raw[ofs], len);
+		zc += len;
+		ofs += len;
+	}
+	uint32_t adler = (s2 << 16) | s1;
+	*zc++ = adler >> 24;
+	*zc++ = adler >> 16;
+	*zc++ = adler >> 8;
+	*zc++ = adler;
+
+	png_chunk(fout, "IDAT", z, zc - z);
+	png_chunk(fout, "IEND", NULL, 0);
+
+	free(raw);
+	free(z);
+	fclose(fout);
+	return true;
+}
+
+struct bitwriter {
+	FILE* fout;
+	uint32_t acc;
+	int bits;
+};
+
+static void put_bits(struct bitwriter* bw, uint32_t val, int n)
+{
+	for (int i = n - 1; i >= 0; i--){
+		bw->acc = (bw->acc << 1) | ((val >> i) & 1);
+		if (++bw->bits == 8){
+			fputc(bw->acc, bw->fout);
+			if (bw->acc == 0xff)
+				fputc(0x00, bw->fout);
+			bw->acc = bw->bits = 0;
+		}
+	}
+}
+
+/* standard luminance DC table, AC has nothing but end-of-block */
+static const uint8_t dc_bits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1};
+static const uint8_t ac_bits[16] = {1};
+
+static bool write_jpeg(const char* path, size_t w, size_t h, size_t seed)
+{
+	FILE* fout = fopen(path, "w");
+	if (!fout)
+		return false;
+
+	uint16_t dc_code[12];
+	uint8_t dc_len[12];
+	for (size_t len = 1, code = 0, sym = 0; len <= 16; len++, code <<= 1)
+		for (size_t i = 0; i < dc_bits[len - 1]; i++, code++, sym++){
+			dc_code[sym] = code;
+			dc_len[sym] = len;
+		}
+
+	static const uint8_t hdr[] = {
+		0xff, 0xd8,
+/* DQT, flat 8 */
+		0xff, 0xdb, 0x00, 67, 0x00,
+		8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+		8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+		8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+		8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8,
+	};
+	fwrite(hdr, sizeof(hdr), 1, fout);
+
+	uint8_t sof[] = {
+		0xff, 0xc0, 0x00, 17, 8, h >> 8, h, w >> 8, w, 3,
+		1, 0x11, 0, 2, 0x11, 0, 3, 0x11, 0
+	};
+	fwrite(sof, sizeof(sof), 1, fout);
+
+	fwrite((uint8_t[]){0xff, 0xc4, 0x00, 3 + 16 + 12, 0x00}, 5, 1, fout);
+	fwrite(dc_bits, 16, 1, fout);
+	for (uint8_t i = 0; i < 12; i++)
+		fputc(i, fout);
+
+	fwrite((uint8_t[]){0xff, 0xc4, 0x00, 3 + 16 + 1, 0x10}, 5, 1, fout);
+	fwrite(ac_bits, 16, 1, fout);
+	fputc(0x00, fout);
+
+	static const uint8_t sos[] = {
+		0xff, 0xda, 0x00, 12, 3, 1, 0x00, 2, 0x00, 3, 0x00, 0, 63, 0};
+	fwrite(sos, sizeof(sos), 1, fout);
+
+	struct bitwriter bw = {.fout = fout};
+	int pred[3] = {0};
+
+	for (size_t by = 0; by < h; by += 8)
+		for (size_t bx = 0; bx < w; bx += 8){
+			float sum[3] = {0};
+			for (size_t y = by; y < by + 8; y++)
+				for (size_t x = bx; x < bx + 8; x++){
+					uint8_t px[3];
+					pixel(x, y, seed, px);
+					sum[0] += 0.299f * px[0] + 0.587f * px[1] + 0.114f * px[2];
+					sum[1] += -0.1687f * px[0] - 0.3313f * px[1] + 0.5f * px[2] + 128.0f;
+					sum[2] += 0.5f * px[0] - 0.4187f * px[1] - 0.0813f * px[2] + 128.0f;
+				}
+
+/* DC of the level shifted block is 8 * mean, quantized by 8 */
+			for (size_t c = 0; c < 3; c++){
+				int dc = (int)(sum[c] / 64.0f + 0.5f) - 128;
+				int diff = dc - pred[c];
+				pred[c] = dc;
+
+				int mag = diff < 0 ? -diff : diff;
+				int cat = 0;
+				while (mag >> cat)
+					cat++;
+
+				put_bits(&bw, dc_code[cat], dc_len[cat]);
+				if (cat)
+					put_bits(&bw, diff < 0 ? diff + (1 << cat) - 1 : diff, cat);
+				put_bits(&bw, 0, 1);
+			}
+		}
+
+	if (bw.bits)
+		put_bits(&bw, 0x7f, 8 - bw.bits);
+	fwrite((uint8_t[]){0xff, 0xd9}, 2, 1, fout);
+	fclose(fout);
+	return true;
+}
+
+static size_t generate(const char* dir, size_t n, char** paths)
+{
+	for (size_t i = 0; i < n; i++){
+		char buf[strlen(dir) + 32];
+		snprintf(buf, sizeof(buf), "%s/%05zu.%s", dir, i, i % 2 ? "jpg" : "png");
+		if (!(i % 2 ? write_jpeg : write_png)(buf, GEN_W, GEN_H, i)){
+			fprintf(stderr, "couldn't write %s\n", buf);
+			return i;
+		}
+		paths[i] = strdup(buf);
+	}
+	return n;
+}
+
+static int cmpstr(const void* a, const void* b)
+{
+	return strcmp(*(char**)a, *(char**)b);
+}
+
+static size_t scan(const char* dir, size_t n, char** paths)
+{
+	DIR* d = opendir(dir);
+	if (!d)
+		return 0;
+
+	size_t count = 0;
+	struct dirent* ent;
+	while (count < n && (ent = readdir(d))){
+		char buf[strlen(dir) + strlen(ent->d_name) + 2];
+		snprintf(buf, sizeof(buf), "%s/%s", dir, ent->d_name);
+		struct stat st;
+		if (0 == stat(buf, &st) && S_ISREG(st.st_mode))
+			paths[count++] = strdup(buf);
+	}
+	closedir(d);
+
+	qsort(paths, count, sizeof(char*), cmpstr);
+	return count;
+}
+
+static void wait_pool()
+{
+	struct pollfd fds[IMGLOAD_MAX_WORKERS];
+	size_t n = imgload_pollfds(fds, IMGLOAD_MAX_WORKERS);
+	if (n)
+		poll(fds, n, 1000);
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 200;
+	imgload_workers = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+	size_t window = argc > 3 ? strtoul(argv[3], NULL, 10) : 5;
+	const char* dir = argc > 4 ? argv[4] : NULL;
+	if (!n)
+		n = 200;
+	if (!window)
+		window = 1;
+
+	char** paths = malloc(sizeof(char*) * n);
+	char tmpdir[] = "/tmp/imgload_speed_XXXXXX";
+	bool generated = !dir;
+
+	if (generated){
+		if (!mkdtemp(tmpdir)){
+			fprintf(stderr, "couldn't create temporary directory\n");
+			return EXIT_FAILURE;
+		}
+		dir = tmpdir;
+		double start = now();
+		n = generate(dir, n, paths);
+		printf("generated %zu %dx%d images in %.2fs\n", n, GEN_W, GEN_H, now() - start);
+	}
+	else
+		n = scan(dir, n, paths);
+
+	if (!n){
+		fprintf(stderr, "no images\n");
+		return EXIT_FAILURE;
+	}
+
+	struct img_state* pl = calloc(n, sizeof(struct img_state));
+	for (size_t i = 0; i < n; i++)
+		pl[i] = (struct img_state){
+			.fd = -1,
+			.fname = paths[i],
+			.density = 38.0
+		};
+
+/* step through in order with [window] items queued, as aloadimage would */
+	size_t ok = 0, broken = 0, pixels = 0, queued = 0;
+	double start = now();
+
+	for (size_t i = 0; i < n; i++){
+		for (; queued < n && queued < i + window; queued++)
+			imgload_spawn(NULL, &pl[queued], queued == i ? 0 : 1);
+
+		while (!imgload_poll(&pl[i]))
+			wait_pool();
+
+		if (pl[i].broken || !pl[i].ready){
+			fprintf(stderr, "%s: failed (%s)\n", pl[i].fname, pl[i].msg);
+			broken++;
+		}
+		else {
+			if (generated &&
+				(pl[i].w != GEN_W || pl[i].h != GEN_H ||
+				pl[i].buf_sz != GEN_W * GEN_H * 4)){
+				fprintf(stderr, "%s: unexpected size %d*%d\n",
+					pl[i].fname, pl[i].w, pl[i].h);
+				broken++;
+			}
+			else
+				ok++;
+			pixels += pl[i].w * pl[i].h;
+		}
+
+		imgload_reset(&pl[i]);
+	}
+
+	double elapsed = now() - start;
+	imgload_shutdown();
+
+	struct rusage self, children;
+	getrusage(RUSAGE_SELF, &self);
+	getrusage(RUSAGE_CHILDREN, &children);
+
+	printf("%zu images (%zu failed) in %.2fs, %.1f images/s, %.1f Mpixels/s\n",
+		n, broken, elapsed, n / elapsed, pixels / elapsed / 1e6);
+	printf("peak rss: %ld KiB (viewer), %ld KiB (largest decoder)\n",
+		self.ru_maxrss, children.ru_maxrss);
+
+	for (size_t i = 0; i < n; i++){
+		if (generated)
+			unlink(paths[i]);
+		free(paths[i]);
+	}
+	if (generated)
+		rmdir(tmpdir);
+
+	free(paths);
+	free(pl);
+	return broken ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,265 @@
+/*
+ * Headless harness for the Lua non-blocking I/O bindings (alt/nbio.c, here
+ * built from the vendored copy in shmif/tui/lua as that one is free of engine
+ * dependencies). A child process streams lines into a pipe and a plain
+ * lua_State reads them back through each of the :read() forms, checking that
+ * line and byte counts match and reporting lines/s.
+ *
+ * Usage: nbio_speed [number of lines, default 1000000] [line length, default 80]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#include "nbio.h"
+
+static int wait_fd = -1;
+
+static const struct {
+	const char* name;
+	const char* src;
+} modes[] = {
+	{"read()",
+		"local n, b = 0, 0\n"
+		"while true do\n"
+		"	local line, alive = src:read()\n"
+		"	if line then n = n + 1; b = b + #line\n"
+		"	elseif not alive then break\n"
+		"	else wait() end\n"
+		"end\n"
+		"return n, b\n"
+	},
+	{"read(cb)",
+		"local n, b, alive = 0, 0, true\n"
+		"local cb = function(line, eof) n = n + 1; b = b + #line end\n"
+		"while alive do\n"
+		"	_, alive = src:read(false, cb)\n"
+		"	if alive then wait() end\n"
+		"end\n"
+		"return n, b\n"
+	},
+	{"read(tbl)",
+		"local n, b, alive = 0, 0, true\n"
+		"while alive do\n"
+		"	local tbl = {}\n"
+		"	_, alive = src:read(false, tbl)\n"
+		"	for i=1,#tbl do n = n + 1; b = b + #tbl[i] end\n"
+		"	if alive then wait() end\n"
+		"end\n"
+		"return n, b\n"
+	},
+	{"read(tbl, cb)",
+		"local n, b, alive = 0, 0, true\n"
+		"local tbl = {}\n"
+		"local cb = function(lines, eof)\n"
+		"	for i=1,#lines do n = n + 1; b = b + #lines[i]; lines[i] = nil end\n"
+		"end\n"
+		"while alive do\n"
+		"	_, alive = src:read(false, tbl, cb)\n"
+		"	if alive then wait() end\n"
+		"end\n"
+		"return n, b\n"
+	},
+	{"read(true)",
+		"local n, b, alive = 0, 0, true\n"
+		"while alive do\n"
+		"	local buf\n"
+		"	buf, alive = src:read(true)\n"
+		"	if buf then\n"
+		"		b = b + #buf\n"
+		"		for _ in string.gmatch(buf, \"\\n\") do n = n + 1 end\n"
+		"	end\n"
+		"	if alive then wait() end\n"
+		"end\n"
+		"return n, b\n"
+	}
+};
+
+/* the vendored copy borrows this from shmif */
+unsigned long long arcan_timemillis()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool add_job(int fd, mode_t mode, intptr_t tag)
+{
+	return true;
+}
+
+static bool remove_job(int fd, mode_t mode, intptr_t* out)
+{
+	return false;
+}
+
+static void error_job(lua_State* L, int fd, intptr_t tag, const char* src)
+{
+}
+
+static int lwait(lua_State* L)
+{
+	struct pollfd pfd = {.fd = wait_fd, .events = POLLIN};
+	poll(&pfd, 1, 1000);
+	return 0;
+}
+
+/* write [n] lines of [len] bytes (including the linefeed) in big blocks, then
+ * optionally one line of [tail] bytes */
+static pid_t spawn_writer(int fd, size_t n, size_t len, size_t tail)
+{
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid)
+		return pid;
+
+	size_t per = 65536 / len + 1;
+	char* buf = malloc(per * len);
+	for (size_t i = 0; i < per; i++){
+		memset(&buf[i * len], 'a' + i % 26, len - 1);
+		buf[i * len + len - 1] = '\n';
+	}
+
+	while (n){
+		size_t step = n < per ? n : per;
+		size_t left = step * len;
+		char* cur = buf;
+		while (left){
+			ssize_t nw = write(fd, cur, left);
+			if (-1 == nw)
+				continue;
+			cur += nw;
+			left -= nw;
+		}
+		n -= step;
+	}
+
+	if (tail){
+		buf = realloc(buf, tail);
+		memset(buf, 'x', tail - 1);
+		buf[tail - 1] = '\n';
+		for (size_t ofs = 0; ofs < tail;){
+			ssize_t nw = write(fd, &buf[ofs], tail - ofs);
+			if (nw > 0)
+				ofs += nw;
+		}
+	}
+
+	_exit(EXIT_SUCCESS);
+}
+
+static bool run(lua_State* L, const char* src,
+	size_t n, size_t len, size_t tail, size_t* out_n, size_t* out_b, double* t)
+{
+	int fds[2];
+	if (-1 == pipe(fds))
+		return false;
+
+	pid_t pid = spawn_writer(fds[1], n, len, tail);
+	close(fds[1]);
+
+	struct nonblock_io* dst;
+	if (!alt_nbio_import(L, fds[0], O_RDONLY, &dst, NULL))
+		return false;
+	wait_fd = fds[0];
+	lua_setglobal(L, "src");
+
+	if (0 != luaL_loadstring(L, src)){
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return false;
+	}
+
+	double start = now();
+	if (0 != lua_pcall(L, 0, 2, 0)){
+		fprintf(stderr, "%s\n", lua_tostring(L, -1));
+		return false;
+	}
+	*t = now() - start;
+
+	*out_n = lua_tointeger(L, -2);
+	*out_b = lua_tointeger(L, -1);
+	lua_pop(L, 2);
+
+/* dropping the reference lets __gc close it */
+	lua_pushnil(L);
+	lua_setglobal(L, "src");
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	waitpid(pid, NULL, 0);
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+	size_t len = argc > 2 ? strtoul(argv[2], NULL, 10) : 80;
+	if (!n)
+		n = 1000000;
+	if (len < 2)
+		len = 80;
+
+	lua_State* L = luaL_newstate();
+	luaL_openlibs(L);
+	alt_nbio_register(L, add_job, remove_job, error_job);
+	lua_pushcfunction(L, lwait);
+	lua_setglobal(L, "wait");
+
+	printf("%-16s %10s %12s %10s\n", "mode", "lines", "lines/s", "MB/s");
+	int rc = EXIT_SUCCESS;
+
+	for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++){
+		size_t got_n, got_b;
+		double t;
+		if (!run(L, modes[i].src, n, len, 0, &got_n, &got_b, &t)){
+			fprintf(stderr, "%s: harness failure\n", modes[i].name);
+			return EXIT_FAILURE;
+		}
+
+		printf("%-16s %10zu %12.0f %10.1f%s\n", modes[i].name, got_n,
+			got_n / t, got_b / t / 1e6,
+			got_n != n || got_b != n * len ? " (MISMATCH)" : "");
+
+		if (got_n != n || got_b != n * len)
+			rc = EXIT_FAILURE;
+	}
+
+/* a line longer than the initial buffer should come out whole */
+	size_t got_n, got_b;
+	double t;
+	size_t tail = NBIO_BUFFER_BASE * 3 + 17;
+	if (!run(L, modes[0].src, 10, len, tail, &got_n, &got_b, &t) ||
+		got_n != 11 || got_b != 10 * len + tail){
+		fprintf(stderr, "long line: got %zu lines, %zu bytes\n", got_n, got_b);
+		rc = EXIT_FAILURE;
+	}
+
+/* while one longer than the cap is split into cap-sized pieces */
+	tail = NBIO_BUFFER_CAP + 17;
+	if (!run(L, modes[2].src, 10, len, tail, &got_n, &got_b, &t) ||
+		got_n != 12 || got_b != 10 * len + tail){
+		fprintf(stderr, "capped line: got %zu lines, %zu bytes\n", got_n, got_b);
+		rc = EXIT_FAILURE;
+	}
+
+	lua_close(L);
+	return rc;
+}
@@ -0,0 +1,288 @@
+/*
+ * Test and benchmark for the asynchronous readback ring (platform/agp/
+ * readback.c) using the software slots and simulated fences of the stub AGP
+ * platform. Checks that readbacks come back in order with the contents the
+ * store had at request time, across resizes and ring size changes, then
+ * simulates a render loop where the transfer takes longer than a frame and
+ * compares dropped frames and latency for different ring sizes.
+ *
+ * Usage: readback_ring [transfer delay ms, default 12] [frame time ms, default 5]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "platform_types.h"
+#include "video_platform.h"
+#include "platform.h"
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+#include "arcan_video.h"
+#include "arcan_videoint.h"
+
+struct arcan_video_display arcan_video_display;
+
+static const char* delay_str = "12";
+
+/* the stub platform takes the simulated transfer time from the config layer */
+static bool lookup(const char* const key,
+	unsigned short ind, char** val, uintptr_t tag)
+{
+	if (strcmp(key, "graphics_readback_delay") != 0 || ind){
+		if (val)
+			*val = NULL;
+		return false;
+	}
+	if (val)
+		*val = strdup(delay_str);
+	return true;
+}
+
+cfg_lookup_fun platform_config_lookup(uintptr_t* tag)
+{
+	*tag = 0;
+	return lookup;
+}
+
+unsigned long long arcan_timemillis()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+unsigned long long arcan_timemicros()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sleep_ms(unsigned ms)
+{
+	struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000};
+	nanosleep(&ts, NULL);
+}
+
+static void setup_store(struct agp_vstore* s, size_t w, size_t h)
+{
+	free(s->vinf.text.raw);
+	s->w = w;
+	s->h = h;
+	s->bpp = sizeof(av_pixel);
+	s->txmapped = TXSTATE_TEX2D;
+	s->vinf.text.s_raw = w * h * sizeof(av_pixel);
+	s->vinf.text.raw = malloc(s->vinf.text.s_raw);
+}
+
+/* stamp the frame number into every pixel so a mixed up or torn slot shows */
+static void draw(struct agp_vstore* s, uint32_t frame)
+{
+	for (size_t i = 0; i < s->w * s->h; i++)
+		s->vinf.text.raw[i] = frame;
+}
+
+static bool check(struct asynch_readback_meta* m,
+	uint32_t frame, size_t w, size_t h)
+{
+	if (!m->ptr || m->w != w || m->h != h ||
+		m->buf_sz != w * h * sizeof(av_pixel))
+		return false;
+
+	for (size_t i = 0; i < w * h; i++)
+		if (m->ptr[i] != frame)
+			return false;
+
+	return true;
+}
+
+#define CHECK(X, ...) do { if (!(X)){\
+	fprintf(stderr, __VA_ARGS__); return false; } } while(0)
+
+static bool test_order(struct agp_vstore* s)
+{
+	setup_store(s, 64, 32);
+	agp_readback_buffers(s, 4);
+
+/* fill the ring, the next request should be refused */
+	for (uint32_t i = 0; i < 4; i++){
+		draw(s, i);
+		CHECK(agp_request_readback(s), "request %"PRIu32" failed\n", i);
+	}
+	CHECK(!agp_request_readback(s), "request into a full ring accepted\n");
+	CHECK(agp_readback_pending(s) == 4, "pending mismatch\n");
+
+/* nothing is handed out before the simulated fence signals */
+	struct asynch_readback_meta m = agp_poll_readback(s);
+	CHECK(!m.ptr, "readback completed ahead of its fence\n");
+
+	sleep_ms(atoi(delay_str) + 2);
+	for (uint32_t i = 0; i < 4; i++){
+		m = agp_poll_readback(s);
+		CHECK(check(&m, i, 64, 32), "readback %"PRIu32" out of order/corrupt\n", i);
+
+/* a second poll without release has to wait */
+		struct asynch_readback_meta m2 = agp_poll_readback(s);
+		CHECK(!m2.ptr, "poll while mapped returned data\n");
+		m.release(m.tag);
+	}
+	CHECK(!agp_readback_pending(s), "ring not empty\n");
+
+/* wrap around a few times */
+	for (uint32_t i = 0; i < 10; i++){
+		draw(s, 100 + i);
+		CHECK(agp_request_readback(s), "wrap request %"PRIu32" failed\n", i);
+		if (i % 2){
+			sleep_ms(atoi(delay_str) + 2);
+			for (uint32_t j = i - 1; j <= i; j++){
+				m = agp_poll_readback(s);
+				CHECK(check(&m, 100 + j, 64, 32), "wrap readback %"PRIu32" bad\n", j);
+				m.release(m.tag);
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool test_resize(struct agp_vstore* s)
+{
+	setup_store(s, 64, 32);
+	agp_readback_buffers(s, 2);
+	draw(s, 1);
+	CHECK(agp_request_readback(s), "request before resize failed\n");
+
+	setup_store(s, 32, 16);
+	draw(s, 2);
+	CHECK(agp_request_readback(s), "request after resize failed\n");
+
+	sleep_ms(atoi(delay_str) + 2);
+	struct asynch_readback_meta m = agp_poll_readback(s);
+	CHECK(check(&m, 1, 64, 32), "pre-resize readback bad\n");
+	m.release(m.tag);
+	m = agp_poll_readback(s);
+	CHECK(check(&m, 2, 32, 16), "post-resize readback bad\n");
+	m.release(m.tag);
+
+	return true;
+}
+
+static bool test_shrink(struct agp_vstore* s)
+{
+	setup_store(s, 16, 16);
+	agp_readback_buffers(s, 4);
+
+/* move the head so the pending set wraps before shrinking */
+	draw(s, 0);
+	agp_request_readback(s);
+	draw(s, 1);
+	agp_request_readback(s);
+	sleep_ms(atoi(delay_str) + 2);
+	struct asynch_readback_meta m = agp_poll_readback(s);
+	m.release(m.tag);
+	m = agp_poll_readback(s);
+	m.release(m.tag);
+
+	for (uint32_t i = 0; i < 4; i++){
+		draw(s, 10 + i);
+		CHECK(agp_request_readback(s), "request %"PRIu32" before shrink failed\n", i);
+	}
+
+/* the oldest ones survive */
+	agp_readback_buffers(s, 2);
+	CHECK(agp_readback_pending(s) == 2, "pending after shrink mismatch\n");
+	sleep_ms(atoi(delay_str) + 2);
+	for (uint32_t i = 0; i < 2; i++){
+		m = agp_poll_readback(s);
+		CHECK(check(&m, 10 + i, 16, 16), "readback %"PRIu32" after shrink bad\n", i);
+		m.release(m.tag);
+	}
+	CHECK(!agp_poll_readback(s).ptr, "discarded readback delivered\n");
+
+	agp_readback_drop(s, true);
+	CHECK(!s->vinf.text.readback && !agp_readback_pending(s), "drop left state\n");
+	return true;
+}
+
+/* Render [n_frames] frames of [frame_ms] each, requesting a readback after
+ * every one and collecting whatever has completed, as the engine does. */
+static bool run_pipeline(struct agp_vstore* s, size_t ring,
+	size_t n_frames, unsigned frame_ms)
+{
+	setup_store(s, 320, 240);
+	agp_readback_drop(s, true);
+	agp_readback_buffers(s, ring);
+
+	size_t drops = 0, got = 0;
+	uint64_t lat_sum = 0, lat_max = 0;
+	uint32_t last = 0;
+	bool first = true;
+
+	uint64_t start = arcan_timemicros();
+	for (uint32_t i = 0; i < n_frames + 1000; i++){
+		if (i < n_frames){
+			draw(s, i);
+			if (!agp_request_readback(s))
+				drops++;
+		}
+		else if (!agp_readback_pending(s))
+			break;
+
+		struct asynch_readback_meta m;
+		while ((m = agp_poll_readback(s)).ptr){
+			uint32_t frame = m.ptr[0];
+			CHECK(first || frame > last, "ring %zu: frame %"PRIu32" after %"PRIu32"\n",
+				ring, frame, last);
+			CHECK(check(&m, frame, 320, 240), "ring %zu: frame %"PRIu32" corrupt\n",
+				ring, frame);
+			uint64_t lat = arcan_timemicros() - m.requested;
+			lat_sum += lat;
+			if (lat > lat_max)
+				lat_max = lat;
+			last = frame;
+			first = false;
+			got++;
+			m.release(m.tag);
+		}
+
+		sleep_ms(frame_ms);
+	}
+	double elapsed = (arcan_timemicros() - start) / 1e6;
+
+	printf("%-6zu %8zu %8zu %8zu %10.1f %10.1f %10.1f\n", ring, n_frames, got,
+		drops, got / elapsed, got ? lat_sum / got / 1000.0 : 0.0, lat_max / 1000.0);
+
+	CHECK(got + drops == n_frames, "ring %zu: %zu delivered + %zu dropped != %zu\n",
+		ring, got, drops, n_frames);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1)
+		delay_str = argv[1];
+	unsigned frame_ms = argc > 2 ? strtoul(argv[2], NULL, 10) : 5;
+	if (!frame_ms)
+		frame_ms = 5;
+
+	struct agp_vstore store = {0};
+	if (!test_order(&store) || !test_resize(&store) || !test_shrink(&store))
+		return EXIT_FAILURE;
+
+	printf("transfer %s ms, frame %u ms\n", delay_str, frame_ms);
+	printf("%-6s %8s %8s %8s %10s %10s %10s\n",
+		"ring", "frames", "read", "dropped", "read/s", "lat ms", "max ms");
+
+	for (size_t ring = 1; ring <= 4; ring++)
+		if (!run_pipeline(&store, ring, 200, frame_ms))
+			return EXIT_FAILURE;
+
+	agp_readback_drop(&store, true);
+	free(store.vinf.text.raw);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+/*
+ * Micro-benchmark for the frameserver speex resampler, runs each quality
+ * level over a few common conversions with the scalar reference kernels and
+ * with the runtime selected vector ones, and reports throughput along with
+ * the largest deviation between the two outputs.
+ *
+ * Usage: resample_speed [seconds of input, default 10]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "speex_resampler.h"
+
+static const struct {
+	unsigned in, out;
+} ratios[] = {
+	{44100, 48000},
+	{48000, 44100},
+	{44100, 88200},
+	{48000, 96000},
+	{96000, 48000},
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(unsigned in_rate, unsigned out_rate, int quality,
+	const float* in, size_t in_len, float* out, size_t out_len, size_t* produced)
+{
+	int err;
+	SpeexResamplerState* st =
+		speex_resampler_init(2, in_rate, out_rate, quality, &err);
+	if (!st){
+		fprintf(stderr, "init failed: %s\n", speex_resampler_strerror(err));
+		exit(EXIT_FAILURE);
+	}
+
+/* feed in blocks that are about the size a frameserver would push */
+	const size_t block = 1024;
+	size_t ofs_in = 0, ofs_out = 0;
+	double start = now();
+
+	while (ofs_in < in_len && ofs_out < out_len){
+		spx_uint32_t nin = in_len - ofs_in > block ? block : in_len - ofs_in;
+		spx_uint32_t nout = out_len - ofs_out;
+		speex_resampler_process_interleaved_float(st,
+			&in[ofs_in * 2], &nin, &out[ofs_out * 2], &nout);
+		ofs_in += nin;
+		ofs_out += nout;
+		if (!nin && !nout)
+			break;
+	}
+
+	double elapsed = now() - start;
+	speex_resampler_destroy(st);
+	*produced = ofs_out;
+	return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+	double seconds = argc > 1 ? strtod(argv[1], NULL) : 10.0;
+	if (seconds <= 0)
+		seconds = 10.0;
+
+	printf("vector kernel: %s\n", speex_resampler_kernel(0));
+	printf("%-14s %3s %12s %12s %8s %12s\n",
+		"ratio", "q", "scalar x-rt", "vector x-rt", "speedup", "max diff");
+
+	for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++){
+		size_t in_len = ratios[r].in * seconds;
+		size_t out_len = (size_t)(in_len * ((double)ratios[r].out / ratios[r].in)) + 4096;
+
+		float* in = malloc(in_len * 2 * sizeof(float));
+		float* ref = malloc(out_len * 2 * sizeof(float));
+		float* vec = malloc(out_len * 2 * sizeof(float));
+		if (!in || !ref || !vec){
+			fprintf(stderr, "out of memory\n");
+			return EXIT_FAILURE;
+		}
+
+/* two tones and some noise, scaled like SINT16 input */
+		srand(1);
+		for (size_t i = 0; i < in_len; i++){
+			double t = (double) i / ratios[r].in;
+			in[i * 2 + 0] = 12000.0 * sin(2.0 * M_PI * 440.0 * t) +
+				(rand() % 2000 - 1000);
+			in[i * 2 + 1] = 12000.0 * sin(2.0 * M_PI * 3150.0 * t) +
+				(rand() % 2000 - 1000);
+		}
+
+		for (int q = SPEEX_RESAMPLER_QUALITY_MIN; q <= SPEEX_RESAMPLER_QUALITY_MAX; q++){
+			size_t n_ref, n_vec;
+			speex_resampler_kernel(1);
+			double t_ref = run(ratios[r].in, ratios[r].out, q, in, in_len, ref, out_len, &n_ref);
+			speex_resampler_kernel(0);
+			double t_vec = run(ratios[r].in, ratios[r].out, q, in, in_len, vec, out_len, &n_vec);
+
+			double maxdiff = 0;
+			size_t n = n_ref < n_vec ? n_ref : n_vec;
+			for (size_t i = 0; i < n * 2; i++){
+				double d = fabs(ref[i] - vec[i]);
+				if (d > maxdiff)
+					maxdiff = d;
+			}
+
+			char label[32];
+			snprintf(label, sizeof(label), "%u->%u", ratios[r].in, ratios[r].out);
+			printf("%-14s %3d %12.1f %12.1f %7.2fx %12.4f%s\n", label, q,
+				seconds / t_ref, seconds / t_vec, t_ref / t_vec, maxdiff,
+				n_ref != n_vec ? " (length mismatch)" : "");
+		}
+
+		free(in);
+		free(ref);
+		free(vec);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,335 @@
+/*
+ * Test and benchmark for the uniform shadow cache in the shader manager
+ * (platform/agp/shdrmgmt.c). The GL function table is replaced with a mock
+ * that keeps the uniform values of each program, so after every step the
+ * state the programs actually hold can be compared against what was pushed,
+ * i.e. what uploading everything every time would have resulted in. A scene
+ * of objects drawn with a few shared shaders and uniform groups is replayed
+ * for a number of frames and the uniform calls issued and skipped reported.
+ *
+ * Usage: shader_cache [objects, default 500] [frames, default 100]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "glfun.h"
+
+#include "platform.h"
+
+#include "arcan_math.h"
+#include "arcan_general.h"
+
+bool arcan_trace_enabled = false;
+
+void arcan_trace_mark(
+	const char* sys, const char* subsys,
+	uint8_t trigger, uint8_t tracelevel,
+	uint64_t identifier,
+	uint32_t quant, const char* message,
+	const char* file_name, const char* func_name, uint32_t line)
+{
+}
+
+void arcan_warning(const char* msg, ...)
+{
+}
+
+void arcan_fatal(const char* msg, ...)
+{
+	va_list args;
+	va_start(args, msg);
+	vfprintf(stderr, msg, args);
+	va_end(args);
+	abort();
+}
+
+agp_shader_id agp_default_shader(enum SHADER_TYPES type)
+{
+	return BROKEN_SHADER;
+}
+
+void agp_shader_source(enum SHADER_TYPES type, const char** vert, const char** frag)
+{
+	*vert = "void main(){}";
+	*frag = "void main(){}";
+}
+
+/*
+ * Mock GL, a uniform 'exists' in a program if the name is found in the
+ * sources attached to it, locations are handed out in order of lookup.
+ */
+#define MOCK_PRG 64
+#define MOCK_LOC 32
+
+struct mock_prg {
+	char src[4096];
+	char* names[MOCK_LOC];
+	size_t n_names;
+	uint8_t val[MOCK_LOC][64];
+};
+
+static struct mock_prg prgs[MOCK_PRG];
+static char* shaders[MOCK_PRG * 2];
+static GLuint n_prg, n_shader, cur_prg;
+static size_t gl_calls;
+
+static GLuint m_create_shader(GLenum stage)
+{
+	return ++n_shader;
+}
+
+static void m_shader_source(GLuint id,
+	GLsizei n, const GLchar** src, const GLint* len)
+{
+	shaders[id] = strdup(src[0]);
+}
+
+static void m_nop(GLuint id)
+{
+}
+
+static void m_get_iv(GLuint id, GLenum kind, GLint* out)
+{
+	*out = GL_TRUE;
+}
+
+static void m_shader_log(GLuint id, GLsizei lim, GLsizei* len, GLchar* buf)
+{
+	*len = 0;
+}
+
+static GLuint m_create_program()
+{
+	return ++n_prg;
+}
+
+static void m_attach_shader(GLuint prg, GLuint shader)
+{
+	strncat(prgs[prg].src, shaders[shader],
+		sizeof(prgs[prg].src) - strlen(prgs[prg].src) - 1);
+}
+
+static void m_use_program(GLuint prg)
+{
+	cur_prg = prg;
+}
+
+static GLint m_get_uniform_loc(GLuint prg, const GLchar* name)
+{
+	struct mock_prg* p = &prgs[prg];
+	if (!strstr(p->src, name))
+		return -1;
+
+	for (size_t i = 0; i < p->n_names; i++)
+		if (strcmp(p->names[i], name) == 0)
+			return i;
+
+	p->names[p->n_names] = strdup(name);
+	return p->n_names++;
+}
+
+static GLint m_get_attr_loc(GLuint prg, const GLchar* name)
+{
+	return -1;
+}
+
+static void m_unif_1i(GLint loc, GLint v)
+{
+	memcpy(prgs[cur_prg].val[loc], &v, sizeof(v));
+	gl_calls++;
+}
+
+static void m_unif_1f(GLint loc, GLfloat v)
+{
+	memcpy(prgs[cur_prg].val[loc], &v, sizeof(v));
+	gl_calls++;
+}
+
+static void m_unif_2f(GLint loc, GLfloat a, GLfloat b)
+{
+	GLfloat v[] = {a, b};
+	memcpy(prgs[cur_prg].val[loc], v, sizeof(v));
+	gl_calls++;
+}
+
+static void m_unif_3f(GLint loc, GLfloat a, GLfloat b, GLfloat c)
+{
+	GLfloat v[] = {a, b, c};
+	memcpy(prgs[cur_prg].val[loc], v, sizeof(v));
+	gl_calls++;
+}
+
+static void m_unif_4f(GLint loc, GLfloat a, GLfloat b, GLfloat c, GLfloat d)
+{
+	GLfloat v[] = {a, b, c, d};
+	memcpy(prgs[cur_prg].val[loc], v, sizeof(v));
+	gl_calls++;
+}
+
+static void m_unif_m4fv(GLint loc, GLsizei n, GLboolean tp, const GLfloat* v)
+{
+	memcpy(prgs[cur_prg].val[loc], v, sizeof(GLfloat) * 16);
+	gl_calls++;
+}
+
+static struct agp_fenv mock_env = {
+	.create_shader = m_create_shader,
+	.shader_source = m_shader_source,
+	.compile_shader = m_nop,
+	.get_shader_iv = m_get_iv,
+	.shader_log = m_shader_log,
+	.create_program = m_create_program,
+	.attach_shader = m_attach_shader,
+	.link_program = m_nop,
+	.get_program_iv = m_get_iv,
+	.use_program = m_use_program,
+	.delete_program = m_nop,
+	.delete_shader = m_nop,
+	.get_uniform_loc = m_get_uniform_loc,
+	.get_attr_loc = m_get_attr_loc,
+	.unif_1i = m_unif_1i,
+	.unif_1f = m_unif_1f,
+	.unif_2f = m_unif_2f,
+	.unif_3f = m_unif_3f,
+	.unif_4f = m_unif_4f,
+	.unif_m4fv = m_unif_m4fv
+};
+
+struct agp_fenv* agp_env()
+{
+	return &mock_env;
+}
+
+/* what the bound program should hold for [name], bytes [sz] */
+static bool verify(const char* name, const void* val, size_t sz)
+{
+	struct mock_prg* p = &prgs[cur_prg];
+	for (size_t i = 0; i < p->n_names; i++)
+		if (strcmp(p->names[i], name) == 0)
+			return memcmp(p->val[i], val, sz) == 0;
+
+/* not in the program, nothing to hold */
+	return true;
+}
+
+#define CHECK(X, ...) do { if (!(X)){\
+	fprintf(stderr, __VA_ARGS__); return EXIT_FAILURE; } } while(0)
+
+static const char* vprg_a =
+	"uniform mat4 modelview; uniform mat4 projection; void main(){}";
+static const char* fprg_a =
+	"uniform float obj_opacity; void main(){}";
+static const char* fprg_b =
+	"uniform float obj_opacity; uniform vec4 tint; uniform int timestamp;"
+	"void main(){}";
+static const char* fprg_c =
+	"uniform float obj_opacity; uniform vec2 obj_output_sz; void main(){}";
+
+int main(int argc, char** argv)
+{
+	size_t n_obj = argc > 1 ? strtoul(argv[1], NULL, 10) : 500;
+	size_t n_frames = argc > 2 ? strtoul(argv[2], NULL, 10) : 100;
+	if (!n_obj)
+		n_obj = 500;
+	if (!n_frames)
+		n_frames = 100;
+
+	agp_shader_id sh[3] = {
+		agp_shader_build("a", NULL, vprg_a, fprg_a),
+		agp_shader_build("b", NULL, vprg_a, fprg_b),
+		agp_shader_build("c", NULL, vprg_a, fprg_c)
+	};
+	CHECK(sh[0] != BROKEN_SHADER &&
+		sh[1] != BROKEN_SHADER && sh[2] != BROKEN_SHADER, "shader build failed\n");
+
+/* four uniform groups of b, each with its own tint */
+	agp_shader_id groups[4];
+	float tints[4][4];
+	for (size_t i = 0; i < 4; i++){
+		groups[i] = i ? agp_shader_addgroup(sh[1]) : sh[1];
+		CHECK(groups[i] != BROKEN_SHADER, "addgroup failed\n");
+		for (size_t j = 0; j < 4; j++)
+			tints[i][j] = (float)(i + 1) / (j + 1);
+		agp_shader_activate(groups[i]);
+		agp_shader_forceunif("tint", shdrvec4, tints[i]);
+	}
+
+/* the same value again is a no-op */
+	struct agp_shader_stats st;
+	agp_shader_stats(NULL, true);
+	size_t calls = gl_calls;
+	agp_shader_forceunif("tint", shdrvec4, tints[3]);
+	agp_shader_stats(&st, true);
+	CHECK(gl_calls == calls && st.skipped == 1 && st.issued == 0,
+		"repeated forceunif was uploaded\n");
+
+	float proj[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1};
+	float out_sz[2] = {640, 480};
+	calls = gl_calls;
+	agp_shader_stats(NULL, true);
+
+	struct timespec ts0, ts1;
+	clock_gettime(CLOCK_MONOTONIC, &ts0);
+
+	for (size_t f = 0; f < n_frames; f++){
+/* per frame environment, as a rendertarget pass would set it */
+		proj[0] = 1.0f + (f % 2);
+		agp_shader_envv(PROJECTION_MATR, proj, sizeof(float) * 16);
+		int32_t tsv = f;
+		agp_shader_envv(TIMESTAMP_D, &tsv, sizeof(int32_t));
+		agp_shader_envv(SIZE_OUTPUT, out_sz, sizeof(float) * 2);
+
+		for (size_t i = 0; i < n_obj; i++){
+/* runs of objects share a shader, b cycles through its groups */
+			size_t run = (i / 8) % 3;
+			agp_shader_id id = run == 1 ? groups[(i / 24) % 4] : sh[run];
+			agp_shader_activate(id);
+
+			float mv[16] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, i, f, 0, 1};
+			agp_shader_envv(MODELVIEW_MATR, mv, sizeof(float) * 16);
+			float opa = i % 10 ? 1.0 : 0.5;
+			agp_shader_envv(OBJ_OPACITY, &opa, sizeof(float));
+
+			CHECK(verify("modelview", mv, sizeof(mv)) &&
+				verify("projection", proj, sizeof(proj)) &&
+				verify("obj_opacity", &opa, sizeof(float)) &&
+				verify("timestamp", &tsv, sizeof(int32_t)) &&
+				verify("obj_output_sz", out_sz, sizeof(out_sz)) &&
+				(run != 1 || verify("tint", tints[(i / 24) % 4], sizeof(float) * 4)),
+				"frame %zu, object %zu: program state mismatch\n", f, i);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts1);
+	double elapsed = (ts1.tv_sec - ts0.tv_sec) + (ts1.tv_nsec - ts0.tv_nsec) / 1e9;
+
+	agp_shader_stats(&st, false);
+	calls = gl_calls - calls;
+	CHECK(calls == st.issued, "%zu GL calls, %zu counted as issued\n",
+		calls, (size_t) st.issued);
+
+	printf("%zu objects, %zu frames, 3 shaders (4 groups)\n", n_obj, n_frames);
+	printf("%-12s %12s %12s %14s\n", "", "issued", "skipped", "issued/frame");
+	printf("%-12s %12zu %12s %14.1f\n", "uncached",
+		(size_t)(st.issued + st.skipped), "-",
+		(double)(st.issued + st.skipped) / n_frames);
+	printf("%-12s %12zu %12zu %14.1f\n", "cached",
+		(size_t) st.issued, (size_t) st.skipped, (double) st.issued / n_frames);
+	printf("%.2f us/object (mock GL)\n", elapsed * 1e6 / (n_obj * n_frames));
+
+/* after a rebuild the programs are new and everything has to go again */
+	agp_shader_rebuild_all();
+	agp_shader_activate(sh[0]);
+	agp_shader_activate(groups[2]);
+	CHECK(verify("projection", proj, sizeof(proj)) &&
+		verify("obj_output_sz", out_sz, sizeof(out_sz)) &&
+		verify("tint", tints[2], sizeof(float) * 4), "state lost on rebuild\n");
+
+	agp_shader_flush();
+	return EXIT_SUCCESS;
+}